@@ -0,0 +1,246 @@
+// Range aggregate benchmark: fills ChannelModel history with 1e9 samples of
+// slowly wandering multi-channel lines, then times get_aggregate over random
+// windows from 1 s to the whole session and get_aggregate_buckets for
+// dashboard-style bucketing, against decoding the same windows with
+// read_history and folding the samples. The whole-session aggregate of
+// every channel is checked against what was ingested.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "bench_util.h"
+#include "benchmarks.h"
+#include "channel_model.h"
+
+namespace {
+struct AggregateConfig {
+    int channels = 32;
+    double samples = 1e9;
+    double rate = 1000.0;
+    int queries = 200;
+    int baseline = 5;
+    double history_mb = 16384.0;
+    std::string spill_dir;
+    std::string json_out;
+};
+
+struct WindowResult {
+    const char* name;
+    double seconds;
+    double width;
+    double query_us = 0.0;
+    double samples = 0.0;
+};
+
+void print_usage() {
+    std::fprintf(stderr,
+        "Usage: simple_com_chart_bench aggregate [options]\n"
+        "\n"
+        "  --channels N     channels (default 32)\n"
+        "  --samples N      samples in total (default 1e9)\n"
+        "  --rate N         lines/s, one sample per channel each, up to 2000 as\n"
+        "                   closer samples are merged (default 1000)\n"
+        "  --queries N      queries per window size (default 200)\n"
+        "  --baseline N     1 h windows also read and folded sample by sample\n"
+        "                   (default 5)\n"
+        "  --history-mb N   in-memory history budget (default 16384)\n"
+        "  --spill-dir DIR  spill history past the budget to segment files in DIR\n"
+        "  --json FILE      write the results as JSON\n");
+}
+
+bool parse_config(int argc, char** argv, AggregateConfig* cfg, std::string* error) {
+    bench::Args args(argc, argv, 0);
+    if (args.flag("--help") || args.flag("-h")) {
+        return false;
+    }
+    double number = 0.0;
+    if (args.number("--channels", &number)) {
+        cfg->channels = static_cast<int>(number);
+    }
+    args.number("--samples", &cfg->samples);
+    args.number("--rate", &cfg->rate);
+    if (args.number("--queries", &number)) {
+        cfg->queries = static_cast<int>(number);
+    }
+    if (args.number("--baseline", &number)) {
+        cfg->baseline = static_cast<int>(number);
+    }
+    args.number("--history-mb", &cfg->history_mb);
+    args.text("--spill-dir", &cfg->spill_dir);
+    args.text("--json", &cfg->json_out);
+    if (!args.finish(error)) {
+        return false;
+    }
+    if (cfg->channels < 1 || cfg->channels > ChannelModel::kMaxChannels || cfg->rate <= 0.0 || cfg->rate > 2000.0 ||
+        cfg->samples / cfg->channels / cfg->rate < 60.0 || cfg->queries < 1 || cfg->baseline < 0 ||
+        cfg->history_mb <= 0.0) {
+        *error = "Invalid aggregate configuration (the session must last at least 60 s)";
+        return false;
+    }
+    return true;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+} // namespace
+
+int run_aggregate_bench(int argc, char** argv) {
+    AggregateConfig cfg;
+    std::string error;
+    if (!parse_config(argc, argv, &cfg, &error)) {
+        if (!error.empty()) {
+            std::fprintf(stderr, "%s\n\n", error.c_str());
+        }
+        print_usage();
+        return error.empty() ? 0 : 1;
+    }
+
+    ChannelModel model;
+    model.set_time_window(10.0);
+    model.set_history_budget(static_cast<size_t>(cfg.history_mb * 1024.0 * 1024.0));
+    if (!cfg.spill_dir.empty() && !model.enable_spill(cfg.spill_dir, &error)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 2;
+    }
+    std::vector<std::string> keys;
+    for (int ch = 0; ch < cfg.channels; ++ch) {
+        keys.push_back("ch" + std::to_string(ch));
+    }
+
+    // Random walks of a few mV per step that often hold their value.
+    std::mt19937 rng(4242);
+    std::vector<int> values(static_cast<size_t>(cfg.channels), 2000);
+    std::vector<long long> sums(static_cast<size_t>(cfg.channels), 0);
+    std::unordered_map<std::string, int> kv;
+    const uint64_t lines = static_cast<uint64_t>(cfg.samples / cfg.channels);
+    const uint64_t lines_per_frame = static_cast<uint64_t>(0.05 * cfg.rate) + 1;
+    const double session = static_cast<double>(lines) / cfg.rate;
+
+    auto a = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < lines; ++i) {
+        double line_ts = static_cast<double>(i) / cfg.rate;
+        kv.clear();
+        for (int ch = 0; ch < cfg.channels; ++ch) {
+            uint32_t r = rng();
+            int& v = values[static_cast<size_t>(ch)];
+            if ((r & 3) == 0) {
+                v = std::max(0, v + static_cast<int>((r >> 2) % 7) - 3);
+            }
+            kv[keys[static_cast<size_t>(ch)]] = v;
+            sums[static_cast<size_t>(ch)] += v;
+        }
+        model.update_from_kv(kv, line_ts);
+        if (i % lines_per_frame == 0) {
+            model.prune(line_ts);
+        }
+    }
+    model.prune(session);
+    double fill_s = seconds_since(a);
+    model.flush_spill();
+
+    // Whole session per channel, checked against the ingested values.
+    RangeAggregate total;
+    auto b = std::chrono::steady_clock::now();
+    for (size_t ch = 0; ch < keys.size(); ++ch) {
+        RangeAggregate agg;
+        model.get_aggregate(keys[ch], 0.0, session, &agg);
+        if (agg.count != lines || agg.sum != sums[ch]) {
+            std::fprintf(stderr, "%s: aggregate %llu samples, sum %lld; ingested %llu, sum %lld\n",
+                         keys[ch].c_str(), static_cast<unsigned long long>(agg.count),
+                         static_cast<long long>(agg.sum), static_cast<unsigned long long>(lines), sums[ch]);
+            return 3;
+        }
+        total.add(agg);
+    }
+    double full_ms = seconds_since(b) * 1e3 / static_cast<double>(keys.size());
+
+    // Random windows, plain and bucketed.
+    std::vector<WindowResult> windows = {
+        {"1 s", 1.0, 0.0},
+        {"1 min", 60.0, 0.0},
+        {"1 h", 3600.0, 0.0},
+        {"session", session, 0.0},
+        {"1 min / 100 ms", 60.0, 0.1},
+        {"1 h / 3.6 s", 3600.0, 3.6},
+        {"session / 1000", session, session / 1000.0},
+    };
+    std::vector<RangeAggregate> buckets;
+    for (WindowResult& w : windows) {
+        double span = std::min(w.seconds, session);
+        std::uniform_real_distribution<double> pos(0.0, session - span);
+        double samples = 0.0;
+        auto c = std::chrono::steady_clock::now();
+        for (int q = 0; q < cfg.queries; ++q) {
+            double t0 = pos(rng);
+            model.get_aggregate_buckets(keys[static_cast<size_t>(q) % keys.size()], t0, t0 + span, w.width, &buckets);
+            for (const RangeAggregate& bucket : buckets) {
+                samples += static_cast<double>(bucket.count);
+            }
+        }
+        w.query_us = seconds_since(c) * 1e6 / cfg.queries;
+        w.samples = samples / cfg.queries;
+    }
+
+    // The same 1 h windows read back and folded sample by sample.
+    std::vector<ChannelSample> out;
+    double baseline_us = 0.0;
+    if (cfg.baseline > 0) {
+        double span = std::min(3600.0, session);
+        std::uniform_real_distribution<double> pos(0.0, session - span);
+        auto d = std::chrono::steady_clock::now();
+        for (int q = 0; q < cfg.baseline; ++q) {
+            double t0 = pos(rng);
+            out.clear();
+            model.read_history(keys[static_cast<size_t>(q) % keys.size()], t0, t0 + span, &out);
+            RangeAggregate agg;
+            for (const ChannelSample& s : out) {
+                agg.add(s.t, s.v);
+            }
+        }
+        baseline_us = seconds_since(d) * 1e6 / cfg.baseline;
+    }
+
+    uint64_t history = model.get_history_samples() + model.get_spilled_samples();
+    std::printf("%d channels x %.0f samples/s, %.0f s session, %llu samples in history\n", cfg.channels, cfg.rate,
+                session, static_cast<unsigned long long>(history));
+    std::printf("fill         %.1f s (%.1f ns/sample)\n", fill_s,
+                fill_s * 1e9 / static_cast<double>(lines * keys.size()));
+    std::printf("session      %.3f ms per channel (%llu samples, mean %.2f)\n", full_ms,
+                static_cast<unsigned long long>(total.count / keys.size()), total.mean());
+    for (const WindowResult& w : windows) {
+        std::printf("%-16s %10.1f us per query (%.0f samples)\n", w.name, w.query_us, w.samples);
+    }
+    if (cfg.baseline > 0) {
+        const WindowResult& hour = windows[2];
+        std::printf("1 h read+fold %9.1f us per query (%.0fx the aggregate)\n", baseline_us,
+                    hour.query_us > 0.0 ? baseline_us / hour.query_us : 0.0);
+    }
+
+    if (!cfg.json_out.empty()) {
+        std::string json = "{\n";
+        char buf[256] = {};
+        std::snprintf(buf, sizeof(buf), "  \"samples\": %llu,\n  \"fill_s\": %.2f,\n  \"session_ms\": %.4f,\n",
+                      static_cast<unsigned long long>(history), fill_s, full_ms);
+        json += buf;
+        json += "  \"windows\": [\n";
+        for (size_t i = 0; i < windows.size(); ++i) {
+            std::snprintf(buf, sizeof(buf), "    {\"name\": \"%s\", \"query_us\": %.2f, \"samples\": %.0f}%s\n",
+                          windows[i].name, windows[i].query_us, windows[i].samples,
+                          i + 1 < windows.size() ? "," : "");
+            json += buf;
+        }
+        std::snprintf(buf, sizeof(buf), "  ],\n  \"hour_read_fold_us\": %.2f\n}\n", baseline_us);
+        json += buf;
+        if (!bench::write_text_file(cfg.json_out, json, &error)) {
+            std::fprintf(stderr, "%s\n", error.c_str());
+            return 2;
+        }
+    }
+    return 0;
+}
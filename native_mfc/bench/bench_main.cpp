@@ -0,0 +1,48 @@
+// Benchmark drivers for the capture pipeline. Built on the same core library
+// as the GUI and the headless tool.
+
+#include <cstdio>
+#include <cstring>
+
+#include "benchmarks.h"
+
+namespace {
+struct Command {
+    const char* name;
+    const char* summary;
+    int (*run)(int argc, char** argv);
+};
+
+const Command kCommands[] = {
+    {"soak", "max zero-drop rate search + long soak with RSS tracking", run_soak_bench},
+    {"storage", "ChannelModel ring storage vs std::deque", run_storage_bench},
+    {"history", "compressed history size, decode and window read speed", run_history_bench},
+    {"filter", "smoothing filter throughput, streaming and batched", run_filter_bench},
+    {"resample", "aligned CSV export from history with each resampling policy", run_resample_bench},
+    {"reference", "multi-hour reference overlays: index build and per-frame draw cost", run_reference_bench},
+    {"aggregate", "range aggregates over 1e9-sample histories vs decoding them", run_aggregate_bench},
+};
+
+void print_usage(const char* argv0) {
+    std::fprintf(stderr, "Usage: %s <command> [options]\n\nCommands:\n", argv0);
+    for (const auto& cmd : kCommands) {
+        std::fprintf(stderr, "  %-10s %s\n", cmd.name, cmd.summary);
+    }
+    std::fprintf(stderr, "\nRun '%s <command> --help' for command options.\n", argv0);
+}
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2 || std::strcmp(argv[1], "-h") == 0 || std::strcmp(argv[1], "--help") == 0) {
+        print_usage(argv[0]);
+        return argc < 2 ? 1 : 0;
+    }
+    for (const auto& cmd : kCommands) {
+        if (std::strcmp(argv[1], cmd.name) == 0) {
+            return cmd.run(argc - 2, argv + 2);
+        }
+    }
+    std::fprintf(stderr, "Unknown command: %s\n\n", argv[1]);
+    print_usage(argv[0]);
+    return 1;
+}
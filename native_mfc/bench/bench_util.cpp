@@ -0,0 +1,174 @@
+#include "bench_util.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#elif defined(__linux__)
+#include <unistd.h>
+#endif
+
+namespace {
+std::atomic<uint64_t> g_allocations{0};
+} // namespace
+
+void* operator new(std::size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+namespace bench {
+
+uint64_t allocation_count() {
+    return g_allocations.load(std::memory_order_relaxed);
+}
+
+uint64_t current_rss_bytes() {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS pmc = {};
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+        return static_cast<uint64_t>(pmc.WorkingSetSize);
+    }
+    return 0;
+#elif defined(__linux__)
+    FILE* f = std::fopen("/proc/self/statm", "r");
+    if (!f) {
+        return 0;
+    }
+    unsigned long long size = 0;
+    unsigned long long resident = 0;
+    int n = std::fscanf(f, "%llu %llu", &size, &resident);
+    std::fclose(f);
+    if (n != 2) {
+        return 0;
+    }
+    return static_cast<uint64_t>(resident) * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+#else
+    return 0;
+#endif
+}
+
+uint64_t private_rss_bytes() {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS pmc = {};
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+        return static_cast<uint64_t>(pmc.PagefileUsage);
+    }
+    return 0;
+#elif defined(__linux__)
+    FILE* f = std::fopen("/proc/self/statm", "r");
+    if (!f) {
+        return 0;
+    }
+    unsigned long long size = 0;
+    unsigned long long resident = 0;
+    unsigned long long shared = 0;
+    int n = std::fscanf(f, "%llu %llu %llu", &size, &resident, &shared);
+    std::fclose(f);
+    if (n != 3 || shared > resident) {
+        return 0;
+    }
+    return static_cast<uint64_t>(resident - shared) * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+#else
+    return 0;
+#endif
+}
+
+Args::Args(int argc, char** argv, int first) {
+    for (int i = first; i < argc; ++i) {
+        args_.push_back(argv[i]);
+    }
+    used_.assign(args_.size(), false);
+}
+
+bool Args::flag(const char* name) {
+    for (size_t i = 0; i < args_.size(); ++i) {
+        if (!used_[i] && args_[i] == name) {
+            used_[i] = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Args::text(const char* name, std::string* out) {
+    for (size_t i = 0; i < args_.size(); ++i) {
+        if (used_[i] || args_[i] != name) {
+            continue;
+        }
+        used_[i] = true;
+        if (i + 1 >= args_.size()) {
+            error_ = std::string("Missing value for ") + name;
+            return false;
+        }
+        used_[i + 1] = true;
+        *out = args_[i + 1];
+        return true;
+    }
+    return false;
+}
+
+bool Args::number(const char* name, double* out) {
+    std::string value;
+    if (!text(name, &value)) {
+        return false;
+    }
+    char* end = nullptr;
+    double parsed = std::strtod(value.c_str(), &end);
+    if (value.empty() || (end && *end != '\0')) {
+        error_ = std::string("Invalid value for ") + name + ": " + value;
+        return false;
+    }
+    *out = parsed;
+    return true;
+}
+
+bool Args::finish(std::string* error) const {
+    if (!error_.empty()) {
+        *error = error_;
+        return false;
+    }
+    for (size_t i = 0; i < args_.size(); ++i) {
+        if (!used_[i]) {
+            *error = "Unknown argument: " + args_[i];
+            return false;
+        }
+    }
+    return true;
+}
+
+bool write_text_file(const std::string& path, const std::string& text, std::string* error) {
+    std::ofstream f(path, std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!f) {
+        *error = "Cannot create file: " + path;
+        return false;
+    }
+    f << text;
+    if (!f) {
+        *error = "Write failed: " + path;
+        return false;
+    }
+    return true;
+}
+
+} // namespace bench
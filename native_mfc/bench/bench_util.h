@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Helpers shared by the benchmark drivers.
+namespace bench {
+
+// Resident set size of this process in bytes, or 0 when unavailable.
+uint64_t current_rss_bytes();
+// Resident memory not backed by files (mapped files' pages excluded).
+uint64_t private_rss_bytes();
+
+// Number of global operator new calls so far (the bench binary replaces
+// operator new to count them).
+uint64_t allocation_count();
+
+// Simple "--name value" argument reader used by every subcommand.
+class Args {
+public:
+    Args(int argc, char** argv, int first);
+
+    bool flag(const char* name);
+    bool number(const char* name, double* out);
+    bool text(const char* name, std::string* out);
+
+    // Reports the first malformed or unknown argument, if any.
+    bool finish(std::string* error) const;
+
+private:
+    std::vector<std::string> args_;
+    std::vector<bool> used_;
+    std::string error_;
+};
+
+bool write_text_file(const std::string& path, const std::string& text, std::string* error);
+
+} // namespace bench
@@ -0,0 +1,11 @@
+#pragma once
+
+// Entry points of the simple_com_chart_bench subcommands. Each receives the
+// arguments that follow the subcommand name.
+int run_soak_bench(int argc, char** argv);
+int run_storage_bench(int argc, char** argv);
+int run_history_bench(int argc, char** argv);
+int run_filter_bench(int argc, char** argv);
+int run_resample_bench(int argc, char** argv);
+int run_reference_bench(int argc, char** argv);
+int run_aggregate_bench(int argc, char** argv);
@@ -0,0 +1,212 @@
+// Filter benchmark: runs a noisy mV trace through each smoothing filter one
+// sample at a time (the ingest path) and in blocks (the path that primes a
+// filter added mid-capture), checks the two agree, and reports throughput.
+// A last pass measures ChannelModel ingest with and without one filtered
+// derived channel per received channel.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "bench_util.h"
+#include "benchmarks.h"
+#include "channel_filter.h"
+#include "channel_model.h"
+
+namespace {
+struct FilterConfig {
+    double samples = 1e7;
+    int block = 4096;
+    int channels = 8;
+    std::string json_out;
+};
+
+struct FilterResult {
+    const char* definition;
+    double stream_msps = 0.0;
+    double batch_msps = 0.0;
+    double max_diff = 0.0;
+};
+
+void print_usage() {
+    std::fprintf(stderr,
+        "Usage: simple_com_chart_bench filter [options]\n"
+        "\n"
+        "  --samples N      samples per filter (default 1e7)\n"
+        "  --block N        batch size (default 4096)\n"
+        "  --channels N     channels for the ingest pass (default 8)\n"
+        "  --json FILE      write the results as JSON\n");
+}
+
+bool parse_config(int argc, char** argv, FilterConfig* cfg, std::string* error) {
+    bench::Args args(argc, argv, 0);
+    if (args.flag("--help") || args.flag("-h")) {
+        return false;
+    }
+    double number = 0.0;
+    args.number("--samples", &cfg->samples);
+    if (args.number("--block", &number)) {
+        cfg->block = static_cast<int>(number);
+    }
+    if (args.number("--channels", &number)) {
+        cfg->channels = static_cast<int>(number);
+    }
+    args.text("--json", &cfg->json_out);
+    if (!args.finish(error)) {
+        return false;
+    }
+    if (cfg->samples < 1e4 || cfg->block < 1 || cfg->channels < 1 ||
+        cfg->channels * 2 > ChannelModel::kMaxChannels) {
+        *error = "Invalid filter configuration";
+        return false;
+    }
+    return true;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Slow sine plus uniform noise and rare spikes, like a noisy ADC channel.
+std::vector<double> make_trace(size_t n) {
+    std::mt19937 rng(4242);
+    std::uniform_int_distribution<int> noise(-40, 40);
+    std::vector<double> x(n);
+    for (size_t i = 0; i < n; ++i) {
+        double v = 3300.0 + 500.0 * std::sin(static_cast<double>(i) * 1e-4) + noise(rng);
+        if (rng() % 1000 == 0) {
+            v += 2000.0;
+        }
+        x[i] = std::round(v);
+    }
+    return x;
+}
+
+// ns per line for update_from_kv with the given derived definition per
+// channel (none when empty).
+double ingest_ns(const FilterConfig& cfg, const std::vector<double>& trace, const std::string& definition) {
+    ChannelModel model;
+    model.set_time_window(5.0);
+    model.set_history_budget(0);
+    std::vector<std::string> keys;
+    for (int ch = 0; ch < cfg.channels; ++ch) {
+        keys.push_back("ch" + std::to_string(ch));
+        if (!definition.empty()) {
+            std::string error;
+            std::string expr = definition;
+            expr.replace(expr.find('x'), 1, keys.back());
+            model.add_derived_channel("f" + std::to_string(ch), expr, &error);
+        }
+    }
+    const size_t lines = std::min<size_t>(trace.size(), 1000000);
+    std::unordered_map<std::string, int> kv;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < lines; ++i) {
+        double t = static_cast<double>(i) * 0.001;
+        kv.clear();
+        for (int ch = 0; ch < cfg.channels; ++ch) {
+            kv[keys[static_cast<size_t>(ch)]] = static_cast<int>(trace[(i + static_cast<size_t>(ch) * 977) % trace.size()]);
+        }
+        model.update_from_kv(kv, t);
+        if (i % 50 == 0) {
+            model.prune(t);
+        }
+    }
+    return seconds_since(start) * 1e9 / static_cast<double>(lines);
+}
+} // namespace
+
+int run_filter_bench(int argc, char** argv) {
+    FilterConfig cfg;
+    std::string error;
+    if (!parse_config(argc, argv, &cfg, &error)) {
+        if (!error.empty()) {
+            std::fprintf(stderr, "%s\n\n", error.c_str());
+        }
+        print_usage();
+        return error.empty() ? 0 : 1;
+    }
+
+    const size_t n = static_cast<size_t>(cfg.samples);
+    std::vector<double> trace = make_trace(n);
+    std::vector<double> out_stream(n);
+    std::vector<double> out_batch(n);
+
+    std::vector<FilterResult> results = {
+        {"boxcar(x, 16)"}, {"boxcar(x, 256)"}, {"ema(x, 0.05)"}, {"lowpass(x, 0.02)"},
+        {"median(x, 9)"}, {"median(x, 255)"},
+    };
+    for (auto& r : results) {
+        FilterSpec spec;
+        std::string source;
+        if (!parse_filter_call(r.definition, &spec, &source, &error)) {
+            std::fprintf(stderr, "%s: %s\n", r.definition, error.c_str());
+            return 2;
+        }
+        ChannelFilter stream(spec);
+        auto a = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < n; ++i) {
+            out_stream[i] = stream.process(trace[i]);
+        }
+        r.stream_msps = static_cast<double>(n) / seconds_since(a) * 1e-6;
+
+        ChannelFilter batch(spec);
+        auto b = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < n; i += static_cast<size_t>(cfg.block)) {
+            size_t count = std::min(static_cast<size_t>(cfg.block), n - i);
+            batch.process_batch(trace.data() + i, out_batch.data() + i, count);
+        }
+        r.batch_msps = static_cast<double>(n) / seconds_since(b) * 1e-6;
+
+        for (size_t i = 0; i < n; ++i) {
+            r.max_diff = std::max(r.max_diff, std::fabs(out_stream[i] - out_batch[i]));
+        }
+    }
+
+    double base_ns = ingest_ns(cfg, trace, "");
+    double ema_ns = ingest_ns(cfg, trace, "ema(x, 0.05)");
+    double median_ns = ingest_ns(cfg, trace, "median(x, 9)");
+
+    std::printf("%.0f samples per filter, batches of %d\n", cfg.samples, cfg.block);
+    std::printf("%-18s %12s %12s %10s\n", "filter", "stream MS/s", "batch MS/s", "max diff");
+    for (const auto& r : results) {
+        std::printf("%-18s %12.1f %12.1f %10.2g\n", r.definition, r.stream_msps, r.batch_msps, r.max_diff);
+    }
+    std::printf("ingest, %d channels: %.0f ns/line raw, %.0f with ema, %.0f with median(9) per channel\n",
+                cfg.channels, base_ns, ema_ns, median_ns);
+
+    bool mismatch = false;
+    for (const auto& r : results) {
+        // The batch boxcar sums in a different order; everything else is exact.
+        if (r.max_diff > 1e-6) {
+            std::fprintf(stderr, "%s: batch output differs from streaming by %g\n", r.definition, r.max_diff);
+            mismatch = true;
+        }
+    }
+
+    if (!cfg.json_out.empty()) {
+        std::string json = "{\n  \"filters\": [\n";
+        char buf[256] = {};
+        for (size_t i = 0; i < results.size(); ++i) {
+            const auto& r = results[i];
+            std::snprintf(buf, sizeof(buf),
+                "    {\"filter\": \"%s\", \"stream_msamples_per_sec\": %.2f, \"batch_msamples_per_sec\": %.2f}%s\n",
+                r.definition, r.stream_msps, r.batch_msps, i + 1 < results.size() ? "," : "");
+            json += buf;
+        }
+        std::snprintf(buf, sizeof(buf),
+            "  ],\n  \"ingest_ns_per_line\": {\"raw\": %.1f, \"ema\": %.1f, \"median9\": %.1f}\n}\n",
+            base_ns, ema_ns, median_ns);
+        json += buf;
+        if (!bench::write_text_file(cfg.json_out, json, &error)) {
+            std::fprintf(stderr, "%s\n", error.c_str());
+            return 2;
+        }
+    }
+    return mismatch ? 3 : 0;
+}
@@ -0,0 +1,209 @@
+// Compressed history benchmark: streams slowly changing mV channels through
+// ChannelModel with a short hot window, so almost everything ends up in the
+// compressed history, then reports bytes per sample, decode throughput for a
+// full read and the cost of reading short windows at random positions.
+// With --spill-dir the history budget is kept small so most blocks go through
+// the on-disk spill tier and are read back from the mapped segments.
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "bench_util.h"
+#include "benchmarks.h"
+#include "channel_model.h"
+
+namespace {
+struct HistoryConfig {
+    int channels = 16;
+    double rate = 500.0;
+    double seconds = 3600.0;
+    double window = 10.0;
+    double jitter_us = 200.0;
+    int lookups = 1000;
+    double history_mb = 0.0;
+    std::string spill_dir;
+    std::string json_out;
+};
+
+void print_usage() {
+    std::fprintf(stderr,
+        "Usage: simple_com_chart_bench history [options]\n"
+        "\n"
+        "  --channels N     channels (default 16)\n"
+        "  --rate N         lines/s, one sample per channel each (default 500)\n"
+        "  --seconds SEC    simulated session length (default 3600)\n"
+        "  --window SEC     hot window (default 10)\n"
+        "  --jitter-us US   random arrival delay added to each line (default 200)\n"
+        "  --lookups N      random 1 s window reads (default 1000)\n"
+        "  --spill-dir DIR  spill history to segment files in DIR\n"
+        "  --history-mb N   in-memory history budget (default 16384, 4 with --spill-dir)\n"
+        "  --json FILE      write the results as JSON\n");
+}
+
+bool parse_config(int argc, char** argv, HistoryConfig* cfg, std::string* error) {
+    bench::Args args(argc, argv, 0);
+    if (args.flag("--help") || args.flag("-h")) {
+        return false;
+    }
+    double number = 0.0;
+    if (args.number("--channels", &number)) {
+        cfg->channels = static_cast<int>(number);
+    }
+    args.number("--rate", &cfg->rate);
+    args.number("--seconds", &cfg->seconds);
+    args.number("--window", &cfg->window);
+    args.number("--jitter-us", &cfg->jitter_us);
+    if (args.number("--lookups", &number)) {
+        cfg->lookups = static_cast<int>(number);
+    }
+    args.number("--history-mb", &cfg->history_mb);
+    args.text("--spill-dir", &cfg->spill_dir);
+    args.text("--json", &cfg->json_out);
+    if (!args.finish(error)) {
+        return false;
+    }
+    if (cfg->channels < 1 || cfg->channels > ChannelModel::kMaxChannels || cfg->rate <= 0.0 ||
+        cfg->window < 1.0 || cfg->seconds <= cfg->window || cfg->jitter_us < 0.0 || cfg->history_mb < 0.0 ||
+        cfg->jitter_us * 1e-6 >= 0.5 / cfg->rate) {
+        *error = "Invalid history configuration (--seconds must exceed --window, jitter below half a line)";
+        return false;
+    }
+    return true;
+}
+} // namespace
+
+int run_history_bench(int argc, char** argv) {
+    HistoryConfig cfg;
+    std::string error;
+    if (!parse_config(argc, argv, &cfg, &error)) {
+        if (!error.empty()) {
+            std::fprintf(stderr, "%s\n\n", error.c_str());
+        }
+        print_usage();
+        return error.empty() ? 0 : 1;
+    }
+
+    using clock = std::chrono::steady_clock;
+    ChannelModel model;
+    model.set_time_window(cfg.window);
+    double history_mb = cfg.history_mb > 0.0 ? cfg.history_mb : (cfg.spill_dir.empty() ? 16384.0 : 4.0);
+    model.set_history_budget(static_cast<size_t>(history_mb * 1024.0 * 1024.0));
+    if (!cfg.spill_dir.empty() && !model.enable_spill(cfg.spill_dir, &error)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 2;
+    }
+
+    std::vector<std::string> keys;
+    for (int ch = 0; ch < cfg.channels; ++ch) {
+        keys.push_back("ch" + std::to_string(ch));
+    }
+
+    // Random walks of a few mV per step that often hold their value.
+    std::mt19937 rng(12345);
+    std::vector<int> values(static_cast<size_t>(cfg.channels), 2000);
+    std::unordered_map<std::string, int> kv;
+    std::uniform_real_distribution<double> jitter(0.0, cfg.jitter_us * 1e-6);
+    const uint64_t lines = static_cast<uint64_t>(cfg.seconds * cfg.rate);
+    const uint64_t lines_per_frame = static_cast<uint64_t>(0.05 * cfg.rate) + 1;
+    long long ingested_sum = 0;
+    uint64_t ingested = 0;
+
+    auto a = clock::now();
+    for (uint64_t i = 0; i < lines; ++i) {
+        double read_ts = static_cast<double>(i) / cfg.rate + jitter(rng);
+        kv.clear();
+        for (int ch = 0; ch < cfg.channels; ++ch) {
+            uint32_t r = rng();
+            if ((r & 3) == 0) {
+                values[static_cast<size_t>(ch)] += static_cast<int>((r >> 2) % 7) - 3;
+                if (values[static_cast<size_t>(ch)] < 0) {
+                    values[static_cast<size_t>(ch)] = 0;
+                }
+            }
+            kv[keys[static_cast<size_t>(ch)]] = values[static_cast<size_t>(ch)];
+            ingested_sum += values[static_cast<size_t>(ch)];
+        }
+        ingested += static_cast<uint64_t>(model.update_from_kv(kv, read_ts));
+        if (i % lines_per_frame == 0) {
+            model.prune(read_ts);
+        }
+    }
+    model.prune(static_cast<double>(lines) / cfg.rate);
+    auto b = clock::now();
+    model.flush_spill();
+
+    uint64_t history = model.get_history_samples() + model.get_spilled_samples();
+    size_t history_bytes = model.get_history_bytes() + static_cast<size_t>(model.get_spilled_bytes());
+    double bytes_per_sample = history ? static_cast<double>(history_bytes) / static_cast<double>(history) : 0.0;
+    double ingest_ns = static_cast<double>(std::chrono::duration<double>(b - a).count()) * 1e9 /
+                       static_cast<double>(ingested ? ingested : 1);
+
+    // Full read of every channel, checked against what was ingested.
+    std::vector<ChannelSample> out;
+    long long read_sum = 0;
+    uint64_t read = 0;
+    auto c = clock::now();
+    for (const auto& key : keys) {
+        out.clear();
+        model.read_history(key, -1.0, cfg.seconds + 1.0, &out);
+        read += out.size();
+        for (const auto& s : out) {
+            read_sum += s.v;
+        }
+    }
+    auto d = clock::now();
+    double decode_msps = static_cast<double>(read) / std::chrono::duration<double>(d - c).count() * 1e-6;
+
+    // Short windows at random positions, as when scrolling through history.
+    std::uniform_real_distribution<double> pos(0.0, cfg.seconds - 1.0);
+    auto e = clock::now();
+    size_t window_samples = 0;
+    for (int i = 0; i < cfg.lookups; ++i) {
+        double t0 = pos(rng);
+        out.clear();
+        model.read_history(keys[static_cast<size_t>(i) % keys.size()], t0, t0 + 1.0, &out);
+        window_samples += out.size();
+    }
+    auto f = clock::now();
+    double lookup_us = cfg.lookups > 0
+        ? std::chrono::duration<double>(f - e).count() * 1e6 / static_cast<double>(cfg.lookups) : 0.0;
+
+    std::printf("%d channels x %.0f samples/s, %.0f s session, %.0f s hot window\n",
+                cfg.channels, cfg.rate, cfg.seconds, cfg.window);
+    std::printf("history      %llu samples in %.1f MB, %.3f bytes/sample\n",
+                static_cast<unsigned long long>(history), static_cast<double>(history_bytes) / (1024.0 * 1024.0),
+                bytes_per_sample);
+    if (model.is_spill_enabled()) {
+        std::printf("spilled      %llu samples in %.1f MB on disk\n",
+                    static_cast<unsigned long long>(model.get_spilled_samples()),
+                    static_cast<double>(model.get_spilled_bytes()) / (1024.0 * 1024.0));
+    }
+    std::printf("ingest       %.1f ns/sample (including compression)\n", ingest_ns);
+    std::printf("full read    %.1f M samples/s\n", decode_msps);
+    std::printf("1 s window   %.1f us per read (%.0f samples)\n", lookup_us,
+                cfg.lookups > 0 ? static_cast<double>(window_samples) / cfg.lookups : 0.0);
+    if (read != ingested || read_sum != ingested_sum) {
+        std::fprintf(stderr, "round trip mismatch: %llu/%llu samples, sum %lld/%lld\n",
+                     static_cast<unsigned long long>(read), static_cast<unsigned long long>(ingested),
+                     read_sum, ingested_sum);
+        return 3;
+    }
+
+    if (!cfg.json_out.empty()) {
+        char buf[512] = {};
+        std::snprintf(buf, sizeof(buf),
+            "{\n  \"samples\": %llu,\n  \"bytes\": %llu,\n  \"bytes_per_sample\": %.4f,\n"
+            "  \"ingest_ns\": %.2f,\n  \"decode_msamples_per_sec\": %.2f,\n  \"window_read_us\": %.2f\n}\n",
+            static_cast<unsigned long long>(history), static_cast<unsigned long long>(history_bytes),
+            bytes_per_sample, ingest_ns, decode_msps, lookup_us);
+        if (!bench::write_text_file(cfg.json_out, buf, &error)) {
+            std::fprintf(stderr, "%s\n", error.c_str());
+            return 2;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,310 @@
+// Reference overlay benchmark: writes multi-hour binary recordings, opens
+// them as references (timing the one-off index build and a cached reopen),
+// then times frames that draw a live window with and without the
+// references under it, like PlotView, and reports the private memory
+// they add (pages of the mapped indexes are page cache, not counted).
+
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "bench_util.h"
+#include "benchmarks.h"
+#include "channel_model.h"
+#include "recording.h"
+#include "reference_trace.h"
+
+namespace {
+struct ReferenceConfig {
+    int references = 3;
+    int channels = 4;
+    double hours = 1.0;
+    double rate = 1000.0;
+    int pixels = 1600;
+    std::string dir;
+    bool keep = false;
+    std::string json_out;
+};
+
+struct FrameResult {
+    double window = 0.0;
+    double live_us = 0.0;
+    double refs_us = 0.0;
+    double points = 0.0;
+};
+
+void print_usage() {
+    std::fprintf(stderr,
+        "Usage: simple_com_chart_bench reference [options]\n"
+        "\n"
+        "  --references N   recordings overlaid (default 3)\n"
+        "  --channels N     channels per recording and live (default 4)\n"
+        "  --hours H        length of each recording (default 1)\n"
+        "  --rate N         lines/s, one sample per channel each (default 1000)\n"
+        "  --pixels N       plot width (default 1600)\n"
+        "  --dir DIR        where recordings and indexes go (default: temp dir)\n"
+        "  --keep           keep the files for another run (reopens them)\n"
+        "  --json FILE      write the results as JSON\n");
+}
+
+bool parse_config(int argc, char** argv, ReferenceConfig* cfg, std::string* error) {
+    bench::Args args(argc, argv, 0);
+    if (args.flag("--help") || args.flag("-h")) {
+        return false;
+    }
+    double number = 0.0;
+    if (args.number("--references", &number)) {
+        cfg->references = static_cast<int>(number);
+    }
+    if (args.number("--channels", &number)) {
+        cfg->channels = static_cast<int>(number);
+    }
+    args.number("--hours", &cfg->hours);
+    args.number("--rate", &cfg->rate);
+    if (args.number("--pixels", &number)) {
+        cfg->pixels = static_cast<int>(number);
+    }
+    args.text("--dir", &cfg->dir);
+    cfg->keep = args.flag("--keep");
+    args.text("--json", &cfg->json_out);
+    if (!args.finish(error)) {
+        return false;
+    }
+    if (cfg->references < 1 || cfg->channels < 1 || cfg->channels > 64 || cfg->hours <= 0.0 ||
+        cfg->rate <= 0.0 || cfg->pixels < 100) {
+        *error = "Invalid reference configuration";
+        return false;
+    }
+    return true;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Charge-cycle-like channels: slow ramps with noise and a few steps.
+void write_recording(const std::string& path, const ReferenceConfig& cfg, unsigned seed, std::string* error) {
+    RecordingWriter writer;
+    if (!writer.open(path, RecordingWriter::Format::kBinary, error)) {
+        return;
+    }
+    std::mt19937 rng(seed);
+    std::unordered_map<std::string, int> kv;
+    std::vector<std::string> keys;
+    for (int ch = 0; ch < cfg.channels; ++ch) {
+        keys.push_back("ch" + std::to_string(ch));
+    }
+    const uint64_t lines = static_cast<uint64_t>(cfg.hours * 3600.0 * cfg.rate);
+    for (uint64_t i = 0; i < lines; ++i) {
+        double t = static_cast<double>(i) / cfg.rate;
+        kv.clear();
+        for (int ch = 0; ch < cfg.channels; ++ch) {
+            double phase = t / (600.0 + 60.0 * ch);
+            int v = static_cast<int>(3000.0 + 1000.0 * std::sin(phase) + 200.0 * std::floor(std::fmod(phase, 4.0)));
+            kv[keys[static_cast<size_t>(ch)]] = v + static_cast<int>(rng() % 9) - 4;
+        }
+        writer.write_line(t, kv);
+    }
+    writer.close();
+}
+
+// One channel's points the way PlotView picks them for live data.
+size_t live_points(const ChannelModel& model, const std::string& key, double t_start, double t_end, int pixels,
+                   std::vector<ChannelSample>* out) {
+    out->clear();
+    LodView lod = model.get_lod_view(key, t_start, t_end, pixels);
+    if (!lod.empty()) {
+        lod.to_step_points(t_start, t_end, pixels, out);
+        return out->size();
+    }
+    double px_per_sec = static_cast<double>(pixels) / (t_end - t_start);
+    long last_px = LONG_MIN;
+    for (ChannelSample s : model.get_window_view(key, t_start, t_end)) {
+        long px = std::lround((s.t - t_start) * px_per_sec);
+        if (px == last_px) {
+            out->back() = s;
+        } else {
+            out->push_back(s);
+            last_px = px;
+        }
+    }
+    return out->size();
+}
+} // namespace
+
+int run_reference_bench(int argc, char** argv) {
+    ReferenceConfig cfg;
+    std::string error;
+    if (!parse_config(argc, argv, &cfg, &error)) {
+        if (!error.empty()) {
+            std::fprintf(stderr, "%s\n\n", error.c_str());
+        }
+        print_usage();
+        return error.empty() ? 0 : 1;
+    }
+    std::error_code ec;
+    std::filesystem::path dir = cfg.dir.empty() ? std::filesystem::temp_directory_path(ec)
+                                                 : std::filesystem::path(cfg.dir);
+
+    std::vector<std::string> paths;
+    double write_s = 0.0;
+    uint64_t recording_bytes = 0;
+    for (int r = 0; r < cfg.references; ++r) {
+        std::string path = (dir / ("scc_reference_" + std::to_string(r) + ".rec")).string();
+        paths.push_back(path);
+        if (cfg.keep && std::filesystem::exists(path, ec)) {
+            recording_bytes += std::filesystem::file_size(path, ec);
+            continue;
+        }
+        auto start = std::chrono::steady_clock::now();
+        write_recording(path, cfg, 100u + static_cast<unsigned>(r), &error);
+        if (!error.empty()) {
+            std::fprintf(stderr, "%s\n", error.c_str());
+            return 2;
+        }
+        write_s += seconds_since(start);
+        recording_bytes += std::filesystem::file_size(path, ec);
+    }
+
+    // First open builds the index (unless kept from a previous run); the
+    // second maps the existing one.
+    double build_s = 0.0;
+    double reopen_s = 0.0;
+    uint64_t rss_before = bench::private_rss_bytes();
+    std::vector<ReferenceOverlay> overlays(paths.size());
+    for (int pass = 0; pass < 2; ++pass) {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t r = 0; r < paths.size(); ++r) {
+            if (!overlays[r].open("\"" + paths[r] + "\"", &error)) {
+                std::fprintf(stderr, "%s\n", error.c_str());
+                return 2;
+            }
+        }
+        (pass == 0 ? build_s : reopen_s) = seconds_since(start);
+    }
+    uint64_t rss_open = bench::private_rss_bytes();
+    uint64_t ref_samples = 0;
+    for (const auto& overlay : overlays) {
+        ref_samples += overlay.trace().total_samples();
+    }
+
+    // Live side: an hour of the same channels in the model's window.
+    const double max_window = 3600.0;
+    ChannelModel model;
+    model.set_time_window(max_window);
+    model.set_memory_budget(size_t(2) << 30);
+    model.set_history_budget(0);
+    std::unordered_map<std::string, int> kv;
+    std::vector<std::string> keys;
+    for (int ch = 0; ch < cfg.channels; ++ch) {
+        keys.push_back("ch" + std::to_string(ch));
+    }
+    const uint64_t live_lines = static_cast<uint64_t>(std::min(max_window, cfg.hours * 3600.0) * cfg.rate);
+    for (uint64_t i = 0; i < live_lines; ++i) {
+        kv.clear();
+        for (int ch = 0; ch < cfg.channels; ++ch) {
+            kv[keys[static_cast<size_t>(ch)]] = 3000 + static_cast<int>(i % 977) + ch;
+        }
+        model.update_from_kv(kv, static_cast<double>(i) / cfg.rate);
+    }
+    const double live_end = static_cast<double>(live_lines - 1) / cfg.rate;
+
+    uint64_t rss_live = bench::private_rss_bytes();
+    std::vector<ChannelSample> points;
+    std::vector<FrameResult> frames;
+    std::mt19937 rng(5);
+    const int kFrames = 200;
+    for (double window : {5.0, 60.0, 600.0, 3600.0}) {
+        if (window > live_end + 1.0 / cfg.rate) {
+            continue;
+        }
+        FrameResult fr;
+        fr.window = window;
+        const double t_start = live_end - window;
+        auto start = std::chrono::steady_clock::now();
+        for (int f = 0; f < kFrames; ++f) {
+            for (const auto& key : keys) {
+                live_points(model, key, t_start, live_end, cfg.pixels, &points);
+            }
+        }
+        fr.live_us = seconds_since(start) / kFrames * 1e6;
+
+        // Each frame lines the references up at a different point, as a live
+        // session moving through them would.
+        size_t drawn = 0;
+        double ref_span = cfg.hours * 3600.0;
+        std::uniform_real_distribution<double> at(window, ref_span);
+        start = std::chrono::steady_clock::now();
+        for (int f = 0; f < kFrames; ++f) {
+            double offset = live_end - at(rng);
+            for (const auto& key : keys) {
+                for (const auto& overlay : overlays) {
+                    int ch = overlay.channel_for(key);
+                    if (ch >= 0) {
+                        overlay.trace().draw_points(static_cast<size_t>(ch), offset, t_start - offset,
+                                                    live_end - offset, cfg.pixels, &points);
+                        drawn += points.size();
+                    }
+                }
+            }
+        }
+        fr.refs_us = seconds_since(start) / kFrames * 1e6;
+        fr.points = static_cast<double>(drawn) / kFrames;
+        frames.push_back(fr);
+    }
+    uint64_t rss_after = bench::private_rss_bytes();
+
+    std::printf("%d references x %d channels x %.1f h at %.0f lines/s: %.1f M samples, %.0f MB recorded",
+                cfg.references, cfg.channels, cfg.hours, cfg.rate, static_cast<double>(ref_samples) * 1e-6,
+                static_cast<double>(recording_bytes) / 1e6);
+    if (write_s > 0.0) {
+        std::printf(" in %.1f s", write_s);
+    }
+    std::printf("\n");
+    std::printf("index build: %.2f s (%.0f MB/s of recording), cached reopen: %.3f ms\n", build_s,
+                build_s > 0.0 ? static_cast<double>(recording_bytes) / build_s / 1e6 : 0.0, reopen_s * 1e3);
+    std::printf("private RSS: %.1f MB before opening, %.1f MB with references open, %.1f MB with live data, "
+                "%.1f MB after drawing\n", static_cast<double>(rss_before) / 1e6, static_cast<double>(rss_open) / 1e6,
+                static_cast<double>(rss_live) / 1e6, static_cast<double>(rss_after) / 1e6);
+    std::printf("%-10s %14s %18s %16s\n", "window s", "live us/frame", "references us/fr", "ref points/fr");
+    for (const auto& fr : frames) {
+        std::printf("%-10.0f %14.1f %18.1f %16.0f\n", fr.window, fr.live_us, fr.refs_us, fr.points);
+    }
+
+    if (!cfg.json_out.empty()) {
+        std::string json = "{\n";
+        char buf[256] = {};
+        std::snprintf(buf, sizeof(buf),
+            "  \"references\": %d,\n  \"reference_samples\": %llu,\n  \"index_build_s\": %.3f,\n"
+            "  \"reopen_ms\": %.3f,\n  \"private_rss_after_mb\": %.1f,\n  \"frames\": [\n",
+            cfg.references, static_cast<unsigned long long>(ref_samples), build_s, reopen_s * 1e3,
+            static_cast<double>(rss_after) / 1e6);
+        json += buf;
+        for (size_t i = 0; i < frames.size(); ++i) {
+            const auto& fr = frames[i];
+            std::snprintf(buf, sizeof(buf),
+                "    {\"window_s\": %.0f, \"live_us\": %.1f, \"references_us\": %.1f, \"points\": %.0f}%s\n",
+                fr.window, fr.live_us, fr.refs_us, fr.points, i + 1 < frames.size() ? "," : "");
+            json += buf;
+        }
+        json += "  ]\n}\n";
+        if (!bench::write_text_file(cfg.json_out, json, &error)) {
+            std::fprintf(stderr, "%s\n", error.c_str());
+            return 2;
+        }
+    }
+
+    if (!cfg.keep) {
+        for (size_t r = 0; r < paths.size(); ++r) {
+            std::filesystem::remove(overlays[r].trace().index_path(), ec);
+            std::filesystem::remove(paths[r], ec);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,212 @@
+// Resampling benchmark: fills ChannelModel history with jittered multi-
+// channel lines, then exports aligned CSV with each policy and reports rows,
+// samples and bytes per second. Output goes to /dev/null unless --out is
+// given; with --out a plain write of the same number of bytes to the same
+// file is timed as well, to show whether the export keeps up with the disk.
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "bench_util.h"
+#include "benchmarks.h"
+#include "channel_model.h"
+#include "resampler.h"
+
+namespace {
+struct ResampleConfig {
+    int channels = 16;
+    double samples = 1e8;
+    double rate = 1000.0;
+    double jitter_us = 200.0;
+    std::string out;
+    std::string json_out;
+};
+
+struct ExportResult {
+    const char* name;
+    ResamplePolicy policy;
+    double step;
+    double tolerance;
+    uint64_t rows = 0;
+    uint64_t samples = 0;
+    uint64_t bytes = 0;
+    double seconds = 0.0;
+};
+
+void print_usage() {
+    std::fprintf(stderr,
+        "Usage: simple_com_chart_bench resample [options]\n"
+        "\n"
+        "  --channels N     channels (default 16)\n"
+        "  --samples N      samples in total (default 1e8)\n"
+        "  --rate N         lines/s, one sample per channel each (default 1000)\n"
+        "  --jitter-us US   random arrival delay per channel sample (default 200)\n"
+        "  --out FILE       export to FILE and time a raw write of the same size\n"
+        "                   (default: export to /dev/null only)\n"
+        "  --json FILE      write the results as JSON\n");
+}
+
+bool parse_config(int argc, char** argv, ResampleConfig* cfg, std::string* error) {
+    bench::Args args(argc, argv, 0);
+    if (args.flag("--help") || args.flag("-h")) {
+        return false;
+    }
+    double number = 0.0;
+    if (args.number("--channels", &number)) {
+        cfg->channels = static_cast<int>(number);
+    }
+    args.number("--samples", &cfg->samples);
+    args.number("--rate", &cfg->rate);
+    args.number("--jitter-us", &cfg->jitter_us);
+    args.text("--out", &cfg->out);
+    args.text("--json", &cfg->json_out);
+    if (!args.finish(error)) {
+        return false;
+    }
+    if (cfg->channels < 1 || cfg->channels > ChannelModel::kMaxChannels || cfg->samples < 1e4 ||
+        cfg->rate <= 0.0 || cfg->jitter_us < 0.0 || cfg->jitter_us * 1e-6 >= 0.5 / cfg->rate) {
+        *error = "Invalid resample configuration (jitter must stay below half a line)";
+        return false;
+    }
+    return true;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Time to write bytes from memory to path, as the ceiling for an export.
+double raw_write_seconds(const std::string& path, uint64_t bytes) {
+    std::FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) {
+        return 0.0;
+    }
+    std::vector<char> block(size_t(1) << 20, '7');
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t done = 0; done < bytes; done += block.size()) {
+        size_t n = static_cast<size_t>(std::min<uint64_t>(block.size(), bytes - done));
+        if (std::fwrite(block.data(), 1, n, f) != n) {
+            break;
+        }
+    }
+    std::fclose(f);
+    return seconds_since(start);
+}
+} // namespace
+
+int run_resample_bench(int argc, char** argv) {
+    ResampleConfig cfg;
+    std::string error;
+    if (!parse_config(argc, argv, &cfg, &error)) {
+        if (!error.empty()) {
+            std::fprintf(stderr, "%s\n\n", error.c_str());
+        }
+        print_usage();
+        return error.empty() ? 0 : 1;
+    }
+
+    // Each channel's sample gets its own arrival delay, like fields nudged
+    // apart by the model's merge epsilon or by merged ports.
+    ChannelModel model;
+    model.set_time_window(10.0);
+    model.set_history_budget(size_t(16) << 30);
+    std::vector<std::string> keys;
+    for (int ch = 0; ch < cfg.channels; ++ch) {
+        keys.push_back("ch" + std::to_string(ch));
+    }
+    std::mt19937 rng(777);
+    std::uniform_real_distribution<double> jitter(0.0, cfg.jitter_us * 1e-6);
+    std::vector<int> values(static_cast<size_t>(cfg.channels), 2000);
+    std::unordered_map<std::string, int> kv;
+    const uint64_t lines = static_cast<uint64_t>(cfg.samples / cfg.channels);
+    const uint64_t lines_per_frame = static_cast<uint64_t>(0.05 * cfg.rate) + 1;
+
+    auto a = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < lines; ++i) {
+        double line_ts = static_cast<double>(i) / cfg.rate;
+        for (int ch = 0; ch < cfg.channels; ++ch) {
+            uint32_t r = rng();
+            if ((r & 3) == 0) {
+                values[static_cast<size_t>(ch)] += static_cast<int>((r >> 2) % 7) - 3;
+            }
+            kv.clear();
+            kv[keys[static_cast<size_t>(ch)]] = values[static_cast<size_t>(ch)];
+            model.update_from_kv(kv, line_ts + jitter(rng));
+        }
+        if (i % lines_per_frame == 0) {
+            model.prune(line_ts);
+        }
+    }
+    double fill_s = seconds_since(a);
+
+    ResampleGrid span;
+    span.t_start = 0.0;
+    span.t_end = static_cast<double>(lines) / cfg.rate;
+    std::vector<ExportResult> results = {
+        {"hold, line grid", ResamplePolicy::kHold, 1.0 / cfg.rate, 0.0},
+        {"linear, line grid", ResamplePolicy::kLinear, 1.0 / cfg.rate, 0.0},
+        {"minmax, 100 ms", ResamplePolicy::kMinMax, 0.1, 0.0},
+        // Merging with a tolerance cannot be split, so this one runs on a
+        // single thread.
+        {"hold, merged lines", ResamplePolicy::kHold, 0.0, cfg.jitter_us * 1e-6},
+    };
+    const std::string target = cfg.out.empty() ? "/dev/null" : cfg.out;
+    for (auto& r : results) {
+        ResampleGrid grid = span;
+        grid.step = r.step;
+        grid.tolerance = r.tolerance;
+        AlignedCsvStats stats;
+        auto start = std::chrono::steady_clock::now();
+        if (!write_aligned_csv(model, keys, grid, r.policy, target, &stats, &error)) {
+            std::fprintf(stderr, "%s\n", error.c_str());
+            return 2;
+        }
+        r.seconds = seconds_since(start);
+        r.rows = stats.rows;
+        r.samples = stats.samples;
+        r.bytes = stats.bytes;
+    }
+    double raw_mbps = 0.0;
+    if (!cfg.out.empty()) {
+        double raw_s = raw_write_seconds(cfg.out, results[0].bytes);
+        raw_mbps = raw_s > 0.0 ? static_cast<double>(results[0].bytes) / raw_s / 1e6 : 0.0;
+        std::remove(cfg.out.c_str());
+    }
+
+    std::printf("%d channels, %llu samples, filled in %.1f s\n", cfg.channels,
+                static_cast<unsigned long long>(lines * static_cast<uint64_t>(cfg.channels)), fill_s);
+    std::printf("%-20s %10s %12s %10s %10s\n", "export", "rows", "M samples/s", "M rows/s", "MB/s");
+    for (const auto& r : results) {
+        double s = r.seconds > 0.0 ? r.seconds : 1e-9;
+        std::printf("%-20s %10llu %12.1f %10.2f %10.0f\n", r.name, static_cast<unsigned long long>(r.rows),
+                    static_cast<double>(r.samples) / s * 1e-6, static_cast<double>(r.rows) / s * 1e-6,
+                    static_cast<double>(r.bytes) / s / 1e6);
+    }
+    if (!cfg.out.empty()) {
+        std::printf("raw write of %.0f MB: %.0f MB/s\n", static_cast<double>(results[0].bytes) / 1e6, raw_mbps);
+    }
+
+    if (!cfg.json_out.empty()) {
+        std::string json = "{\n  \"exports\": [\n";
+        char buf[256] = {};
+        for (size_t i = 0; i < results.size(); ++i) {
+            const auto& r = results[i];
+            std::snprintf(buf, sizeof(buf),
+                "    {\"export\": \"%s\", \"rows\": %llu, \"samples\": %llu, \"seconds\": %.3f, \"bytes\": %llu}%s\n",
+                r.name, static_cast<unsigned long long>(r.rows), static_cast<unsigned long long>(r.samples),
+                r.seconds, static_cast<unsigned long long>(r.bytes), i + 1 < results.size() ? "," : "");
+            json += buf;
+        }
+        std::snprintf(buf, sizeof(buf), "  ],\n  \"raw_write_mb_per_sec\": %.1f\n}\n", raw_mbps);
+        json += buf;
+        if (!bench::write_text_file(cfg.json_out, json, &error)) {
+            std::fprintf(stderr, "%s\n", error.c_str());
+            return 2;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,613 @@
+// End-to-end soak benchmark: a paced synthetic generator feeds the real
+// LineFramer, log parser, ChannelModel ingest/prune and a headless render
+// pass that does the data work of PlotView (series fetch, window filter,
+// pixel decimation, projection). Threads mirror the GUI: a reader thread
+// frames bytes into a bounded pending queue, a frame thread drains it.
+//
+// The driver binary-searches the highest line rate with zero drops, then
+// soaks at that rate while sampling RSS, and writes a JSON report.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_util.h"
+#include "benchmarks.h"
+#include "channel_model.h"
+#include "clock.h"
+#include "line_framer.h"
+#include "log_parser.h"
+#include "pipeline_stats.h"
+
+namespace {
+constexpr int kPoolLines = 8192;
+constexpr int kReadChunk = LineFramer::kMaxRxBuffer / 2;
+constexpr double kMinRate = 10.0;
+
+struct SoakConfig {
+    int channels = 6;
+    double window = 10.0;
+    double trial_sec = 5.0;
+    double soak_sec = 600.0;
+    double start_rate = 10000.0;
+    double max_rate = 5.0e6;
+    double precision = 0.05;
+    double fixed_rate = 0.0;
+    double read_ms = 20.0;
+    double frame_ms = 50.0;
+    int pending_cap = 2000;
+    int width = 1200;
+    int height = 600;
+    double rss_interval = 1.0;
+    bool quiet = false;
+    std::string json_out;
+};
+
+void print_usage() {
+    std::fprintf(stderr,
+        "Usage: simple_com_chart_bench soak [options]\n"
+        "\n"
+        "  --channels N       keys per generated line (default 6)\n"
+        "  --window SEC       model time window (default 10)\n"
+        "  --trial SEC        duration of each search trial (default 5)\n"
+        "  --soak SEC         soak duration at the found rate, 0 = skip (default 600)\n"
+        "  --rate N           skip the search and soak at N lines/s\n"
+        "  --start-rate N     first search rate in lines/s (default 10000)\n"
+        "  --max-rate N       search ceiling in lines/s (default 5000000)\n"
+        "  --precision F      stop bisecting at this relative gap (default 0.05)\n"
+        "  --read-ms MS       reader poll interval (default 20, as the GUI)\n"
+        "  --frame-ms MS      frame interval (default 50, as the GUI)\n"
+        "  --pending-cap N    pending line queue bound, 0 = unbounded (default 2000, as the GUI)\n"
+        "  --width PX         headless plot width (default 1200)\n"
+        "  --rss-interval SEC RSS sampling period (default 1)\n"
+        "  --json FILE        write the report as JSON\n"
+        "  --quiet            only print the result\n");
+}
+
+// Pre-rendered log lines in the device format, cycled by the generator.
+class LineGenerator {
+public:
+    explicit LineGenerator(int channels) {
+        offsets_.reserve(kPoolLines + 1);
+        char buf[64] = {};
+        for (int i = 0; i < kPoolLines; ++i) {
+            offsets_.push_back(blob_.size());
+            std::snprintf(buf, sizeof(buf), "state:%d", (i / 512) % 4);
+            blob_ += buf;
+            for (int ch = 1; ch < channels; ++ch) {
+                double phase = static_cast<double>(i) * 2.0 * 3.14159265358979 / kPoolLines;
+                int value = 2000 + static_cast<int>(1500.0 * std::sin(phase * ch + ch)) + (i * 7 + ch * 13) % 17;
+                std::snprintf(buf, sizeof(buf), ",ch%d:%dmv", ch, value);
+                blob_ += buf;
+            }
+            blob_ += "\r\n";
+        }
+        offsets_.push_back(blob_.size());
+    }
+
+    void next(uint64_t count, std::string* out) {
+        while (count > 0) {
+            size_t n = static_cast<size_t>(std::min<uint64_t>(count, static_cast<uint64_t>(kPoolLines - cursor_)));
+            out->append(blob_, offsets_[cursor_], offsets_[cursor_ + n] - offsets_[cursor_]);
+            cursor_ = (cursor_ + n) % kPoolLines;
+            count -= n;
+        }
+    }
+
+private:
+    std::string blob_;
+    std::vector<size_t> offsets_;
+    size_t cursor_ = 0;
+};
+
+// The data path of PlotView::update_from_model and PlotView::draw_plot
+// without GDI+: y range over the window, window filter, one sample per pixel
+// column (or pyramid buckets for long windows), projection to plot
+// coordinates, end tags.
+class HeadlessRender {
+public:
+    HeadlessRender(int width, int height) : width_(std::max(1, width)), height_(std::max(1, height)) {}
+
+    uint64_t render(const ChannelModel& model) {
+        double window = model.get_time_window();
+        const auto& enabled = model.get_enabled_keys_with_data();
+
+        bool has_data = false;
+        double y_min = 0.0;
+        double y_max = 0.0;
+        for (const auto& key : enabled) {
+            SeriesView series = model.get_series_view(key);
+            int vmin = 0;
+            int vmax = 0;
+            if (series.empty() || !series.since(series.back().t - window).value_range(&vmin, &vmax)) {
+                continue;
+            }
+            if (!has_data) {
+                y_min = vmin;
+                y_max = vmax;
+                has_data = true;
+            } else {
+                y_min = std::min<double>(y_min, vmin);
+                y_max = std::max<double>(y_max, vmax);
+            }
+        }
+        double y_span = (y_max - y_min) > 0.0 ? (y_max - y_min) : 1.0;
+
+        uint64_t segments = 0;
+        for (const auto& key : enabled) {
+            SeriesView series = model.get_series_view(key);
+            if (series.size() < 2) {
+                continue;
+            }
+            double t_end = series.back().t;
+            double t_start = t_end - window;
+            simplified_.clear();
+            LodView lod = model.get_lod_view(key, t_start, t_end, width_);
+            if (!lod.empty()) {
+                lod.to_step_points(t_start, t_end, width_, &simplified_);
+            } else {
+                int last_px = INT_MIN;
+                for (ChannelSample sample : series.since(t_start)) {
+                    int px = static_cast<int>(std::lround((sample.t - t_start) / window * width_));
+                    if (px == last_px) {
+                        simplified_.back() = sample;
+                    } else {
+                        simplified_.push_back(sample);
+                        last_px = px;
+                    }
+                }
+            }
+            for (size_t i = 0; i + 1 < simplified_.size(); ++i) {
+                float px = static_cast<float>((simplified_[i + 1].t - t_start) / window * width_);
+                float py = static_cast<float>((simplified_[i].v - y_min) / y_span * height_);
+                sink_ += px + py;
+                segments++;
+            }
+        }
+
+        ChannelSample last;
+        for (const auto& key : enabled) {
+            if (model.get_last_sample(key, &last)) {
+                sink_ += static_cast<float>(last.v);
+            }
+        }
+        return segments;
+    }
+
+private:
+    int width_;
+    int height_;
+    volatile float sink_ = 0.0f;
+    std::vector<ChannelSample> simplified_;
+};
+
+struct TrialResult {
+    double rate = 0.0;
+    double duration = 0.0;
+    bool passed = false;
+    uint64_t lines_generated = 0;
+    uint64_t segments = 0;
+    uint64_t peak_rss = 0;
+    std::vector<std::pair<double, uint64_t>> rss;
+    PipelineStatsSnapshot snap;
+
+    uint64_t total(PipelineCounter c) const {
+        return snap.totals[static_cast<int>(c)];
+    }
+    double per_sec(PipelineCounter c) const {
+        return duration > 0.0 ? static_cast<double>(total(c)) / duration : 0.0;
+    }
+    uint64_t drops() const {
+        return total(PipelineCounter::kDroppedBytes) + total(PipelineCounter::kDroppedLines) +
+            total(PipelineCounter::kDroppedKeys);
+    }
+};
+
+struct PendingItem {
+    std::string line;
+    double ts = 0.0;
+};
+
+TrialResult run_trial(const SoakConfig& cfg, double rate, double duration, bool progress) {
+    const Clock& clock = monotonic_clock();
+    double t0 = clock.now();
+
+    ChannelModel model;
+    model.set_time_window(cfg.window);
+    PipelineStats stats(t0);
+
+    std::mutex pending_mutex;
+    std::vector<PendingItem> pending;
+    std::atomic<bool> running{true};
+    std::atomic<uint64_t> generated{0};
+    uint64_t segments = 0;
+
+    std::thread reader([&]() {
+        LineGenerator generator(cfg.channels);
+        LineFramer framer;
+        std::string bytes;
+        std::vector<std::string> lines;
+        double read_interval = cfg.read_ms * 1e-3;
+        double next_read = t0;
+        double prev_ts = t0;
+        uint64_t sent = 0;
+        while (running.load(std::memory_order_relaxed)) {
+            double now = clock.now();
+            if (now < next_read) {
+                std::this_thread::sleep_for(std::chrono::duration<double>(next_read - now));
+                continue;
+            }
+            next_read = std::max(next_read + read_interval, now);
+
+            uint64_t due = static_cast<uint64_t>((now - t0) * rate);
+            if (due <= sent) {
+                continue;
+            }
+            bytes.clear();
+            generator.next(due - sent, &bytes);
+            generated.fetch_add(due - sent, std::memory_order_relaxed);
+            sent = due;
+
+            lines.clear();
+            for (size_t off = 0; off < bytes.size(); off += kReadChunk) {
+                size_t n = std::min(bytes.size() - off, static_cast<size_t>(kReadChunk));
+                framer.push(bytes.data() + off, n, &lines);
+            }
+            stats.add(PipelineCounter::kBytesRead, bytes.size());
+            stats.add(PipelineCounter::kLinesFramed, lines.size());
+            stats.add(PipelineCounter::kDroppedBytes, static_cast<uint64_t>(framer.consume_overflow()));
+
+            // Lines are spread evenly over the read interval, as if the
+            // device had timestamped them, so each line can become a sample.
+            std::lock_guard<std::mutex> lock(pending_mutex);
+            for (size_t i = 0; i < lines.size(); ++i) {
+                double ts = prev_ts + (now - prev_ts) * static_cast<double>(i + 1) / static_cast<double>(lines.size());
+                pending.push_back(PendingItem{std::move(lines[i]), ts});
+            }
+            prev_ts = now;
+            if (cfg.pending_cap > 0 && pending.size() > static_cast<size_t>(cfg.pending_cap)) {
+                size_t overflow = pending.size() - static_cast<size_t>(cfg.pending_cap);
+                pending.erase(pending.begin(), pending.begin() + static_cast<std::ptrdiff_t>(overflow));
+                stats.add(PipelineCounter::kDroppedLines, overflow);
+            }
+        }
+    });
+
+    std::thread frame([&]() {
+        HeadlessRender render(cfg.width, cfg.height);
+        std::vector<PendingItem> batch;
+        double frame_interval = cfg.frame_ms * 1e-3;
+        double next_frame = t0 + frame_interval;
+        while (running.load(std::memory_order_relaxed)) {
+            double now = clock.now();
+            if (now < next_frame) {
+                std::this_thread::sleep_for(std::chrono::duration<double>(next_frame - now));
+                continue;
+            }
+            next_frame = std::max(next_frame + frame_interval, now);
+
+            batch.clear();
+            {
+                std::lock_guard<std::mutex> lock(pending_mutex);
+                batch.swap(pending);
+            }
+            double oldest_read_ts = 0.0;
+            for (const auto& item : batch) {
+                double parse_start = clock.now();
+                stats.record(PipelineLatency::kReadToParse, parse_start - item.ts);
+                auto kv = log_parser::parse_kv_log(item.line);
+                double parse_end = clock.now();
+                stats.record(PipelineLatency::kParse, parse_end - parse_start);
+                if (kv.empty()) {
+                    continue;
+                }
+                stats.add(PipelineCounter::kLinesParsed);
+                int stored = model.update_from_kv(kv, item.ts);
+                stats.record(PipelineLatency::kIngest, clock.now() - parse_end);
+                stats.add(PipelineCounter::kSamplesIngested, static_cast<uint64_t>(stored));
+                if (oldest_read_ts <= 0.0) {
+                    oldest_read_ts = item.ts;
+                }
+            }
+            if (oldest_read_ts > 0.0) {
+                stats.mark_ingested(oldest_read_ts, clock.now());
+            }
+            stats.add(PipelineCounter::kDroppedKeys, static_cast<uint64_t>(model.consume_dropped_keys()));
+
+            double paint_start = clock.now();
+            model.prune(paint_start);
+            segments += render.render(model);
+            stats.mark_painted(paint_start, clock.now());
+        }
+    });
+
+    TrialResult result;
+    result.rate = rate;
+    double next_rss = t0;
+    double next_progress = t0 + 10.0;
+    double end = t0 + duration;
+    while (true) {
+        double now = clock.now();
+        if (now >= next_rss) {
+            uint64_t rss = bench::current_rss_bytes();
+            result.rss.emplace_back(now - t0, rss);
+            result.peak_rss = std::max(result.peak_rss, rss);
+            next_rss += cfg.rss_interval;
+        }
+        if (progress && now >= next_progress) {
+            std::fprintf(stderr, "  [%6.0f s] lines %llu samples %llu drops %llu rss %.1f MB\n", now - t0,
+                         static_cast<unsigned long long>(stats.get(PipelineCounter::kLinesParsed)),
+                         static_cast<unsigned long long>(stats.get(PipelineCounter::kSamplesIngested)),
+                         static_cast<unsigned long long>(stats.get(PipelineCounter::kDroppedBytes) +
+                                                         stats.get(PipelineCounter::kDroppedLines) +
+                                                         stats.get(PipelineCounter::kDroppedKeys)),
+                         static_cast<double>(result.rss.empty() ? 0 : result.rss.back().second) / (1024.0 * 1024.0));
+            next_progress += 10.0;
+        }
+        if (now >= end) {
+            break;
+        }
+        double wake = std::min(end, std::min(next_rss, progress ? next_progress : end));
+        std::this_thread::sleep_for(std::chrono::duration<double>(std::max(0.0, wake - now)));
+    }
+
+    running = false;
+    reader.join();
+    frame.join();
+
+    double t1 = clock.now();
+    result.duration = t1 - t0;
+    result.snap = stats.take_snapshot(t1);
+    result.lines_generated = generated.load();
+    result.segments = segments;
+    // Lines still queued when the trial stops were neither processed nor
+    // dropped; only a backlog beyond one read batch means the frame thread fell
+    // behind.
+    uint64_t parsed = result.total(PipelineCounter::kLinesParsed);
+    uint64_t backlog = result.lines_generated > parsed ? result.lines_generated - parsed : 0;
+    uint64_t tolerance = static_cast<uint64_t>(rate * (cfg.read_ms + cfg.frame_ms) * 1e-3) + 1;
+    result.passed = result.drops() == 0 && backlog <= tolerance;
+    return result;
+}
+
+void print_trial(const TrialResult& r) {
+    std::fprintf(stderr,
+        "  %10.0f lines/s  %s  parsed %.0f/s samples %.0f/s  drops bytes %llu lines %llu keys %llu  rss %.1f MB\n",
+        r.rate, r.passed ? "PASS" : "FAIL",
+        r.per_sec(PipelineCounter::kLinesParsed), r.per_sec(PipelineCounter::kSamplesIngested),
+        static_cast<unsigned long long>(r.total(PipelineCounter::kDroppedBytes)),
+        static_cast<unsigned long long>(r.total(PipelineCounter::kDroppedLines)),
+        static_cast<unsigned long long>(r.total(PipelineCounter::kDroppedKeys)),
+        static_cast<double>(r.peak_rss) / (1024.0 * 1024.0));
+}
+
+// RSS over the second half of the run: the median is the steady state and
+// the least-squares slope flags unbounded growth.
+void rss_steady_state(const TrialResult& r, uint64_t* steady, double* growth_per_min) {
+    *steady = 0;
+    *growth_per_min = 0.0;
+    if (r.rss.empty()) {
+        return;
+    }
+    size_t begin = r.rss.size() / 2;
+    std::vector<uint64_t> tail;
+    double sx = 0.0, sy = 0.0, sxx = 0.0, sxy = 0.0;
+    for (size_t i = begin; i < r.rss.size(); ++i) {
+        double x = r.rss[i].first;
+        double y = static_cast<double>(r.rss[i].second);
+        tail.push_back(r.rss[i].second);
+        sx += x;
+        sy += y;
+        sxx += x * x;
+        sxy += x * y;
+    }
+    std::sort(tail.begin(), tail.end());
+    *steady = tail[tail.size() / 2];
+    double n = static_cast<double>(tail.size());
+    double denom = n * sxx - sx * sx;
+    if (tail.size() >= 2 && denom > 0.0) {
+        *growth_per_min = (n * sxy - sx * sy) / denom * 60.0;
+    }
+}
+
+std::string trial_json(const TrialResult& r, const char* indent) {
+    char buf[512] = {};
+    std::snprintf(buf, sizeof(buf),
+        "{\"rate\": %.0f, \"passed\": %s, \"duration_s\": %.2f, \"lines_per_sec\": %.1f, "
+        "\"samples_per_sec\": %.1f, \"frames\": %llu, \"dropped_bytes\": %llu, \"dropped_lines\": %llu, "
+        "\"dropped_keys\": %llu, \"peak_rss_bytes\": %llu}",
+        r.rate, r.passed ? "true" : "false", r.duration,
+        r.per_sec(PipelineCounter::kLinesParsed), r.per_sec(PipelineCounter::kSamplesIngested),
+        static_cast<unsigned long long>(r.total(PipelineCounter::kFramesPainted)),
+        static_cast<unsigned long long>(r.total(PipelineCounter::kDroppedBytes)),
+        static_cast<unsigned long long>(r.total(PipelineCounter::kDroppedLines)),
+        static_cast<unsigned long long>(r.total(PipelineCounter::kDroppedKeys)),
+        static_cast<unsigned long long>(r.peak_rss));
+    return std::string(indent) + buf;
+}
+
+std::string report_json(const SoakConfig& cfg, const std::vector<TrialResult>& search, double best_rate,
+                        const TrialResult* soak) {
+    std::string out;
+    char buf[512] = {};
+    std::snprintf(buf, sizeof(buf),
+        "{\n  \"config\": {\"channels\": %d, \"window_s\": %.1f, \"trial_s\": %.1f, \"soak_s\": %.1f, "
+        "\"read_ms\": %.1f, \"frame_ms\": %.1f, \"pending_cap\": %d, \"width\": %d},\n",
+        cfg.channels, cfg.window, cfg.trial_sec, cfg.soak_sec, cfg.read_ms, cfg.frame_ms,
+        cfg.pending_cap, cfg.width);
+    out += buf;
+    out += "  \"search\": [\n";
+    for (size_t i = 0; i < search.size(); ++i) {
+        out += trial_json(search[i], "    ");
+        out += (i + 1 < search.size()) ? ",\n" : "\n";
+    }
+    out += "  ],\n";
+    std::snprintf(buf, sizeof(buf), "  \"max_zero_drop_lines_per_sec\": %.0f,\n", best_rate);
+    out += buf;
+
+    if (!soak) {
+        out += "  \"soak\": null\n}\n";
+        return out;
+    }
+    uint64_t steady = 0;
+    double growth = 0.0;
+    rss_steady_state(*soak, &steady, &growth);
+    out += "  \"soak\": {\n    \"result\": " + trial_json(*soak, "") + ",\n";
+    std::snprintf(buf, sizeof(buf),
+        "    \"steady_rss_bytes\": %llu,\n    \"rss_growth_bytes_per_min\": %.0f,\n    \"rss\": [",
+        static_cast<unsigned long long>(steady), growth);
+    out += buf;
+    for (size_t i = 0; i < soak->rss.size(); ++i) {
+        std::snprintf(buf, sizeof(buf), "%s[%.1f, %llu]", i ? ", " : "", soak->rss[i].first,
+                      static_cast<unsigned long long>(soak->rss[i].second));
+        out += buf;
+    }
+    out += "],\n    \"pipeline\": ";
+    std::string pipeline = PipelineStats::to_json(soak->snap);
+    while (!pipeline.empty() && pipeline.back() == '\n') {
+        pipeline.pop_back();
+    }
+    for (char c : pipeline) {
+        out += c;
+        if (c == '\n') {
+            out += "    ";
+        }
+    }
+    out += "\n  }\n}\n";
+    return out;
+}
+
+bool parse_config(int argc, char** argv, SoakConfig* cfg, std::string* error) {
+    bench::Args args(argc, argv, 0);
+    if (args.flag("--help") || args.flag("-h")) {
+        return false;
+    }
+    double number = 0.0;
+    if (args.number("--channels", &number)) {
+        cfg->channels = static_cast<int>(number);
+    }
+    args.number("--window", &cfg->window);
+    args.number("--trial", &cfg->trial_sec);
+    args.number("--soak", &cfg->soak_sec);
+    args.number("--rate", &cfg->fixed_rate);
+    args.number("--start-rate", &cfg->start_rate);
+    args.number("--max-rate", &cfg->max_rate);
+    args.number("--precision", &cfg->precision);
+    args.number("--read-ms", &cfg->read_ms);
+    args.number("--frame-ms", &cfg->frame_ms);
+    if (args.number("--pending-cap", &number)) {
+        cfg->pending_cap = static_cast<int>(number);
+    }
+    if (args.number("--width", &number)) {
+        cfg->width = static_cast<int>(number);
+    }
+    args.number("--rss-interval", &cfg->rss_interval);
+    args.text("--json", &cfg->json_out);
+    cfg->quiet = args.flag("--quiet");
+    if (!args.finish(error)) {
+        return false;
+    }
+
+    if (cfg->channels < 1 || cfg->window <= 0.0 || cfg->trial_sec <= 0.0 || cfg->soak_sec < 0.0 ||
+        cfg->start_rate < kMinRate || cfg->max_rate < cfg->start_rate || cfg->precision <= 0.0 ||
+        cfg->read_ms <= 0.0 || cfg->frame_ms <= 0.0 || cfg->pending_cap < 0 || cfg->rss_interval <= 0.0) {
+        *error = "Invalid soak configuration";
+        return false;
+    }
+    return true;
+}
+} // namespace
+
+int run_soak_bench(int argc, char** argv) {
+    SoakConfig cfg;
+    std::string error;
+    if (!parse_config(argc, argv, &cfg, &error)) {
+        if (!error.empty()) {
+            std::fprintf(stderr, "%s\n\n", error.c_str());
+        }
+        print_usage();
+        return error.empty() ? 0 : 1;
+    }
+
+    std::vector<TrialResult> search;
+    double best = 0.0;
+    if (cfg.fixed_rate > 0.0) {
+        best = cfg.fixed_rate;
+    } else {
+        if (!cfg.quiet) {
+            std::fprintf(stderr, "Searching max zero-drop rate (%.0f s trials)...\n", cfg.trial_sec);
+        }
+        auto trial = [&](double rate) {
+            search.push_back(run_trial(cfg, rate, cfg.trial_sec, false));
+            if (!cfg.quiet) {
+                print_trial(search.back());
+            }
+            return search.back().passed;
+        };
+
+        double lo = 0.0;
+        double hi = 0.0;
+        for (double rate = cfg.start_rate; rate <= cfg.max_rate; rate *= 2.0) {
+            if (!trial(rate)) {
+                hi = rate;
+                break;
+            }
+            lo = rate;
+        }
+        while (hi > 0.0 && (hi - lo) / hi > cfg.precision) {
+            double mid = (lo + hi) * 0.5;
+            if (mid < kMinRate) {
+                break;
+            }
+            if (trial(mid)) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+        best = lo;
+    }
+
+    TrialResult soak;
+    bool soaked = false;
+    if (best > 0.0 && cfg.soak_sec > 0.0) {
+        if (!cfg.quiet) {
+            std::fprintf(stderr, "Soaking at %.0f lines/s for %.0f s...\n", best, cfg.soak_sec);
+        }
+        soak = run_trial(cfg, best, cfg.soak_sec, !cfg.quiet);
+        soaked = true;
+        if (!cfg.quiet) {
+            print_trial(soak);
+        }
+    }
+
+    std::printf("max zero-drop rate: %.0f lines/s\n", best);
+    if (soaked) {
+        uint64_t steady = 0;
+        double growth = 0.0;
+        rss_steady_state(soak, &steady, &growth);
+        std::printf("soak %s: %.0f lines/s %.0f samples/s over %.0f s\n", soak.passed ? "passed" : "FAILED",
+                    soak.per_sec(PipelineCounter::kLinesParsed), soak.per_sec(PipelineCounter::kSamplesIngested),
+                    soak.duration);
+        std::printf("rss: peak %.1f MB steady %.1f MB growth %.1f KB/min\n",
+                    static_cast<double>(soak.peak_rss) / (1024.0 * 1024.0),
+                    static_cast<double>(steady) / (1024.0 * 1024.0), growth / 1024.0);
+    }
+
+    if (!cfg.json_out.empty() &&
+        !bench::write_text_file(cfg.json_out, report_json(cfg, search, best, soaked ? &soak : nullptr), &error)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 2;
+    }
+    if (best <= 0.0) {
+        return 3;
+    }
+    return (soaked && !soak.passed) ? 3 : 0;
+}
@@ -0,0 +1,405 @@
+// Channel storage benchmark: the SampleRing used by ChannelModel, plain, in
+// run-length mode and sharing one timestamp per line between all channels,
+// against the std::deque<ChannelSample> it replaced.
+// All run the same simulated stream (append per channel, prune and a
+// window min/max scan every frame) on a virtual clock, so results do not
+// depend on wall time. --hold makes the stream step-like.
+// A last case feeds ChannelModel lines, stamped once per serial read, that
+// every other channel is on only a share of (--present), and counts how
+// often such channels fall back from shared timestamps.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "bench_util.h"
+#include "benchmarks.h"
+#include "channel_model.h"
+#include "sample_ring.h"
+
+namespace {
+struct StorageConfig {
+    int channels = 16;
+    double rate = 1000.0;
+    double window = 10.0;
+    double seconds = 600.0;
+    double frame_ms = 50.0;
+    int hold = 1;
+    double present = 0.8;
+    std::string json_out;
+};
+
+void print_usage() {
+    std::fprintf(stderr,
+        "Usage: simple_com_chart_bench storage [options]\n"
+        "\n"
+        "  --channels N     channels (default 16)\n"
+        "  --rate N         samples/s per channel (default 1000)\n"
+        "  --window SEC     retention window (default 10)\n"
+        "  --seconds SEC    simulated stream length (default 600)\n"
+        "  --frame-ms MS    prune + scan period (default 50)\n"
+        "  --hold N         samples each value is held for (default 1)\n"
+        "  --present F      share of lines every other channel is on in the\n"
+        "                   ChannelModel case (default 0.8)\n"
+        "  --json FILE      write the results as JSON\n");
+}
+
+class DequeStore {
+public:
+    static const char* name() { return "deque"; }
+
+    void push(double t, int v) { samples_.push_back(ChannelSample{t, v}); }
+
+    void prune(double cutoff) {
+        while (!samples_.empty() && samples_.front().t < cutoff) {
+            samples_.pop_front();
+        }
+    }
+
+    bool scan(int* vmin, int* vmax) const {
+        if (samples_.empty()) {
+            return false;
+        }
+        int lo = samples_.front().v;
+        int hi = lo;
+        for (const auto& s : samples_) {
+            lo = std::min(lo, s.v);
+            hi = std::max(hi, s.v);
+        }
+        *vmin = lo;
+        *vmax = hi;
+        return true;
+    }
+
+    size_t size() const { return samples_.size(); }
+
+    // libstdc++/MSVC deques allocate fixed blocks plus a block map; count
+    // the element blocks only.
+    size_t bytes() const {
+        constexpr size_t kBlockBytes = 512;
+        size_t per_block = std::max<size_t>(1, kBlockBytes / sizeof(ChannelSample));
+        return (samples_.size() / per_block + 1) * kBlockBytes;
+    }
+
+private:
+    std::deque<ChannelSample> samples_;
+};
+
+class RingStore {
+public:
+    static const char* name() { return "ring"; }
+
+    explicit RingStore(size_t capacity_hint) : hint_(capacity_hint) {}
+
+    void push(double t, int v) { ring_.push_back(t, v, hint_); }
+
+    void prune(double cutoff) { ring_.pop_front(ring_.lower_bound(cutoff)); }
+
+    bool scan(int* vmin, int* vmax) const { return ring_.value_range(0, ring_.size(), vmin, vmax); }
+
+    size_t size() const { return ring_.size(); }
+    // Chunks (columns and block summaries), chunk table and chunk tree.
+    size_t bytes() const { return ring_.allocated_bytes(); }
+
+private:
+    SampleRing ring_;
+    size_t hint_;
+};
+
+class RunStore {
+public:
+    static const char* name() { return "runs"; }
+
+    RunStore() { ring_.set_run_length(true); }
+
+    void push(double t, int v) { ring_.push_back(t, v); }
+
+    void prune(double cutoff) { ring_.pop_front(ring_.lower_bound(cutoff)); }
+
+    bool scan(int* vmin, int* vmax) const { return ring_.value_range(0, ring_.size(), vmin, vmax); }
+
+    size_t size() const { return ring_.size(); }
+    size_t bytes() const { return ring_.allocated_bytes(); }
+
+private:
+    SampleRing ring_;
+};
+
+// Every channel is on every line, so the rows are the stream's steps.
+class RowStore {
+public:
+    struct Shared {
+        RowTimeline rows;
+        // Rows before it are dropped once every channel has pruned.
+        double cutoff = 0.0;
+        bool pruned = false;
+    };
+
+    static const char* name() { return "rows"; }
+
+    RowStore(std::shared_ptr<Shared> shared, size_t channels, size_t capacity_hint)
+        : shared_(std::move(shared)), channels_(channels), hint_(capacity_hint) {
+        ring_.set_row_times(&shared_->rows);
+    }
+
+    void push(double t, int v) {
+        // The line's first channel adds its row.
+        RowTimeline& rows = shared_->rows;
+        if (rows.empty() || rows.time(rows.end_row() - 1) < t) {
+            if (shared_->pruned) {
+                rows.drop_before(rows.lower_bound(shared_->cutoff));
+                shared_->pruned = false;
+            }
+            rows.push_back(t);
+        }
+        ring_.push_back(t, v, hint_);
+    }
+
+    void prune(double cutoff) {
+        ring_.pop_front(ring_.lower_bound(cutoff));
+        shared_->cutoff = cutoff;
+        shared_->pruned = true;
+    }
+
+    bool scan(int* vmin, int* vmax) const { return ring_.value_range(0, ring_.size(), vmin, vmax); }
+
+    size_t size() const { return ring_.size(); }
+    // The ring plus this channel's share of the timeline.
+    size_t bytes() const { return ring_.allocated_bytes() + shared_->rows.allocated_bytes() / channels_; }
+
+private:
+    std::shared_ptr<Shared> shared_;
+    SampleRing ring_;
+    size_t channels_;
+    size_t hint_;
+};
+
+struct StorageResult {
+    const char* name = "";
+    double push_prune_ns = 0.0;  // per appended sample, steady state
+    double scan_ns = 0.0;        // per scanned sample
+    uint64_t steady_allocations = 0;
+    double bytes_per_sample = 0.0;
+    long long checksum = 0;
+};
+
+template <typename Store>
+StorageResult run_store(const StorageConfig& cfg, std::vector<Store> stores) {
+    using clock = std::chrono::steady_clock;
+    const double dt = 1.0 / cfg.rate;
+    const double frame = cfg.frame_ms * 1e-3;
+    const uint64_t per_frame = static_cast<uint64_t>(frame * cfg.rate + 0.5);
+    const uint64_t frames = static_cast<uint64_t>(cfg.seconds / frame);
+    const uint64_t fill_frames = static_cast<uint64_t>(cfg.window / frame) + 1;
+
+    StorageResult result;
+    result.name = Store::name();
+    double push_sec = 0.0;
+    double scan_sec = 0.0;
+    uint64_t pushed = 0;
+    uint64_t scanned = 0;
+    uint64_t allocs_at_steady = 0;
+    double t = 0.0;
+    uint64_t step = 0;
+
+    for (uint64_t f = 0; f < frames; ++f) {
+        bool steady = f >= fill_frames;
+        if (f == fill_frames) {
+            allocs_at_steady = bench::allocation_count();
+        }
+
+        auto a = clock::now();
+        for (uint64_t i = 0; i < per_frame; ++i) {
+            for (size_t ch = 0; ch < stores.size(); ++ch) {
+                uint64_t held = step / static_cast<uint64_t>(cfg.hold);
+                int v = static_cast<int>(((held * 2654435761u + ch * 40503u) >> 20) & 0xFFF);
+                stores[ch].push(t, v);
+            }
+            t += dt;
+            step++;
+        }
+        for (auto& store : stores) {
+            store.prune(t - cfg.window);
+        }
+        auto b = clock::now();
+
+        for (const auto& store : stores) {
+            int lo = 0;
+            int hi = 0;
+            if (store.scan(&lo, &hi)) {
+                result.checksum += lo + hi;
+            }
+            scanned += steady ? store.size() : 0;
+        }
+        auto c = clock::now();
+
+        if (steady) {
+            push_sec += std::chrono::duration<double>(b - a).count();
+            scan_sec += std::chrono::duration<double>(c - b).count();
+            pushed += per_frame * stores.size();
+        }
+    }
+
+    result.steady_allocations = bench::allocation_count() - allocs_at_steady;
+    result.push_prune_ns = pushed ? push_sec * 1e9 / static_cast<double>(pushed) : 0.0;
+    result.scan_ns = scanned ? scan_sec * 1e9 / static_cast<double>(scanned) : 0.0;
+    size_t bytes = 0;
+    size_t samples = 0;
+    for (const auto& store : stores) {
+        bytes += store.bytes();
+        samples += store.size();
+    }
+    result.bytes_per_sample = samples ? static_cast<double>(bytes) / static_cast<double>(samples) : 0.0;
+    return result;
+}
+
+struct PartialRowsResult {
+    double ingest_ns = 0.0;  // per stored sample, prune included
+    uint64_t fallbacks = 0;
+    uint64_t checks = 0;
+};
+
+// Lines of a serial read share its timestamp, so a channel missing from the
+// line before stores a time that is not its line's row.
+PartialRowsResult run_partial_rows(const StorageConfig& cfg) {
+    constexpr uint64_t kLinesPerRead = 8;
+    ChannelModel model;
+    model.set_time_window(cfg.window);
+    model.set_history_budget(0);
+    model.set_shared_timestamps(true);
+    std::vector<std::string> keys;
+    for (int ch = 0; ch < cfg.channels; ++ch) {
+        keys.push_back("ch" + std::to_string(ch));
+    }
+
+    const uint64_t per_frame = static_cast<uint64_t>(cfg.frame_ms * 1e-3 * cfg.rate + 0.5);
+    const uint64_t frames = static_cast<uint64_t>(cfg.seconds / (cfg.frame_ms * 1e-3));
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> draw(0.0, 1.0);
+    std::unordered_map<std::string, int> kv;
+    uint64_t line = 0;
+    uint64_t stored = 0;
+    auto a = std::chrono::steady_clock::now();
+    for (uint64_t f = 0; f < frames; ++f) {
+        for (uint64_t i = 0; i < per_frame; ++i, ++line) {
+            double read_ts = static_cast<double>(line - line % kLinesPerRead) / cfg.rate;
+            kv.clear();
+            for (size_t ch = 0; ch < keys.size(); ++ch) {
+                if (ch % 2 == 0 || draw(rng) < cfg.present) {
+                    kv[keys[ch]] = static_cast<int>(((line * 2654435761u + ch * 40503u) >> 20) & 0xFFF);
+                }
+            }
+            stored += static_cast<uint64_t>(model.update_from_kv(kv, read_ts));
+        }
+        model.prune(static_cast<double>(line) / cfg.rate);
+    }
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - a).count();
+
+    PartialRowsResult result;
+    result.ingest_ns = stored ? sec * 1e9 / static_cast<double>(stored) : 0.0;
+    result.fallbacks = model.get_row_fallbacks();
+    result.checks = stored / 4096;
+    return result;
+}
+
+bool parse_config(int argc, char** argv, StorageConfig* cfg, std::string* error) {
+    bench::Args args(argc, argv, 0);
+    if (args.flag("--help") || args.flag("-h")) {
+        return false;
+    }
+    double number = 0.0;
+    if (args.number("--channels", &number)) {
+        cfg->channels = static_cast<int>(number);
+    }
+    args.number("--rate", &cfg->rate);
+    args.number("--window", &cfg->window);
+    args.number("--seconds", &cfg->seconds);
+    args.number("--frame-ms", &cfg->frame_ms);
+    if (args.number("--hold", &number)) {
+        cfg->hold = static_cast<int>(number);
+    }
+    args.number("--present", &cfg->present);
+    args.text("--json", &cfg->json_out);
+    if (!args.finish(error)) {
+        return false;
+    }
+    if (cfg->channels < 1 || cfg->hold < 1 || cfg->rate <= 0.0 || cfg->window <= 0.0 || cfg->frame_ms <= 0.0 ||
+        cfg->present < 0.0 || cfg->present > 1.0 ||
+        cfg->seconds < cfg->window * 2.0) {
+        *error = "Invalid storage configuration (--seconds must be at least twice --window)";
+        return false;
+    }
+    return true;
+}
+} // namespace
+
+int run_storage_bench(int argc, char** argv) {
+    StorageConfig cfg;
+    std::string error;
+    if (!parse_config(argc, argv, &cfg, &error)) {
+        if (!error.empty()) {
+            std::fprintf(stderr, "%s\n\n", error.c_str());
+        }
+        print_usage();
+        return error.empty() ? 0 : 1;
+    }
+
+    size_t hint = static_cast<size_t>(cfg.rate * cfg.window * 1.25) + 1;
+    std::vector<StorageResult> results;
+    results.push_back(run_store(cfg, std::vector<DequeStore>(static_cast<size_t>(cfg.channels))));
+    results.push_back(run_store(cfg, std::vector<RingStore>(static_cast<size_t>(cfg.channels), RingStore(hint))));
+    results.push_back(run_store(cfg, std::vector<RunStore>(static_cast<size_t>(cfg.channels))));
+    size_t channels = static_cast<size_t>(cfg.channels);
+    results.push_back(run_store(cfg, std::vector<RowStore>(
+        channels, RowStore(std::make_shared<RowStore::Shared>(), channels, hint))));
+
+    std::printf("%d channels x %.0f samples/s, values held %d samples, %.0f s window, %.0f s simulated\n",
+                cfg.channels, cfg.rate, cfg.hold, cfg.window, cfg.seconds);
+    std::printf("%-8s %14s %12s %14s %12s\n", "storage", "push+prune ns", "scan ns", "steady allocs", "bytes/sample");
+    for (const auto& r : results) {
+        std::printf("%-8s %14.2f %12.3f %14llu %12.1f\n", r.name, r.push_prune_ns, r.scan_ns,
+                    static_cast<unsigned long long>(r.steady_allocations), r.bytes_per_sample);
+    }
+    PartialRowsResult partial = run_partial_rows(cfg);
+    std::printf("model, every other channel on %.1f%% of lines: %.2f ns/sample, %llu shared-row fallbacks in %llu "
+                "mode checks\n",
+                cfg.present * 100.0, partial.ingest_ns, static_cast<unsigned long long>(partial.fallbacks),
+                static_cast<unsigned long long>(partial.checks));
+    for (size_t i = 1; i < results.size(); ++i) {
+        if (results[i].checksum != results[0].checksum) {
+            std::fprintf(stderr, "checksum mismatch: %s %lld vs %s %lld\n", results[0].name, results[0].checksum,
+                         results[i].name, results[i].checksum);
+            return 3;
+        }
+    }
+
+    if (!cfg.json_out.empty()) {
+        std::string out = "{\n  \"results\": [\n";
+        char buf[256] = {};
+        for (size_t i = 0; i < results.size(); ++i) {
+            const auto& r = results[i];
+            std::snprintf(buf, sizeof(buf),
+                "    {\"storage\": \"%s\", \"push_prune_ns\": %.3f, \"scan_ns\": %.4f, "
+                "\"steady_allocations\": %llu, \"bytes_per_sample\": %.2f}%s\n",
+                r.name, r.push_prune_ns, r.scan_ns, static_cast<unsigned long long>(r.steady_allocations),
+                r.bytes_per_sample, (i + 1 < results.size()) ? "," : "");
+            out += buf;
+        }
+        std::snprintf(buf, sizeof(buf),
+            "  ],\n  \"partial_rows\": {\"ingest_ns\": %.3f, \"fallbacks\": %llu, \"checks\": %llu}\n}\n",
+            partial.ingest_ns, static_cast<unsigned long long>(partial.fallbacks),
+            static_cast<unsigned long long>(partial.checks));
+        out += buf;
+        if (!bench::write_text_file(cfg.json_out, out, &error)) {
+            std::fprintf(stderr, "%s\n", error.c_str());
+            return 2;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+
+// POSIX byte source for the headless tool: a serial device, a pty, stdin or
+// a plain file. Serial devices and ptys are switched to raw mode with the
+// same framing options the GUI offers.
+class CaptureSource {
+public:
+    enum Parity {
+        kParityNone = 0,
+        kParityOdd = 1,
+        kParityEven = 2,
+    };
+
+    CaptureSource();
+    ~CaptureSource();
+
+    CaptureSource(const CaptureSource&) = delete;
+    CaptureSource& operator=(const CaptureSource&) = delete;
+
+    bool open_device(const std::string& path,
+                     int baud,
+                     int data_bits,
+                     int parity,
+                     int stop_bits,
+                     std::string* error);
+    bool open_stdin(std::string* error);
+    bool open_file(const std::string& path, std::string* error);
+
+    bool is_open() const;
+    bool at_eof() const;
+    void close();
+
+    // Waits up to timeout_ms for input, then reads what is available.
+    // Returns the byte count, 0 on timeout or EOF, -1 on error.
+    int read_some(char* buffer, int size, int timeout_ms, std::string* error);
+
+private:
+    int fd_ = -1;
+    bool owns_fd_ = false;
+    bool eof_ = false;
+};
@@ -0,0 +1,220 @@
+#include "capture_source.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace {
+bool baud_to_speed(int baud, speed_t* out) {
+    struct Entry {
+        int baud;
+        speed_t speed;
+    };
+    static const Entry kTable[] = {
+        {9600, B9600},
+        {19200, B19200},
+        {38400, B38400},
+        {57600, B57600},
+        {115200, B115200},
+        {230400, B230400},
+#ifdef B460800
+        {460800, B460800},
+#endif
+#ifdef B921600
+        {921600, B921600},
+#endif
+#ifdef B1000000
+        {1000000, B1000000},
+#endif
+#ifdef B2000000
+        {2000000, B2000000},
+#endif
+    };
+    for (const auto& entry : kTable) {
+        if (entry.baud == baud) {
+            *out = entry.speed;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string errno_text(const char* what) {
+    return std::string(what) + ": " + std::strerror(errno);
+}
+} // namespace
+
+CaptureSource::CaptureSource() = default;
+
+CaptureSource::~CaptureSource() {
+    close();
+}
+
+bool CaptureSource::open_device(const std::string& path,
+                                int baud,
+                                int data_bits,
+                                int parity,
+                                int stop_bits,
+                                std::string* error) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        if (error) {
+            *error = errno_text("Open failed");
+        }
+        return false;
+    }
+
+    if (isatty(fd)) {
+        speed_t speed = 0;
+        if (!baud_to_speed(baud, &speed)) {
+            if (error) {
+                *error = "Unsupported baud rate";
+            }
+            ::close(fd);
+            return false;
+        }
+
+        termios tio = {};
+        if (tcgetattr(fd, &tio) != 0) {
+            if (error) {
+                *error = errno_text("tcgetattr failed");
+            }
+            ::close(fd);
+            return false;
+        }
+
+        cfmakeraw(&tio);
+        cfsetispeed(&tio, speed);
+        cfsetospeed(&tio, speed);
+
+        tio.c_cflag &= ~CSIZE;
+        switch (data_bits) {
+        case 5: tio.c_cflag |= CS5; break;
+        case 6: tio.c_cflag |= CS6; break;
+        case 7: tio.c_cflag |= CS7; break;
+        default: tio.c_cflag |= CS8; break;
+        }
+
+        tio.c_cflag &= ~(PARENB | PARODD);
+        if (parity == kParityEven) {
+            tio.c_cflag |= PARENB;
+        } else if (parity == kParityOdd) {
+            tio.c_cflag |= PARENB | PARODD;
+        }
+
+        if (stop_bits >= 2) {
+            tio.c_cflag |= CSTOPB;
+        } else {
+            tio.c_cflag &= ~CSTOPB;
+        }
+        tio.c_cflag |= CLOCAL | CREAD;
+        tio.c_cc[VMIN] = 0;
+        tio.c_cc[VTIME] = 0;
+
+        if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+            if (error) {
+                *error = errno_text("tcsetattr failed");
+            }
+            ::close(fd);
+            return false;
+        }
+        tcflush(fd, TCIOFLUSH);
+    }
+
+    fd_ = fd;
+    owns_fd_ = true;
+    eof_ = false;
+    return true;
+}
+
+bool CaptureSource::open_stdin(std::string* error) {
+    close();
+    if (fcntl(STDIN_FILENO, F_GETFD) < 0) {
+        if (error) {
+            *error = errno_text("stdin unavailable");
+        }
+        return false;
+    }
+    fd_ = STDIN_FILENO;
+    owns_fd_ = false;
+    eof_ = false;
+    return true;
+}
+
+bool CaptureSource::open_file(const std::string& path, std::string* error) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (error) {
+            *error = errno_text("Open failed");
+        }
+        return false;
+    }
+    fd_ = fd;
+    owns_fd_ = true;
+    eof_ = false;
+    return true;
+}
+
+bool CaptureSource::is_open() const {
+    return fd_ >= 0;
+}
+
+bool CaptureSource::at_eof() const {
+    return eof_;
+}
+
+void CaptureSource::close() {
+    if (fd_ >= 0 && owns_fd_) {
+        ::close(fd_);
+    }
+    fd_ = -1;
+    owns_fd_ = false;
+    eof_ = false;
+}
+
+int CaptureSource::read_some(char* buffer, int size, int timeout_ms, std::string* error) {
+    if (fd_ < 0 || eof_ || !buffer || size <= 0) {
+        return 0;
+    }
+
+    pollfd pfd = {};
+    pfd.fd = fd_;
+    pfd.events = POLLIN;
+    int ready = ::poll(&pfd, 1, timeout_ms);
+    if (ready < 0) {
+        if (errno == EINTR) {
+            return 0;
+        }
+        if (error) {
+            *error = errno_text("poll failed");
+        }
+        return -1;
+    }
+    if (ready == 0) {
+        return 0;
+    }
+
+    ssize_t n = ::read(fd_, buffer, static_cast<size_t>(size));
+    if (n < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            return 0;
+        }
+        if (error) {
+            *error = errno_text("Read failed");
+        }
+        return -1;
+    }
+    if (n == 0) {
+        // Writer side is gone (end of file, closed pipe or hung-up pty).
+        eof_ = true;
+        return 0;
+    }
+    return static_cast<int>(n);
+}
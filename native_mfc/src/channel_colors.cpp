@@ -0,0 +1,56 @@
+#include "channel_colors.h"
+
+#include <cmath>
+
+namespace {
+const uint32_t kPalette[] = {
+    0xFF6347,
+    0x1E90FF,
+    0x32CD32,
+    0xFF1493,
+    0x8A2BE2,
+    0xFF8C00,
+    0x00CED1,
+    0xDC143C,
+};
+constexpr size_t kPaletteSize = sizeof(kPalette) / sizeof(kPalette[0]);
+constexpr double kGoldenAngle = 137.50776405003785;
+
+uint32_t hsv_to_rgb(double h, double s, double v) {
+    double c = v * s;
+    double hp = std::fmod(h, 360.0) / 60.0;
+    double x = c * (1.0 - std::fabs(std::fmod(hp, 2.0) - 1.0));
+    double r = 0.0, g = 0.0, b = 0.0;
+    if (hp < 1.0) {
+        r = c; g = x;
+    } else if (hp < 2.0) {
+        r = x; g = c;
+    } else if (hp < 3.0) {
+        g = c; b = x;
+    } else if (hp < 4.0) {
+        g = x; b = c;
+    } else if (hp < 5.0) {
+        r = x; b = c;
+    } else {
+        r = c; b = x;
+    }
+    double m = v - c;
+    auto channel = [m](double value) {
+        return static_cast<uint32_t>(std::lround((value + m) * 255.0));
+    };
+    return (channel(r) << 16) | (channel(g) << 8) | channel(b);
+}
+} // namespace
+
+uint32_t channel_color(size_t index) {
+    if (index < kPaletteSize) {
+        return kPalette[index];
+    }
+    size_t n = index - kPaletteSize;
+    double hue = 15.0 + static_cast<double>(n) * kGoldenAngle;
+    // Alternate saturation/value bands so equal hues on later turns differ.
+    static const double kSat[] = {0.75, 0.55, 0.90};
+    static const double kVal[] = {1.00, 0.85, 0.95};
+    size_t band = (n / 3) % 3;
+    return hsv_to_rgb(hue, kSat[band], kVal[band]);
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Plot color for the channel registered at `index`, as 0xRRGGBB. The first
+// eight are the original palette; later channels walk the hue circle by the
+// golden angle so that neighbouring channels stay distinguishable.
+uint32_t channel_color(size_t index);
@@ -0,0 +1,294 @@
+#include "channel_filter.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+
+namespace {
+constexpr double kPi = 3.14159265358979323846;
+
+std::string trim(const std::string& s) {
+    size_t b = s.find_first_not_of(" \t\r\n");
+    if (b == std::string::npos) {
+        return "";
+    }
+    size_t e = s.find_last_not_of(" \t\r\n");
+    return s.substr(b, e - b + 1);
+}
+
+bool parse_number(const std::string& text, double* out) {
+    std::string s = trim(text);
+    if (s.empty()) {
+        return false;
+    }
+    char* end = nullptr;
+    *out = std::strtod(s.c_str(), &end);
+    return end == s.c_str() + s.size() && std::isfinite(*out);
+}
+} // namespace
+
+bool parse_filter_call(const std::string& text, FilterSpec* spec, std::string* source, std::string* error) {
+    std::string s = trim(text);
+    size_t name_end = 0;
+    while (name_end < s.size() && std::isalpha(static_cast<unsigned char>(s[name_end]))) {
+        name_end++;
+    }
+    std::string name = s.substr(0, name_end);
+    FilterSpec out;
+    size_t params = 1;
+    if (name == "boxcar") {
+        out.kind = FilterSpec::Kind::kBoxcar;
+    } else if (name == "ema") {
+        out.kind = FilterSpec::Kind::kEma;
+    } else if (name == "lowpass") {
+        out.kind = FilterSpec::Kind::kLowpass;
+        params = 2;
+    } else if (name == "median") {
+        out.kind = FilterSpec::Kind::kMedian;
+    } else {
+        return false;
+    }
+    size_t open = s.find_first_not_of(" \t", name_end);
+    if (open == std::string::npos || s[open] != '(' || s.back() != ')') {
+        return false;
+    }
+
+    // Split at top-level commas; the call must close at the last character.
+    std::vector<std::string> args;
+    int depth = 0;
+    size_t start = open + 1;
+    for (size_t i = open; i < s.size(); ++i) {
+        char c = s[i];
+        if (c == '(' || c == '[') {
+            depth++;
+        } else if (c == ')' || c == ']') {
+            depth--;
+            if (depth == 0 && i + 1 != s.size()) {
+                return false;
+            }
+        } else if (c == ',' && depth == 1) {
+            args.push_back(s.substr(start, i - start));
+            start = i + 1;
+        }
+    }
+    args.push_back(s.substr(start, s.size() - 1 - start));
+
+    if (args.size() < 2 || args.size() > 1 + params) {
+        *error = name + " takes a source and " + (params == 1 ? "1 parameter" : "1 or 2 parameters");
+        return false;
+    }
+    double p[2] = {0.0, out.q};
+    for (size_t i = 1; i < args.size(); ++i) {
+        if (!parse_number(args[i], &p[i - 1])) {
+            *error = "Invalid " + name + " parameter: " + trim(args[i]);
+            return false;
+        }
+    }
+    switch (out.kind) {
+    case FilterSpec::Kind::kBoxcar:
+    case FilterSpec::Kind::kMedian:
+        if (p[0] < 1.0 || p[0] > ChannelFilter::kMaxLength || p[0] != std::floor(p[0])) {
+            *error = name + " length must be a whole number from 1 to " + std::to_string(ChannelFilter::kMaxLength);
+            return false;
+        }
+        out.length = static_cast<int>(p[0]);
+        break;
+    case FilterSpec::Kind::kEma:
+        if (!(p[0] > 0.0 && p[0] <= 1.0)) {
+            *error = "ema weight must be in (0, 1]";
+            return false;
+        }
+        out.alpha = p[0];
+        break;
+    case FilterSpec::Kind::kLowpass:
+        if (!(p[0] > 0.0 && p[0] < 0.5) || !(p[1] > 0.0)) {
+            *error = "lowpass corner must be in (0, 0.5) of the sample rate, Q above 0";
+            return false;
+        }
+        out.cutoff = p[0];
+        out.q = p[1];
+        break;
+    }
+    *spec = out;
+    *source = trim(args[0]);
+    return true;
+}
+
+ChannelFilter::ChannelFilter(const FilterSpec& spec) : spec_(spec) {
+    if (spec_.kind == FilterSpec::Kind::kLowpass) {
+        // RBJ cookbook low-pass, normalised by a0.
+        double w0 = 2.0 * kPi * spec_.cutoff;
+        double cosw = std::cos(w0);
+        double alpha = std::sin(w0) / (2.0 * spec_.q);
+        double a0 = 1.0 + alpha;
+        b0_ = (1.0 - cosw) * 0.5 / a0;
+        b1_ = (1.0 - cosw) / a0;
+        b2_ = b0_;
+        a1_ = -2.0 * cosw / a0;
+        a2_ = (1.0 - alpha) / a0;
+    }
+    reset();
+}
+
+void ChannelFilter::reset() {
+    bool windowed = spec_.kind == FilterSpec::Kind::kBoxcar || spec_.kind == FilterSpec::Kind::kMedian;
+    window_.assign(windowed ? static_cast<size_t>(spec_.length) : 0, 0.0);
+    pos_ = 0;
+    filled_ = 0;
+    sum_ = 0.0;
+    sorted_.clear();
+    sorted_.reserve(window_.size());
+    primed_ = false;
+    y_ = 0.0;
+    z1_ = 0.0;
+    z2_ = 0.0;
+}
+
+double ChannelFilter::process(double x) {
+    switch (spec_.kind) {
+    case FilterSpec::Kind::kBoxcar:
+        return boxcar(x);
+    case FilterSpec::Kind::kMedian:
+        return median(x);
+    case FilterSpec::Kind::kEma:
+        y_ = primed_ ? y_ + spec_.alpha * (x - y_) : x;
+        primed_ = true;
+        return y_;
+    case FilterSpec::Kind::kLowpass: {
+        if (!primed_) {
+            // Start settled at the first value instead of ringing up from 0.
+            z2_ = (b2_ - a2_) * x;
+            z1_ = (b1_ - a1_) * x + z2_;
+            primed_ = true;
+        }
+        double y = b0_ * x + z1_;
+        z1_ = b1_ * x - a1_ * y + z2_;
+        z2_ = b2_ * x - a2_ * y;
+        return y;
+    }
+    }
+    return x;
+}
+
+double ChannelFilter::push_window(double x) {
+    double old = window_[pos_];
+    window_[pos_] = x;
+    pos_ = pos_ + 1 == window_.size() ? 0 : pos_ + 1;
+    if (filled_ < window_.size()) {
+        filled_++;
+    }
+    return old;
+}
+
+double ChannelFilter::boxcar(double x) {
+    bool full = filled_ == window_.size();
+    double old = push_window(x);
+    sum_ += x - (full ? old : 0.0);
+    if (pos_ == 0) {
+        // Re-sum once per lap so fractional inputs cannot drift.
+        sum_ = 0.0;
+        for (double v : window_) {
+            sum_ += v;
+        }
+    }
+    return sum_ / static_cast<double>(filled_);
+}
+
+double ChannelFilter::median(double x) {
+    if (filled_ == window_.size()) {
+        sorted_.erase(std::lower_bound(sorted_.begin(), sorted_.end(), window_[pos_]));
+    }
+    push_window(x);
+    sorted_.insert(std::upper_bound(sorted_.begin(), sorted_.end(), x), x);
+    size_t half = sorted_.size() / 2;
+    return sorted_.size() % 2 ? sorted_[half] : (sorted_[half - 1] + sorted_[half]) * 0.5;
+}
+
+void ChannelFilter::process_batch(const double* in, double* out, size_t n) {
+    switch (spec_.kind) {
+    case FilterSpec::Kind::kBoxcar:
+        boxcar_batch(in, out, n);
+        return;
+    case FilterSpec::Kind::kMedian:
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = median(in[i]);
+        }
+        return;
+    case FilterSpec::Kind::kEma: {
+        if (n == 0) {
+            return;
+        }
+        double y = primed_ ? y_ : in[0];
+        const double a = spec_.alpha;
+        for (size_t i = 0; i < n; ++i) {
+            y += a * (in[i] - y);
+            out[i] = y;
+        }
+        y_ = y;
+        primed_ = true;
+        return;
+    }
+    case FilterSpec::Kind::kLowpass: {
+        if (n == 0) {
+            return;
+        }
+        out[0] = process(in[0]);
+        const double b0 = b0_, b1 = b1_, b2 = b2_, a1 = a1_, a2 = a2_;
+        double z1 = z1_, z2 = z2_;
+        for (size_t i = 1; i < n; ++i) {
+            double x = in[i];
+            double y = b0 * x + z1;
+            z1 = b1 * x - a1 * y + z2;
+            z2 = b2 * x - a2 * y;
+            out[i] = y;
+        }
+        z1_ = z1;
+        z2_ = z2;
+        return;
+    }
+    }
+}
+
+void ChannelFilter::boxcar_batch(const double* in, double* out, size_t n) {
+    size_t i = 0;
+    for (; i < n && filled_ < window_.size(); ++i) {
+        out[i] = boxcar(in[i]);
+    }
+    if (i == n) {
+        return;
+    }
+
+    // ext = the window in time order followed by the rest of the input;
+    // each output is a difference of two prefix sums of ext.
+    const size_t len = window_.size();
+    const size_t m = n - i;
+    scratch_.resize(len + m + 1);
+    double* prefix = scratch_.data();
+    prefix[0] = 0.0;
+    for (size_t k = 0; k < len; ++k) {
+        prefix[k + 1] = prefix[k] + window_[(pos_ + k) % len];
+    }
+    for (size_t k = 0; k < m; ++k) {
+        prefix[len + k + 1] = prefix[len + k] + in[i + k];
+    }
+    const double inv = 1.0 / static_cast<double>(len);
+    double* dst = out + i;
+    for (size_t k = 0; k < m; ++k) {
+        dst[k] = (prefix[len + k + 1] - prefix[k + 1]) * inv;
+    }
+
+    // Leave the state as if the samples had gone through boxcar().
+    if (m >= len) {
+        std::copy(in + n - len, in + n, window_.begin());
+        pos_ = 0;
+    } else {
+        for (size_t k = 0; k < m; ++k) {
+            push_window(in[i + k]);
+        }
+    }
+    sum_ = 0.0;
+    for (double v : window_) {
+        sum_ += v;
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Parameters of one smoothing filter.
+struct FilterSpec {
+    enum class Kind : uint8_t { kBoxcar, kEma, kLowpass, kMedian };
+
+    Kind kind = Kind::kBoxcar;
+    int length = 1;         // boxcar, median: samples in the window
+    double alpha = 1.0;     // ema: weight of the newest sample, (0, 1]
+    double cutoff = 0.1;    // lowpass: corner as a fraction of the sample rate, (0, 0.5)
+    double q = 0.7071;      // lowpass: quality factor (0.7071 = Butterworth)
+};
+
+// Recognises "kind(source, p1[, p2])" spanning the whole text:
+//   boxcar(x, N)   moving average over N samples
+//   ema(x, A)      exponential average, y += A * (x - y)
+//   lowpass(x, F[, Q])  2nd-order IIR low-pass, corner F x sample rate
+//   median(x, N)   running median over N samples
+// *source receives the inner expression text. Returns false with *error left
+// empty when the text is not a filter call at all.
+bool parse_filter_call(const std::string& text, FilterSpec* spec, std::string* source, std::string* error);
+
+// Streaming filter over one channel's values. process() handles a sample as
+// it arrives; process_batch() runs a block through the same state (used to
+// warm up and backfill a filter added mid-capture) with the per-sample
+// bookkeeping hoisted out of the loop, and the boxcar as a difference of
+// prefix sums the compiler can vectorise.
+class ChannelFilter {
+public:
+    static constexpr int kMaxLength = 4096;
+
+    ChannelFilter() = default;
+    explicit ChannelFilter(const FilterSpec& spec);
+
+    const FilterSpec& spec() const { return spec_; }
+    void reset();
+
+    double process(double x);
+    void process_batch(const double* in, double* out, size_t n);
+
+private:
+    double push_window(double x);  // stores x, returns the value it replaced
+    double boxcar(double x);
+    double median(double x);
+    void boxcar_batch(const double* in, double* out, size_t n);
+
+    FilterSpec spec_;
+
+    // Boxcar and median: the last `length` inputs, oldest at pos_ once full.
+    std::vector<double> window_;
+    size_t pos_ = 0;
+    size_t filled_ = 0;
+    double sum_ = 0.0;
+    std::vector<double> scratch_;
+    // Median: the window's values in ascending order.
+    std::vector<double> sorted_;
+
+    // EMA output, or the low-pass state (transposed direct form II).
+    bool primed_ = false;
+    double y_ = 0.0;
+    double b0_ = 1.0;
+    double b1_ = 0.0;
+    double b2_ = 0.0;
+    double a1_ = 0.0;
+    double a2_ = 0.0;
+    double z1_ = 0.0;
+    double z2_ = 0.0;
+};
@@ -0,0 +1,329 @@
+#include "channel_history.h"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+constexpr double kTicksPerSecond = 1e6;
+
+// Prefix code classes: class i is written as i one-bits and a zero (the
+// last class drops the zero) followed by widths[i] payload bits.
+constexpr int kTimeWidths[] = {0, 7, 9, 12, 32, 64};
+constexpr int kValueWidths[] = {0, 4, 8, 16, 33};
+constexpr int kTimeClasses = sizeof(kTimeWidths) / sizeof(kTimeWidths[0]);
+constexpr int kValueClasses = sizeof(kValueWidths) / sizeof(kValueWidths[0]);
+
+uint64_t zigzag(int64_t v) {
+    return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+
+int64_t unzigzag(uint64_t v) {
+    return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+}
+
+// Number of leading one bits; v must not be all ones.
+int leading_ones(uint64_t v) {
+#ifdef _MSC_VER
+    unsigned long index = 0;
+    _BitScanReverse64(&index, ~v);
+    return 63 - static_cast<int>(index);
+#else
+    return __builtin_clzll(~v);
+#endif
+}
+
+bool fits(uint64_t v, int width) {
+    return width >= 64 || v < (uint64_t(1) << width);
+}
+
+// MSB-first reader over a block; keeps up to 64 upcoming bits in a word.
+class BitReader {
+public:
+    BitReader(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+    uint64_t get(int count) {
+        if (count == 0) {
+            return 0;
+        }
+        if (count > 56) {
+            uint64_t hi = get(32);
+            return (hi << (count - 32)) | get(count - 32);
+        }
+        if (avail_ < count) {
+            refill();
+        }
+        uint64_t out = word_ >> (64 - count);
+        word_ <<= count;
+        avail_ -= count;
+        return out;
+    }
+
+    uint64_t get_code(const int* widths, int classes) {
+        if (avail_ < classes) {
+            refill();
+        }
+        // Clearing the bit after the longest run caps it at the last class.
+        int cls = leading_ones(word_ & ~(uint64_t(1) << (64 - classes)));
+        int used = (cls < classes - 1) ? cls + 1 : cls;
+        word_ <<= used;
+        avail_ -= used;
+        return get(widths[cls]);
+    }
+
+private:
+    void refill() {
+        // Whole bytes up to 64 bits at once while 8 remain, then byte by byte.
+        if (pos_ + 8 <= size_) {
+            uint64_t next = 0;
+            for (int i = 0; i < 8; ++i) {
+                next = (next << 8) | data_[pos_ + static_cast<size_t>(i)];
+            }
+            word_ |= next >> avail_;
+            pos_ += static_cast<size_t>((63 - avail_) >> 3);
+            avail_ |= 56;
+            return;
+        }
+        while (avail_ <= 56) {
+            uint64_t byte = (pos_ < size_) ? data_[pos_] : 0;
+            pos_++;
+            word_ |= byte << (56 - avail_);
+            avail_ += 8;
+        }
+    }
+
+    const uint8_t* data_;
+    size_t size_;
+    size_t pos_ = 0;
+    uint64_t word_ = 0;
+    int avail_ = 0;
+};
+
+template <typename Fn>
+void for_each_sample(const uint8_t* data, size_t size, uint32_t count, Fn&& fn) {
+    if (count == 0) {
+        return;
+    }
+    BitReader in(data, size);
+    int64_t tick = static_cast<int64_t>(in.get(64));
+    int value = static_cast<int>(static_cast<uint32_t>(in.get(32)));
+    int64_t delta = 0;
+    fn(static_cast<double>(tick) / kTicksPerSecond, value);
+    for (uint32_t i = 1; i < count; ++i) {
+        delta += unzigzag(in.get_code(kTimeWidths, kTimeClasses));
+        tick += delta;
+        value = static_cast<int>(value + unzigzag(in.get_code(kValueWidths, kValueClasses)));
+        fn(static_cast<double>(tick) / kTicksPerSecond, value);
+    }
+}
+} // namespace
+
+void ChannelHistory::put_bits(Block* block, uint64_t value, int count) {
+    while (count > 0) {
+        int bit = static_cast<int>(block->bits & 7);
+        if (bit == 0) {
+            block->data.push_back(0);
+            bytes_ += 1;
+        }
+        int room = 8 - bit;
+        int take = std::min(room, count);
+        uint64_t chunk = (value >> (count - take)) & ((1u << take) - 1);
+        block->data.back() |= static_cast<uint8_t>(chunk << (room - take));
+        block->bits += static_cast<size_t>(take);
+        count -= take;
+    }
+}
+
+void ChannelHistory::append(double t, int v) {
+    int64_t tick = std::llround(t * kTicksPerSecond);
+    double t_stored = static_cast<double>(tick) / kTicksPerSecond;
+    samples_++;
+
+    if (blocks_.empty() || blocks_.back().info.count == kBlockSamples) {
+        if (!blocks_.empty()) {
+            blocks_.back().data.shrink_to_fit();
+        }
+        blocks_.emplace_back();
+        bytes_ += sizeof(Block);
+        Block& block = blocks_.back();
+        block.info = HistoryBlockInfo{t_stored, t_stored, v, v, 1, v, v, v};
+        put_bits(&block, static_cast<uint64_t>(tick), 64);
+        put_bits(&block, static_cast<uint32_t>(v), 32);
+        prev_tick_ = tick;
+        prev_delta_ = 0;
+        prev_value_ = v;
+        return;
+    }
+
+    Block& block = blocks_.back();
+    int64_t delta = tick - prev_tick_;
+    const struct {
+        uint64_t zz;
+        const int* widths;
+        int classes;
+    } fields[] = {
+        {zigzag(delta - prev_delta_), kTimeWidths, kTimeClasses},
+        {zigzag(static_cast<int64_t>(v) - prev_value_), kValueWidths, kValueClasses},
+    };
+    for (const auto& f : fields) {
+        int cls = 0;
+        while (!fits(f.zz, f.widths[cls])) {
+            cls++;
+        }
+        if (cls < f.classes - 1) {
+            put_bits(&block, (uint64_t(1) << (cls + 1)) - 2, cls + 1);
+        } else {
+            put_bits(&block, (uint64_t(1) << cls) - 1, cls);
+        }
+        put_bits(&block, f.zz, f.widths[cls]);
+    }
+
+    prev_tick_ = tick;
+    prev_delta_ = delta;
+    prev_value_ = v;
+    block.info.t_last = t_stored;
+    block.info.vmin = std::min(block.info.vmin, v);
+    block.info.vmax = std::max(block.info.vmax, v);
+    block.info.count++;
+    block.info.v_last = v;
+    block.info.sum += v;
+}
+
+void ChannelHistory::clear() {
+    blocks_.clear();
+    samples_ = 0;
+    bytes_ = 0;
+}
+
+bool ChannelHistory::pop_sealed_front(HistoryBlockInfo* info, std::vector<uint8_t>* data) {
+    if (!has_sealed_front()) {
+        return false;
+    }
+    Block& block = blocks_.front();
+    *info = block.info;
+    samples_ -= block.info.count;
+    bytes_ -= block.data.size() + sizeof(Block);
+    data->swap(block.data);
+    blocks_.pop_front();
+    return true;
+}
+
+uint32_t ChannelHistory::drop_front() {
+    if (blocks_.empty()) {
+        return 0;
+    }
+    const Block& block = blocks_.front();
+    uint32_t count = block.info.count;
+    samples_ -= count;
+    bytes_ -= block.data.size() + sizeof(Block);
+    blocks_.pop_front();
+    return count;
+}
+
+size_t ChannelHistory::first_block_at(double t) const {
+    size_t lo = 0;
+    size_t hi = blocks_.size();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (blocks_[mid].info.t_last < t) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+void ChannelHistory::decode_block(size_t i, std::vector<ChannelSample>* out) const {
+    out->clear();
+    const Block& block = blocks_[i];
+    out->reserve(block.info.count);
+    for_each_sample(block.data.data(), block.data.size(), block.info.count, [out](double t, int v) {
+        out->push_back(ChannelSample{t, v});
+    });
+}
+
+void ChannelHistory::decode(const uint8_t* data, size_t size, uint32_t count, double t_start, double t_end,
+                            std::vector<ChannelSample>* out) {
+    for_each_sample(data, size, count, [&](double t, int v) {
+        if (t >= t_start && t <= t_end) {
+            out->push_back(ChannelSample{t, v});
+        }
+    });
+}
+
+bool ChannelHistory::decode_range(const uint8_t* data, size_t size, uint32_t count, double t_start, double t_end,
+                                  int* vmin, int* vmax) {
+    bool found = false;
+    for_each_sample(data, size, count, [&](double t, int v) {
+        if (t >= t_start && t <= t_end) {
+            *vmin = found ? std::min(*vmin, v) : v;
+            *vmax = found ? std::max(*vmax, v) : v;
+            found = true;
+        }
+    });
+    return found;
+}
+
+void ChannelHistory::aggregate_block(const HistoryBlockInfo& info, const uint8_t* data, size_t size,
+                                     AggregateBuckets* out) {
+    if (out->fits(info.t_first, info.t_last)) {
+        out->add(info.summary());
+        return;
+    }
+    for_each_sample(data, size, info.count, [out](double t, int v) { out->add(t, v); });
+}
+
+void ChannelHistory::read(double t_start, double t_end, std::vector<ChannelSample>* out) const {
+    for (size_t i = first_block_at(t_start); i < blocks_.size(); ++i) {
+        const Block& block = blocks_[i];
+        if (block.info.t_first > t_end) {
+            break;
+        }
+        decode(block.data.data(), block.data.size(), block.info.count, t_start, t_end, out);
+    }
+}
+
+void ChannelHistory::aggregate(AggregateBuckets* out) const {
+    for (size_t i = first_block_at(out->t_start()); i < blocks_.size(); ++i) {
+        const Block& block = blocks_[i];
+        if (block.info.t_first > out->t_end()) {
+            break;
+        }
+        aggregate_block(block.info, block.data.data(), block.data.size(), out);
+    }
+}
+
+bool ChannelHistory::value_range(double t_start, double t_end, int* vmin, int* vmax) const {
+    bool found = false;
+    int lo = 0;
+    int hi = 0;
+    auto take = [&](int a, int b) {
+        lo = found ? std::min(lo, a) : a;
+        hi = found ? std::max(hi, b) : b;
+        found = true;
+    };
+    for (size_t i = first_block_at(t_start); i < blocks_.size(); ++i) {
+        const Block& block = blocks_[i];
+        if (block.info.t_first > t_end) {
+            break;
+        }
+        if (block.info.t_first >= t_start && block.info.t_last <= t_end) {
+            take(block.info.vmin, block.info.vmax);
+            continue;
+        }
+        int a = 0;
+        int b = 0;
+        if (decode_range(block.data.data(), block.data.size(), block.info.count, t_start, t_end, &a, &b)) {
+            take(a, b);
+        }
+    }
+    if (found) {
+        *vmin = lo;
+        *vmax = hi;
+    }
+    return found;
+}
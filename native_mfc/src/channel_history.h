@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "range_aggregate.h"
+#include "sample_ring.h"
+
+// Index entry for one compressed block.
+struct HistoryBlockInfo {
+    double t_first = 0.0;
+    double t_last = 0.0;
+    int vmin = 0;
+    int vmax = 0;
+    uint32_t count = 0;
+    int v_first = 0;
+    int v_last = 0;
+    int64_t sum = 0;
+
+    RangeAggregate summary() const {
+        return RangeAggregate{count, vmin, vmax, sum, ChannelSample{t_first, v_first}, ChannelSample{t_last, v_last}};
+    }
+};
+
+// Compressed history of one channel: samples that left the hot ring, oldest
+// first, in blocks of up to kBlockSamples. Timestamps are stored as
+// microsecond ticks with delta-of-delta encoding and values as zigzag
+// deltas, each behind a short prefix code, so a steady rate and unchanged
+// values cost one bit each. The newest block stays open and is readable
+// while it fills.
+class ChannelHistory {
+public:
+    static constexpr uint32_t kBlockSamples = 1024;
+
+    // Times must be non-decreasing.
+    void append(double t, int v);
+    void clear();
+
+    bool empty() const { return blocks_.empty(); }
+    size_t block_count() const { return blocks_.size(); }
+    const HistoryBlockInfo& block_info(size_t i) const { return blocks_[i].info; }
+    uint64_t samples() const { return samples_; }
+    // Encoded bytes plus per-block overhead.
+    size_t bytes() const { return bytes_; }
+
+    // Drops the oldest block; returns its sample count.
+    uint32_t drop_front();
+    // Removes the oldest block if it is sealed (full), handing over its
+    // index entry and encoded bytes; false when only the open block is left.
+    bool pop_sealed_front(HistoryBlockInfo* info, std::vector<uint8_t>* data);
+    bool has_sealed_front() const {
+        return blocks_.size() > 1 || (!blocks_.empty() && blocks_[0].info.count == kBlockSamples);
+    }
+
+    // Appends the samples with t_start <= time <= t_end to out.
+    void read(double t_start, double t_end, std::vector<ChannelSample>* out) const;
+    // Value range over [t_start, t_end]; whole blocks come from the index.
+    bool value_range(double t_start, double t_end, int* vmin, int* vmax) const;
+    // Folds the samples within out's range into it; blocks inside one
+    // bucket come from the index, only the others are decoded.
+    void aggregate(AggregateBuckets* out) const;
+
+    // Decodes every sample of block i into out (replacing its contents).
+    void decode_block(size_t i, std::vector<ChannelSample>* out) const;
+
+    // Appends the samples of an encoded block with t_start <= time <= t_end.
+    static void decode(const uint8_t* data, size_t size, uint32_t count, double t_start, double t_end,
+                       std::vector<ChannelSample>* out);
+    // Value range of an encoded block's samples within [t_start, t_end].
+    static bool decode_range(const uint8_t* data, size_t size, uint32_t count, double t_start, double t_end,
+                             int* vmin, int* vmax);
+    // Folds an encoded block into out, from its index entry when it lies
+    // inside one bucket.
+    static void aggregate_block(const HistoryBlockInfo& info, const uint8_t* data, size_t size,
+                                AggregateBuckets* out);
+
+private:
+    struct Block {
+        HistoryBlockInfo info;
+        std::vector<uint8_t> data;
+        size_t bits = 0;
+    };
+
+    void put_bits(Block* block, uint64_t value, int count);
+    // First block whose t_last >= t.
+    size_t first_block_at(double t) const;
+
+    std::deque<Block> blocks_;
+    uint64_t samples_ = 0;
+    size_t bytes_ = 0;
+
+    // Encoder state for the open (newest) block.
+    int64_t prev_tick_ = 0;
+    int64_t prev_delta_ = 0;
+    int prev_value_ = 0;
+};
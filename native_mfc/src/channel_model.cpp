@@ -1,163 +1,1310 @@
 #include "channel_model.h"
 
+#include "spill_store.h"
+#include "trace.h"
+
 #include <algorithm>
+#include <cctype>
+#include <climits>
 #include <cmath>
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+constexpr double kCapacityHeadroom = 1.25;
+// Rings shrink when less than a quarter full after a prune.
+constexpr size_t kShrinkFactor = 4;
+constexpr size_t kShrinkMinCapacity = 1024;
+// Time and value columns plus ~2 bytes for the block index and LOD pyramid.
+constexpr size_t kBytesPerSample = sizeof(double) + sizeof(int) + 2;
+constexpr size_t kMinChannelSamples = 4096;
+// First and last time, first index and value (see SampleRing).
+constexpr size_t kBytesPerRun = 2 * sizeof(double) + sizeof(uint64_t) + sizeof(int);
+// Appends between storage mode checks, and the mean run lengths that
+// switch a channel into and out of run-length storage.
+constexpr uint32_t kModeCheckSamples = 4096;
+constexpr uint32_t kEnterRunLength = 16;
+constexpr uint32_t kLeaveRunLength = 4;
+// A channel shares line timestamps once it has a sample on at least
+// kSharedRowsNum / kSharedRowsDen of the lines.
+constexpr uint64_t kSharedRowsNum = 3;
+constexpr uint64_t kSharedRowsDen = 4;
+// Longest wait, in storage mode checks, before a channel that fell back
+// from shared timestamps tries them again.
+constexpr uint32_t kMaxRowBackoff = 64;
+
+int bit_count(uint64_t v) {
+#ifdef _MSC_VER
+    return static_cast<int>(__popcnt64(v));
+#else
+    return __builtin_popcountll(v);
+#endif
+}
+
+size_t round_down_pow2(size_t n) {
+    size_t p = 1;
+    while (p * 2 <= n) {
+        p *= 2;
+    }
+    return p;
+}
+} // namespace
+
+ChannelModel::ChannelModel() {
+    update_sample_limit();
+}
+
+ChannelModel::~ChannelModel() = default;
+
 void ChannelModel::reset_samples() {
-    for (auto& kv : channels_) {
-        kv.second.clear();
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    bump_version();
+    for (auto& ch : channels_) {
+        ch.samples.clear();
+        ch.lod.clear();
+        ch.history.clear();
+        ch.window_sums.clear();
+        ch.session.clear();
+        ch.window_sketch.clear();
+        ch.session_hist.clear();
+        ch.last_ts = 0.0;
+        ch.mode_samples = 0;
+        ch.mode_changes = 0;
+        ch.mode_line_seq = line_seq_;
+        ch.shared_rows = ch.samples.shared_times();
+        ch.row_wait = 0;
+        ch.row_backoff = 1;
+        ch.transitions.clear();
+    }
+    row_times_.clear();
+    for (auto& d : derived_) {
+        d.filter.reset();
     }
-    last_ts_.clear();
+    for (auto& armed : triggers_) {
+        armed.trigger.reset();
+        armed.pending = false;
+    }
+    pending_captures_.clear();
+    if (spill_) {
+        spill_->clear();
+    }
+    std::fill(data_bits_.begin(), data_bits_.end(), 0);
+    active_keys_.clear();
     total_samples_ = 0;
     rx_lines_ = 0;
     dropped_keys_ = 0;
+    evicted_samples_ = 0;
+    dropped_history_ = 0;
 }
 
 void ChannelModel::reset() {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    bump_version();
     channels_.clear();
-    enabled_.clear();
+    row_times_.clear();
+    // Definitions survive; their channels are recreated on the next line.
+    for (auto& d : derived_) {
+        d.id = -1;
+        std::fill(d.input_ids.begin(), d.input_ids.end(), -1);
+        d.filter.reset();
+    }
+    for (auto& armed : triggers_) {
+        armed.trigger.reset();
+        armed.id = -1;
+        armed.pending = false;
+    }
+    pending_captures_.clear();
+    if (spill_) {
+        spill_->clear();
+    }
     key_order_.clear();
-    first_seen_ts_.clear();
-    last_ts_.clear();
+    index_.clear();
+    enabled_bits_.clear();
+    data_bits_.clear();
+    enabled_count_ = 0;
+    active_keys_.clear();
     total_samples_ = 0;
     rx_lines_ = 0;
     dropped_keys_ = 0;
+    evicted_samples_ = 0;
+    dropped_history_ = 0;
+    update_sample_limit();
 }
 
 void ChannelModel::set_time_window(double sec) {
     if (sec < 1.0) {
         sec = 1.0;
     }
+    std::unique_lock<std::shared_mutex> lock(mutex_);
     time_window_sec_ = sec;
+    bump_version();
+    for (auto& ch : channels_) {
+        size_t hint = std::min(capacity_hint(ch.samples), sample_limit_);
+        if (hint > ch.samples.capacity()) {
+            ch.samples.reserve(hint);
+        }
+    }
 }
 
 double ChannelModel::get_time_window() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
     return time_window_sec_;
 }
 
-bool ChannelModel::ensure_channel(const std::string& key, double timestamp) {
-    if (channels_.find(key) != channels_.end()) {
-        return true;
+void ChannelModel::set_memory_budget(size_t bytes) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    memory_budget_ = bytes;
+    update_sample_limit();
+}
+
+size_t ChannelModel::get_memory_budget() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return memory_budget_;
+}
+
+size_t ChannelModel::get_channel_sample_limit() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return sample_limit_;
+}
+
+void ChannelModel::set_history_budget(size_t bytes) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    bump_version();
+    history_budget_ = bytes;
+    enforce_history_budget();
+}
+
+size_t ChannelModel::get_history_budget() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return history_budget_;
+}
+
+size_t ChannelModel::get_history_bytes() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return history_bytes();
+}
+
+size_t ChannelModel::history_bytes() const {
+    size_t bytes = 0;
+    for (const auto& ch : channels_) {
+        bytes += ch.history.bytes();
+    }
+    return bytes;
+}
+
+void ChannelModel::set_shared_timestamps(bool enabled) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (enabled == shared_timestamps_) {
+        return;
     }
+    shared_timestamps_ = enabled;
+    if (!enabled) {
+        bump_version();
+        for (auto& ch : channels_) {
+            ch.samples.set_row_times(nullptr);
+            ch.shared_rows = false;
+        }
+        row_times_.clear();
+    }
+}
 
-    if (static_cast<int>(channels_.size()) >= kMaxChannels) {
-        dropped_keys_ += 1;
+bool ChannelModel::get_shared_timestamps() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return shared_timestamps_;
+}
+
+uint64_t ChannelModel::get_row_fallbacks() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return row_fallbacks_;
+}
+
+size_t ChannelModel::get_sample_bytes() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    size_t bytes = row_times_.allocated_bytes();
+    for (const auto& ch : channels_) {
+        bytes += ch.samples.allocated_bytes();
+    }
+    return bytes;
+}
+
+uint64_t ChannelModel::get_history_samples() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    uint64_t samples = 0;
+    for (const auto& ch : channels_) {
+        samples += ch.history.samples();
+    }
+    return samples;
+}
+
+int ChannelModel::consume_dropped_history() {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    int count = dropped_history_;
+    dropped_history_ = 0;
+    if (spill_) {
+        count += spill_->consume_lost_samples();
+    }
+    return count;
+}
+
+bool ChannelModel::enable_spill(const std::string& dir, std::string* error) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto spill = std::make_unique<SpillStore>();
+    if (!spill->open(dir, error)) {
         return false;
     }
+    spill_ = std::move(spill);
+    return true;
+}
+
+void ChannelModel::disable_spill() {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    bump_version();
+    spill_.reset();
+}
+
+bool ChannelModel::is_spill_enabled() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return spill_ != nullptr;
+}
+
+void ChannelModel::flush_spill() {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    if (spill_) {
+        spill_->flush();
+    }
+}
+
+uint64_t ChannelModel::get_spilled_samples() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return spill_ ? spill_->samples() : 0;
+}
+
+uint64_t ChannelModel::get_spilled_bytes() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return spill_ ? spill_->bytes_on_disk() : 0;
+}
+
+size_t ChannelModel::run_limit() const {
+    return sample_limit_ * kBytesPerSample / kBytesPerRun;
+}
+
+void ChannelModel::retire_samples(Channel& ch, size_t n) {
+    n = std::min(n, ch.samples.size());
+    if (ch.samples.run_length() || ch.samples.shared_times()) {
+        // No time column to walk in these layouts.
+        for (size_t i = 0; i < n; ++i) {
+            ChannelSample s = ch.samples.at(i);
+            ch.window_sums.remove(s.v);
+            if (history_budget_ > 0) {
+                ch.history.append(s.t, s.v);
+            }
+        }
+    } else {
+        for (size_t i = 0; i < n;) {
+            SampleRing::Segment seg = ch.samples.segment(i, n);
+            for (size_t j = 0; j < seg.count; ++j) {
+                ch.window_sums.remove(seg.v[j]);
+            }
+            if (history_budget_ > 0) {
+                for (size_t j = 0; j < seg.count; ++j) {
+                    ch.history.append(seg.t[j], seg.v[j]);
+                }
+            }
+            i += seg.count;
+        }
+    }
+    ch.window_sketch.evict(n);
+    ch.samples.pop_front(n);
+}
+
+void ChannelModel::enforce_history_budget() {
+    // Oldest front block across all channels that passes the filter.
+    auto oldest_front = [this](bool sealed_only) {
+        Channel* oldest = nullptr;
+        for (auto& ch : channels_) {
+            if ((sealed_only ? ch.history.has_sealed_front() : !ch.history.empty()) &&
+                (!oldest || ch.history.block_info(0).t_first < oldest->history.block_info(0).t_first)) {
+                oldest = &ch;
+            }
+        }
+        return oldest;
+    };
+    size_t bytes = history_bytes();
+    while (bytes > history_budget_) {
+        // Spill the oldest sealed block; without spilling (or with only open
+        // blocks left) drop the oldest block instead.
+        Channel* oldest = spill_ ? oldest_front(true) : nullptr;
+        bool spill = oldest != nullptr;
+        if (!oldest) {
+            oldest = oldest_front(false);
+        }
+        if (!oldest) {
+            break;
+        }
+        size_t before = oldest->history.bytes();
+        if (spill) {
+            HistoryBlockInfo info;
+            std::vector<uint8_t> data;
+            oldest->history.pop_sealed_front(&info, &data);
+            // Queued for the spill writer; never waits on the disk.
+            spill_->append(static_cast<int>(oldest - channels_.data()), info, std::move(data));
+        } else {
+            dropped_history_ += static_cast<int>(oldest->history.drop_front());
+        }
+        bytes -= before - oldest->history.bytes();
+    }
+}
 
-    channels_[key] = std::deque<ChannelSample>();
-    enabled_[key] = true;
-    last_ts_[key] = 0.0;
+void ChannelModel::update_sample_limit() {
+    size_t channels = std::max<size_t>(1, channels_.size());
+    size_t share = memory_budget_ / kBytesPerSample / channels;
+    sample_limit_ = round_down_pow2(std::max(share, kMinChannelSamples));
+}
+
+size_t ChannelModel::capacity_hint(const SampleRing& ring) const {
+    if (ring.size() < 2) {
+        return 0;
+    }
+    double span = ring.back().t - ring.front().t;
+    if (span <= 0.0) {
+        return 0;
+    }
+    double rate = static_cast<double>(ring.size() - 1) / span;
+    return static_cast<size_t>(rate * time_window_sec_ * kCapacityHeadroom) + 1;
+}
 
-    first_seen_ts_[key] = timestamp;
+int ChannelModel::find_channel(const std::string& key) const {
+    auto it = index_.find(key);
+    return (it != index_.end()) ? it->second : -1;
+}
+
+int ChannelModel::add_channel(const std::string& key, double timestamp) {
+    if (static_cast<int>(channels_.size()) >= kMaxChannels) {
+        dropped_keys_ += 1;
+        return -1;
+    }
+
+    int id = static_cast<int>(channels_.size());
+    channels_.emplace_back();
+    channels_.back().first_seen_ts = timestamp;
+    channels_.back().mode_line_seq = line_seq_;
+    if (shared_timestamps_) {
+        channels_.back().shared_rows = channels_.back().samples.set_row_times(&row_times_);
+    }
     key_order_.push_back(key);
-    return true;
+    index_.emplace(key, id);
+
+    size_t words = (channels_.size() + 63) / 64;
+    enabled_bits_.resize(words, 0);
+    data_bits_.resize(words, 0);
+    set_enabled_bit(id, true);
+    update_sample_limit();
+    for (auto& armed : triggers_) {
+        if (armed.trigger.spec().key == key) {
+            armed.id = id;
+            channels_.back().has_trigger = true;
+        }
+    }
+    channels_.back().indexed =
+        std::find(transition_keys_.begin(), transition_keys_.end(), key) != transition_keys_.end();
+    return id;
+}
+
+bool ChannelModel::ensure_channel(const std::string& key, double timestamp) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (find_channel(key) >= 0) {
+        return true;
+    }
+    bump_version();
+    return add_channel(key, timestamp) >= 0;
 }
 
 int ChannelModel::consume_dropped_keys() {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
     int count = dropped_keys_;
     dropped_keys_ = 0;
     return count;
 }
 
+int ChannelModel::consume_evicted_samples() {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    int count = evicted_samples_;
+    evicted_samples_ = 0;
+    return count;
+}
+
+void ChannelModel::set_enabled_bit(int id, bool enabled) {
+    if (test_bit(enabled_bits_, id) == enabled) {
+        return;
+    }
+    uint64_t mask = uint64_t(1) << (id & 63);
+    if (enabled) {
+        enabled_bits_[static_cast<size_t>(id) >> 6] |= mask;
+        enabled_count_++;
+    } else {
+        enabled_bits_[static_cast<size_t>(id) >> 6] &= ~mask;
+        enabled_count_--;
+    }
+    if (test_bit(data_bits_, id)) {
+        update_active_key(id, enabled);
+    }
+}
+
+void ChannelModel::set_data_bit(int id, bool has_data) {
+    if (test_bit(data_bits_, id) == has_data) {
+        return;
+    }
+    uint64_t mask = uint64_t(1) << (id & 63);
+    if (has_data) {
+        data_bits_[static_cast<size_t>(id) >> 6] |= mask;
+    } else {
+        data_bits_[static_cast<size_t>(id) >> 6] &= ~mask;
+    }
+    if (test_bit(enabled_bits_, id)) {
+        update_active_key(id, has_data);
+    }
+}
+
+void ChannelModel::update_active_key(int id, bool active) {
+    // Active channels before id, counted in the bitsets.
+    size_t word = static_cast<size_t>(id) >> 6;
+    size_t index = 0;
+    for (size_t w = 0; w < word; ++w) {
+        index += static_cast<size_t>(bit_count(enabled_bits_[w] & data_bits_[w]));
+    }
+    uint64_t below = (uint64_t(1) << (id & 63)) - 1;
+    index += static_cast<size_t>(bit_count(enabled_bits_[word] & data_bits_[word] & below));
+    auto it = active_keys_.begin() + static_cast<std::ptrdiff_t>(index);
+    if (active) {
+        active_keys_.insert(it, key_order_[static_cast<size_t>(id)]);
+    } else {
+        active_keys_.erase(it);
+    }
+}
+
 void ChannelModel::set_enabled(const std::string& key, bool enabled) {
-    auto it = enabled_.find(key);
-    if (it != enabled_.end()) {
-        it->second = enabled;
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    int id = find_channel(key);
+    if (id >= 0) {
+        set_enabled_bit(id, enabled);
     }
 }
 
 bool ChannelModel::is_enabled(const std::string& key) const {
-    auto it = enabled_.find(key);
-    if (it == enabled_.end()) {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    int id = find_channel(key);
+    if (id < 0) {
         return true;
     }
-    return it->second;
+    return test_bit(enabled_bits_, id);
 }
 
-std::vector<std::string> ChannelModel::get_keys() const {
+const std::vector<std::string>& ChannelModel::get_keys() const {
     return key_order_;
 }
 
 int ChannelModel::get_total_samples() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
     return total_samples_;
 }
 
 int ChannelModel::get_enabled_count() const {
-    int count = 0;
-    for (const auto& kv : enabled_) {
-        if (kv.second) {
-            count++;
-        }
-    }
-    return count;
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return enabled_count_;
 }
 
-void ChannelModel::update_from_kv(const std::unordered_map<std::string, int>& kv, double timestamp) {
+int ChannelModel::update_from_kv(const std::unordered_map<std::string, int>& kv, double timestamp) {
     if (kv.empty()) {
-        return;
+        return 0;
     }
 
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    bump_version();
+    line_seq_++;
+    if (shared_timestamps_) {
+        // Bumped like a channel's times (see store_sample), so a channel
+        // also on the previous line gets the row's time after a step back.
+        double row_t = timestamp;
+        if (!row_times_.empty() && row_t <= row_times_.time(row_times_.end_row() - 1)) {
+            row_t = row_times_.time(row_times_.end_row() - 1) + ts_eps_;
+        }
+        row_times_.push_back(row_t);
+    }
+    int stored = 0;
     for (const auto& pair : kv) {
-        const std::string& key = pair.first;
+        int id = find_channel(pair.first);
+        if (id < 0) {
+            id = add_channel(pair.first, timestamp);
+            if (id < 0) {
+                continue;
+            }
+        }
+
         int value = pair.second;
+        if (value < 0 || channels_[static_cast<size_t>(id)].derived) {
+            continue;
+        }
+        channels_[static_cast<size_t>(id)].received = true;
+        double t = store_sample(id, timestamp, value);
+        check_triggers(id, t, value);
+        stored++;
+    }
+    if (!derived_.empty()) {
+        stored += update_derived(timestamp);
+    }
+    if (!pending_captures_.empty()) {
+        complete_captures(timestamp, false);
+    }
+    return stored;
+}
+
+double ChannelModel::store_sample(int id, double timestamp, int value) {
+    Channel& ch = channels_[static_cast<size_t>(id)];
+    ch.line_seq = line_seq_;
+    double t = timestamp;
+    if (t <= ch.last_ts) {
+        t = ch.last_ts + ts_eps_;
+    }
+    ch.last_ts = t;
+
+    auto& buf = ch.samples;
+    if (!buf.empty() && std::abs(t - buf.back().t) < ts_eps_) {
+        ChannelSample old = buf.back();
+        int old_value = old.v;
+        if (ch.indexed) {
+            // The replaced sample's change moves to t with it.
+            int prev = old_value;
+            if (!ch.transitions.empty() && ch.transitions.back().t == old.t) {
+                prev = ch.transitions.back().from;
+                ch.transitions.pop_back();
+            }
+            if (value != prev) {
+                ch.transitions.add(t, prev, value);
+            }
+        }
+        buf.set_back(t, value);
+        if (!buf.run_length()) {
+            ch.lod.set_last(value);
+        }
+        ch.window_sums.remove(old_value);
+        ch.window_sums.add(value);
+        ch.session.replace_last(old_value, value);
+        ch.window_sketch.replace_last(old_value, value);
+        ch.session_hist.remove(old_value);
+        ch.session_hist.add(value);
+        return t;
+    }
+
+    size_t hint = 0;
+    if (buf.run_length()) {
+        // Runs are what costs memory here, so the budget caps them instead
+        // of samples; the oldest run goes as a whole.
+        if (buf.run_count() >= run_limit() && !buf.extends_run(t, value)) {
+            size_t n = buf.run_samples(0);
+            retire_samples(ch, n);
+            evicted_samples_ += static_cast<int>(n);
+        }
+    } else if (buf.size() == buf.capacity()) {
+        if (buf.capacity() >= sample_limit_) {
+            retire_samples(ch, 1);
+            evicted_samples_ += 1;
+        } else {
+            hint = std::min(capacity_hint(buf), sample_limit_);
+        }
+    }
+    if (buf.empty()) {
+        set_data_bit(id, true);
+    } else {
+        int last = buf.back().v;
+        if (last != value) {
+            ch.mode_changes++;
+            if (ch.indexed) {
+                ch.transitions.add(t, last, value);
+            }
+        }
+    }
+    buf.push_back(t, value, hint);
+    if (!buf.run_length()) {
+        ch.lod.append(t, value);
+    }
+    ch.window_sums.add(value);
+    if (ch.session.count() == 0) {
+        ch.session_start_ts = t;
+    }
+    ch.session.add(value);
+    ch.window_sketch.add(value);
+    ch.session_hist.add(value);
+    total_samples_ += 1;
+    if (++ch.mode_samples == kModeCheckSamples) {
+        update_storage_mode(ch);
+    }
+    return t;
+}
+
+void ChannelModel::update_storage_mode(Channel& ch) {
+    auto& buf = ch.samples;
+    if (!buf.run_length() && ch.mode_changes * kEnterRunLength <= ch.mode_samples) {
+        buf.set_run_length(true);
+        ch.lod.clear();
+    } else if (buf.run_length() && ch.mode_changes * kLeaveRunLength > ch.mode_samples) {
+        // Expanded, the window may not fit the sample budget.
+        if (buf.size() > sample_limit_) {
+            evicted_samples_ += static_cast<int>(buf.size() - sample_limit_);
+            retire_samples(ch, buf.size() - sample_limit_);
+        }
+        buf.set_run_length(false);
+        for (size_t i = 0; i < buf.size();) {
+            SampleRing::Segment seg = buf.segment(i, buf.size());
+            for (size_t j = 0; j < seg.count; ++j) {
+                ch.lod.append(seg.t[j], seg.v[j]);
+            }
+            i += seg.count;
+        }
+    }
+    if (shared_timestamps_ && !buf.run_length()) {
+        // Backs off so a channel that keeps missing rows is not converted
+        // (O(n)) at every check.
+        bool back_off = ch.shared_rows && !buf.shared_times();
+        if (back_off) {
+            row_fallbacks_++;
+        } else if (buf.shared_times()) {
+            // Held on for a whole check.
+            ch.row_backoff = std::max<uint32_t>(1, ch.row_backoff / 2);
+        } else if (ch.row_wait > 0) {
+            ch.row_wait--;
+        } else if (ch.mode_samples * kSharedRowsDen >= (line_seq_ - ch.mode_line_seq) * kSharedRowsNum) {
+            back_off = !buf.set_row_times(&row_times_);
+        }
+        if (back_off) {
+            ch.row_wait = ch.row_backoff;
+            ch.row_backoff = std::min(ch.row_backoff * 2, kMaxRowBackoff);
+        }
+    }
+    ch.shared_rows = buf.shared_times();
+    ch.mode_samples = 0;
+    ch.mode_changes = 0;
+    ch.mode_line_seq = line_seq_;
+}
+
+int ChannelModel::update_derived(double timestamp) {
+    int stored = 0;
+    double values[Expression::kMaxInputs];
+    for (auto& d : derived_) {
+        // Recomputed when any input got a value on this line; every input
+        // needs at least one sample.
+        bool touched = false;
+        bool ready = true;
+        for (size_t i = 0; i < d.input_ids.size(); ++i) {
+            int& in = d.input_ids[i];
+            if (in < 0) {
+                in = find_channel(d.expr.inputs()[i]);
+            }
+            if (in < 0 || channels_[static_cast<size_t>(in)].samples.empty()) {
+                ready = false;
+                break;
+            }
+            const Channel& src = channels_[static_cast<size_t>(in)];
+            touched = touched || src.line_seq == line_seq_;
+            values[i] = src.samples.back().v;
+        }
+        if (!ready || !touched) {
+            continue;
+        }
+        double result = d.expr.evaluate(values);
+        if (d.filtered) {
+            // Keep NaN and infinities out of the filter state.
+            if (!std::isfinite(result)) {
+                continue;
+            }
+            result = d.filter.process(result);
+        }
+        result = std::round(result);
+        if (!(result >= static_cast<double>(INT_MIN) && result <= static_cast<double>(INT_MAX))) {
+            continue;
+        }
+        if (d.id < 0) {
+            d.id = add_channel(d.name, timestamp);
+            if (d.id < 0) {
+                continue;
+            }
+            channels_[static_cast<size_t>(d.id)].derived = true;
+        }
+        double t = store_sample(d.id, timestamp, static_cast<int>(result));
+        check_triggers(d.id, t, static_cast<int>(result));
+        stored++;
+    }
+    return stored;
+}
+
+bool ChannelModel::add_derived_channel(const std::string& name, const std::string& expression,
+                                       std::string* error) {
+    Derived d;
+    d.name = name;
+    d.definition = expression;
+    FilterSpec spec;
+    std::string source = expression;
+    std::string filter_error;
+    d.filtered = parse_filter_call(expression, &spec, &source, &filter_error);
+    if (!filter_error.empty()) {
+        *error = filter_error;
+        return false;
+    }
+    if (!Expression::compile(source, &d.expr, error)) {
+        return false;
+    }
+    if (d.filtered) {
+        d.filter = ChannelFilter(spec);
+    }
+    bool valid_name = !name.empty() && name.size() <= 16 && std::isalpha(static_cast<unsigned char>(name[0])) &&
+        std::all_of(name.begin(), name.end(), [](char c) {
+            return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '/';
+        });
+    if (!valid_name) {
+        *error = "Invalid channel name: " + name;
+        return false;
+    }
+    const auto& inputs = d.expr.inputs();
+    if (std::find(inputs.begin(), inputs.end(), name) != inputs.end()) {
+        *error = name + " refers to itself";
+        return false;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    for (const auto& other : derived_) {
+        if (other.name == name) {
+            *error = name + " is already defined";
+            return false;
+        }
+    }
+    d.id = find_channel(name);
+    if (d.id >= 0 && channels_[static_cast<size_t>(d.id)].received) {
+        *error = name + " is a received channel";
+        return false;
+    }
+    if (d.id >= 0) {
+        channels_[static_cast<size_t>(d.id)].derived = true;
+    }
+    d.input_ids.assign(inputs.size(), -1);
+    if (d.filtered && d.expr.is_input()) {
+        prime_filter(d);
+    }
+    derived_.push_back(std::move(d));
+    return true;
+}
+
+void ChannelModel::prime_filter(Derived& d) {
+    int src = find_channel(d.expr.inputs()[0]);
+    if (src < 0 || channels_[static_cast<size_t>(src)].samples.empty()) {
+        return;
+    }
+    const SampleRing& ring = channels_[static_cast<size_t>(src)].samples;
+    std::vector<double> in(ring.size());
+    for (size_t i = 0; i < ring.size(); ++i) {
+        in[i] = ring.value_at(i);
+    }
+    std::vector<double> out(in.size());
+    d.filter.process_batch(in.data(), out.data(), in.size());
+
+    // Only times after the channel's newest sample are stored, so a
+    // re-added filter continues its own trace instead of rewriting it.
+    double after = -1.0;
+    if (d.id >= 0) {
+        const Channel& ch = channels_[static_cast<size_t>(d.id)];
+        after = ch.samples.empty() ? ch.last_ts : ch.samples.back().t;
+    }
+    size_t first = ring.lower_bound(after);
+    while (first < ring.size() && ring.time_at(first) <= after) {
+        first++;
+    }
+    if (first >= ring.size()) {
+        return;
+    }
+    if (d.id < 0) {
+        d.id = add_channel(d.name, ring.time_at(first));
+        if (d.id < 0) {
+            return;
+        }
+        channels_[static_cast<size_t>(d.id)].derived = true;
+    }
+    bump_version();
+    // add_channel may have moved the source ring.
+    const SampleRing& src_ring = channels_[static_cast<size_t>(src)].samples;
+    for (size_t i = first; i < src_ring.size(); ++i) {
+        double v = std::round(out[i]);
+        if (v >= static_cast<double>(INT_MIN) && v <= static_cast<double>(INT_MAX)) {
+            store_sample(d.id, src_ring.time_at(i), static_cast<int>(v));
+        }
+    }
+}
+
+void ChannelModel::clear_derived_channels() {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    for (const auto& d : derived_) {
+        if (d.id >= 0) {
+            channels_[static_cast<size_t>(d.id)].derived = false;
+        }
+    }
+    derived_.clear();
+}
+
+std::vector<std::pair<std::string, std::string>> ChannelModel::get_derived_channels() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    std::vector<std::pair<std::string, std::string>> out;
+    for (const auto& d : derived_) {
+        out.emplace_back(d.name, d.definition);
+    }
+    return out;
+}
+
+bool ChannelModel::add_trigger(const std::string& definition, std::string* error) {
+    TriggerSpec spec;
+    if (!parse_trigger(definition, &spec, error)) {
+        return false;
+    }
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    ArmedTrigger armed;
+    armed.trigger = Trigger(spec, definition);
+    armed.id = find_channel(spec.key);
+    if (armed.id >= 0) {
+        channels_[static_cast<size_t>(armed.id)].has_trigger = true;
+    }
+    triggers_.push_back(std::move(armed));
+    return true;
+}
+
+void ChannelModel::clear_triggers() {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    triggers_.clear();
+    pending_captures_.clear();
+    for (auto& ch : channels_) {
+        ch.has_trigger = false;
+    }
+}
 
-        ensure_channel(key, timestamp);
-        if (channels_.find(key) == channels_.end()) {
+std::vector<std::string> ChannelModel::get_triggers() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    std::vector<std::string> out;
+    for (const auto& armed : triggers_) {
+        out.push_back(armed.trigger.text());
+    }
+    return out;
+}
+
+void ChannelModel::set_max_captures(size_t count) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    max_captures_ = std::max<size_t>(count, 1);
+    while (captures_.size() > max_captures_) {
+        captures_.pop_front();
+    }
+}
+
+void ChannelModel::finish_captures() {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    complete_captures(0.0, true);
+}
+
+void ChannelModel::clear_captures() {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    captures_.clear();
+}
+
+uint64_t ChannelModel::get_capture_seq() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return capture_seq_;
+}
+
+size_t ChannelModel::get_capture_count() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return captures_.size();
+}
+
+bool ChannelModel::get_capture(size_t index, TriggerCapture* out) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    if (index >= captures_.size()) {
+        return false;
+    }
+    *out = captures_[index];
+    return true;
+}
+
+void ChannelModel::check_triggers(int id, double timestamp, int value) {
+    if (!channels_[static_cast<size_t>(id)].has_trigger) {
+        return;
+    }
+    for (size_t i = 0; i < triggers_.size(); ++i) {
+        ArmedTrigger& armed = triggers_[i];
+        double fire_t = 0.0;
+        if (armed.id != id || !armed.trigger.on_sample(timestamp, value, &fire_t) || armed.pending) {
             continue;
         }
+        armed.pending = true;
+        pending_captures_.push_back(PendingCapture{i, fire_t});
+    }
+}
 
-        if (value < 0) {
+void ChannelModel::complete_captures(double now, bool all) {
+    SCC_TRACE_SCOPE("ChannelModel::complete_captures");
+    for (size_t p = 0; p < pending_captures_.size();) {
+        const PendingCapture pending = pending_captures_[p];
+        ArmedTrigger& armed = triggers_[pending.trigger];
+        const TriggerSpec& spec = armed.trigger.spec();
+        if (!all && now < pending.t + spec.post) {
+            ++p;
             continue;
         }
+        pending_captures_.erase(pending_captures_.begin() + static_cast<std::ptrdiff_t>(p));
+        armed.pending = false;
 
-        double t = timestamp;
-        auto it_last = last_ts_.find(key);
-        double last = (it_last != last_ts_.end()) ? it_last->second : 0.0;
-        if (t <= last) {
-            t = last + ts_eps_;
+        TriggerCapture capture;
+        capture.seq = ++capture_seq_;
+        capture.trigger = armed.trigger.text();
+        capture.t = pending.t;
+        capture_range(pending.t - spec.pre, pending.t + spec.post, &capture);
+        captures_.push_back(std::move(capture));
+        while (captures_.size() > max_captures_) {
+            captures_.pop_front();
         }
-        last_ts_[key] = t;
+    }
+}
 
-        auto& buf = channels_[key];
-        if (!buf.empty() && std::abs(t - buf.back().t) < ts_eps_) {
-            buf.back().t = t;
-            buf.back().v = value;
-        } else {
-            buf.push_back(ChannelSample{t, value});
-            total_samples_ += 1;
+void ChannelModel::capture_range(double t_start, double t_end, TriggerCapture* out) const {
+    out->t_start = t_start;
+    out->t_end = t_end;
+    out->keys.clear();
+    out->series.clear();
+    std::vector<ChannelSample> samples;
+    for (const auto& key : key_order_) {
+        samples.clear();
+        read_history(key, t_start, t_end, &samples);
+        if (!samples.empty()) {
+            out->keys.push_back(key);
+            out->series.push_back(samples);
+        }
+    }
+}
+
+void ChannelModel::set_transition_index(const std::string& key, bool enabled) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto it = std::find(transition_keys_.begin(), transition_keys_.end(), key);
+    if (enabled == (it != transition_keys_.end())) {
+        return;
+    }
+    if (enabled) {
+        transition_keys_.push_back(key);
+    } else {
+        transition_keys_.erase(it);
+    }
+    int id = find_channel(key);
+    if (id < 0) {
+        return;
+    }
+    Channel& ch = channels_[static_cast<size_t>(id)];
+    ch.indexed = enabled;
+    ch.transitions.clear();
+    if (enabled) {
+        index_transitions(id);
+    }
+}
+
+void ChannelModel::index_transitions(int id) {
+    Channel& ch = channels_[static_cast<size_t>(id)];
+    const std::string& key = key_order_[static_cast<size_t>(id)];
+    double t_first = 0.0;
+    double t_last = 0.0;
+    if (!get_stored_span(key, &t_first, &t_last)) {
+        return;
+    }
+    std::vector<ChannelSample> samples;
+    read_history(key, t_first, t_last, &samples);
+    for (size_t i = 1; i < samples.size(); ++i) {
+        if (samples[i].v != samples[i - 1].v) {
+            ch.transitions.add(samples[i].t, samples[i - 1].v, samples[i].v);
         }
     }
 }
 
+std::vector<std::string> ChannelModel::get_transition_keys() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return transition_keys_;
+}
+
+bool ChannelModel::find_next_transition(const std::string& key, double t, int from, int to, Transition* out) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    int id = find_channel(key);
+    return id >= 0 && channels_[static_cast<size_t>(id)].transitions.next(t, from, to, out);
+}
+
+bool ChannelModel::find_prev_transition(const std::string& key, double t, int from, int to, Transition* out) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    int id = find_channel(key);
+    return id >= 0 && channels_[static_cast<size_t>(id)].transitions.prev(t, from, to, out);
+}
+
+uint64_t ChannelModel::count_transitions(const std::string& key, int from, int to) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    int id = find_channel(key);
+    return id >= 0 ? channels_[static_cast<size_t>(id)].transitions.count(from, to) : 0;
+}
+
+std::vector<TransitionCount> ChannelModel::get_transition_counts(const std::string& key) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    int id = find_channel(key);
+    return id >= 0 ? channels_[static_cast<size_t>(id)].transitions.counts() : std::vector<TransitionCount>();
+}
+
 void ChannelModel::prune(double now) {
+    SCC_TRACE_SCOPE("ChannelModel::prune");
     double cutoff = now - time_window_sec_;
-    for (auto& kv : channels_) {
-        auto& buf = kv.second;
-        while (!buf.empty() && buf.front().t < cutoff) {
-            buf.pop_front();
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    bump_version();
+    for (size_t id = 0; id < channels_.size(); ++id) {
+        Channel& ch = channels_[id];
+        auto& buf = ch.samples;
+        auto& lod = ch.lod;
+        if (buf.empty()) {
+            continue;
+        }
+        retire_samples(ch, buf.lower_bound(cutoff));
+        while (buf.run_count() > run_limit()) {
+            size_t n = buf.run_samples(0);
+            evicted_samples_ += static_cast<int>(n);
+            retire_samples(ch, n);
+        }
+        if (!buf.run_length() && buf.size() > sample_limit_) {
+            evicted_samples_ += static_cast<int>(buf.size() - sample_limit_);
+            retire_samples(ch, buf.size() - sample_limit_);
+        }
+        if (buf.capacity() > sample_limit_ ||
+            (buf.capacity() > kShrinkMinCapacity && buf.size() * kShrinkFactor < buf.capacity())) {
+            buf.reserve(std::min(buf.size() * 2, sample_limit_));
         }
+        if (buf.empty()) {
+            lod.clear();
+            set_data_bit(static_cast<int>(id), false);
+        } else {
+            lod.trim_before(buf.front().t);
+        }
+    }
+    if (shared_timestamps_) {
+        // Rows before every channel's oldest sample are no longer needed.
+        double oldest = HUGE_VAL;
+        for (const auto& ch : channels_) {
+            if (!ch.samples.empty()) {
+                oldest = std::min(oldest, ch.samples.front().t);
+            }
+        }
+        row_times_.drop_before(row_times_.lower_bound(oldest));
     }
+    enforce_history_budget();
 }
 
-std::vector<std::string> ChannelModel::get_enabled_keys_with_data() const {
-    std::vector<std::string> keys;
-    for (const auto& key : key_order_) {
-        auto it = channels_.find(key);
-        if (it == channels_.end()) {
-            continue;
+const std::vector<std::string>& ChannelModel::get_enabled_keys_with_data() const {
+    return active_keys_;
+}
+
+SeriesView ChannelModel::get_series_view(const std::string& key) const {
+    int id = find_channel(key);
+    if (id < 0) {
+        return SeriesView();
+    }
+    return channels_[static_cast<size_t>(id)].samples.view(get_version());
+}
+
+SeriesView ChannelModel::get_window_view(const std::string& key, double t_start, double t_end) const {
+    return get_series_view(key).between(t_start, t_end);
+}
+
+LodView ChannelModel::get_lod_view(const std::string& key, double t_start, double t_end, int pixels) const {
+    int id = find_channel(key);
+    if (id < 0) {
+        return LodView();
+    }
+    const Channel& ch = channels_[static_cast<size_t>(id)];
+    return select_lod_view(ch.samples, ch.lod, t_start, t_end, pixels);
+}
+
+bool ChannelModel::get_nearest_sample(const std::string& key, double t, ChannelSample* out) const {
+    SeriesView series = get_series_view(key);
+    if (series.empty()) {
+        return false;
+    }
+    *out = series[series.nearest(t)];
+    return true;
+}
+
+void ChannelModel::read_history(const std::string& key, double t_start, double t_end,
+                                std::vector<ChannelSample>* out) const {
+    int id = find_channel(key);
+    if (id < 0) {
+        return;
+    }
+    const Channel& ch = channels_[static_cast<size_t>(id)];
+    if (spill_) {
+        spill_->read(id, t_start, t_end, out);
+    }
+    ch.history.read(t_start, t_end, out);
+    SeriesView hot = ch.samples.view().between(t_start, t_end);
+    out->insert(out->end(), hot.begin(), hot.end());
+}
+
+bool ChannelModel::get_stored_span(const std::string& key, double* t_first, double* t_last) const {
+    int id = find_channel(key);
+    if (id < 0) {
+        return false;
+    }
+    const Channel& ch = channels_[static_cast<size_t>(id)];
+    bool found = false;
+    if (!ch.samples.empty()) {
+        *t_first = ch.samples.front().t;
+        *t_last = ch.samples.back().t;
+        found = true;
+    }
+    if (!ch.history.empty()) {
+        const HistoryBlockInfo& last = ch.history.block_info(ch.history.block_count() - 1);
+        *t_first = ch.history.block_info(0).t_first;
+        *t_last = found ? *t_last : last.t_last;
+        found = true;
+    }
+    double spill_first = 0.0;
+    double spill_last = 0.0;
+    if (spill_ && spill_->time_span(id, &spill_first, &spill_last)) {
+        *t_first = spill_first;
+        *t_last = found ? *t_last : spill_last;
+        found = true;
+    }
+    return found;
+}
+
+bool ChannelModel::get_history_value_range(const std::string& key, double t_start, double t_end,
+                                           int* vmin, int* vmax) const {
+    int id = find_channel(key);
+    if (id < 0) {
+        return false;
+    }
+    const Channel& ch = channels_[static_cast<size_t>(id)];
+    int cold_min = 0;
+    int cold_max = 0;
+    int hot_min = 0;
+    int hot_max = 0;
+    bool cold = ch.history.value_range(t_start, t_end, &cold_min, &cold_max);
+    int spill_min = 0;
+    int spill_max = 0;
+    if (spill_ && spill_->value_range(id, t_start, t_end, &spill_min, &spill_max)) {
+        cold_min = cold ? std::min(cold_min, spill_min) : spill_min;
+        cold_max = cold ? std::max(cold_max, spill_max) : spill_max;
+        cold = true;
+    }
+    bool hot = ch.samples.view().between(t_start, t_end).value_range(&hot_min, &hot_max);
+    if (!cold && !hot) {
+        return false;
+    }
+    *vmin = cold ? (hot ? std::min(cold_min, hot_min) : cold_min) : hot_min;
+    *vmax = cold ? (hot ? std::max(cold_max, hot_max) : cold_max) : hot_max;
+    return true;
+}
+
+bool ChannelModel::get_aggregate(const std::string& key, double t_start, double t_end, RangeAggregate* out) const {
+    std::vector<RangeAggregate> buckets;
+    if (!get_aggregate_buckets(key, t_start, t_end, 0.0, &buckets)) {
+        return false;
+    }
+    *out = buckets[0];
+    return true;
+}
+
+bool ChannelModel::get_aggregate_buckets(const std::string& key, double t_start, double t_end, double width,
+                                         std::vector<RangeAggregate>* out) const {
+    int id = find_channel(key);
+    if (id < 0) {
+        return false;
+    }
+    AggregateBuckets buckets(t_start, t_end, width);
+    if (!buckets.valid()) {
+        return false;
+    }
+    // Oldest tier first, so first and last come out right.
+    const Channel& ch = channels_[static_cast<size_t>(id)];
+    if (spill_) {
+        spill_->aggregate(id, &buckets);
+    }
+    ch.history.aggregate(&buckets);
+    ch.samples.view().between(t_start, t_end).aggregate(&buckets);
+    out->swap(buckets.buckets());
+    return true;
+}
+
+bool ChannelModel::get_channel_stats(const std::string& key, ChannelStats* window, ChannelStats* session) const {
+    int id = find_channel(key);
+    if (id < 0) {
+        return false;
+    }
+    const Channel& ch = channels_[static_cast<size_t>(id)];
+    if (window) {
+        *window = ChannelStats();
+        ch.window_sums.fill(window);
+        SeriesView series = ch.samples.view();
+        series.value_range(&window->min, &window->max);
+        if (series.size() > 1 && series.back().t > series.front().t) {
+            window->rate = static_cast<double>(series.size() - 1) / (series.back().t - series.front().t);
         }
-        if (!it->second.empty() && is_enabled(key)) {
-            keys.push_back(key);
+    }
+    if (session) {
+        *session = ChannelStats();
+        ch.session.fill(session);
+        if (session->count > 1 && ch.last_ts > ch.session_start_ts) {
+            session->rate = static_cast<double>(session->count - 1) / (ch.last_ts - ch.session_start_ts);
         }
     }
-    return keys;
+    return true;
+}
+
+bool ChannelModel::get_value_histogram(const std::string& key, ValueHistogram* window,
+                                       ValueHistogram* session) const {
+    int id = find_channel(key);
+    if (id < 0) {
+        return false;
+    }
+    const Channel& ch = channels_[static_cast<size_t>(id)];
+    if (window) {
+        ch.window_sketch.merged(ch.samples.view(), window);
+    }
+    if (session) {
+        *session = ch.session_hist;
+    }
+    return true;
+}
+
+bool ChannelModel::copy_series(const std::string& key, SampleRing* out, LodPyramid* lod) const {
+    int id = find_channel(key);
+    if (id < 0) {
+        return false;
+    }
+    *out = channels_[static_cast<size_t>(id)].samples;
+    out->own_row_times();
+    if (lod) {
+        *lod = channels_[static_cast<size_t>(id)].lod;
+    }
+    return true;
 }
 
-std::vector<ChannelSample> ChannelModel::get_series(const std::string& key) const {
-    auto it = channels_.find(key);
-    if (it == channels_.end()) {
-        return {};
+bool ChannelModel::get_last_sample(const std::string& key, ChannelSample* out) const {
+    int id = find_channel(key);
+    if (id < 0 || channels_[static_cast<size_t>(id)].samples.empty()) {
+        return false;
+    }
+    *out = channels_[static_cast<size_t>(id)].samples.back();
+    return true;
+}
+
+bool ChannelModel::get_session_start(double* t) const {
+    bool found = false;
+    for (const auto& ch : channels_) {
+        if (ch.session.count() > 0 && (!found || ch.session_start_ts < *t)) {
+            *t = ch.session_start_ts;
+            found = true;
+        }
     }
-    return std::vector<ChannelSample>(it->second.begin(), it->second.end());
+    return found;
 }
@@ -1,54 +1,307 @@
 #pragma once
 
+#include <atomic>
 #include <deque>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
-struct ChannelSample {
-    double t = 0.0;
-    int v = 0;
-};
+#include "channel_filter.h"
+#include "channel_history.h"
+#include "channel_stats.h"
+#include "expression.h"
+#include "lod_pyramid.h"
+#include "range_aggregate.h"
+#include "sample_ring.h"
+#include "transition_index.h"
+#include "trigger.h"
+#include "value_sketch.h"
+
+class SpillStore;
 
 class ChannelModel {
 public:
+    static constexpr int kMaxChannels = 1024;
+    // Sample storage shared by all channels unless set_memory_budget is used.
+    static constexpr size_t kDefaultMemoryBudget = size_t(256) << 20;
+    // Compressed history kept beyond the hot window, shared by all channels.
+    static constexpr size_t kDefaultHistoryBudget = size_t(256) << 20;
+    static constexpr size_t kDefaultMaxCaptures = 16;
+
+    ChannelModel();
+    ~ChannelModel();
+    ChannelModel(const ChannelModel&) = delete;
+    ChannelModel& operator=(const ChannelModel&) = delete;
+
     void reset_samples();
     void reset();
 
     void set_time_window(double sec);
     double get_time_window() const;
 
+    // Split equally between channels; samples the cap pushes out early are
+    // counted by consume_evicted_samples.
+    void set_memory_budget(size_t bytes);
+    size_t get_memory_budget() const;
+    size_t get_channel_sample_limit() const;
+
+    // Channels on at least 3/4 of the lines share one timestamp per line
+    // (see SampleRing::set_row_times). Off by default.
+    void set_shared_timestamps(bool enabled);
+    bool get_shared_timestamps() const;
+    // Times a channel fell back from shared timestamps to its own.
+    uint64_t get_row_fallbacks() const;
+    // Bytes held by the hot rings, shared timestamps included.
+    size_t get_sample_bytes() const;
+
+    // Compressed samples that left the hot ring. Past the budget the oldest
+    // blocks are dropped and counted; 0 keeps no history.
+    void set_history_budget(size_t bytes);
+    size_t get_history_budget() const;
+    size_t get_history_bytes() const;
+    uint64_t get_history_samples() const;
+    int consume_dropped_history();
+
+    // History blocks over the budget go to segment files under dir instead
+    // of being dropped. The files are removed by disable_spill.
+    bool enable_spill(const std::string& dir, std::string* error);
+    void disable_spill();
+    bool is_spill_enabled() const;
+    // Waits for queued blocks to reach disk; ingest never needs this.
+    void flush_spill();
+    uint64_t get_spilled_samples() const;
+    uint64_t get_spilled_bytes() const;
+
     bool ensure_channel(const std::string& key, double timestamp);
     int consume_dropped_keys();
+    int consume_evicted_samples();
 
     void set_enabled(const std::string& key, bool enabled);
     bool is_enabled(const std::string& key) const;
 
-    std::vector<std::string> get_keys() const;
+    const std::vector<std::string>& get_keys() const;
 
     int get_total_samples() const;
     int get_enabled_count() const;
 
-    void update_from_kv(const std::unordered_map<std::string, int>& kv, double timestamp);
+    // Computed whenever an input gets a value and stored under name, rounded.
+    // The expression may be wrapped in one filter (see parse_filter_call).
+    bool add_derived_channel(const std::string& name, const std::string& expression, std::string* error);
+    // Stops computing; channels already created keep their samples.
+    void clear_derived_channels();
+    // (name, expression) pairs in definition order.
+    std::vector<std::pair<std::string, std::string>> get_derived_channels() const;
+
+    // A firing trigger (see parse_trigger) captures every channel from pre
+    // to post seconds around it once ingest passes the post window.
+    bool add_trigger(const std::string& definition, std::string* error);
+    void clear_triggers();
+    std::vector<std::string> get_triggers() const;
+    void set_max_captures(size_t count);
+    // Completes pending captures with the samples so far (end of stream).
+    void finish_captures();
+    void clear_captures();
+    // Captures completed this session; increases by one per capture.
+    uint64_t get_capture_seq() const;
+    size_t get_capture_count() const;
+    // Copy of a capture, oldest first.
+    bool get_capture(size_t index, TriggerCapture* out) const;
+    // Every channel's stored samples in [t_start, t_end], like a capture.
+    void capture_range(double t_start, double t_end, TriggerCapture* out) const;
+
+    // Indexes the channel's value changes for the whole session, starting
+    // with its stored samples.
+    void set_transition_index(const std::string& key, bool enabled);
+    std::vector<std::string> get_transition_keys() const;
+    // Next change of key after t (previous: before t) matching from -> to;
+    // TransitionIndex::kAnyValue matches any value.
+    bool find_next_transition(const std::string& key, double t, int from, int to, Transition* out) const;
+    bool find_prev_transition(const std::string& key, double t, int from, int to, Transition* out) const;
+    uint64_t count_transitions(const std::string& key, int from, int to) const;
+    // Per kind, most frequent first.
+    std::vector<TransitionCount> get_transition_counts(const std::string& key) const;
+
+    // Returns the number of values stored, derived values included.
+    int update_from_kv(const std::unordered_map<std::string, int>& kv, double timestamp);
     void prune(double now);
 
-    std::vector<std::string> get_enabled_keys_with_data() const;
-    std::vector<ChannelSample> get_series(const std::string& key) const;
+    // Enabled channels holding at least one sample, in registration order.
+    const std::vector<std::string>& get_enabled_keys_with_data() const;
+    bool get_last_sample(const std::string& key, ChannelSample* out) const;
+    // Time of the first sample since the last reset_samples.
+    bool get_session_start(double* t) const;
+
+    // Valid until the next mutating call; another thread must hold
+    // read_lock() while it uses the view.
+    SeriesView get_series_view(const std::string& key) const;
+    // Samples with t_start <= time <= t_end.
+    SeriesView get_window_view(const std::string& key, double t_start, double t_end) const;
+    // Sample closest in time to t (binary search).
+    bool get_nearest_sample(const std::string& key, double t, ChannelSample* out) const;
+    // Empty when the raw samples are sparse enough to draw directly.
+    LodView get_lod_view(const std::string& key, double t_start, double t_end, int pixels) const;
+    // Spilled, history and hot samples with t_start <= time <= t_end, oldest first.
+    void read_history(const std::string& key, double t_start, double t_end, std::vector<ChannelSample>* out) const;
+    // Times of the oldest and newest sample read_history can return.
+    bool get_stored_span(const std::string& key, double* t_first, double* t_last) const;
+    bool get_history_value_range(const std::string& key, double t_start, double t_end, int* vmin, int* vmax) const;
+    // Summary of what read_history would return; false for unknown keys or
+    // t_end < t_start.
+    bool get_aggregate(const std::string& key, double t_start, double t_end, RangeAggregate* out) const;
+    // The same per bucket of width seconds (see AggregateBuckets).
+    bool get_aggregate_buckets(const std::string& key, double t_start, double t_end, double width,
+                               std::vector<RangeAggregate>* out) const;
+
+    // Over the time window and since the last reset_samples.
+    bool get_channel_stats(const std::string& key, ChannelStats* window, ChannelStats* session) const;
+
+    // Over the time window and since the last reset_samples.
+    bool get_value_histogram(const std::string& key, ValueHistogram* window, ValueHistogram* session) const;
+
+    // Copy-on-write snapshot that ingest never changes.
+    bool copy_series(const std::string& key, SampleRing* out, LodPyramid* lod = nullptr) const;
+
+    // A view whose version() differs is stale.
+    uint64_t get_version() const { return version_.load(std::memory_order_acquire); }
+    bool is_current(const SeriesView& view) const { return view.version() == get_version(); }
+    // Another thread holds this around the sample, series and statistics
+    // queries; the other calls take the lock themselves.
+    std::shared_lock<std::shared_mutex> read_lock() const {
+        return std::shared_lock<std::shared_mutex>(mutex_);
+    }
 
 private:
-    static constexpr int kMaxChannels = 16;
+    struct Channel {
+        SampleRing samples;
+        LodPyramid lod;
+        ChannelHistory history;
+        WindowSums window_sums;
+        SessionStats session;
+        WindowSketch window_sketch;
+        ValueHistogram session_hist;
+        double first_seen_ts = 0.0;
+        double session_start_ts = 0.0;
+        double last_ts = 0.0;
+        // update_from_kv call that last stored a value here.
+        uint64_t line_seq = 0;
+        // Appends and value changes since the storage mode was last checked.
+        uint32_t mode_samples = 0;
+        uint32_t mode_changes = 0;
+        // line_seq_ when they were last reset.
+        uint64_t mode_line_seq = 0;
+        // After a fallback from shared rows: checks left to wait, and the
+        // next wait (doubled per fallback).
+        bool shared_rows = false;
+        uint32_t row_wait = 0;
+        uint32_t row_backoff = 1;
+        bool indexed = false;
+        TransitionIndex transitions;
+        bool derived = false;
+        // A received key stored a value here, so it cannot become derived.
+        bool received = false;
+        bool has_trigger = false;
+    };
+
+    struct Derived {
+        std::string name;
+        std::string definition;
+        Expression expr;
+        bool filtered = false;
+        ChannelFilter filter;
+        int id = -1;                  // channel, created on first result
+        std::vector<int> input_ids;   // per expr.inputs(), -1 until seen
+    };
+
+    struct ArmedTrigger {
+        Trigger trigger;
+        int id = -1;             // channel, once it exists
+        bool pending = false;    // capture waiting for its post window
+    };
+
+    struct PendingCapture {
+        size_t trigger;
+        double t;
+    };
+
+    int find_channel(const std::string& key) const;
+    int add_channel(const std::string& key, double timestamp);
+
+    static bool test_bit(const std::vector<uint64_t>& bits, int id) {
+        return (bits[static_cast<size_t>(id) >> 6] >> (id & 63)) & 1u;
+    }
+    void set_enabled_bit(int id, bool enabled);
+    void set_data_bit(int id, bool has_data);
+    // Adds or removes id's key in active_keys_ after its bits changed.
+    void update_active_key(int id, bool active);
+
+    // Capacity for one time window at the observed rate; 0 until known.
+    size_t capacity_hint(const SampleRing& ring) const;
+    void update_sample_limit();
+    // Runs a run-length channel may hold within the per-channel budget.
+    size_t run_limit() const;
+    // Drops the n oldest hot samples, moving them to history when enabled.
+    void retire_samples(Channel& ch, size_t n);
+    // Moves a channel between plain, run-length and shared-row storage.
+    void update_storage_mode(Channel& ch);
+    void enforce_history_budget();
+    size_t history_bytes() const;
+    // Returns the time stored, which triggers must use.
+    double store_sample(int id, double timestamp, int value);
+    // Returns the number of derived values stored for the current line.
+    int update_derived(double timestamp);
+    // Runs a new filter over its source key's window (batch path).
+    void prime_filter(Derived& d);
+    void check_triggers(int id, double timestamp, int value);
+    // Completes pending captures whose window ends at or before now.
+    void complete_captures(double now, bool all);
+    // Indexes the changes in a channel's stored samples.
+    void index_transitions(int id);
+    void bump_version() { version_.fetch_add(1, std::memory_order_release); }
+
+    mutable std::shared_mutex mutex_;
+    std::atomic<uint64_t> version_{0};
 
     double time_window_sec_ = 5.0;
+    size_t memory_budget_ = kDefaultMemoryBudget;
+    size_t sample_limit_ = 0;
+    size_t history_budget_ = kDefaultHistoryBudget;
+    // One time per update_from_kv call while shared timestamps are on.
+    RowTimeline row_times_;
+    bool shared_timestamps_ = false;
+    uint64_t row_fallbacks_ = 0;
 
-    std::unordered_map<std::string, std::deque<ChannelSample>> channels_;
-    std::unordered_map<std::string, bool> enabled_;
+    std::vector<Channel> channels_;
     std::vector<std::string> key_order_;
-    std::unordered_map<std::string, double> first_seen_ts_;
-    std::unordered_map<std::string, double> last_ts_;
+    std::unordered_map<std::string, int> index_;
+    std::unique_ptr<SpillStore> spill_;
+    std::vector<Derived> derived_;
+    uint64_t line_seq_ = 0;
+
+    std::vector<ArmedTrigger> triggers_;
+    std::vector<PendingCapture> pending_captures_;
+    std::deque<TriggerCapture> captures_;
+    size_t max_captures_ = kDefaultMaxCaptures;
+    uint64_t capture_seq_ = 0;
+    std::vector<std::string> transition_keys_;
+
+    // One bit per channel id.
+    std::vector<uint64_t> enabled_bits_;
+    std::vector<uint64_t> data_bits_;
+    int enabled_count_ = 0;
+
+    // Keys set in both bitsets, in id order; only writers update it.
+    std::vector<std::string> active_keys_;
 
     int total_samples_ = 0;
     int rx_lines_ = 0;
     int dropped_keys_ = 0;
+    int evicted_samples_ = 0;
+    int dropped_history_ = 0;
 
     double ts_eps_ = 0.0005;
 };
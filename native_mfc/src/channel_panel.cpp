@@ -5,7 +5,14 @@
 
 namespace {
 constexpr int kValueWidth = 70;
+constexpr int kStatWidth = 64;
+// Statistics columns after Channel and Value.
+constexpr const wchar_t* kStatColumns[] = {L"Mean", L"Min", L"Max", L"Std", L"RMS", L"Rate/s"};
+constexpr int kStatCount = sizeof(kStatColumns) / sizeof(kStatColumns[0]);
+constexpr int kFirstStatColumn = 2;
 constexpr int kPadding = 6;
+// Outside the int range, so it never matches a real value.
+constexpr long long kNoValue = -(1LL << 40);
 
 std::wstring to_wstring(const std::string& s) {
     if (s.empty()) {
@@ -25,6 +32,18 @@ std::wstring to_wstring(int value) {
     _snwprintf_s(buf, 64, _TRUNCATE, L"%d", value);
     return buf;
 }
+std::wstring format_stat(const ChannelStats& stats, int column) {
+    wchar_t buf[64] = {};
+    switch (column) {
+    case 0: _snwprintf_s(buf, 64, _TRUNCATE, L"%.1f", stats.mean); break;
+    case 1: _snwprintf_s(buf, 64, _TRUNCATE, L"%d", stats.min); break;
+    case 2: _snwprintf_s(buf, 64, _TRUNCATE, L"%d", stats.max); break;
+    case 3: _snwprintf_s(buf, 64, _TRUNCATE, L"%.2f", stats.stddev); break;
+    case 4: _snwprintf_s(buf, 64, _TRUNCATE, L"%.1f", stats.rms); break;
+    default: _snwprintf_s(buf, 64, _TRUNCATE, L"%.0f", stats.rate); break;
+    }
+    return buf;
+}
 } // namespace
 
 bool ChannelPanel::create(HWND parent, int x, int y, int w, int h, int id) {
@@ -48,6 +67,8 @@ HWND ChannelPanel::hwnd() const {
 
 void ChannelPanel::reset() {
     keys_.clear();
+    shown_values_.clear();
+    shown_stats_.clear();
     index_map_.clear();
     color_map_.clear();
     if (list_) {
@@ -78,6 +99,8 @@ void ChannelPanel::ensure_channel(const std::string& key, bool enabled, COLORREF
 
     int index = static_cast<int>(keys_.size());
     keys_.push_back(key);
+    shown_values_.push_back(kNoValue);
+    shown_stats_.resize(shown_stats_.size() + kStatCount, L"--");
     index_map_[key] = index;
     color_map_[key] = color;
 
@@ -90,6 +113,9 @@ void ChannelPanel::ensure_channel(const std::string& key, bool enabled, COLORREF
     ListView_InsertItem(list_, &item);
     ListView_SetCheckState(list_, index, enabled ? TRUE : FALSE);
     ListView_SetItemText(list_, index, 1, const_cast<wchar_t*>(L"--"));
+    for (int c = 0; c < kStatCount; ++c) {
+        ListView_SetItemText(list_, index, kFirstStatColumn + c, const_cast<wchar_t*>(L"--"));
+    }
     suppress_notify_ = false;
 }
 
@@ -101,6 +127,11 @@ void ChannelPanel::update_values(const std::unordered_map<std::string, int>& lat
     for (size_t i = 0; i < keys_.size(); ++i) {
         const auto& key = keys_[i];
         auto it = latest.find(key);
+        long long shown = (it == latest.end()) ? kNoValue : it->second;
+        if (shown_values_[i] == shown) {
+            continue;
+        }
+        shown_values_[i] = shown;
         if (it == latest.end()) {
             ListView_SetItemText(list_, static_cast<int>(i), 1, const_cast<wchar_t*>(L"--"));
         } else {
@@ -110,6 +141,26 @@ void ChannelPanel::update_values(const std::unordered_map<std::string, int>& lat
     }
 }
 
+void ChannelPanel::update_stats(const std::unordered_map<std::string, ChannelStats>& stats) {
+    if (!list_) {
+        return;
+    }
+
+    for (size_t i = 0; i < keys_.size(); ++i) {
+        auto it = stats.find(keys_[i]);
+        bool has_stats = it != stats.end() && it->second.count > 0;
+        for (int c = 0; c < kStatCount; ++c) {
+            std::wstring text = has_stats ? format_stat(it->second, c) : L"--";
+            std::wstring& shown = shown_stats_[i * kStatCount + static_cast<size_t>(c)];
+            if (shown == text) {
+                continue;
+            }
+            shown = text;
+            ListView_SetItemText(list_, static_cast<int>(i), kFirstStatColumn + c, const_cast<wchar_t*>(shown.c_str()));
+        }
+    }
+}
+
 std::unordered_map<std::string, bool> ChannelPanel::get_checkbox_state_map() const {
     std::unordered_map<std::string, bool> result;
     if (!list_) {
@@ -122,6 +173,17 @@ std::unordered_map<std::string, bool> ChannelPanel::get_checkbox_state_map() con
     return result;
 }
 
+std::string ChannelPanel::get_selected_key() const {
+    if (!list_) {
+        return std::string();
+    }
+    int index = ListView_GetNextItem(list_, -1, LVNI_SELECTED);
+    if (index < 0 || index >= static_cast<int>(keys_.size())) {
+        return std::string();
+    }
+    return keys_[static_cast<size_t>(index)];
+}
+
 LRESULT CALLBACK ChannelPanel::WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
     ChannelPanel* self = reinterpret_cast<ChannelPanel*>(GetWindowLongPtrW(hwnd, GWLP_USERDATA));
     if (msg == WM_NCCREATE) {
@@ -158,6 +220,12 @@ LRESULT ChannelPanel::handle_message(HWND hwnd, UINT msg, WPARAM wParam, LPARAM
         col.pszText = const_cast<wchar_t*>(L"Value");
         col.cx = kValueWidth;
         ListView_InsertColumn(list_, 1, &col);
+
+        for (int c = 0; c < kStatCount; ++c) {
+            col.pszText = const_cast<wchar_t*>(kStatColumns[c]);
+            col.cx = kStatWidth;
+            ListView_InsertColumn(list_, kFirstStatColumn + c, &col);
+        }
         return 0;
     }
     case WM_SIZE: {
@@ -222,13 +290,18 @@ void ChannelPanel::layout(int w, int h) {
     int list_w = w - 2 * kPadding;
     MoveWindow(list_, kPadding, list_y, list_w, list_h, TRUE);
 
+    // Channel names take what is left; the list scrolls horizontally when
+    // the panel is narrower than the statistics columns.
     int value_w = kValueWidth;
-    int channel_w = list_w - value_w - 6;
+    int channel_w = list_w - value_w - kStatCount * kStatWidth - 6;
     if (channel_w < 80) {
         channel_w = 80;
     }
     ListView_SetColumnWidth(list_, 0, channel_w);
     ListView_SetColumnWidth(list_, 1, value_w);
+    for (int c = 0; c < kStatCount; ++c) {
+        ListView_SetColumnWidth(list_, kFirstStatColumn + c, kStatWidth);
+    }
 }
 
 void ChannelPanel::on_all_none(bool all_checked) {
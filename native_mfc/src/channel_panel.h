@@ -6,6 +6,8 @@
 #include <unordered_map>
 #include <vector>
 
+#include "channel_stats.h"
+
 class ChannelPanel {
 public:
     bool create(HWND parent, int x, int y, int w, int h, int id);
@@ -15,7 +17,11 @@ public:
     void update_count(int count);
     void ensure_channel(const std::string& key, bool enabled, COLORREF color);
     void update_values(const std::unordered_map<std::string, int>& latest);
+    // Window statistics columns; channels missing from the map show "--".
+    void update_stats(const std::unordered_map<std::string, ChannelStats>& stats);
     std::unordered_map<std::string, bool> get_checkbox_state_map() const;
+    // Key of the selected row, or empty.
+    std::string get_selected_key() const;
 
 private:
     static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
@@ -35,5 +41,10 @@ private:
     std::vector<std::string> keys_;
     std::unordered_map<std::string, int> index_map_;
     std::unordered_map<std::string, COLORREF> color_map_;
+    // Value currently shown in each row (kNoValue for "--"), so unchanged
+    // rows are not rewritten every frame.
+    std::vector<long long> shown_values_;
+    // Text shown in each statistics cell, row-major.
+    std::vector<std::wstring> shown_stats_;
     bool suppress_notify_ = false;
 };
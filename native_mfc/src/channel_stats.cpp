@@ -0,0 +1,100 @@
+#include "channel_stats.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+uint64_t square(int v) {
+    int64_t w = v;
+    return static_cast<uint64_t>(w * w);
+}
+} // namespace
+
+void SessionStats::add(int v) {
+    if (count_ == 1) {
+        min_ = last_;
+        max_ = last_;
+    } else if (count_ > 1) {
+        min_ = std::min(min_, last_);
+        max_ = std::max(max_, last_);
+    }
+    last_ = v;
+    count_++;
+    double delta = v - mean_;
+    mean_ += delta / static_cast<double>(count_);
+    m2_ += delta * (v - mean_);
+}
+
+void SessionStats::replace_last(int old_v, int v) {
+    if (count_ == 0) {
+        return;
+    }
+    if (count_ == 1) {
+        mean_ = v;
+        m2_ = 0.0;
+    } else {
+        // Reverse Welford step for old_v, then a forward step for v.
+        double n = static_cast<double>(count_ - 1);
+        double delta = old_v - mean_;
+        double mean = mean_ - delta / n;
+        m2_ = std::max(0.0, m2_ - delta * (old_v - mean));
+        mean_ = mean;
+        delta = v - mean_;
+        mean_ += delta / static_cast<double>(count_);
+        m2_ += delta * (v - mean_);
+    }
+    last_ = v;
+}
+
+void SessionStats::clear() {
+    *this = SessionStats();
+}
+
+void SessionStats::fill(ChannelStats* out) const {
+    out->count = count_;
+    if (count_ == 0) {
+        return;
+    }
+    double var = m2_ / static_cast<double>(count_);
+    out->mean = mean_;
+    out->stddev = std::sqrt(var);
+    out->rms = std::sqrt(mean_ * mean_ + var);
+    out->min = count_ == 1 ? last_ : std::min(min_, last_);
+    out->max = count_ == 1 ? last_ : std::max(max_, last_);
+}
+
+void WindowSums::add(int v) {
+    count_++;
+    sum_ += v;
+    uint64_t sq = square(v);
+    sq_lo_ += sq;
+    sq_hi_ += (sq_lo_ < sq) ? 1 : 0;
+}
+
+void WindowSums::remove(int v) {
+    if (count_ == 0) {
+        return;
+    }
+    count_--;
+    sum_ -= v;
+    uint64_t sq = square(v);
+    sq_hi_ -= (sq_lo_ < sq) ? 1 : 0;
+    sq_lo_ -= sq;
+}
+
+void WindowSums::clear() {
+    *this = WindowSums();
+}
+
+void WindowSums::fill(ChannelStats* out) const {
+    out->count = count_;
+    if (count_ == 0) {
+        return;
+    }
+    double n = static_cast<double>(count_);
+    double mean = static_cast<double>(sum_) / n;
+    double mean_sq = (static_cast<double>(sq_hi_) * 18446744073709551616.0 + static_cast<double>(sq_lo_)) / n;
+    out->mean = mean;
+    out->stddev = std::sqrt(std::max(0.0, mean_sq - mean * mean));
+    out->rms = std::sqrt(mean_sq);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+
+// Summary of one channel over a span of samples.
+struct ChannelStats {
+    uint64_t count = 0;
+    double mean = 0.0;
+    double stddev = 0.0;  // population standard deviation
+    double rms = 0.0;
+    int min = 0;
+    int max = 0;
+    double rate = 0.0;    // samples per second
+};
+
+// Welford accumulator over every sample of a session; O(1) per update and
+// numerically stable however long the session runs.
+class SessionStats {
+public:
+    void add(int v);
+    // The newest sample's value changed from old_v to v (merged sample).
+    void replace_last(int old_v, int v);
+    void clear();
+
+    uint64_t count() const { return count_; }
+    // Fills count, mean, stddev, rms, min and max.
+    void fill(ChannelStats* out) const;
+
+private:
+    uint64_t count_ = 0;
+    double mean_ = 0.0;
+    double m2_ = 0.0;
+    // Over the samples before the newest, which is kept apart so that
+    // replace_last can drop its value from them.
+    int min_ = 0;
+    int max_ = 0;
+    int last_ = 0;
+};
+
+// Running sums over a sliding window: values are added on ingest and
+// removed on eviction. The sum and the 128-bit sum of squares are exact
+// integers, so removals never accumulate rounding drift.
+class WindowSums {
+public:
+    void add(int v);
+    void remove(int v);
+    void clear();
+
+    uint64_t count() const { return count_; }
+    // Fills count, mean, stddev and rms.
+    void fill(ChannelStats* out) const;
+
+private:
+    uint64_t count_ = 0;
+    int64_t sum_ = 0;
+    uint64_t sq_lo_ = 0;
+    uint64_t sq_hi_ = 0;
+};
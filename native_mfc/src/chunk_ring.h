@@ -0,0 +1,164 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// The object *p points to, cloned first when another shared_ptr still
+// refers to it, so the caller can modify it without the other holders
+// seeing the change.
+template <typename T>
+T& unshare(std::shared_ptr<T>* p) {
+    if (p->use_count() > 1) {
+        *p = std::make_shared<T>(**p);
+    } else {
+        // The last other holder may have just let go on another thread;
+        // its reads must happen before our writes.
+        std::atomic_thread_fence(std::memory_order_acquire);
+    }
+    return **p;
+}
+
+// Power-of-two ring of entries stored in fixed-size chunks that copies of
+// the ring share. Copying is O(1): the slot table is shared until either
+// copy next changes it, and a chunk another copy can still see is cloned
+// before it is written, so a copy is an immutable snapshot however the
+// original moves on. A snapshot keeps alive only the chunks it covers.
+//
+// Chunks are allocated when their first entry is written and released
+// once the head moves past them; one released chunk is kept for reuse, so
+// steady appends and drops do not allocate. Position p (see pos) lives in
+// slot p >> kShift at offset p & kChunkMask.
+template <typename Chunk, size_t kShift>
+class ChunkRing {
+public:
+    static constexpr size_t kChunkSize = size_t(1) << kShift;
+    static constexpr size_t kChunkMask = kChunkSize - 1;
+
+    ChunkRing() = default;
+    // The spare chunk stays with the original.
+    ChunkRing(const ChunkRing& other)
+        : table_(other.table_), start_(other.start_), size_(other.size_), mask_(other.mask_) {}
+    ChunkRing& operator=(const ChunkRing& other) {
+        table_ = other.table_;
+        owned_ = nullptr;
+        start_ = other.start_;
+        size_ = other.size_;
+        mask_ = other.mask_;
+        return *this;
+    }
+    ChunkRing(ChunkRing&&) noexcept = default;
+    ChunkRing& operator=(ChunkRing&&) noexcept = default;
+
+    size_t size() const { return size_; }
+    size_t slot_count() const { return table_ ? (mask_ + 1) >> kShift : 0; }
+    // Chunks holding entries.
+    size_t chunks_used() const { return ((start_ & kChunkMask) + size_ + kChunkMask) >> kShift; }
+
+    // Position of logical index i; 0 is the oldest entry.
+    size_t pos(size_t i) const { return (start_ + i) & mask_; }
+    const Chunk& chunk(size_t slot) const { return *(*table_)[slot]; }
+    const Chunk& chunk_at(size_t p) const { return chunk(p >> kShift); }
+
+    // Appends an entry and returns the chunk to store it in, at offset
+    // *p & kChunkMask. reserve() must have made room for it.
+    Chunk& push_back(size_t* p) {
+        *p = pos(size_);
+        size_++;
+        return writable(*p);
+    }
+
+    // Chunk holding position p, allocated if empty and cloned if shared.
+    Chunk& writable(size_t p) {
+        size_t index = p >> kShift;
+        // Chunks only become shared through the table, so the last chunk
+        // handed out stays ours while the table is.
+        if (owned_ && index == owned_index_ && table_.use_count() == 1) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return *owned_;
+        }
+        std::shared_ptr<Chunk>& slot = unshare(&table_)[index];
+        if (!slot) {
+            slot = spare_ ? std::move(spare_) : std::make_shared<Chunk>();
+        }
+        owned_ = &unshare(&slot);
+        owned_index_ = index;
+        return *owned_;
+    }
+
+    void pop_front(size_t n) {
+        n = std::min(n, size_);
+        if (n == 0) {
+            return;
+        }
+        // Chunks the head moves past, or every chunk once the ring empties.
+        size_t drop = n == size_ ? chunks_used() : ((start_ & kChunkMask) + n) >> kShift;
+        if (drop > 0) {
+            owned_ = nullptr;
+            std::vector<std::shared_ptr<Chunk>>& table = unshare(&table_);
+            size_t slot_mask = slot_count() - 1;
+            for (size_t k = 0, slot = start_ >> kShift; k < drop; ++k, slot = (slot + 1) & slot_mask) {
+                release(&table[slot]);
+            }
+        }
+        size_ -= n;
+        start_ = size_ == 0 ? 0 : (start_ + n) & mask_;
+    }
+
+    void clear() { pop_front(size_); }
+
+    // Sizes the slot table for at least max(entries, size()) entries at any
+    // alignment, moving chunk pointers rather than entries. Returns whether
+    // the table changed; the chunks in use then start at slot 0.
+    bool reserve(size_t entries) {
+        size_t needed = ((std::max(entries, size_) + kChunkMask) >> kShift) + 1;
+        size_t slots = 1;
+        while (slots < needed) {
+            slots <<= 1;
+        }
+        if (slots == slot_count()) {
+            return false;
+        }
+        auto table = std::make_shared<std::vector<std::shared_ptr<Chunk>>>(slots);
+        if (table_) {
+            bool owned = table_.use_count() == 1;
+            size_t slot_mask = slot_count() - 1;
+            size_t used = chunks_used();
+            for (size_t k = 0, slot = start_ >> kShift; k < used; ++k, slot = (slot + 1) & slot_mask) {
+                std::shared_ptr<Chunk>& from = (*table_)[slot];
+                (*table)[k] = owned ? std::move(from) : from;
+            }
+        }
+        table_ = std::move(table);
+        owned_ = nullptr;
+        start_ &= kChunkMask;
+        mask_ = (slots << kShift) - 1;
+        return true;
+    }
+
+    // Bytes of chunks and slot table referenced by this ring.
+    size_t allocated_bytes() const {
+        return (chunks_used() + (spare_ ? 1 : 0)) * sizeof(Chunk) + slot_count() * sizeof(std::shared_ptr<Chunk>);
+    }
+
+private:
+    void release(std::shared_ptr<Chunk>* slot) {
+        if (!spare_ && slot->use_count() == 1) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            spare_ = std::move(*slot);
+        } else {
+            slot->reset();
+        }
+    }
+
+    std::shared_ptr<std::vector<std::shared_ptr<Chunk>>> table_;
+    std::shared_ptr<Chunk> spare_;
+    Chunk* owned_ = nullptr;
+    size_t owned_index_ = 0;
+    size_t start_ = 0;
+    size_t size_ = 0;
+    size_t mask_ = 0;
+};
@@ -0,0 +1,903 @@
+// Headless capture-and-analyze tool. Runs the same line framer, log parser
+// and ChannelModel as the GUI, without a display.
+
+#include <algorithm>
+#include <cctype>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "capture_source.h"
+#include "channel_model.h"
+#include "clock.h"
+#include "journal.h"
+#include "line_framer.h"
+#include "log_parser.h"
+#include "pipeline_stats.h"
+#include "recording.h"
+#include "resampler.h"
+#include "trace.h"
+
+namespace {
+constexpr int kReadIntervalMs = 20;
+constexpr int kReadChunk = LineFramer::kMaxRxBuffer / 2;
+constexpr int kReplayBatchLines = 1024;
+
+volatile std::sig_atomic_t g_stop = 0;
+
+void on_signal(int) {
+    g_stop = 1;
+}
+
+// Stage latencies always measure real CPU time, whatever drives the pipeline.
+double latency_now() {
+    return monotonic_clock().now();
+}
+
+struct Options {
+    std::string device;
+    std::string journal_in;
+    bool use_stdin = false;
+
+    int baud = 115200;
+    int data_bits = 8;
+    int parity = CaptureSource::kParityNone;
+    int stop_bits = 1;
+
+    double time_window = 30.0;
+    double history_mb = static_cast<double>(ChannelModel::kDefaultHistoryBudget >> 20);
+    std::string spill_dir;
+    bool shared_time = false;
+    std::vector<std::string> derived;
+    std::vector<std::string> triggers;
+    std::vector<std::string> transition_keys;
+    std::vector<std::string> aggregate_keys;
+    double aggregate_bucket = 0.0;
+    std::string capture_dir;
+    double stats_interval = 1.0;
+    double duration = 0.0;
+    bool quiet = false;
+    bool virtual_clock = false;
+    double virtual_step = 0.001;
+
+    std::string csv_out;
+    std::string record_out;
+    std::string journal_out;
+    std::string stats_json;
+    std::string trace_out;
+
+    std::string aligned_out;
+    std::vector<std::string> aligned_keys;
+    double aligned_step = 0.0;
+    double aligned_tolerance = 0.0;
+    ResamplePolicy aligned_policy = ResamplePolicy::kHold;
+};
+
+void print_usage(const char* argv0) {
+    std::fprintf(stderr,
+        "Usage: %s [options] <device|->\n"
+        "       %s [options] --journal FILE\n"
+        "\n"
+        "Source:\n"
+        "  <device>            serial device or pty (e.g. /dev/ttyUSB0, /dev/pts/3)\n"
+        "  -                   read the log stream from stdin\n"
+        "  --journal FILE      replay a journal written with --journal-out\n"
+        "\n"
+        "Serial framing:\n"
+        "  --baud N            baud rate (default 115200)\n"
+        "  --data N            data bits 5..8 (default 8)\n"
+        "  --parity N|E|O      parity (default N)\n"
+        "  --stop 1|2          stop bits (default 1)\n"
+        "\n"
+        "Processing:\n"
+        "  --window SEC        model time window (default 30)\n"
+        "  --history-mb N      compressed history kept beyond the window, 0 = off\n"
+        "                      (default 256)\n"
+        "  --spill-dir DIR     move history past --history-mb to segment files in\n"
+        "                      DIR instead of dropping it (removed on exit)\n"
+        "  --shared-time       channels on (nearly) every line share one stored\n"
+        "                      timestamp per line instead of one each\n"
+        "  --derive NAME=EXPR  derived channel computed on ingest, e.g. P=V*I/1000\n"
+        "                      or D=[Q2/Q3]-T1 (repeatable; + - * / abs min max);\n"
+        "                      S=ema(CHG,0.1) smooths with boxcar/ema/lowpass/median\n"
+        "  --trigger DEF       capture all channels around an event (repeatable):\n"
+        "                      'KEY rise|fall|cross LEVEL', 'KEY above|below LEVEL\n"
+        "                      [min SEC] [max SEC]' or 'KEY change [FROM|*] [TO|*]',\n"
+        "                      plus optional 'hyst H', 'pre SEC', 'post SEC' (1 s)\n"
+        "  --transitions KEY   index KEY's value changes by (from, to) and print\n"
+        "                      the count and first/last time of each on exit\n"
+        "                      (repeatable)\n"
+        "  --aggregate KEY     on exit, print count, min, max, mean, first and last\n"
+        "                      of KEY over everything stored (repeatable)\n"
+        "  --aggregate-bucket SEC\n"
+        "                      also print them per SEC-wide bucket\n"
+        "  --stats SEC         stats print interval, 0 = off (default 1)\n"
+        "  --duration SEC      stop after SEC seconds (default: until EOF/Ctrl+C)\n"
+        "  --quiet             only print the final summary\n"
+        "  --clock real|virtual\n"
+        "                      virtual (journal only): time follows the journal\n"
+        "                      timestamps, so replays run unthrottled and give\n"
+        "                      identical model contents and stats windows\n"
+        "  --virtual-step SEC  virtual time added per untimestamped line (default 0.001)\n"
+        "\n"
+        "Outputs:\n"
+        "  --csv FILE          stream samples as CSV (t,key,value)\n"
+        "  --record FILE       stream samples as a binary recording\n"
+        "  --journal-out FILE  write received lines with timestamps\n"
+        "  --capture-dir DIR   write each trigger capture as DIR/capture_NNNN.csv\n"
+        "  --aligned-csv FILE  on exit, write every stored sample on a common time\n"
+        "                      grid (t,KEY1,KEY2,...)\n"
+        "  --align-keys LIST   comma-separated channels (default: all)\n"
+        "  --align-step SEC    grid spacing; 0 = a row per distinct sample time\n"
+        "                      (default 0)\n"
+        "  --align-tolerance SEC\n"
+        "                      with step 0, merge times this close into one row\n"
+        "  --align-policy hold|linear|minmax\n"
+        "                      value per row: last sample, interpolated, or the\n"
+        "                      bucket's min and max columns (default hold)\n"
+        "  --stats-json FILE   rewrite pipeline stats as JSON every --stats period\n"
+        "  --trace-out FILE    write a Chrome trace on exit (needs SCC_ENABLE_TRACE)\n",
+        argv0, argv0);
+}
+
+bool parse_number(const char* text, double* out) {
+    char* end = nullptr;
+    double value = std::strtod(text, &end);
+    if (!text[0] || (end && *end != '\0')) {
+        return false;
+    }
+    *out = value;
+    return true;
+}
+
+bool parse_args(int argc, char** argv, Options* opt, std::string* error) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto need_value = [&](const char* name) -> const char* {
+            if (i + 1 >= argc) {
+                *error = std::string("Missing value for ") + name;
+                return nullptr;
+            }
+            return argv[++i];
+        };
+        auto need_number = [&](const char* name, double* out) -> bool {
+            const char* value = need_value(name);
+            if (!value) {
+                return false;
+            }
+            if (!parse_number(value, out)) {
+                *error = std::string("Invalid value for ") + name + ": " + value;
+                return false;
+            }
+            return true;
+        };
+
+        double number = 0.0;
+        if (arg == "-h" || arg == "--help") {
+            return false;
+        } else if (arg == "-") {
+            opt->use_stdin = true;
+        } else if (arg == "--journal") {
+            const char* value = need_value("--journal");
+            if (!value) {
+                return false;
+            }
+            opt->journal_in = value;
+        } else if (arg == "--baud") {
+            if (!need_number("--baud", &number)) {
+                return false;
+            }
+            opt->baud = static_cast<int>(number);
+        } else if (arg == "--data") {
+            if (!need_number("--data", &number)) {
+                return false;
+            }
+            opt->data_bits = static_cast<int>(number);
+        } else if (arg == "--parity") {
+            const char* value = need_value("--parity");
+            if (!value) {
+                return false;
+            }
+            char p = static_cast<char>(std::toupper(static_cast<unsigned char>(value[0])));
+            if (p == 'N') {
+                opt->parity = CaptureSource::kParityNone;
+            } else if (p == 'E') {
+                opt->parity = CaptureSource::kParityEven;
+            } else if (p == 'O') {
+                opt->parity = CaptureSource::kParityOdd;
+            } else {
+                *error = std::string("Invalid parity: ") + value;
+                return false;
+            }
+        } else if (arg == "--stop") {
+            if (!need_number("--stop", &number)) {
+                return false;
+            }
+            opt->stop_bits = static_cast<int>(number);
+        } else if (arg == "--window") {
+            if (!need_number("--window", &opt->time_window)) {
+                return false;
+            }
+        } else if (arg == "--history-mb") {
+            if (!need_number("--history-mb", &opt->history_mb)) {
+                return false;
+            }
+            if (opt->history_mb < 0.0) {
+                *error = "Invalid value for --history-mb";
+                return false;
+            }
+        } else if (arg == "--spill-dir") {
+            const char* value = need_value("--spill-dir");
+            if (!value) {
+                return false;
+            }
+            opt->spill_dir = value;
+        } else if (arg == "--shared-time") {
+            opt->shared_time = true;
+        } else if (arg == "--derive") {
+            const char* value = need_value("--derive");
+            if (!value) {
+                return false;
+            }
+            if (!std::strchr(value, '=')) {
+                *error = std::string("Expected NAME=EXPR for --derive: ") + value;
+                return false;
+            }
+            opt->derived.push_back(value);
+        } else if (arg == "--trigger") {
+            const char* value = need_value("--trigger");
+            if (!value) {
+                return false;
+            }
+            opt->triggers.push_back(value);
+        } else if (arg == "--transitions") {
+            const char* value = need_value("--transitions");
+            if (!value) {
+                return false;
+            }
+            opt->transition_keys.push_back(value);
+        } else if (arg == "--aggregate") {
+            const char* value = need_value("--aggregate");
+            if (!value) {
+                return false;
+            }
+            opt->aggregate_keys.push_back(value);
+        } else if (arg == "--aggregate-bucket") {
+            if (!need_number("--aggregate-bucket", &opt->aggregate_bucket)) {
+                return false;
+            }
+            if (opt->aggregate_bucket < 0.0) {
+                *error = "Invalid value for --aggregate-bucket";
+                return false;
+            }
+        } else if (arg == "--capture-dir") {
+            const char* value = need_value("--capture-dir");
+            if (!value) {
+                return false;
+            }
+            opt->capture_dir = value;
+        } else if (arg == "--aligned-csv") {
+            const char* value = need_value("--aligned-csv");
+            if (!value) {
+                return false;
+            }
+            opt->aligned_out = value;
+        } else if (arg == "--align-keys") {
+            const char* value = need_value("--align-keys");
+            if (!value) {
+                return false;
+            }
+            std::string list = value;
+            size_t begin = 0;
+            while (begin <= list.size()) {
+                size_t comma = std::min(list.find(',', begin), list.size());
+                if (comma > begin) {
+                    opt->aligned_keys.push_back(list.substr(begin, comma - begin));
+                }
+                begin = comma + 1;
+            }
+        } else if (arg == "--align-step") {
+            if (!need_number("--align-step", &opt->aligned_step)) {
+                return false;
+            }
+        } else if (arg == "--align-tolerance") {
+            if (!need_number("--align-tolerance", &opt->aligned_tolerance)) {
+                return false;
+            }
+        } else if (arg == "--align-policy") {
+            const char* value = need_value("--align-policy");
+            if (!value) {
+                return false;
+            }
+            if (!parse_resample_policy(value, &opt->aligned_policy)) {
+                *error = std::string("Invalid align policy: ") + value;
+                return false;
+            }
+        } else if (arg == "--stats") {
+            if (!need_number("--stats", &opt->stats_interval)) {
+                return false;
+            }
+        } else if (arg == "--duration") {
+            if (!need_number("--duration", &opt->duration)) {
+                return false;
+            }
+        } else if (arg == "--quiet") {
+            opt->quiet = true;
+        } else if (arg == "--clock") {
+            const char* value = need_value("--clock");
+            if (!value) {
+                return false;
+            }
+            std::string mode = value;
+            if (mode == "real") {
+                opt->virtual_clock = false;
+            } else if (mode == "virtual") {
+                opt->virtual_clock = true;
+            } else {
+                *error = "Invalid clock: " + mode;
+                return false;
+            }
+        } else if (arg == "--virtual-step") {
+            if (!need_number("--virtual-step", &opt->virtual_step)) {
+                return false;
+            }
+        } else if (arg == "--csv") {
+            const char* value = need_value("--csv");
+            if (!value) {
+                return false;
+            }
+            opt->csv_out = value;
+        } else if (arg == "--record") {
+            const char* value = need_value("--record");
+            if (!value) {
+                return false;
+            }
+            opt->record_out = value;
+        } else if (arg == "--journal-out") {
+            const char* value = need_value("--journal-out");
+            if (!value) {
+                return false;
+            }
+            opt->journal_out = value;
+        } else if (arg == "--stats-json") {
+            const char* value = need_value("--stats-json");
+            if (!value) {
+                return false;
+            }
+            opt->stats_json = value;
+        } else if (arg == "--trace-out") {
+            const char* value = need_value("--trace-out");
+            if (!value) {
+                return false;
+            }
+            opt->trace_out = value;
+        } else if (!arg.empty() && arg[0] == '-') {
+            *error = "Unknown option: " + arg;
+            return false;
+        } else if (opt->device.empty()) {
+            opt->device = arg;
+        } else {
+            *error = "Unexpected argument: " + arg;
+            return false;
+        }
+    }
+
+    int sources = (opt->device.empty() ? 0 : 1) + (opt->use_stdin ? 1 : 0) + (opt->journal_in.empty() ? 0 : 1);
+    if (sources != 1) {
+        *error = "Exactly one source is required (device, '-' or --journal)";
+        return false;
+    }
+    if (opt->data_bits < 5 || opt->data_bits > 8) {
+        *error = "Invalid data bits";
+        return false;
+    }
+    if (opt->baud <= 0) {
+        *error = "Invalid baud rate";
+        return false;
+    }
+    if (opt->virtual_clock && opt->journal_in.empty()) {
+        *error = "--clock virtual requires --journal";
+        return false;
+    }
+    if (opt->virtual_step < 0.0) {
+        *error = "Invalid virtual step";
+        return false;
+    }
+    if (opt->aligned_step < 0.0 || opt->aligned_tolerance < 0.0) {
+        *error = "Invalid align step or tolerance";
+        return false;
+    }
+    return true;
+}
+
+class HeadlessPipeline {
+public:
+    HeadlessPipeline(const Options& opt, double start) : opt_(opt), stats_(start) {
+        model_.set_time_window(opt.time_window);
+        model_.set_history_budget(static_cast<size_t>(opt.history_mb * 1024.0 * 1024.0));
+        model_.set_shared_timestamps(opt.shared_time);
+    }
+
+    bool open_outputs(std::string* error) {
+        if (!opt_.spill_dir.empty() && !model_.enable_spill(opt_.spill_dir, error)) {
+            return false;
+        }
+        for (const auto& def : opt_.derived) {
+            size_t eq = def.find('=');
+            std::string name = def.substr(0, eq);
+            name.erase(std::remove(name.begin(), name.end(), ' '), name.end());
+            if (!model_.add_derived_channel(name, def.substr(eq + 1), error)) {
+                *error = "--derive " + def + ": " + *error;
+                return false;
+            }
+            derived_names_.push_back(name);
+        }
+        for (const auto& def : opt_.triggers) {
+            if (!model_.add_trigger(def, error)) {
+                *error = "--trigger " + def + ": " + *error;
+                return false;
+            }
+        }
+        for (const auto& key : opt_.transition_keys) {
+            model_.set_transition_index(key, true);
+        }
+        if (!opt_.csv_out.empty() && !csv_.open(opt_.csv_out, RecordingWriter::Format::kCsv, error)) {
+            return false;
+        }
+        if (!opt_.record_out.empty() && !record_.open(opt_.record_out, RecordingWriter::Format::kBinary, error)) {
+            return false;
+        }
+        if (!opt_.journal_out.empty() && !journal_.open(opt_.journal_out, error)) {
+            return false;
+        }
+        return true;
+    }
+
+    void close_outputs() {
+        model_.finish_captures();
+        report_captures();
+        csv_.close();
+        record_.close();
+        journal_.close();
+        if (!opt_.aligned_out.empty()) {
+            write_aligned();
+        }
+        report_transitions();
+        report_aggregates();
+    }
+
+    PipelineStats& stats() {
+        return stats_;
+    }
+
+    // read_ts is pipeline time (stored with the samples); arrival_ts is the
+    // latency clock reading when the line was received.
+    void ingest(const std::string& line, double read_ts, double arrival_ts) {
+        SCC_TRACE_SCOPE("ingest");
+        journal_.write(read_ts, line);
+
+        double parse_start = latency_now();
+        stats_.record(PipelineLatency::kReadToParse, parse_start - arrival_ts);
+        auto kv = log_parser::parse_kv_log(line);
+        double parse_end = latency_now();
+        stats_.record(PipelineLatency::kParse, parse_end - parse_start);
+        if (kv.empty()) {
+            return;
+        }
+        stats_.add(PipelineCounter::kLinesParsed);
+        for (const auto& pair : kv) {
+            interval_counts_[pair.first] += 1;
+            session_counts_[pair.first] += 1;
+        }
+
+        int stored = model_.update_from_kv(kv, read_ts);
+        stats_.record(PipelineLatency::kIngest, latency_now() - parse_end);
+        stats_.add(PipelineCounter::kSamplesIngested, static_cast<uint64_t>(stored));
+        for (const auto& name : derived_names_) {
+            ChannelSample last;
+            if (model_.get_last_sample(name, &last) && last.t == read_ts) {
+                interval_counts_[name] += 1;
+                session_counts_[name] += 1;
+            }
+        }
+
+        if (model_.get_capture_seq() != captures_seen_) {
+            report_captures();
+        }
+
+        csv_.write_line(read_ts, kv);
+        record_.write_line(read_ts, kv);
+        if (read_ts > latest_ts_) {
+            latest_ts_ = read_ts;
+        }
+    }
+
+    void prune() {
+        if (latest_ts_ > 0.0) {
+            model_.prune(latest_ts_);
+        }
+        int evicted = model_.consume_evicted_samples();
+        if (evicted > 0) {
+            stats_.add(PipelineCounter::kEvictedSamples, static_cast<uint64_t>(evicted));
+        }
+        history_dropped_ += static_cast<uint64_t>(model_.consume_dropped_history());
+        int dropped = model_.consume_dropped_keys();
+        if (dropped > 0) {
+            stats_.add(PipelineCounter::kDroppedKeys, static_cast<uint64_t>(dropped));
+        }
+    }
+
+    void print_stats(double now, bool final_report) {
+        auto snap = stats_.take_snapshot(now);
+        auto total = [&](PipelineCounter c) {
+            return static_cast<unsigned long long>(snap.totals[static_cast<int>(c)]);
+        };
+        double elapsed = snap.uptime > 0.0 ? snap.uptime : 1e-9;
+        double dt = snap.interval > 0.0 ? snap.interval : 1e-9;
+
+        if (final_report) {
+            std::fprintf(stderr,
+                "[%9.1f s] total: lines %llu (%.1f/s) parsed %llu samples %llu (%.1f/s) bytes %llu"
+                " | dropped: bytes %llu lines %llu keys %llu\n",
+                snap.uptime,
+                total(PipelineCounter::kLinesFramed),
+                static_cast<double>(total(PipelineCounter::kLinesFramed)) / elapsed,
+                total(PipelineCounter::kLinesParsed),
+                total(PipelineCounter::kSamplesIngested),
+                static_cast<double>(total(PipelineCounter::kSamplesIngested)) / elapsed,
+                total(PipelineCounter::kBytesRead),
+                total(PipelineCounter::kDroppedBytes),
+                total(PipelineCounter::kDroppedLines),
+                total(PipelineCounter::kDroppedKeys));
+            size_t window = 0;
+            for (const auto& key : model_.get_keys()) {
+                window += model_.get_series_view(key).size();
+            }
+            size_t window_bytes = model_.get_sample_bytes();
+            std::fprintf(stderr, "  window: %llu samples in %.1f KB (%.2f bytes/sample)\n",
+                static_cast<unsigned long long>(window), static_cast<double>(window_bytes) / 1024.0,
+                window ? static_cast<double>(window_bytes) / static_cast<double>(window) : 0.0);
+            uint64_t history = model_.get_history_samples();
+            size_t history_bytes = model_.get_history_bytes();
+            std::fprintf(stderr, "  history: %llu samples in %.1f KB (%.2f bytes/sample), dropped %llu\n",
+                static_cast<unsigned long long>(history), static_cast<double>(history_bytes) / 1024.0,
+                history ? static_cast<double>(history_bytes) / static_cast<double>(history) : 0.0,
+                static_cast<unsigned long long>(history_dropped_));
+            if (model_.is_spill_enabled()) {
+                std::fprintf(stderr, "  spilled: %llu samples, %.1f KB on disk\n",
+                    static_cast<unsigned long long>(model_.get_spilled_samples()),
+                    static_cast<double>(model_.get_spilled_bytes()) / 1024.0);
+            }
+        } else {
+            std::fprintf(stderr, "[%9.1f s] lines %llu samples %llu\n",
+                snap.uptime, total(PipelineCounter::kLinesFramed), total(PipelineCounter::kSamplesIngested));
+            for (const auto& line : PipelineStats::format_summary(snap)) {
+                std::fprintf(stderr, "  %s\n", line.c_str());
+            }
+        }
+
+        for (const auto& key : model_.get_keys()) {
+            SeriesView series = model_.get_series_view(key);
+            const auto& counts = final_report ? session_counts_ : interval_counts_;
+            auto it = counts.find(key);
+            double rate = (it != counts.end()) ? static_cast<double>(it->second) : 0.0;
+            rate /= final_report ? elapsed : dt;
+            if (series.empty()) {
+                std::fprintf(stderr, "  %-16s window %8zu  rate %9.1f/s  --\n",
+                    key.c_str(), series.size(), rate);
+                continue;
+            }
+            ChannelStats stats;
+            model_.get_channel_stats(key, &stats, nullptr);
+            model_.get_value_histogram(key, &histogram_, nullptr);
+            std::fprintf(stderr, "  %-16s window %8zu  rate %9.1f/s  last %8d  min %8d  max %8d"
+                "  mean %10.2f  std %8.2f  rms %10.2f  p1/p50/p99 %.1f/%.1f/%.1f\n",
+                key.c_str(), series.size(), rate, series.back().v, stats.min, stats.max,
+                stats.mean, stats.stddev, stats.rms,
+                histogram_.quantile(0.01), histogram_.quantile(0.5), histogram_.quantile(0.99));
+        }
+        interval_counts_.clear();
+
+        if (!opt_.stats_json.empty()) {
+            std::ofstream f(opt_.stats_json, std::ios::trunc);
+            if (f) {
+                f << PipelineStats::to_json(snap);
+            }
+        }
+
+        csv_.flush();
+        record_.flush();
+        journal_.flush();
+    }
+
+private:
+    // Resamples the selected channels over everything still stored.
+    void write_aligned() {
+        std::vector<std::string> keys = opt_.aligned_keys.empty() ? model_.get_keys() : opt_.aligned_keys;
+        ResampleGrid grid;
+        grid.step = opt_.aligned_step;
+        grid.tolerance = opt_.aligned_tolerance;
+        bool any = false;
+        for (const auto& key : keys) {
+            double first = 0.0;
+            double last = 0.0;
+            if (!model_.get_stored_span(key, &first, &last)) {
+                continue;
+            }
+            grid.t_start = any ? std::min(grid.t_start, first) : first;
+            grid.t_end = any ? std::max(grid.t_end, last) : last;
+            any = true;
+        }
+        if (!any) {
+            std::fprintf(stderr, "aligned: no samples for the selected channels\n");
+            return;
+        }
+
+        double start = monotonic_clock().now();
+        AlignedCsvStats stats;
+        std::string error;
+        if (!write_aligned_csv(model_, keys, grid, opt_.aligned_policy, opt_.aligned_out, &stats, &error)) {
+            std::fprintf(stderr, "aligned: %s\n", error.c_str());
+            return;
+        }
+        std::fprintf(stderr, "aligned: %llu rows x %zu columns from %llu samples, %.1f MB in %.2f s -> %s\n",
+            static_cast<unsigned long long>(stats.rows), stats.columns,
+            static_cast<unsigned long long>(stats.samples), static_cast<double>(stats.bytes) / 1e6,
+            monotonic_clock().now() - start, opt_.aligned_out.c_str());
+    }
+
+    // Per --transitions key: each (from, to) kind with its count and the
+    // times of its first and last occurrence.
+    void report_transitions() {
+        const double kInf = std::numeric_limits<double>::infinity();
+        for (const auto& key : opt_.transition_keys) {
+            uint64_t total = model_.count_transitions(key, TransitionIndex::kAnyValue, TransitionIndex::kAnyValue);
+            std::fprintf(stderr, "transitions %s: %llu\n", key.c_str(), static_cast<unsigned long long>(total));
+            for (const auto& kind : model_.get_transition_counts(key)) {
+                Transition first;
+                Transition last;
+                model_.find_next_transition(key, -kInf, kind.from, kind.to, &first);
+                model_.find_prev_transition(key, kInf, kind.from, kind.to, &last);
+                std::fprintf(stderr, "  %d -> %d  x%llu  first %.6f s  last %.6f s\n", kind.from, kind.to,
+                    static_cast<unsigned long long>(kind.count), first.t, last.t);
+            }
+        }
+    }
+
+    // Per --aggregate key: the summary over the stored span, then per
+    // --aggregate-bucket bucket.
+    void report_aggregates() {
+        auto print = [](const char* label, const RangeAggregate& a) {
+            std::fprintf(stderr, "%s%llu samples", label, static_cast<unsigned long long>(a.count));
+            if (a.count > 0) {
+                std::fprintf(stderr, "  min %d  max %d  mean %.3f  first %d @ %.6f s  last %d @ %.6f s", a.min,
+                    a.max, a.mean(), a.first.v, a.first.t, a.last.v, a.last.t);
+            }
+            std::fprintf(stderr, "\n");
+        };
+        for (const auto& key : opt_.aggregate_keys) {
+            double t_first = 0.0;
+            double t_last = 0.0;
+            RangeAggregate total;
+            if (!model_.get_stored_span(key, &t_first, &t_last) ||
+                !model_.get_aggregate(key, t_first, t_last, &total)) {
+                std::fprintf(stderr, "aggregate %s: no samples\n", key.c_str());
+                continue;
+            }
+            std::string label = "aggregate " + key + ": ";
+            print(label.c_str(), total);
+            std::vector<RangeAggregate> buckets;
+            if (opt_.aggregate_bucket <= 0.0 ||
+                !model_.get_aggregate_buckets(key, t_first, t_last, opt_.aggregate_bucket, &buckets)) {
+                continue;
+            }
+            for (size_t i = 0; i < buckets.size(); ++i) {
+                char bucket[64];
+                double t = t_first + static_cast<double>(i) * opt_.aggregate_bucket;
+                std::snprintf(bucket, sizeof(bucket), "  %.6f s  ", t);
+                print(bucket, buckets[i]);
+            }
+        }
+    }
+
+    // Prints (and with --capture-dir writes) captures completed since the
+    // last call.
+    void report_captures() {
+        uint64_t seq = model_.get_capture_seq();
+        size_t count = model_.get_capture_count();
+        size_t fresh = static_cast<size_t>(std::min<uint64_t>(seq - captures_seen_, count));
+        captures_seen_ = seq;
+        for (size_t i = count - fresh; i < count; ++i) {
+            TriggerCapture copy;
+            if (!model_.get_capture(i, &copy)) {
+                break;
+            }
+            const TriggerCapture* capture = &copy;
+            std::fprintf(stderr, "capture %llu: '%s' at %.6f s, %zu channels, %zu samples\n",
+                static_cast<unsigned long long>(capture->seq), capture->trigger.c_str(), capture->t,
+                capture->keys.size(), capture->sample_count());
+            if (opt_.capture_dir.empty()) {
+                continue;
+            }
+            char name[32] = {};
+            std::snprintf(name, sizeof(name), "/capture_%04llu.csv", static_cast<unsigned long long>(capture->seq));
+            RecordingWriter out;
+            std::string error;
+            if (!out.open(opt_.capture_dir + name, RecordingWriter::Format::kCsv, &error)) {
+                std::fprintf(stderr, "  %s\n", error.c_str());
+                continue;
+            }
+            std::unordered_map<std::string, int> kv;
+            for (size_t k = 0; k < capture->keys.size(); ++k) {
+                for (const auto& s : capture->series[k]) {
+                    kv.clear();
+                    kv[capture->keys[k]] = s.v;
+                    out.write_line(s.t, kv);
+                }
+            }
+        }
+    }
+
+    const Options& opt_;
+    ChannelModel model_;
+    PipelineStats stats_;
+
+    uint64_t history_dropped_ = 0;
+    ValueHistogram histogram_;
+    RecordingWriter csv_;
+    RecordingWriter record_;
+    JournalWriter journal_;
+
+    double latest_ts_ = 0.0;
+
+    std::unordered_map<std::string, uint64_t> interval_counts_;
+    std::unordered_map<std::string, uint64_t> session_counts_;
+    std::vector<std::string> derived_names_;
+    uint64_t captures_seen_ = 0;
+};
+
+int run_stream(const Options& opt, HeadlessPipeline* pipeline, const Clock& clock, double start) {
+    CaptureSource source;
+    std::string error;
+    bool ok = opt.use_stdin
+        ? source.open_stdin(&error)
+        : source.open_device(opt.device, opt.baud, opt.data_bits, opt.parity, opt.stop_bits, &error);
+    if (!ok) {
+        std::fprintf(stderr, "Open failed: %s\n", error.c_str());
+        return 2;
+    }
+
+    LineFramer framer;
+    std::vector<char> buffer(kReadChunk);
+    std::vector<std::string> lines;
+    double next_report = start + opt.stats_interval;
+
+    while (!g_stop && !source.at_eof()) {
+        int n = source.read_some(buffer.data(), static_cast<int>(buffer.size()), kReadIntervalMs, &error);
+        if (n < 0) {
+            std::fprintf(stderr, "Serial error: %s\n", error.c_str());
+            return 2;
+        }
+
+        double now = clock.now();
+        if (n > 0) {
+            SCC_TRACE_SCOPE("read_batch");
+            auto& stats = pipeline->stats();
+            stats.add(PipelineCounter::kBytesRead, static_cast<uint64_t>(n));
+            lines.clear();
+            framer.push(buffer.data(), static_cast<size_t>(n), &lines);
+            stats.add(PipelineCounter::kLinesFramed, lines.size());
+            for (const auto& line : lines) {
+                pipeline->ingest(line, now, now);
+            }
+            stats.add(PipelineCounter::kDroppedBytes, static_cast<uint64_t>(framer.consume_overflow()));
+            pipeline->prune();
+        }
+
+        if (!opt.quiet && opt.stats_interval > 0.0 && now >= next_report) {
+            pipeline->print_stats(now, false);
+            next_report = now + opt.stats_interval;
+        }
+        if (opt.duration > 0.0 && now - start >= opt.duration) {
+            break;
+        }
+    }
+    return 0;
+}
+
+int run_journal(const Options& opt, HeadlessPipeline* pipeline, Clock& clock,
+                VirtualClock* virtual_clock, double start) {
+    JournalReader reader;
+    std::string error;
+    if (!reader.open(opt.journal_in, &error)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 2;
+    }
+
+    double next_report = start + opt.stats_interval;
+    double ts = 0.0;
+    std::string line;
+    bool more = true;
+    bool first = true;
+    while (more && !g_stop) {
+        for (int i = 0; i < kReplayBatchLines; ++i) {
+            if (!reader.next(&ts, &line)) {
+                more = false;
+                break;
+            }
+            auto& stats = pipeline->stats();
+            if (virtual_clock) {
+                double t = ts > 0.0 ? ts : virtual_clock->now() + opt.virtual_step;
+                virtual_clock->set(t);
+                if (first) {
+                    // Stats periods start at the first journal timestamp.
+                    start = t;
+                    next_report = t + opt.stats_interval;
+                    stats.reset(t);
+                }
+            }
+            first = false;
+            stats.add(PipelineCounter::kBytesRead, line.size() + 2);
+            stats.add(PipelineCounter::kLinesFramed);
+            pipeline->ingest(line, ts > 0.0 ? ts : clock.now(), latency_now());
+        }
+        pipeline->prune();
+
+        double now = clock.now();
+        if (!opt.quiet && opt.stats_interval > 0.0 && now >= next_report) {
+            pipeline->print_stats(now, false);
+            next_report = now + opt.stats_interval;
+        }
+        if (opt.duration > 0.0 && now - start >= opt.duration) {
+            break;
+        }
+    }
+    return 0;
+}
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    std::string error;
+    if (!parse_args(argc, argv, &opt, &error)) {
+        if (!error.empty()) {
+            std::fprintf(stderr, "%s\n\n", error.c_str());
+        }
+        print_usage(argv[0]);
+        return error.empty() ? 0 : 1;
+    }
+
+    std::signal(SIGINT, on_signal);
+    std::signal(SIGTERM, on_signal);
+#ifdef SIGPIPE
+    std::signal(SIGPIPE, SIG_IGN);
+#endif
+
+    VirtualClock virtual_clock;
+    Clock& clock = opt.virtual_clock ? static_cast<Clock&>(virtual_clock) : monotonic_clock();
+
+    double start = clock.now();
+    HeadlessPipeline pipeline(opt, start);
+    if (!pipeline.open_outputs(&error)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 2;
+    }
+
+    int rc = opt.journal_in.empty()
+        ? run_stream(opt, &pipeline, clock, start)
+        : run_journal(opt, &pipeline, clock, opt.virtual_clock ? &virtual_clock : nullptr, start);
+
+    pipeline.print_stats(clock.now(), true);
+    pipeline.close_outputs();
+
+    if (!opt.trace_out.empty() && !trace::write_chrome_json(opt.trace_out, &error)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+    }
+    return rc;
+}
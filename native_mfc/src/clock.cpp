@@ -0,0 +1,15 @@
+#include "clock.h"
+
+#include <chrono>
+
+double MonotonicClock::now() const {
+    // steady_clock is backed by QueryPerformanceCounter on Windows and
+    // CLOCK_MONOTONIC on Linux.
+    using clock = std::chrono::steady_clock;
+    return std::chrono::duration<double>(clock::now().time_since_epoch()).count();
+}
+
+Clock& monotonic_clock() {
+    static MonotonicClock instance;
+    return instance;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+
+// Time source for the capture, ingest, prune and plot paths. All values are
+// seconds on an arbitrary monotonic epoch.
+//
+// MonotonicClock is the live source. VirtualClock only moves when told to,
+// so journal replays and benchmarks can run faster than real time and still
+// feed the model bit-identical timestamps.
+class Clock {
+public:
+    virtual ~Clock() = default;
+    virtual double now() const = 0;
+};
+
+class MonotonicClock : public Clock {
+public:
+    double now() const override;
+};
+
+// Safe to read from any thread; set/advance belong to the thread driving it.
+class VirtualClock : public Clock {
+public:
+    explicit VirtualClock(double start = 0.0) : now_(start) {}
+
+    double now() const override {
+        return now_.load(std::memory_order_acquire);
+    }
+
+    void set(double t) {
+        now_.store(t, std::memory_order_release);
+    }
+
+    void advance(double dt) {
+        set(now() + dt);
+    }
+
+private:
+    std::atomic<double> now_;
+};
+
+// Shared process-wide instance, used wherever no clock is injected.
+Clock& monotonic_clock();
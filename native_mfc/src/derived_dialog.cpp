@@ -0,0 +1,199 @@
+#include "derived_dialog.h"
+
+#include <sstream>
+
+#include "channel_model.h"
+
+namespace {
+const wchar_t* kHintText =
+    L"One channel per line: NAME = EXPR. Operators + - * / and abs(), min(,), max(,). "
+    L"Keys containing '/' go in brackets: D = [Q2/Q3] - T1. Smoothed copies: S = boxcar(CHG, 16), ema(CHG, 0.1), "
+    L"lowpass(CHG, 0.05) or median(CHG, 9). Lines starting with # are ignored.";
+
+std::wstring to_wstring(const std::string& s) {
+    if (s.empty()) {
+        return L"";
+    }
+    int len = MultiByteToWideChar(CP_UTF8, 0, s.c_str(), -1, nullptr, 0);
+    if (len <= 0) {
+        return L"";
+    }
+    std::wstring out(len - 1, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, s.c_str(), -1, &out[0], len);
+    return out;
+}
+
+std::string to_utf8(const std::wstring& s) {
+    if (s.empty()) {
+        return "";
+    }
+    int len = WideCharToMultiByte(CP_UTF8, 0, s.c_str(), -1, nullptr, 0, nullptr, nullptr);
+    if (len <= 0) {
+        return "";
+    }
+    std::string out(len - 1, '\0');
+    WideCharToMultiByte(CP_UTF8, 0, s.c_str(), -1, &out[0], len, nullptr, nullptr);
+    return out;
+}
+
+std::string trim(const std::string& s) {
+    size_t b = s.find_first_not_of(" \t\r");
+    if (b == std::string::npos) {
+        return "";
+    }
+    size_t e = s.find_last_not_of(" \t\r");
+    return s.substr(b, e - b + 1);
+}
+} // namespace
+
+void DerivedDialog::show(HWND parent, ChannelModel* model) {
+    model_ = model;
+
+    WNDCLASSW wc = {};
+    wc.lpfnWndProc = DerivedDialog::WndProc;
+    wc.hInstance = GetModuleHandleW(nullptr);
+    wc.lpszClassName = L"DerivedDialogWnd";
+    wc.hCursor = LoadCursor(nullptr, IDC_ARROW);
+    wc.hbrBackground = reinterpret_cast<HBRUSH>(GetStockObject(WHITE_BRUSH));
+    RegisterClassW(&wc);
+
+    hwnd_ = CreateWindowExW(
+        WS_EX_DLGMODALFRAME,
+        wc.lpszClassName,
+        L"Derived Channels",
+        WS_OVERLAPPED | WS_CAPTION | WS_SYSMENU | WS_THICKFRAME | WS_VISIBLE,
+        CW_USEDEFAULT, CW_USEDEFAULT, 640, 420,
+        parent,
+        nullptr,
+        wc.hInstance,
+        this
+    );
+    if (!hwnd_) {
+        return;
+    }
+
+    ShowWindow(hwnd_, SW_SHOW);
+
+    MSG msg;
+    while (IsWindow(hwnd_) && GetMessageW(&msg, nullptr, 0, 0)) {
+        if (IsDialogMessageW(hwnd_, &msg)) {
+            continue;
+        }
+        TranslateMessage(&msg);
+        DispatchMessageW(&msg);
+    }
+}
+
+bool DerivedDialog::apply(std::wstring* error) {
+    int len = GetWindowTextLengthW(edit_);
+    std::wstring text(static_cast<size_t>(len) + 1, L'\0');
+    GetWindowTextW(edit_, &text[0], len + 1);
+    text.resize(static_cast<size_t>(len));
+
+    model_->clear_derived_channels();
+    std::istringstream lines(to_utf8(text));
+    std::string line;
+    int line_no = 0;
+    while (std::getline(lines, line)) {
+        line_no++;
+        line = trim(line);
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        size_t eq = line.find('=');
+        std::string err;
+        if (eq == std::string::npos) {
+            err = "expected NAME = EXPR";
+        } else if (model_->add_derived_channel(trim(line.substr(0, eq)), line.substr(eq + 1), &err)) {
+            continue;
+        }
+        *error = L"Line " + std::to_wstring(line_no) + L": " + to_wstring(err);
+        return false;
+    }
+    return true;
+}
+
+LRESULT CALLBACK DerivedDialog::WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+    DerivedDialog* self = reinterpret_cast<DerivedDialog*>(GetWindowLongPtrW(hwnd, GWLP_USERDATA));
+    if (msg == WM_NCCREATE) {
+        CREATESTRUCTW* cs = reinterpret_cast<CREATESTRUCTW*>(lParam);
+        self = reinterpret_cast<DerivedDialog*>(cs->lpCreateParams);
+        SetWindowLongPtrW(hwnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(self));
+    }
+    if (self) {
+        return self->handle_message(hwnd, msg, wParam, lParam);
+    }
+    return DefWindowProcW(hwnd, msg, wParam, lParam);
+}
+
+LRESULT DerivedDialog::handle_message(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+    switch (msg) {
+    case WM_CREATE: {
+        hint_ = CreateWindowW(L"STATIC", kHintText, WS_CHILD | WS_VISIBLE,
+                              10, 10, 600, 56, hwnd, nullptr, nullptr, nullptr);
+        edit_ = CreateWindowExW(WS_EX_CLIENTEDGE, L"EDIT", L"", WS_CHILD | WS_VISIBLE | WS_TABSTOP | ES_MULTILINE |
+                                ES_WANTRETURN | WS_VSCROLL | ES_AUTOVSCROLL, 10, 76, 600, 260, hwnd, nullptr, nullptr, nullptr);
+        font_ = CreateFontW(16, 0, 0, 0, FW_NORMAL, FALSE, FALSE, FALSE, DEFAULT_CHARSET,
+                            OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS, CLEARTYPE_QUALITY, FIXED_PITCH, L"Consolas");
+        if (font_) {
+            SendMessageW(edit_, WM_SETFONT, reinterpret_cast<WPARAM>(font_), TRUE);
+        }
+        std::wstring text;
+        for (const auto& def : model_->get_derived_channels()) {
+            text += to_wstring(def.first) + L" = " + to_wstring(def.second) + L"\r\n";
+        }
+        SetWindowTextW(edit_, text.c_str());
+
+        btn_apply_ = CreateWindowW(L"BUTTON", L"Apply", WS_CHILD | WS_VISIBLE | WS_TABSTOP | BS_PUSHBUTTON,
+                                   440, 346, 80, 26, hwnd, reinterpret_cast<HMENU>(1), nullptr, nullptr);
+        btn_close_ = CreateWindowW(L"BUTTON", L"Close", WS_CHILD | WS_VISIBLE | WS_TABSTOP | BS_PUSHBUTTON,
+                                   530, 346, 80, 26, hwnd, reinterpret_cast<HMENU>(2), nullptr, nullptr);
+        return 0;
+    }
+    case WM_SIZE: {
+        int w = LOWORD(lParam);
+        int h = HIWORD(lParam);
+        if (edit_ && btn_apply_ && btn_close_) {
+            int margin = 10;
+            int hint_h = 56;
+            int btn_h = 26;
+            int btn_w = 80;
+            MoveWindow(hint_, margin, margin, w - 2 * margin, hint_h, TRUE);
+            MoveWindow(edit_, margin, 2 * margin + hint_h, w - 2 * margin, h - 4 * margin - hint_h - btn_h, TRUE);
+            MoveWindow(btn_apply_, w - 2 * btn_w - 2 * margin, h - btn_h - margin, btn_w, btn_h, TRUE);
+            MoveWindow(btn_close_, w - btn_w - margin, h - btn_h - margin, btn_w, btn_h, TRUE);
+        }
+        return 0;
+    }
+    case WM_COMMAND: {
+        HWND from = reinterpret_cast<HWND>(lParam);
+        if (from == btn_apply_) {
+            std::wstring error;
+            if (!apply(&error)) {
+                MessageBoxW(hwnd, error.c_str(), L"Derived Channels", MB_OK | MB_ICONWARNING);
+            }
+            return 0;
+        }
+        if (from == btn_close_) {
+            DestroyWindow(hwnd);
+            return 0;
+        }
+        break;
+    }
+    case WM_CLOSE:
+        DestroyWindow(hwnd);
+        return 0;
+    case WM_DESTROY:
+        if (font_) {
+            DeleteObject(font_);
+            font_ = nullptr;
+        }
+        hwnd_ = nullptr;
+        edit_ = nullptr;
+        hint_ = nullptr;
+        btn_apply_ = nullptr;
+        btn_close_ = nullptr;
+        break;
+    }
+    return DefWindowProcW(hwnd, msg, wParam, lParam);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <windows.h>
+
+#include <string>
+
+class ChannelModel;
+
+// Edits the model's derived channels as "NAME = EXPR" lines.
+class DerivedDialog {
+public:
+    void show(HWND parent, ChannelModel* model);
+
+private:
+    static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
+    LRESULT handle_message(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
+    // Replaces the definitions with the edit's lines; stops at the first bad one.
+    bool apply(std::wstring* error);
+
+    ChannelModel* model_ = nullptr;
+    HWND hwnd_ = nullptr;
+    HWND edit_ = nullptr;
+    HWND hint_ = nullptr;
+    HWND btn_apply_ = nullptr;
+    HWND btn_close_ = nullptr;
+    HFONT font_ = nullptr;
+};
@@ -0,0 +1,253 @@
+#include "expression.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+
+namespace {
+// Unary minuses, parentheses and call arguments open inside each other,
+// each one recursing once more.
+constexpr int kMaxNesting = 64;
+} // namespace
+
+// Recursive-descent parser emitting bytecode while tracking the stack depth
+// the program will need.
+class ExpressionParser {
+public:
+    ExpressionParser(const std::string& text, Expression* out) : text_(text), out_(out) {}
+
+    bool parse(std::string* error) {
+        bool ok = parse_expr();
+        skip_space();
+        if (ok && pos_ != text_.size()) {
+            ok = fail("Unexpected '" + text_.substr(pos_, 1) + "'");
+        }
+        if (!ok) {
+            *error = error_ + " at column " + std::to_string(pos_ + 1);
+        }
+        return ok;
+    }
+
+private:
+    using Op = Expression::Op;
+
+    bool fail(const std::string& message) {
+        if (error_.empty()) {
+            error_ = message;
+        }
+        return false;
+    }
+
+    void skip_space() {
+        while (pos_ < text_.size() && std::isspace(static_cast<unsigned char>(text_[pos_]))) {
+            pos_++;
+        }
+    }
+
+    bool accept(char c) {
+        skip_space();
+        if (pos_ < text_.size() && text_[pos_] == c) {
+            pos_++;
+            return true;
+        }
+        return false;
+    }
+
+    // Pushes (delta > 0) or pops values; fails past kMaxStack.
+    bool emit(Op op, int delta, uint8_t index = 0) {
+        out_->code_.push_back(Expression::Instr{op, index});
+        depth_ += delta;
+        if (depth_ > Expression::kMaxStack) {
+            return fail("Expression too deeply nested");
+        }
+        return true;
+    }
+
+    bool parse_expr() {
+        if (!parse_term()) {
+            return false;
+        }
+        for (;;) {
+            if (accept('+')) {
+                if (!parse_term() || !emit(Op::kAdd, -1)) {
+                    return false;
+                }
+            } else if (accept('-')) {
+                if (!parse_term() || !emit(Op::kSub, -1)) {
+                    return false;
+                }
+            } else {
+                return true;
+            }
+        }
+    }
+
+    bool parse_term() {
+        if (!parse_unary()) {
+            return false;
+        }
+        for (;;) {
+            if (accept('*')) {
+                if (!parse_unary() || !emit(Op::kMul, -1)) {
+                    return false;
+                }
+            } else if (accept('/')) {
+                if (!parse_unary() || !emit(Op::kDiv, -1)) {
+                    return false;
+                }
+            } else {
+                return true;
+            }
+        }
+    }
+
+    bool parse_unary() {
+        if (nesting_ == kMaxNesting) {
+            return fail("Expression nested too deeply");
+        }
+        nesting_++;
+        bool ok = accept('-') ? parse_unary() && emit(Op::kNeg, 0) : parse_primary();
+        nesting_--;
+        return ok;
+    }
+
+    bool parse_primary() {
+        skip_space();
+        if (pos_ >= text_.size()) {
+            return fail("Unexpected end of expression");
+        }
+        char c = text_[pos_];
+        if (c == '(') {
+            pos_++;
+            if (!parse_expr()) {
+                return false;
+            }
+            return accept(')') || fail("Missing ')'");
+        }
+        if (std::isdigit(static_cast<unsigned char>(c)) || c == '.') {
+            const char* start = text_.c_str() + pos_;
+            char* end = nullptr;
+            double value = std::strtod(start, &end);
+            if (end == start) {
+                return fail("Invalid number");
+            }
+            pos_ += static_cast<size_t>(end - start);
+            return emit_const(value);
+        }
+        if (c == '[') {
+            size_t close = text_.find(']', pos_);
+            if (close == std::string::npos || close == pos_ + 1) {
+                return fail("Invalid [key]");
+            }
+            std::string key = text_.substr(pos_ + 1, close - pos_ - 1);
+            pos_ = close + 1;
+            return emit_input(key);
+        }
+        if (std::isalpha(static_cast<unsigned char>(c))) {
+            size_t start = pos_;
+            while (pos_ < text_.size() &&
+                   (std::isalnum(static_cast<unsigned char>(text_[pos_])) || text_[pos_] == '_')) {
+                pos_++;
+            }
+            std::string name = text_.substr(start, pos_ - start);
+            skip_space();
+            if (pos_ < text_.size() && text_[pos_] == '(') {
+                return parse_call(name);
+            }
+            return emit_input(name);
+        }
+        return fail(std::string("Unexpected '") + c + "'");
+    }
+
+    bool parse_call(const std::string& name) {
+        Op op = Op::kAbs;
+        int arity = 1;
+        if (name == "min") {
+            op = Op::kMin;
+            arity = 2;
+        } else if (name == "max") {
+            op = Op::kMax;
+            arity = 2;
+        } else if (name == "boxcar" || name == "ema" || name == "lowpass" || name == "median") {
+            return fail(name + "() must wrap the whole definition");
+        } else if (name != "abs") {
+            return fail("Unknown function " + name);
+        }
+        pos_++;  // '('
+        for (int i = 0; i < arity; ++i) {
+            if (i > 0 && !accept(',')) {
+                return fail(name + " takes " + std::to_string(arity) + " arguments");
+            }
+            if (!parse_expr()) {
+                return false;
+            }
+        }
+        if (!accept(')')) {
+            return fail("Missing ')'");
+        }
+        return emit(op, 1 - arity);
+    }
+
+    bool emit_const(double value) {
+        auto& consts = out_->consts_;
+        auto it = std::find(consts.begin(), consts.end(), value);
+        if (it == consts.end()) {
+            if (consts.size() >= 255) {
+                return fail("Too many constants");
+            }
+            it = consts.insert(consts.end(), value);
+        }
+        return emit(Op::kConst, 1, static_cast<uint8_t>(it - consts.begin()));
+    }
+
+    bool emit_input(const std::string& key) {
+        auto& inputs = out_->inputs_;
+        auto it = std::find(inputs.begin(), inputs.end(), key);
+        if (it == inputs.end()) {
+            if (inputs.size() >= static_cast<size_t>(Expression::kMaxInputs)) {
+                return fail("Too many keys (max " + std::to_string(Expression::kMaxInputs) + ")");
+            }
+            it = inputs.insert(inputs.end(), key);
+        }
+        return emit(Op::kInput, 1, static_cast<uint8_t>(it - inputs.begin()));
+    }
+
+    const std::string& text_;
+    Expression* out_;
+    size_t pos_ = 0;
+    int depth_ = 0;
+    int nesting_ = 0;
+    std::string error_;
+};
+
+bool Expression::compile(const std::string& text, Expression* out, std::string* error) {
+    Expression expr;
+    expr.text_ = text;
+    ExpressionParser parser(text, &expr);
+    if (!parser.parse(error)) {
+        return false;
+    }
+    *out = std::move(expr);
+    return true;
+}
+
+double Expression::evaluate(const double* values) const {
+    double stack[kMaxStack];
+    int top = -1;
+    for (const Instr& in : code_) {
+        switch (in.op) {
+        case Op::kConst: stack[++top] = consts_[in.index]; break;
+        case Op::kInput: stack[++top] = values[in.index]; break;
+        case Op::kAdd: top--; stack[top] += stack[top + 1]; break;
+        case Op::kSub: top--; stack[top] -= stack[top + 1]; break;
+        case Op::kMul: top--; stack[top] *= stack[top + 1]; break;
+        case Op::kDiv: top--; stack[top] /= stack[top + 1]; break;
+        case Op::kNeg: stack[top] = -stack[top]; break;
+        case Op::kAbs: stack[top] = std::fabs(stack[top]); break;
+        case Op::kMin: top--; stack[top] = std::min(stack[top], stack[top + 1]); break;
+        case Op::kMax: top--; stack[top] = std::max(stack[top], stack[top + 1]); break;
+        }
+    }
+    return stack[0];
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Arithmetic over channel values, parsed once into stack bytecode.
+//
+//   expr    := term (('+' | '-') term)*
+//   term    := unary (('*' | '/') unary)*
+//   unary   := '-' unary | primary
+//   primary := number | key | '[' key ']' | func '(' expr (',' expr)* ')' | '(' expr ')'
+//   func    := abs | min | max
+//
+// Keys may contain '/', which needs the bracket form: [Q2/Q3] - T1.
+class Expression {
+public:
+    static constexpr int kMaxInputs = 16;
+    static constexpr int kMaxStack = 32;
+
+    static bool compile(const std::string& text, Expression* out, std::string* error);
+
+    const std::string& text() const { return text_; }
+    // Distinct keys referenced, in order of first use.
+    const std::vector<std::string>& inputs() const { return inputs_; }
+    // True when the expression is a single key.
+    bool is_input() const { return code_.size() == 1 && code_[0].op == Op::kInput; }
+
+    // values[i] is the current value of inputs()[i]. Division by zero gives
+    // an infinite or NaN result for the caller to reject.
+    double evaluate(const double* values) const;
+
+private:
+    enum class Op : uint8_t { kConst, kInput, kAdd, kSub, kMul, kDiv, kNeg, kAbs, kMin, kMax };
+
+    struct Instr {
+        Op op;
+        uint8_t index;  // constant or input slot
+    };
+
+    friend class ExpressionParser;
+
+    std::string text_;
+    std::vector<Instr> code_;
+    std::vector<double> consts_;
+    std::vector<std::string> inputs_;
+};
@@ -0,0 +1,181 @@
+#include "histogram_view.h"
+
+#include <gdiplus.h>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace Gdiplus;
+
+namespace {
+constexpr int kBins = 32;
+constexpr int kMargin = 8;
+constexpr int kTextHeight = 34;
+
+std::wstring to_wstring(const std::string& s) {
+    if (s.empty()) {
+        return L"";
+    }
+    int len = MultiByteToWideChar(CP_UTF8, 0, s.c_str(), -1, nullptr, 0);
+    if (len <= 0) {
+        return L"";
+    }
+    std::wstring out(len - 1, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, s.c_str(), -1, &out[0], len);
+    return out;
+}
+} // namespace
+
+bool HistogramView::create(HWND parent, int x, int y, int w, int h, int id) {
+    WNDCLASSW wc = {};
+    wc.lpfnWndProc = HistogramView::WndProc;
+    wc.hInstance = GetModuleHandleW(nullptr);
+    wc.lpszClassName = L"HistogramViewWnd";
+    wc.hCursor = LoadCursor(nullptr, IDC_ARROW);
+    RegisterClassW(&wc);
+
+    hwnd_ = CreateWindowExW(0, wc.lpszClassName, L"", WS_CHILD | WS_VISIBLE,
+                            x, y, w, h, parent, reinterpret_cast<HMENU>(static_cast<INT_PTR>(id)), wc.hInstance, this);
+    return hwnd_ != nullptr;
+}
+
+HWND HistogramView::hwnd() const {
+    return hwnd_;
+}
+
+void HistogramView::set_histogram(const std::string& key, const ValueHistogram& hist) {
+    key_ = key;
+    if (key.empty()) {
+        hist_.clear();
+    } else {
+        hist_ = hist;
+    }
+    if (hwnd_) {
+        InvalidateRect(hwnd_, nullptr, FALSE);
+    }
+}
+
+LRESULT CALLBACK HistogramView::WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+    HistogramView* self = reinterpret_cast<HistogramView*>(GetWindowLongPtrW(hwnd, GWLP_USERDATA));
+    if (msg == WM_NCCREATE) {
+        CREATESTRUCTW* cs = reinterpret_cast<CREATESTRUCTW*>(lParam);
+        self = reinterpret_cast<HistogramView*>(cs->lpCreateParams);
+        SetWindowLongPtrW(hwnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(self));
+    }
+    if (self) {
+        return self->handle_message(hwnd, msg, wParam, lParam);
+    }
+    return DefWindowProcW(hwnd, msg, wParam, lParam);
+}
+
+LRESULT HistogramView::handle_message(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+    switch (msg) {
+    case WM_PAINT:
+        paint();
+        return 0;
+    case WM_ERASEBKGND:
+        return 1;
+    case WM_SIZE:
+        InvalidateRect(hwnd, nullptr, FALSE);
+        return 0;
+    case WM_LBUTTONUP:
+        log_bins_ = !log_bins_;
+        InvalidateRect(hwnd, nullptr, FALSE);
+        return 0;
+    }
+    return DefWindowProcW(hwnd, msg, wParam, lParam);
+}
+
+void HistogramView::paint() {
+    PAINTSTRUCT ps = {};
+    HDC hdc = BeginPaint(hwnd_, &ps);
+    if (hdc) {
+        RECT client = {};
+        GetClientRect(hwnd_, &client);
+        int w = static_cast<int>(client.right - client.left);
+        int h = static_cast<int>(client.bottom - client.top);
+
+        if (w > 0 && h > 0) {
+            HDC memdc = CreateCompatibleDC(hdc);
+            HBITMAP membmp = CreateCompatibleBitmap(hdc, w, h);
+            HGDIOBJ oldbmp = SelectObject(memdc, membmp);
+
+            draw(memdc, client);
+
+            BitBlt(hdc, 0, 0, w, h, memdc, 0, 0, SRCCOPY);
+
+            SelectObject(memdc, oldbmp);
+            DeleteObject(membmp);
+            DeleteDC(memdc);
+        }
+    }
+    EndPaint(hwnd_, &ps);
+}
+
+void HistogramView::draw(HDC hdc, const RECT& client) {
+    Graphics g(hdc);
+    g.SetTextRenderingHint(TextRenderingHintClearTypeGridFit);
+    g.Clear(Color(255, 0, 0, 0));
+
+    Font font(L"Segoe UI", 9, FontStyleRegular);
+    SolidBrush text_brush(Color(220, 220, 220));
+    if (hist_.empty()) {
+        g.DrawString(L"Histogram: select a channel", -1, &font,
+                     PointF(static_cast<float>(kMargin), static_cast<float>(kMargin)), &text_brush);
+        return;
+    }
+
+    double p1 = hist_.quantile(0.01);
+    double p50 = hist_.quantile(0.5);
+    double p99 = hist_.quantile(0.99);
+    wchar_t line[160] = {};
+    _snwprintf_s(line, 160, _TRUNCATE, L"%s  (%s, n=%llu)\np1 %.1f   p50 %.1f   p99 %.1f",
+                 to_wstring(key_).c_str(), log_bins_ ? L"log" : L"linear",
+                 static_cast<unsigned long long>(hist_.count()), p1, p50, p99);
+    g.DrawString(line, -1, &font, PointF(static_cast<float>(kMargin), 2.0f), &text_brush);
+
+    float left = static_cast<float>(client.left + kMargin);
+    float right = static_cast<float>(client.right - kMargin);
+    float top = static_cast<float>(client.top + kTextHeight);
+    float bottom = static_cast<float>(client.bottom - kMargin);
+    if (right - left < 10.0f || bottom - top < 10.0f) {
+        return;
+    }
+
+    double lo = hist_.lowest();
+    double hi = hist_.highest() + 1.0;
+    if (log_bins_) {
+        hist_.fill_log(lo, hi, kBins, &bins_);
+    } else {
+        hist_.fill_linear(lo, hi, kBins, &bins_);
+    }
+    uint64_t peak = std::max<uint64_t>(1, *std::max_element(bins_.begin(), bins_.end()));
+
+    SolidBrush bar_brush(Color(255, 80, 160, 230));
+    float bar_w = (right - left) / static_cast<float>(kBins);
+    for (int i = 0; i < kBins; ++i) {
+        float bar_h = (bottom - top) * static_cast<float>(bins_[static_cast<size_t>(i)]) / static_cast<float>(peak);
+        if (bar_h > 0.0f) {
+            g.FillRectangle(&bar_brush, left + bar_w * i, bottom - bar_h, std::max(1.0f, bar_w - 1.0f), bar_h);
+        }
+    }
+
+    // Quantile markers at the same x mapping the bins use.
+    double log_lo = std::max(lo, 1.0);
+    auto value_to_x = [&](double v) {
+        double f = 0.0;
+        if (log_bins_) {
+            f = v <= log_lo ? 0.0 : std::log(v / log_lo) / std::log(hi > log_lo ? hi / log_lo : 2.0);
+        } else {
+            f = (v - lo) / (hi > lo ? hi - lo : 1.0);
+        }
+        return left + static_cast<float>(std::min(std::max(f, 0.0), 1.0)) * (right - left);
+    };
+    Pen marker_pen(Color(255, 240, 200, 80), 1.0f);
+    for (double q : {p1, p50, p99}) {
+        float x = value_to_x(q + 0.5);
+        g.DrawLine(&marker_pen, x, top, x, bottom);
+    }
+    Pen axis_pen(Color(255, 90, 90, 90), 1.0f);
+    g.DrawLine(&axis_pen, left, bottom, right, bottom);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+
+#include <string>
+#include <vector>
+
+#include "value_sketch.h"
+
+// Value histogram of one channel over the time window, with p1/p50/p99
+// markers. Clicking toggles between linear and logarithmic bins.
+class HistogramView {
+public:
+    bool create(HWND parent, int x, int y, int w, int h, int id);
+    HWND hwnd() const;
+
+    // Shows hist for key (empty key clears the view).
+    void set_histogram(const std::string& key, const ValueHistogram& hist);
+
+private:
+    static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
+    LRESULT handle_message(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
+
+    void paint();
+    void draw(HDC hdc, const RECT& client);
+
+    HWND hwnd_ = nullptr;
+    std::string key_;
+    ValueHistogram hist_;
+    bool log_bins_ = false;
+    std::vector<uint64_t> bins_;
+};
@@ -0,0 +1,96 @@
+#include "journal.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+bool JournalWriter::open(const std::string& path, std::string* error) {
+    close();
+    out_.open(path, std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!out_) {
+        if (error) {
+            *error = "Cannot create journal: " + path;
+        }
+        return false;
+    }
+    return true;
+}
+
+bool JournalWriter::is_open() const {
+    return out_.is_open();
+}
+
+void JournalWriter::close() {
+    if (out_.is_open()) {
+        out_.close();
+    }
+}
+
+void JournalWriter::write(double ts, const std::string& line) {
+    if (!out_.is_open()) {
+        return;
+    }
+    char stamp[32] = {};
+    std::snprintf(stamp, sizeof(stamp), "%.6f\t", ts);
+    out_ << stamp << line << '\n';
+}
+
+void JournalWriter::flush() {
+    if (out_.is_open()) {
+        out_.flush();
+    }
+}
+
+bool JournalReader::open(const std::string& path, std::string* error) {
+    close();
+    in_.open(path, std::ios::in | std::ios::binary);
+    if (!in_) {
+        if (error) {
+            *error = "Cannot open journal: " + path;
+        }
+        return false;
+    }
+    return true;
+}
+
+bool JournalReader::is_open() const {
+    return in_.is_open();
+}
+
+void JournalReader::close() {
+    if (in_.is_open()) {
+        in_.close();
+    }
+}
+
+bool JournalReader::next(double* ts, std::string* line) {
+    while (std::getline(in_, row_)) {
+        while (!row_.empty() && (row_.back() == '\r' || row_.back() == '\n')) {
+            row_.pop_back();
+        }
+        if (row_.empty()) {
+            continue;
+        }
+
+        double stamp = 0.0;
+        size_t tab = row_.find('\t');
+        if (tab != std::string::npos && tab > 0) {
+            char* end = nullptr;
+            stamp = std::strtod(row_.c_str(), &end);
+            if (end != row_.c_str() + tab) {
+                stamp = 0.0;
+                tab = std::string::npos;
+            }
+        } else {
+            tab = std::string::npos;
+        }
+
+        if (ts) {
+            *ts = stamp;
+        }
+        if (line) {
+            *line = (tab == std::string::npos) ? row_ : row_.substr(tab + 1);
+        }
+        return true;
+    }
+    return false;
+}
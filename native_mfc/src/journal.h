@@ -0,0 +1,35 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+
+// Raw line journal: one received line per row, prefixed by its receive
+// timestamp ("<seconds>\t<line>\n"). Replaying a journal feeds the parser
+// the same lines with the same timestamps as the original capture.
+class JournalWriter {
+public:
+    bool open(const std::string& path, std::string* error);
+    bool is_open() const;
+    void close();
+
+    void write(double ts, const std::string& line);
+    void flush();
+
+private:
+    std::ofstream out_;
+};
+
+class JournalReader {
+public:
+    bool open(const std::string& path, std::string* error);
+    bool is_open() const;
+    void close();
+
+    // Returns false at end of file. Rows without a timestamp prefix are
+    // returned with ts = 0 so the caller can stamp them itself.
+    bool next(double* ts, std::string* line);
+
+private:
+    std::ifstream in_;
+    std::string row_;
+};
@@ -0,0 +1,44 @@
+#include "line_framer.h"
+
+#include "trace.h"
+
+void LineFramer::push(const char* data, size_t size, std::vector<std::string>* lines) {
+    if (!data || size == 0) {
+        return;
+    }
+
+    rx_buffer_.append(data, size);
+    if (static_cast<int>(rx_buffer_.size()) > kMaxRxBuffer) {
+        int overflow = static_cast<int>(rx_buffer_.size()) - kMaxRxBuffer;
+        rx_overflow_ += overflow;
+        SCC_TRACE_INSTANT("rx_overflow", overflow);
+        rx_buffer_.erase(0, overflow);
+    }
+
+    size_t start = 0;
+    size_t pos = 0;
+    while ((pos = rx_buffer_.find('\n', start)) != std::string::npos) {
+        size_t end = pos;
+        while (end > start && (rx_buffer_[end - 1] == '\r' || rx_buffer_[end - 1] == '\n')) {
+            end--;
+        }
+        if (end > start && lines) {
+            lines->emplace_back(rx_buffer_, start, end - start);
+        }
+        start = pos + 1;
+    }
+    if (start > 0) {
+        rx_buffer_.erase(0, start);
+    }
+}
+
+void LineFramer::reset() {
+    rx_buffer_.clear();
+    rx_overflow_ = 0;
+}
+
+int LineFramer::consume_overflow() {
+    int count = rx_overflow_;
+    rx_overflow_ = 0;
+    return count;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Splits a raw byte stream into CR/LF-terminated log lines. Bytes that do
+// not fit into the receive buffer are discarded from the front and counted
+// as overflow, exactly like the original serial read loop.
+class LineFramer {
+public:
+    // Large enough for lines carrying ChannelModel::kMaxChannels keys.
+    static constexpr int kMaxRxBuffer = 64 * 1024;
+
+    void push(const char* data, size_t size, std::vector<std::string>* lines);
+    void reset();
+
+    int consume_overflow();
+
+private:
+    std::string rx_buffer_;
+    int rx_overflow_ = 0;
+};
@@ -0,0 +1,210 @@
+#include "lod_pyramid.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+namespace {
+constexpr size_t kMinLevelCapacity = 16;
+constexpr size_t kShrinkMinCapacity = 256;
+constexpr size_t kShrinkFactor = 4;
+
+size_t round_up_pow2(size_t n) {
+    size_t cap = kMinLevelCapacity;
+    while (cap < n) {
+        cap <<= 1;
+    }
+    return cap;
+}
+
+void merge_bucket(LodBucket* into, const LodBucket& b) {
+    into->vmin = std::min(into->vmin, b.vmin);
+    into->vmax = std::max(into->vmax, b.vmax);
+    into->vlast = b.vlast;
+}
+} // namespace
+
+void LodLevel::reallocate(size_t capacity) {
+    size_t cap = round_up_pow2(std::max(capacity, size()));
+    if (cap == capacity_) {
+        return;
+    }
+    capacity_ = cap;
+    ring_.reserve(cap);
+}
+
+void LodLevel::push_back(const LodBucket& bucket) {
+    if (size() == capacity_) {
+        reallocate(size() * 2);
+    }
+    size_t p = 0;
+    ring_.push_back(&p).buckets[p & kChunkMask] = bucket;
+}
+
+void LodLevel::shrink_to(size_t capacity) {
+    if (capacity < capacity_) {
+        reallocate(capacity);
+    }
+}
+
+size_t LodLevel::upper_bound(double t) const {
+    size_t lo = 0;
+    size_t hi = size();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (at(mid).t <= t) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+void LodView::to_step_points(double t_start, double t_end, int pixels, std::vector<ChannelSample>* out) const {
+    out->clear();
+    if (empty() || pixels <= 0 || t_end <= t_start) {
+        return;
+    }
+    double px_per_sec = static_cast<double>(pixels) / (t_end - t_start);
+
+    LodBucket column;
+    int column_px = INT_MIN;
+    auto emit = [&]() {
+        if (column_px == INT_MIN) {
+            return;
+        }
+        // Vertical strokes first -> min -> max -> last cover the column's range.
+        out->push_back(ChannelSample{column.t, column.vfirst});
+        if (column.vmin != column.vfirst) {
+            out->push_back(ChannelSample{column.t, column.vmin});
+        }
+        if (column.vmax != column.vmin) {
+            out->push_back(ChannelSample{column.t, column.vmax});
+        }
+        if (column.vlast != column.vmax) {
+            out->push_back(ChannelSample{column.t, column.vlast});
+        }
+    };
+
+    for (size_t i = 0; i < size(); ++i) {
+        LodBucket b = (*this)[i];
+        b.t = std::max(b.t, t_start);
+        int px = static_cast<int>(std::lround((b.t - t_start) * px_per_sec));
+        if (px == column_px) {
+            merge_bucket(&column, b);
+            continue;
+        }
+        emit();
+        column = b;
+        column_px = px;
+    }
+    emit();
+}
+
+void LodPyramid::append(double t, int v) {
+    size_t span = kFanout;
+    for (int k = 0; k < kLevels; ++k, span *= kFanout) {
+        LodLevel& level = levels_[k];
+        if (fill_[k] == 0) {
+            level.push_back(LodBucket{t, v, v, v, v});
+        } else {
+            LodBucket& b = level.back();
+            b.vmin = std::min(b.vmin, v);
+            b.vmax = std::max(b.vmax, v);
+            b.vlast = v;
+        }
+        fill_[k] = (fill_[k] + 1 == span) ? 0 : fill_[k] + 1;
+    }
+}
+
+void LodPyramid::set_last(int v) {
+    for (int k = 0; k < kLevels; ++k) {
+        LodLevel& level = levels_[k];
+        if (level.empty()) {
+            continue;
+        }
+        LodBucket& b = level.back();
+        if (fill_[k] == 1) {
+            b = LodBucket{b.t, v, v, v, v};
+        } else {
+            b.vmin = std::min(b.vmin, v);
+            b.vmax = std::max(b.vmax, v);
+            b.vlast = v;
+        }
+    }
+}
+
+void LodPyramid::trim_before(double t) {
+    for (auto& level : levels_) {
+        // Bucket i holds samples up to (excluding) bucket i + 1's start.
+        size_t n = level.upper_bound(t);
+        if (n > 1) {
+            level.pop_front(n - 1);
+        }
+        if (level.capacity() > kShrinkMinCapacity && level.size() * kShrinkFactor < level.capacity()) {
+            level.shrink_to(level.size() * 2);
+        }
+    }
+}
+
+void LodPyramid::clear() {
+    for (int k = 0; k < kLevels; ++k) {
+        levels_[k].clear();
+        fill_[k] = 0;
+    }
+}
+
+size_t LodPyramid::bucket_count(int level) const {
+    if (level < 1 || level > kLevels) {
+        return 0;
+    }
+    return levels_[level - 1].size();
+}
+
+LodView LodPyramid::select(double t_start, double t_end, size_t sample_count, int pixels) const {
+    int level = select_level(sample_count, pixels);
+    return level > 0 ? level_view(level, t_start, t_end) : LodView();
+}
+
+int LodPyramid::select_level(size_t sample_count, int pixels) {
+    size_t needed = kMinPointsPerPixel * static_cast<size_t>(std::max(pixels, 1));
+    size_t span = 1;
+    for (int k = 0; k < kLevels; ++k) {
+        span *= kFanout;
+    }
+    for (int level = kLevels; level >= 1; --level, span /= kFanout) {
+        if (sample_count / span >= needed) {
+            return level;
+        }
+    }
+    return 0;
+}
+
+LodView LodPyramid::level_view(int level, double t_start, double t_end) const {
+    if (level < 1 || level > kLevels) {
+        return LodView();
+    }
+    const LodLevel& buckets = levels_[level - 1];
+    // Include the bucket that starts before t_start but may reach into it.
+    size_t first = buckets.upper_bound(t_start);
+    first = first > 0 ? first - 1 : 0;
+    size_t last = buckets.upper_bound(t_end);
+    return LodView(&buckets, level, first, last);
+}
+
+LodView select_lod_view(const SampleRing& samples, const LodPyramid& lod, double t_start, double t_end,
+                        int pixels) {
+    if (!samples.run_length()) {
+        size_t count = samples.view().between(t_start, t_end).size();
+        return lod.select(t_start, t_end, count, pixels);
+    }
+    size_t end = samples.upper_bound(0, samples.size(), t_end);
+    if (end == 0) {
+        return LodView();
+    }
+    // Include the run that starts before t_start but reaches into it.
+    size_t first = samples.run_upper_bound(t_start);
+    first = first > 0 ? first - 1 : 0;
+    return LodView(&samples, first, samples.run_upper_bound(t_end), samples.at(end - 1));
+}
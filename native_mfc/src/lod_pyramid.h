@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "chunk_ring.h"
+#include "sample_ring.h"
+
+// Summary of a run of consecutive samples.
+struct LodBucket {
+    double t = 0.0;  // time of the first sample
+    int vmin = 0;
+    int vmax = 0;
+    int vfirst = 0;
+    int vlast = 0;
+};
+
+// FIFO of buckets for one pyramid level, stored as a power-of-two ring of
+// chunks that copies share copy-on-write (see ChunkRing), so copying a
+// pyramid for a snapshot is O(1).
+class LodLevel {
+public:
+    size_t size() const { return ring_.size(); }
+    bool empty() const { return ring_.size() == 0; }
+    size_t capacity() const { return capacity_; }
+
+    const LodBucket& at(size_t i) const {
+        size_t p = ring_.pos(i);
+        return ring_.chunk_at(p).buckets[p & kChunkMask];
+    }
+    LodBucket& back() {
+        size_t p = ring_.pos(size() - 1);
+        return ring_.writable(p).buckets[p & kChunkMask];
+    }
+
+    void push_back(const LodBucket& bucket);
+    void pop_front(size_t n) { ring_.pop_front(n); }
+    void clear() { ring_.clear(); }
+    void shrink_to(size_t capacity);
+
+    // First bucket whose start time is > t.
+    size_t upper_bound(double t) const;
+
+private:
+    static constexpr size_t kChunkShift = 8;
+    static constexpr size_t kChunkMask = (size_t(1) << kChunkShift) - 1;
+
+    struct Chunk {
+        LodBucket buckets[size_t(1) << kChunkShift];
+    };
+
+    void reallocate(size_t capacity);
+
+    ChunkRing<Chunk, kChunkShift> ring_;
+    size_t capacity_ = 0;
+};
+
+// Buckets [first, last) of one pyramid level; level 0 (the default) means
+// no level was coarse enough and the raw samples should be used. A view
+// over a run-length ring (level kRunLevel) has one bucket per run.
+class LodView {
+public:
+    static constexpr int kRunLevel = -1;
+
+    LodView() = default;
+    LodView(const LodLevel* buckets, int level, size_t first, size_t last)
+        : buckets_(buckets), level_(level), first_(first), last_(last > first ? last : first) {}
+    // Buckets [first, last) of a flat array, e.g. one in a mapped file.
+    LodView(const LodBucket* buckets, int level, size_t first, size_t last)
+        : flat_(buckets), level_(level), first_(first), last_(last > first ? last : first) {}
+    // Runs [first, last) of a run-length ring followed by tail, the newest
+    // sample to draw, which closes the last run's step.
+    LodView(const SampleRing* runs, size_t first, size_t last, ChannelSample tail)
+        : runs_(runs), tail_(tail), level_(kRunLevel), first_(first), last_((last > first ? last : first) + 1) {}
+
+    int level() const { return level_; }
+    size_t size() const { return last_ - first_; }
+    bool empty() const { return last_ == first_; }
+    LodBucket operator[](size_t i) const {
+        if (runs_) {
+            ChannelSample s = first_ + i + 1 < last_ ? runs_->run_front(first_ + i) : tail_;
+            return LodBucket{s.t, s.v, s.v, s.v, s.v};
+        }
+        return flat_ ? flat_[first_ + i] : buckets_->at(first_ + i);
+    }
+
+    // Step-plot points for [t_start, t_end] drawn pixels wide: buckets that
+    // land in the same pixel column are merged and each column becomes its
+    // first, min, max and last values at one x, so spikes stay visible.
+    void to_step_points(double t_start, double t_end, int pixels, std::vector<ChannelSample>* out) const;
+
+private:
+    const LodLevel* buckets_ = nullptr;
+    const LodBucket* flat_ = nullptr;
+    const SampleRing* runs_ = nullptr;
+    ChannelSample tail_;
+    int level_ = 0;
+    size_t first_ = 0;
+    size_t last_ = 0;
+};
+
+// Multi-resolution summary of one channel: level k (1..kLevels) groups
+// kFanout^k consecutive samples per bucket. Every append extends the newest
+// bucket of each level, so all levels always cover the newest sample and a
+// long window can be drawn from a coarse level at a cost that depends on the
+// plot width rather than the sample count.
+class LodPyramid {
+public:
+    static constexpr int kLevels = 3;
+    static constexpr size_t kFanout = 16;
+
+    void append(double t, int v);
+    // The newest sample's value was replaced in place. Min/max of buckets
+    // holding other samples keep the replaced value as well.
+    void set_last(int v);
+    // Drops buckets whose samples are all older than t.
+    void trim_before(double t);
+    void clear();
+
+    size_t bucket_count(int level) const;
+
+    // Coarsest level that still has at least kMinPointsPerPixel buckets per
+    // pixel for a span holding sample_count raw samples; an empty level-0
+    // view when the raw samples are already sparse enough.
+    LodView select(double t_start, double t_end, size_t sample_count, int pixels) const;
+    // The level select() picks, 0 for the raw samples.
+    static int select_level(size_t sample_count, int pixels);
+    // Buckets of a level overlapping [t_start, t_end].
+    LodView level_view(int level, double t_start, double t_end) const;
+
+    static constexpr size_t kMinPointsPerPixel = 2;
+
+private:
+    LodLevel levels_[kLevels];
+    size_t fill_[kLevels] = {};
+};
+
+// What to draw [t_start, t_end] of a channel from: its runs when the ring
+// is in run-length mode, so the cost follows transitions, otherwise
+// lod.select over the samples in the span.
+LodView select_lod_view(const SampleRing& samples, const LodPyramid& lod, double t_start, double t_end,
+                        int pixels);
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Mapping of a whole file: read-only as it was when opened, or writable
+// for a file created at a fixed size. Unmapped when the last reference
+// goes away; writes reach the file by then.
+class MappedFile {
+public:
+    static std::shared_ptr<const MappedFile> open(const std::string& path);
+    // Creates (or truncates) path with size bytes, zero-filled.
+    static std::shared_ptr<MappedFile> create(const std::string& path, uint64_t size);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* data() const { return data_; }
+    uint8_t* mutable_data() { return data_; }
+    uint64_t size() const { return size_; }
+
+private:
+    MappedFile() = default;
+
+    uint8_t* data_ = nullptr;
+    uint64_t size_ = 0;
+};
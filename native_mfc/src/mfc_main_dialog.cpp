@@ -6,6 +6,9 @@ static constexpr int READ_INTERVAL_MS = 20;
 static constexpr int HOTPLUG_SCAN_MS = 1000;
 static constexpr int UI_UPDATE_MS = 50;
 static constexpr int MAX_PENDING_LINES = 2000;
+static constexpr int STATS_INTERVAL_MS = 1000;
+static constexpr int STATS_DUMP_TICKS = 5;
+static constexpr const char* STATS_DUMP_FILE = "pipeline_stats.json";
 
 static constexpr int IDC_COMBO_PORT = 101;
 static constexpr int IDC_BTN_SCAN = 102;
@@ -24,30 +27,14 @@ static constexpr int IDC_COMBO_TIME = 206;
 
 static constexpr int IDC_CHANNEL_PANEL = 300;
 static constexpr int IDC_PLOT_VIEW = 301;
+static constexpr int IDC_HISTOGRAM_VIEW = 302;
 static constexpr int IDC_STATUS = 400;
 
 static constexpr int IDT_HOTPLUG = 1;
 static constexpr int IDT_UI = 2;
 static constexpr int IDT_AUTO = 3;
 static constexpr int IDT_STATUS = 4;
-
-static COLORREF kColorTable[] = {
-    RGB(255,  99,  71),
-    RGB( 30, 144, 255),
-    RGB( 50, 205,  50),
-    RGB(255,  20, 147),
-    RGB(138,  43, 226),
-    RGB(255, 140,   0),
-    RGB(  0, 206, 209),
-    RGB(220,  20,  60),
-};
-
-static double now_seconds() {
-    static LARGE_INTEGER freq = []{
-        LARGE_INTEGER f; QueryPerformanceFrequency(&f); return f; }();
-    LARGE_INTEGER t; QueryPerformanceCounter(&t);
-    return static_cast<double>(t.QuadPart) / static_cast<double>(freq.QuadPart);
-}
+static constexpr int IDT_STATS = 5;
 
 static COLORREF darken(COLORREF c, int delta) {
     int r = std::max(0, GetRValue(c) - delta);
@@ -74,17 +61,29 @@ BEGIN_MESSAGE_MAP(CMainDialog, CDialogEx)
     ON_BN_CLICKED(IDC_BTN_OVERLAY, &CMainDialog::OnOverlayClicked)
     ON_MESSAGE(WM_APP + 1, &CMainDialog::OnChannelChanged)
     ON_COMMAND(ID_HELP_LOGFORMAT, &CMainDialog::OnHelpLogFormat)
+    ON_COMMAND(ID_VIEW_DIAGNOSTICS, &CMainDialog::OnViewDiagnostics)
+    ON_COMMAND(ID_VIEW_SAVE_TRACE, &CMainDialog::OnViewSaveTrace)
+    ON_COMMAND(ID_VIEW_DERIVED, &CMainDialog::OnViewDerived)
+    ON_COMMAND(ID_VIEW_TRIGGERS, &CMainDialog::OnViewTriggers)
+    ON_COMMAND(ID_VIEW_REFERENCES, &CMainDialog::OnViewReferences)
+    ON_COMMAND(ID_VIEW_TRANSITIONS, &CMainDialog::OnViewTransitions)
 END_MESSAGE_MAP()
 
 CMainDialog::CMainDialog(CWnd* pParent)
     : CDialogEx(IDD_MAIN_DIALOG, pParent) {
 }
 
+void CMainDialog::set_clock(Clock* clock) {
+    clock_ = clock ? clock : &monotonic_clock();
+}
+
 BOOL CMainDialog::OnInitDialog() {
     CDialogEx::OnInitDialog();
     build_ui();
     SetTimer(IDT_HOTPLUG, HOTPLUG_SCAN_MS, nullptr);
     SetTimer(IDT_UI, UI_UPDATE_MS, nullptr);
+    SetTimer(IDT_STATS, STATS_INTERVAL_MS, nullptr);
+    stats_.reset(clock_->now());
     scan_ports();
 
     CMenu menu;
@@ -192,13 +191,28 @@ void CMainDialog::build_ui() {
     ::SendMessageW(combo_time_, CB_ADDSTRING, 0, reinterpret_cast<LPARAM>(L"10"));
     ::SendMessageW(combo_time_, CB_ADDSTRING, 0, reinterpret_cast<LPARAM>(L"30"));
     ::SendMessageW(combo_time_, CB_ADDSTRING, 0, reinterpret_cast<LPARAM>(L"60"));
+    ::SendMessageW(combo_time_, CB_ADDSTRING, 0, reinterpret_cast<LPARAM>(L"300"));
+    ::SendMessageW(combo_time_, CB_ADDSTRING, 0, reinterpret_cast<LPARAM>(L"900"));
+    ::SendMessageW(combo_time_, CB_ADDSTRING, 0, reinterpret_cast<LPARAM>(L"3600"));
     ::SendMessageW(combo_time_, CB_SETCURSEL, 2, 0);
     model_.set_time_window(30.0);
     plot_view_.set_time_window(30.0);
 
+    // History past the in-memory budget goes to segment files in %TEMP%.
+    char temp_dir[MAX_PATH] = {};
+    if (::GetTempPathA(MAX_PATH, temp_dir) > 0) {
+        std::string spill_error;
+        if (!model_.enable_spill(std::string(temp_dir) + "SimpleComChart", &spill_error)) {
+            log_line(L"History spill disabled: " + std::wstring(spill_error.begin(), spill_error.end()));
+        }
+    }
+
     channel_panel_.create(m_hWnd, 0, 0, 300, 300, IDC_CHANNEL_PANEL);
     plot_view_.create(m_hWnd, 0, 0, 300, 300, IDC_PLOT_VIEW);
+    histogram_view_.create(m_hWnd, 0, 0, 300, 160, IDC_HISTOGRAM_VIEW);
     plot_view_.set_model(&model_);
+    plot_view_.set_stats(&stats_);
+    plot_view_.set_clock(clock_);
 
     LOGFONTW lf = {};
     SystemParametersInfoW(SPI_GETICONTITLELOGFONT, sizeof(lf), &lf, 0);
@@ -253,9 +267,12 @@ void CMainDialog::layout_ui(int w, int h) {
 
     int main_top = bottom_y + bottom_h + padding;
     int main_h = h - main_top - status_h - padding;
-    int left_w = 360;
+    // Wide enough for the statistics columns, but never more than a third.
+    int left_w = std::max(360, std::min(600, w / 3));
 
-    ::MoveWindow(channel_panel_.hwnd(), padding, main_top, left_w, main_h, TRUE);
+    int histogram_h = std::min(180, main_h / 3);
+    ::MoveWindow(channel_panel_.hwnd(), padding, main_top, left_w, main_h - histogram_h - padding, TRUE);
+    ::MoveWindow(histogram_view_.hwnd(), padding, main_top + main_h - histogram_h, left_w, histogram_h, TRUE);
     ::MoveWindow(plot_view_.hwnd(), padding + left_w + padding, main_top,
         w - left_w - (3 * padding), main_h, TRUE);
 
@@ -273,7 +290,7 @@ void CMainDialog::OnSize(UINT nType, int cx, int cy) {
         is_minimized_ = false;
         flush_pending_lines();
         if (!snapshot_) {
-            plot_view_.update_from_model(now_seconds());
+            plot_view_.update_from_model(clock_->now());
         } else {
             ::InvalidateRect(plot_view_.hwnd(), nullptr, FALSE);
         }
@@ -292,7 +309,9 @@ void CMainDialog::start_serial_thread() {
     serial_thread_ = std::thread([this]() {
         while (serial_running_) {
             std::wstring error;
-            auto lines = serial_mgr_.read_lines(&error);
+            size_t bytes_read = 0;
+            auto lines = serial_mgr_.read_lines(&error, &bytes_read);
+            stats_.add(PipelineCounter::kBytesRead, bytes_read);
             if (!error.empty()) {
                 {
                     std::lock_guard<std::mutex> lock(error_mutex_);
@@ -302,7 +321,8 @@ void CMainDialog::start_serial_thread() {
                 break;
             }
             if (!lines.empty()) {
-                double ts = now_seconds();
+                double ts = clock_->now();
+                stats_.add(PipelineCounter::kLinesFramed, lines.size());
                 std::lock_guard<std::mutex> lock(pending_mutex_);
                 for (const auto& line : lines) {
                     pending_.lines.push_back(PendingData::Item{line, ts});
@@ -311,6 +331,7 @@ void CMainDialog::start_serial_thread() {
                     size_t overflow = pending_.lines.size() - MAX_PENDING_LINES;
                     pending_.lines.erase(pending_.lines.begin(), pending_.lines.begin() + overflow);
                     pending_dropped_ += static_cast<int>(overflow);
+                    stats_.add(PipelineCounter::kDroppedLines, overflow);
                 }
             }
             std::this_thread::sleep_for(std::chrono::milliseconds(READ_INTERVAL_MS));
@@ -442,12 +463,14 @@ bool CMainDialog::connect_with_validation() {
     }
 
     model_.reset();
+    stats_.reset(clock_->now());
     wchar_t time_buf[8] = {};
     ::GetWindowTextW(combo_time_, time_buf, 7);
     double time_window = _wtof(time_buf);
     model_.set_time_window(time_window);
     plot_view_.reset_visual();
     channel_panel_.reset();
+    synced_channels_ = 0;
 
     start_serial_thread();
 
@@ -499,6 +522,7 @@ void CMainDialog::disconnect() {
 }
 
 void CMainDialog::flush_pending_lines() {
+    SCC_TRACE_SCOPE("flush_pending_lines");
     if (serial_error_pending_) {
         serial_error_pending_ = false;
         std::wstring err;
@@ -531,21 +555,38 @@ void CMainDialog::flush_pending_lines() {
     if (pending.lines.empty()) {
         return;
     }
+    SCC_TRACE_COUNTER("pending_lines", pending.lines.size());
 
     double now = 0.0;
+    double oldest_read_ts = 0.0;
     for (const auto& item : pending.lines) {
+        double parse_start = clock_->now();
+        if (item.ts > 0.0) {
+            stats_.record(PipelineLatency::kReadToParse, parse_start - item.ts);
+        }
         auto kv = log_parser::parse_kv_log(item.line);
+        double parse_end = clock_->now();
+        stats_.record(PipelineLatency::kParse, parse_end - parse_start);
         if (!kv.empty()) {
-            double ts = item.ts > 0.0 ? item.ts : now_seconds();
-            model_.update_from_kv(kv, ts);
+            stats_.add(PipelineCounter::kLinesParsed);
+            double ts = item.ts > 0.0 ? item.ts : parse_end;
+            int stored = model_.update_from_kv(kv, ts);
+            stats_.record(PipelineLatency::kIngest, clock_->now() - parse_end);
+            stats_.add(PipelineCounter::kSamplesIngested, static_cast<uint64_t>(stored));
             if (ts > now) {
                 now = ts;
             }
+            if (oldest_read_ts <= 0.0 || ts < oldest_read_ts) {
+                oldest_read_ts = ts;
+            }
         }
     }
+    if (oldest_read_ts > 0.0) {
+        stats_.mark_ingested(oldest_read_ts, clock_->now());
+    }
 
     if (now <= 0.0) {
-        now = now_seconds();
+        now = clock_->now();
     }
 
     model_.prune(now);
@@ -556,22 +597,52 @@ void CMainDialog::flush_pending_lines() {
     }
 
     std::unordered_map<std::string, int> latest;
+    std::unordered_map<std::string, ChannelStats> window_stats;
     for (const auto& key : model_.get_keys()) {
-        auto series = model_.get_series(key);
-        if (!series.empty()) {
-            latest[key] = series.back().v;
+        ChannelSample last;
+        if (model_.get_last_sample(key, &last)) {
+            latest[key] = last.v;
+        }
+        ChannelStats stats;
+        if (model_.get_channel_stats(key, &stats, nullptr)) {
+            window_stats[key] = stats;
         }
     }
     channel_panel_.update_values(latest);
+    channel_panel_.update_stats(window_stats);
+
+    // Distribution of the selected channel, or the first one with data.
+    std::string histogram_key = channel_panel_.get_selected_key();
+    const auto& with_data = model_.get_enabled_keys_with_data();
+    if (histogram_key.empty() && !with_data.empty()) {
+        histogram_key = with_data.front();
+    }
+    if (!model_.get_value_histogram(histogram_key, &histogram_, nullptr)) {
+        histogram_key.clear();
+    }
+    histogram_view_.set_histogram(histogram_key, histogram_);
 
     set_right_status(L"Samples: " + std::to_wstring(model_.get_total_samples()) + L" | CH: " + std::to_wstring(model_.get_enabled_count()));
 
+    int evicted = model_.consume_evicted_samples();
+    if (evicted > 0) {
+        stats_.add(PipelineCounter::kEvictedSamples, static_cast<uint64_t>(evicted));
+    }
+
     int dropped_keys = model_.consume_dropped_keys();
     if (dropped_keys > 0) {
-        show_status_message(L"Channel limit reached (max 16), ignored new keys", 5000);
+        stats_.add(PipelineCounter::kDroppedKeys, static_cast<uint64_t>(dropped_keys));
+        show_status_message(L"Channel limit reached (max " + std::to_wstring(ChannelModel::kMaxChannels) +
+                            L"), ignored new keys", 5000);
         log_line(L"Channel limit reached, ignored new keys");
     }
 
+    if (model_.get_capture_seq() != captures_seen_) {
+        captures_seen_ = model_.get_capture_seq();
+        show_status_message(L"Trigger capture #" + std::to_wstring(captures_seen_) + L" (View > Triggers...)", 3000);
+        log_line(L"Trigger capture #" + std::to_wstring(captures_seen_));
+    }
+
     if (dropped_lines > 0) {
         show_status_message(L"Input overrun: dropped lines", 3000);
         log_line(L"Input overrun: dropped lines");
@@ -579,26 +650,61 @@ void CMainDialog::flush_pending_lines() {
 
     int rx_overflow = serial_mgr_.consume_rx_overflow();
     if (rx_overflow > 0) {
+        stats_.add(PipelineCounter::kDroppedBytes, static_cast<uint64_t>(rx_overflow));
         show_status_message(L"Input overflow: dropped bytes", 3000);
         log_line(L"Input overflow: dropped bytes");
     }
 }
 
 void CMainDialog::sync_channels() {
-    auto keys = model_.get_keys();
-    for (size_t i = 0; i < keys.size(); ++i) {
+    // Keys are only ever appended, so only the new tail needs a panel row.
+    const auto& keys = model_.get_keys();
+    if (keys.size() < synced_channels_) {
+        synced_channels_ = 0;
+    }
+    if (keys.size() == synced_channels_) {
+        return;
+    }
+    for (size_t i = synced_channels_; i < keys.size(); ++i) {
         const auto& key = keys[i];
-        COLORREF color = kColorTable[i % (sizeof(kColorTable) / sizeof(kColorTable[0]))];
+        uint32_t rgb = channel_color(i);
+        COLORREF color = RGB((rgb >> 16) & 0xFF, (rgb >> 8) & 0xFF, rgb & 0xFF);
         channel_panel_.ensure_channel(key, model_.is_enabled(key), color);
     }
+    synced_channels_ = keys.size();
     channel_panel_.update_count(static_cast<int>(keys.size()));
+}
 
+void CMainDialog::apply_channel_selection() {
     auto state_map = channel_panel_.get_checkbox_state_map();
     for (const auto& kv : state_map) {
         model_.set_enabled(kv.first, kv.second);
     }
 }
 
+void CMainDialog::update_pipeline_stats() {
+    auto snap = stats_.take_snapshot(clock_->now());
+
+    if (diagnostics_visible_) {
+        std::vector<std::wstring> lines;
+        for (const auto& line : PipelineStats::format_summary(snap)) {
+            lines.emplace_back(line.begin(), line.end());
+        }
+        plot_view_.set_diagnostics(lines);
+    }
+
+    stats_ticks_++;
+    if (stats_ticks_ >= STATS_DUMP_TICKS) {
+        stats_ticks_ = 0;
+        if (serial_mgr_.is_connected()) {
+            std::ofstream f(STATS_DUMP_FILE, std::ios::trunc);
+            if (f) {
+                f << PipelineStats::to_json(snap);
+            }
+        }
+    }
+}
+
 void CMainDialog::set_left_status(const std::wstring& text) {
     left_status_ = text;
     if (!flash_active_) {
@@ -740,6 +846,8 @@ void CMainDialog::OnTimer(UINT_PTR nIDEvent) {
         }
     } else if (nIDEvent == IDT_UI) {
         flush_pending_lines();
+    } else if (nIDEvent == IDT_STATS) {
+        update_pipeline_stats();
     } else if (nIDEvent == IDT_AUTO) {
         ::SendMessageW(m_hWnd, WM_COMMAND, IDC_BTN_REFRESH, 0);
     } else if (nIDEvent == IDT_STATUS) {
@@ -755,6 +863,24 @@ BOOL CMainDialog::OnCommand(WPARAM wParam, LPARAM lParam) {
     case ID_HELP_LOGFORMAT:
         OnHelpLogFormat();
         return TRUE;
+    case ID_VIEW_DIAGNOSTICS:
+        OnViewDiagnostics();
+        return TRUE;
+    case ID_VIEW_SAVE_TRACE:
+        OnViewSaveTrace();
+        return TRUE;
+    case ID_VIEW_DERIVED:
+        OnViewDerived();
+        return TRUE;
+    case ID_VIEW_TRIGGERS:
+        OnViewTriggers();
+        return TRUE;
+    case ID_VIEW_REFERENCES:
+        OnViewReferences();
+        return TRUE;
+    case ID_VIEW_TRANSITIONS:
+        OnViewTransitions();
+        return TRUE;
     case IDC_BTN_SCAN:
         if (HIWORD(wParam) != BN_CLICKED) {
             return TRUE;
@@ -774,7 +900,7 @@ BOOL CMainDialog::OnCommand(WPARAM wParam, LPARAM lParam) {
         model_.reset_samples();
         plot_view_.reset_visual();
         if (!snapshot_) {
-            plot_view_.update_from_model(now_seconds());
+            plot_view_.update_from_model(clock_->now());
         }
         channel_panel_.update_values({});
         set_right_status(L"Samples: 0 | CH: " + std::to_wstring(model_.get_enabled_count()));
@@ -810,8 +936,8 @@ BOOL CMainDialog::OnCommand(WPARAM wParam, LPARAM lParam) {
             model_.set_time_window(sec);
             if (!snapshot_) {
                 plot_view_.set_time_window(sec);
-                model_.prune(now_seconds());
-                plot_view_.update_from_model(now_seconds());
+                model_.prune(clock_->now());
+                plot_view_.update_from_model(clock_->now());
             }
         }
         return TRUE;
@@ -839,9 +965,10 @@ void CMainDialog::OnMouseLeave() {
 
 LRESULT CMainDialog::OnChannelChanged(WPARAM, LPARAM) {
     sync_channels();
-    plot_view_.request_temporary_fit(now_seconds(), 0.5);
+    apply_channel_selection();
+    plot_view_.request_temporary_fit(clock_->now(), 0.5);
     if (!snapshot_) {
-        plot_view_.update_from_model(now_seconds());
+        plot_view_.update_from_model(clock_->now());
     }
     return 0;
 }
@@ -850,6 +977,78 @@ void CMainDialog::OnHelpLogFormat() {
     help_dialog_.show(m_hWnd);
 }
 
+void CMainDialog::OnViewDiagnostics() {
+    diagnostics_visible_ = !diagnostics_visible_;
+    CMenu* menu = GetMenu();
+    if (menu) {
+        menu->CheckMenuItem(ID_VIEW_DIAGNOSTICS, MF_BYCOMMAND | (diagnostics_visible_ ? MF_CHECKED : MF_UNCHECKED));
+    }
+    plot_view_.set_diagnostics_visible(diagnostics_visible_);
+    if (diagnostics_visible_) {
+        update_pipeline_stats();
+    }
+}
+
+void CMainDialog::OnViewSaveTrace() {
+    if (!trace::enabled()) {
+        show_status_message(L"Tracing not compiled in (SCC_ENABLE_TRACE=OFF)", 3000);
+        return;
+    }
+    CFileDialog dlg(FALSE, L"json", L"trace.json", OFN_OVERWRITEPROMPT | OFN_PATHMUSTEXIST,
+                    L"Chrome Trace (*.json)|*.json||", this);
+    if (dlg.DoModal() != IDOK) {
+        return;
+    }
+    std::wstring path = dlg.GetPathName().GetString();
+    std::ofstream f(path.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!f) {
+        show_status_message(L"Trace save failed", 3000);
+        log_line(L"Trace save failed: " + path);
+        return;
+    }
+    f << trace::dump_chrome_json();
+    show_status_message(L"Trace saved", 2000);
+    log_line(L"Trace saved: " + path);
+}
+
+void CMainDialog::OnViewDerived() {
+    derived_dialog_.show(m_hWnd, &model_);
+}
+
+void CMainDialog::OnViewTriggers() {
+    trigger_dialog_.show(m_hWnd, &model_, [this](const TriggerCapture& capture) {
+        snapshot_ = true;
+        ::SendMessageW(btn_snapshot_, BM_SETCHECK, BST_CHECKED, 0);
+        ::SetWindowTextW(btn_snapshot_, L"Live");
+        ::InvalidateRect(btn_snapshot_, nullptr, TRUE);
+        plot_view_.show_capture(capture);
+    });
+}
+
+void CMainDialog::OnViewReferences() {
+    reference_dialog_.show(m_hWnd, references_, [this](ReferenceDialog::References references) {
+        references_ = std::move(references);
+        plot_view_.set_references(references_);
+        log_line(L"Reference traces: " + std::to_wstring(references_.size()));
+    });
+}
+
+void CMainDialog::OnViewTransitions() {
+    transition_dialog_.show(m_hWnd, &model_, [this](const std::string& key, const Transition& transition) {
+        // Centre one plot window on the change and show it like a trigger capture.
+        double half = model_.get_time_window() / 2.0;
+        TriggerCapture capture;
+        model_.capture_range(transition.t - half, transition.t + half, &capture);
+        capture.t = transition.t;
+        capture.trigger = key + " " + std::to_string(transition.from) + " -> " + std::to_string(transition.to);
+        snapshot_ = true;
+        ::SendMessageW(btn_snapshot_, BM_SETCHECK, BST_CHECKED, 0);
+        ::SetWindowTextW(btn_snapshot_, L"Live");
+        ::InvalidateRect(btn_snapshot_, nullptr, TRUE);
+        plot_view_.show_capture(capture);
+    });
+}
+
 void CMainDialog::OnSnapshotClicked() {
     bool checked = ::SendMessageW(btn_snapshot_, BM_GETCHECK, 0, 0) == BST_CHECKED;
     if (checked == snapshot_) {
@@ -863,7 +1062,7 @@ void CMainDialog::OnSnapshotClicked() {
         ::SetWindowTextW(btn_snapshot_, L"Live");
     } else {
         ::SetWindowTextW(btn_snapshot_, L"Snapshot");
-        plot_view_.update_from_model(now_seconds());
+        plot_view_.update_from_model(clock_->now());
     }
     ::InvalidateRect(btn_snapshot_, nullptr, TRUE);
 }
@@ -879,7 +1078,7 @@ void CMainDialog::OnOverlayClicked() {
 
     plot_view_.set_overlay_enabled(overlay_enabled_);
     if (overlay_enabled_ && !snapshot_) {
-        plot_view_.update_from_model(now_seconds());
+        plot_view_.update_from_model(clock_->now());
     } else {
         ::InvalidateRect(plot_view_.hwnd(), nullptr, FALSE);
     }
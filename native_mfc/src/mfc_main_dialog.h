@@ -22,10 +22,19 @@
 
 #include "serial_manager.h"
 #include "log_parser.h"
+#include "channel_colors.h"
 #include "channel_model.h"
+#include "clock.h"
+#include "pipeline_stats.h"
+#include "trace.h"
 #include "plot_view.h"
 #include "channel_panel.h"
+#include "histogram_view.h"
+#include "derived_dialog.h"
 #include "help_dialog.h"
+#include "reference_dialog.h"
+#include "transition_dialog.h"
+#include "trigger_dialog.h"
 
 #include "resource.h"
 
@@ -41,6 +50,10 @@ class CMainDialog : public CDialogEx {
 public:
     explicit CMainDialog(CWnd* pParent = nullptr);
 
+    // Replaces the time source for capture timestamps, pruning, fit timing and
+    // stats. Call before the dialog is created.
+    void set_clock(Clock* clock);
+
 protected:
     DECLARE_MESSAGE_MAP()
 
@@ -57,6 +70,12 @@ protected:
     afx_msg void OnMouseLeave();
     afx_msg LRESULT OnChannelChanged(WPARAM wParam, LPARAM lParam);
     afx_msg void OnHelpLogFormat();
+    afx_msg void OnViewDiagnostics();
+    afx_msg void OnViewSaveTrace();
+    afx_msg void OnViewDerived();
+    afx_msg void OnViewTriggers();
+    afx_msg void OnViewReferences();
+    afx_msg void OnViewTransitions();
     afx_msg void OnSnapshotClicked();
     afx_msg void OnOverlayClicked();
 
@@ -76,6 +95,8 @@ private:
 
     void flush_pending_lines();
     void sync_channels();
+    void apply_channel_selection();
+    void update_pipeline_stats();
 
     void set_left_status(const std::wstring& text);
     void set_right_status(const std::wstring& text);
@@ -112,16 +133,30 @@ private:
 
     ChannelPanel channel_panel_;
     PlotView plot_view_;
+    HistogramView histogram_view_;
+    // Reused every UI tick for the histogram view.
+    ValueHistogram histogram_;
     HelpDialog help_dialog_;
+    DerivedDialog derived_dialog_;
+    TriggerDialog trigger_dialog_;
+    ReferenceDialog reference_dialog_;
+    ReferenceDialog::References references_;
+    TransitionDialog transition_dialog_;
+    uint64_t captures_seen_ = 0;
 
     SerialManager serial_mgr_;
     ChannelModel model_;
+    PipelineStats stats_;
+    Clock* clock_ = &monotonic_clock();
 
     std::vector<SerialPortInfo> known_ports_;
 
     bool snapshot_ = false;
     bool overlay_enabled_ = true;
     bool is_minimized_ = false;
+    bool diagnostics_visible_ = false;
+    int stats_ticks_ = 0;
+    size_t synced_channels_ = 0;
 
     std::mutex pending_mutex_;
     PendingData pending_;
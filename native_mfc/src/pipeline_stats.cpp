@@ -0,0 +1,285 @@
+#include "pipeline_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+int highest_bit(uint64_t v) {
+#ifdef _MSC_VER
+    unsigned long index = 0;
+    _BitScanReverse64(&index, v);
+    return static_cast<int>(index);
+#else
+    return 63 - __builtin_clzll(v);
+#endif
+}
+
+std::string format_duration(double seconds) {
+    char buf[32] = {};
+    if (seconds < 1e-6) {
+        std::snprintf(buf, sizeof(buf), "%.0fns", seconds * 1e9);
+    } else if (seconds < 1e-3) {
+        std::snprintf(buf, sizeof(buf), "%.1fus", seconds * 1e6);
+    } else if (seconds < 1.0) {
+        std::snprintf(buf, sizeof(buf), "%.1fms", seconds * 1e3);
+    } else {
+        std::snprintf(buf, sizeof(buf), "%.2fs", seconds);
+    }
+    return buf;
+}
+
+std::string format_rate(double per_sec) {
+    char buf[32] = {};
+    if (per_sec >= 1e6) {
+        std::snprintf(buf, sizeof(buf), "%.2fM/s", per_sec / 1e6);
+    } else if (per_sec >= 1e4) {
+        std::snprintf(buf, sizeof(buf), "%.1fk/s", per_sec / 1e3);
+    } else {
+        std::snprintf(buf, sizeof(buf), "%.0f/s", per_sec);
+    }
+    return buf;
+}
+
+std::string format_latency(const LatencyHistogram::Summary& s) {
+    if (s.count == 0) {
+        return "--";
+    }
+    return "p50 " + format_duration(s.p50) + " p99 " + format_duration(s.p99) +
+        " max " + format_duration(s.max);
+}
+} // namespace
+
+LatencyHistogram::LatencyHistogram() {
+    for (auto& bucket : buckets_) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+int LatencyHistogram::bucket_index(uint64_t ns) {
+    if (ns < static_cast<uint64_t>(kSubBuckets)) {
+        return static_cast<int>(ns);
+    }
+    int shift = highest_bit(ns) - kSubBucketBits;
+    int sub = static_cast<int>((ns >> shift) & (kSubBuckets - 1));
+    return (shift + 1) * kSubBuckets + sub;
+}
+
+double LatencyHistogram::bucket_mid_ns(int index) {
+    if (index < kSubBuckets) {
+        return static_cast<double>(index);
+    }
+    int shift = index / kSubBuckets - 1;
+    int sub = index % kSubBuckets;
+    double lo = std::ldexp(static_cast<double>(kSubBuckets + sub), shift);
+    double width = std::ldexp(1.0, shift);
+    return lo + width * 0.5;
+}
+
+void LatencyHistogram::record(double seconds) {
+    if (!(seconds >= 0.0)) {
+        seconds = 0.0;
+    }
+    uint64_t ns = static_cast<uint64_t>(std::min(seconds, 1.0e9) * 1e9);
+    buckets_[bucket_index(ns)].fetch_add(1, std::memory_order_relaxed);
+    sum_ns_.fetch_add(ns, std::memory_order_relaxed);
+
+    uint64_t prev = max_ns_.load(std::memory_order_relaxed);
+    while (ns > prev && !max_ns_.compare_exchange_weak(prev, ns, std::memory_order_relaxed)) {
+    }
+}
+
+LatencyHistogram::Summary LatencyHistogram::drain() {
+    uint64_t counts[kBuckets];
+    uint64_t total = 0;
+    for (int i = 0; i < kBuckets; ++i) {
+        counts[i] = buckets_[i].exchange(0, std::memory_order_relaxed);
+        total += counts[i];
+    }
+    uint64_t sum = sum_ns_.exchange(0, std::memory_order_relaxed);
+    uint64_t max = max_ns_.exchange(0, std::memory_order_relaxed);
+
+    Summary s;
+    if (total == 0) {
+        return s;
+    }
+    s.count = total;
+    s.mean = static_cast<double>(sum) / static_cast<double>(total) * 1e-9;
+    s.max = static_cast<double>(max) * 1e-9;
+
+    const double targets[3] = {0.50, 0.90, 0.99};
+    double* outputs[3] = {&s.p50, &s.p90, &s.p99};
+    int next = 0;
+    uint64_t seen = 0;
+    for (int i = 0; i < kBuckets && next < 3; ++i) {
+        seen += counts[i];
+        while (next < 3 && static_cast<double>(seen) >= targets[next] * static_cast<double>(total)) {
+            *outputs[next] = std::min(bucket_mid_ns(i), static_cast<double>(max)) * 1e-9;
+            next++;
+        }
+    }
+    return s;
+}
+
+const char* PipelineStats::counter_name(PipelineCounter counter) {
+    switch (counter) {
+    case PipelineCounter::kBytesRead: return "bytes_read";
+    case PipelineCounter::kLinesFramed: return "lines_framed";
+    case PipelineCounter::kLinesParsed: return "lines_parsed";
+    case PipelineCounter::kSamplesIngested: return "samples_ingested";
+    case PipelineCounter::kFramesPainted: return "frames_painted";
+    case PipelineCounter::kDroppedBytes: return "dropped_bytes";
+    case PipelineCounter::kDroppedLines: return "dropped_lines";
+    case PipelineCounter::kDroppedKeys: return "dropped_keys";
+    case PipelineCounter::kEvictedSamples: return "evicted_samples";
+    default: return "unknown";
+    }
+}
+
+const char* PipelineStats::latency_name(PipelineLatency latency) {
+    switch (latency) {
+    case PipelineLatency::kReadToParse: return "read_to_parse";
+    case PipelineLatency::kParse: return "parse";
+    case PipelineLatency::kIngest: return "ingest";
+    case PipelineLatency::kIngestToPaint: return "ingest_to_paint";
+    case PipelineLatency::kPaint: return "paint";
+    case PipelineLatency::kReadToPaint: return "read_to_paint";
+    default: return "unknown";
+    }
+}
+
+PipelineStats::PipelineStats(double start_ts) {
+    for (auto& counter : counters_) {
+        counter.store(0, std::memory_order_relaxed);
+    }
+    start_ts_ = start_ts;
+    last_snapshot_ts_ = start_ts;
+}
+
+void PipelineStats::reset(double start_ts) {
+    for (auto& counter : counters_) {
+        counter.store(0, std::memory_order_relaxed);
+    }
+    for (auto& histogram : histograms_) {
+        histogram.drain();
+    }
+    for (auto& total : last_totals_) {
+        total = 0;
+    }
+    start_ts_ = start_ts;
+    last_snapshot_ts_ = start_ts;
+    oldest_unpainted_read_ts_ = 0.0;
+    first_unpainted_ingest_ts_ = 0.0;
+}
+
+void PipelineStats::mark_ingested(double read_ts, double ingest_ts) {
+    if (oldest_unpainted_read_ts_ <= 0.0 || read_ts < oldest_unpainted_read_ts_) {
+        oldest_unpainted_read_ts_ = read_ts;
+    }
+    if (first_unpainted_ingest_ts_ <= 0.0) {
+        first_unpainted_ingest_ts_ = ingest_ts;
+    }
+}
+
+void PipelineStats::mark_painted(double paint_start, double paint_end) {
+    add(PipelineCounter::kFramesPainted);
+    record(PipelineLatency::kPaint, paint_end - paint_start);
+    if (first_unpainted_ingest_ts_ > 0.0) {
+        record(PipelineLatency::kIngestToPaint, paint_end - first_unpainted_ingest_ts_);
+    }
+    if (oldest_unpainted_read_ts_ > 0.0) {
+        record(PipelineLatency::kReadToPaint, paint_end - oldest_unpainted_read_ts_);
+    }
+    oldest_unpainted_read_ts_ = 0.0;
+    first_unpainted_ingest_ts_ = 0.0;
+}
+
+PipelineStatsSnapshot PipelineStats::take_snapshot(double now) {
+    PipelineStatsSnapshot snap;
+    snap.uptime = now - start_ts_;
+    snap.interval = now - last_snapshot_ts_;
+    double dt = snap.interval > 0.0 ? snap.interval : 0.0;
+
+    for (int i = 0; i < kCounters; ++i) {
+        snap.totals[i] = counters_[i].load(std::memory_order_relaxed);
+        uint64_t delta = snap.totals[i] - last_totals_[i];
+        snap.rates[i] = dt > 0.0 ? static_cast<double>(delta) / dt : 0.0;
+        last_totals_[i] = snap.totals[i];
+    }
+    for (int i = 0; i < kLatencies; ++i) {
+        snap.latency[i] = histograms_[i].drain();
+    }
+    last_snapshot_ts_ = now;
+    return snap;
+}
+
+std::string PipelineStats::to_json(const PipelineStatsSnapshot& snap) {
+    std::string out;
+    char buf[160] = {};
+
+    std::snprintf(buf, sizeof(buf), "{\n  \"uptime_s\": %.3f,\n  \"interval_s\": %.3f,\n  \"counters\": {\n",
+                  snap.uptime, snap.interval);
+    out += buf;
+    for (int i = 0; i < kCounters; ++i) {
+        std::snprintf(buf, sizeof(buf), "    \"%s\": {\"total\": %llu, \"per_sec\": %.1f}%s\n",
+                      counter_name(static_cast<PipelineCounter>(i)),
+                      static_cast<unsigned long long>(snap.totals[i]), snap.rates[i],
+                      (i + 1 < kCounters) ? "," : "");
+        out += buf;
+    }
+    out += "  },\n  \"latency_us\": {\n";
+    for (int i = 0; i < kLatencies; ++i) {
+        const auto& s = snap.latency[i];
+        std::snprintf(buf, sizeof(buf),
+                      "    \"%s\": {\"count\": %llu, \"mean\": %.2f, \"p50\": %.2f, \"p90\": %.2f, \"p99\": %.2f, \"max\": %.2f}%s\n",
+                      latency_name(static_cast<PipelineLatency>(i)),
+                      static_cast<unsigned long long>(s.count),
+                      s.mean * 1e6, s.p50 * 1e6, s.p90 * 1e6, s.p99 * 1e6, s.max * 1e6,
+                      (i + 1 < kLatencies) ? "," : "");
+        out += buf;
+    }
+    out += "  }\n}\n";
+    return out;
+}
+
+std::vector<std::string> PipelineStats::format_summary(const PipelineStatsSnapshot& snap) {
+    auto rate = [&](PipelineCounter c) {
+        return snap.rates[static_cast<int>(c)];
+    };
+    auto total = [&](PipelineCounter c) {
+        return static_cast<unsigned long long>(snap.totals[static_cast<int>(c)]);
+    };
+    auto latency = [&](PipelineLatency l) -> const LatencyHistogram::Summary& {
+        return snap.latency[static_cast<int>(l)];
+    };
+
+    std::vector<std::string> lines;
+    char buf[128] = {};
+
+    std::snprintf(buf, sizeof(buf), "read   %.1f KB/s  framed %s",
+                  rate(PipelineCounter::kBytesRead) / 1024.0,
+                  format_rate(rate(PipelineCounter::kLinesFramed)).c_str());
+    lines.push_back(buf);
+    lines.push_back("queue  " + format_latency(latency(PipelineLatency::kReadToParse)));
+    lines.push_back("parse  " + format_rate(rate(PipelineCounter::kLinesParsed)) + "  " +
+                    format_latency(latency(PipelineLatency::kParse)));
+    lines.push_back("ingest " + format_rate(rate(PipelineCounter::kSamplesIngested)) + "  " +
+                    format_latency(latency(PipelineLatency::kIngest)));
+    if (snap.totals[static_cast<int>(PipelineCounter::kFramesPainted)] > 0) {
+        lines.push_back("paint  " + format_rate(rate(PipelineCounter::kFramesPainted)) + "  " +
+                        format_latency(latency(PipelineLatency::kPaint)));
+        lines.push_back("i->p   " + format_latency(latency(PipelineLatency::kIngestToPaint)));
+        lines.push_back("e2e    " + format_latency(latency(PipelineLatency::kReadToPaint)));
+    }
+    std::snprintf(buf, sizeof(buf), "drops  bytes %llu  lines %llu  keys %llu  evicted %llu",
+                  total(PipelineCounter::kDroppedBytes),
+                  total(PipelineCounter::kDroppedLines),
+                  total(PipelineCounter::kDroppedKeys),
+                  total(PipelineCounter::kEvictedSamples));
+    lines.push_back(buf);
+    return lines;
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Lock-free log-linear latency histogram (HDR style). Values are recorded in
+// nanoseconds into 16 linear sub-buckets per power of two, which bounds the
+// relative error of any reported percentile to about 6%. Recording is a
+// couple of relaxed atomic adds and may happen from any thread.
+class LatencyHistogram {
+public:
+    struct Summary {
+        uint64_t count = 0;
+        double mean = 0.0;
+        double p50 = 0.0;
+        double p90 = 0.0;
+        double p99 = 0.0;
+        double max = 0.0;
+    };
+
+    LatencyHistogram();
+
+    void record(double seconds);
+
+    // Summarizes everything recorded since the previous drain and clears the
+    // buckets. All reported values are in seconds.
+    Summary drain();
+
+private:
+    static constexpr int kSubBucketBits = 4;
+    static constexpr int kSubBuckets = 1 << kSubBucketBits;
+    static constexpr int kBuckets = (64 - kSubBucketBits + 1) * kSubBuckets;
+
+    static int bucket_index(uint64_t ns);
+    static double bucket_mid_ns(int index);
+
+    std::atomic<uint64_t> buckets_[kBuckets];
+    std::atomic<uint64_t> sum_ns_{0};
+    std::atomic<uint64_t> max_ns_{0};
+};
+
+enum class PipelineCounter {
+    kBytesRead,
+    kLinesFramed,
+    kLinesParsed,
+    kSamplesIngested,
+    kFramesPainted,
+    kDroppedBytes,
+    kDroppedLines,
+    kDroppedKeys,
+    kEvictedSamples,
+    kCount,
+};
+
+enum class PipelineLatency {
+    kReadToParse,   // line received -> parse started (pending queue wait)
+    kParse,         // parse_kv_log per line
+    kIngest,        // ChannelModel::update_from_kv per line
+    kIngestToPaint, // first ingest after a paint -> next paint finished
+    kPaint,         // PlotView paint duration
+    kReadToPaint,   // oldest unpainted line received -> paint finished
+    kCount,
+};
+
+struct PipelineStatsSnapshot {
+    static constexpr int kCounters = static_cast<int>(PipelineCounter::kCount);
+    static constexpr int kLatencies = static_cast<int>(PipelineLatency::kCount);
+
+    double uptime = 0.0;
+    double interval = 0.0;
+    uint64_t totals[kCounters] = {};
+    double rates[kCounters] = {};
+    LatencyHistogram::Summary latency[kLatencies];
+};
+
+// Always-on per-stage counters and latency histograms for the
+// read -> frame -> parse -> ingest -> paint pipeline. Counters and
+// histograms are safe to update from the capture thread and the UI thread;
+// mark_ingested/mark_painted and take_snapshot belong to the thread that
+// owns the model and the plot.
+class PipelineStats {
+public:
+    static const char* counter_name(PipelineCounter counter);
+    static const char* latency_name(PipelineLatency latency);
+
+    explicit PipelineStats(double start_ts = 0.0);
+
+    void reset(double start_ts);
+
+    void add(PipelineCounter counter, uint64_t n = 1) {
+        counters_[static_cast<int>(counter)].fetch_add(n, std::memory_order_relaxed);
+    }
+    uint64_t get(PipelineCounter counter) const {
+        return counters_[static_cast<int>(counter)].load(std::memory_order_relaxed);
+    }
+
+    void record(PipelineLatency latency, double seconds) {
+        histograms_[static_cast<int>(latency)].record(seconds);
+    }
+
+    // Ingested data waits here until the next paint picks it up.
+    void mark_ingested(double read_ts, double ingest_ts);
+    void mark_painted(double paint_start, double paint_end);
+
+    // Latency summaries cover the period since the previous snapshot; rates
+    // are computed over the same period.
+    PipelineStatsSnapshot take_snapshot(double now);
+
+    static std::string to_json(const PipelineStatsSnapshot& snap);
+    static std::vector<std::string> format_summary(const PipelineStatsSnapshot& snap);
+
+private:
+    static constexpr int kCounters = PipelineStatsSnapshot::kCounters;
+    static constexpr int kLatencies = PipelineStatsSnapshot::kLatencies;
+
+    std::atomic<uint64_t> counters_[kCounters];
+    LatencyHistogram histograms_[kLatencies];
+
+    double start_ts_ = 0.0;
+    double last_snapshot_ts_ = 0.0;
+    uint64_t last_totals_[kCounters] = {};
+
+    double oldest_unpainted_read_ts_ = 0.0;
+    double first_unpainted_ingest_ts_ = 0.0;
+};
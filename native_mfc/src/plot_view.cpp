@@ -8,6 +8,9 @@
 #include <cmath>
 #include <sstream>
 
+#include "channel_colors.h"
+#include "trace.h"
+
 using namespace Gdiplus;
 
 namespace {
@@ -27,16 +30,9 @@ constexpr int kEndTagXMarginPx = 8;
 constexpr int kEndTagYOffsetPx = 10;
 constexpr int kEndTagSafeMarginPx = 8;
 
-COLORREF kColorTable[] = {
-    RGB(255,  99,  71),
-    RGB( 30, 144, 255),
-    RGB( 50, 205,  50),
-    RGB(255,  20, 147),
-    RGB(138,  43, 226),
-    RGB(255, 140,   0),
-    RGB(  0, 206, 209),
-    RGB(220,  20,  60),
-};
+// Reference traces: same colour as the live channel, faint and thinner.
+constexpr BYTE kReferenceAlpha = 90;
+constexpr float kReferencePenWidth = 3.0f;
 
 std::wstring to_wstring(const std::string& s) {
     if (s.empty()) {
@@ -144,6 +140,10 @@ void PlotView::set_model(ChannelModel* model) {
     model_ = model;
 }
 
+void PlotView::set_clock(const Clock* clock) {
+    clock_ = clock ? clock : &monotonic_clock();
+}
+
 void PlotView::set_time_window(double sec) {
     if (sec < 1.0) {
         sec = 1.0;
@@ -157,6 +157,11 @@ void PlotView::set_overlay_enabled(bool enabled) {
     InvalidateRect(hwnd_, nullptr, FALSE);
 }
 
+void PlotView::set_references(std::vector<std::shared_ptr<const ReferenceOverlay>> references) {
+    references_ = std::move(references);
+    InvalidateRect(hwnd_, nullptr, FALSE);
+}
+
 void PlotView::set_frozen(bool frozen) {
     frozen_ = frozen;
     if (frozen_) {
@@ -172,6 +177,25 @@ void PlotView::set_frozen(bool frozen) {
     InvalidateRect(hwnd_, nullptr, FALSE);
 }
 
+void PlotView::set_stats(PipelineStats* stats) {
+    stats_ = stats;
+}
+
+void PlotView::set_diagnostics_visible(bool visible) {
+    diagnostics_visible_ = visible;
+    if (!visible) {
+        diagnostics_lines_.clear();
+    }
+    InvalidateRect(hwnd_, nullptr, FALSE);
+}
+
+void PlotView::set_diagnostics(const std::vector<std::wstring>& lines) {
+    diagnostics_lines_ = lines;
+    if (diagnostics_visible_) {
+        InvalidateRect(hwnd_, nullptr, FALSE);
+    }
+}
+
 void PlotView::reset_visual() {
     hover_active_ = false;
     hover_values_.clear();
@@ -185,6 +209,7 @@ void PlotView::request_temporary_fit(double now, double duration_sec) {
 }
 
 void PlotView::update_from_model(double now) {
+    SCC_TRACE_SCOPE("PlotView::update_from_model");
     last_now_ = now;
     if (frozen_) {
         return;
@@ -198,33 +223,30 @@ void PlotView::update_from_model(double now) {
     double data_max = 0.0;
     bool has_data = false;
 
-    auto enabled_keys = model_->get_enabled_keys_with_data();
-    auto keys = model_->get_keys();
+    const auto& enabled_keys = model_->get_enabled_keys_with_data();
+    const auto& keys = model_->get_keys();
     for (const auto& key : keys) {
         ensure_color(key);
     }
 
     for (const auto& key : enabled_keys) {
-        auto series = model_->get_series(key);
+        SeriesView series = model_->get_series_view(key);
         if (series.empty()) {
             continue;
         }
 
-        double t_end = series.back().t;
-        double t_start = t_end - time_window_;
-
-        for (const auto& sample : series) {
-            if (sample.t < t_start) {
-                continue;
-            }
-            if (!has_data) {
-                data_min = sample.v;
-                data_max = sample.v;
-                has_data = true;
-            } else {
-                data_min = std::min<double>(data_min, sample.v);
-                data_max = std::max<double>(data_max, sample.v);
-            }
+        int vmin = 0;
+        int vmax = 0;
+        if (!series.since(series.back().t - time_window_).value_range(&vmin, &vmax)) {
+            continue;
+        }
+        if (!has_data) {
+            data_min = vmin;
+            data_max = vmax;
+            has_data = true;
+        } else {
+            data_min = std::min<double>(data_min, vmin);
+            data_max = std::max<double>(data_max, vmax);
         }
     }
 
@@ -246,52 +268,94 @@ void PlotView::capture_snapshot() {
         return;
     }
 
-    auto keys = model_->get_keys();
-    for (const auto& key : keys) {
-        if (!model_->is_enabled(key)) {
-            continue;
-        }
-        auto series = model_->get_series(key);
-        if (series.empty()) {
+    for (const auto& key : model_->get_enabled_keys_with_data()) {
+        FrozenSeries& frozen = frozen_series_[key];
+        if (!model_->copy_series(key, &frozen.samples, &frozen.lod) || frozen.samples.empty()) {
+            frozen_series_.erase(key);
             continue;
         }
         ensure_color(key);
-        frozen_series_[key] = std::move(series);
         frozen_keys_.push_back(key);
     }
 }
 
-std::vector<std::string> PlotView::get_active_keys() const {
+void PlotView::show_capture(const TriggerCapture& capture) {
+    frozen_ = true;
+    frozen_series_.clear();
+    frozen_keys_.clear();
+    hover_active_ = false;
+    hover_values_.clear();
+    for (size_t i = 0; i < capture.keys.size(); ++i) {
+        const auto& samples = capture.series[i];
+        if (samples.empty()) {
+            continue;
+        }
+        FrozenSeries& frozen = frozen_series_[capture.keys[i]];
+        frozen.samples.reserve(samples.size());
+        for (const auto& s : samples) {
+            frozen.samples.push_back(s.t, s.v);
+            frozen.lod.append(s.t, s.v);
+        }
+        ensure_color(capture.keys[i]);
+        frozen_keys_.push_back(capture.keys[i]);
+    }
+    InvalidateRect(hwnd_, nullptr, FALSE);
+}
+
+const std::vector<std::string>& PlotView::get_active_keys() const {
+    static const std::vector<std::string> kNoKeys;
     if (frozen_) {
         return frozen_keys_;
     }
     if (!model_) {
-        return {};
+        return kNoKeys;
     }
     return model_->get_enabled_keys_with_data();
 }
 
+SeriesView PlotView::series_for(const std::string& key) const {
+    if (frozen_) {
+        auto it = frozen_series_.find(key);
+        return (it != frozen_series_.end()) ? it->second.samples.view() : SeriesView();
+    }
+    return model_ ? model_->get_series_view(key) : SeriesView();
+}
+
+LodView PlotView::lod_for(const std::string& key, double t_start, double t_end, int pixels) const {
+    if (frozen_) {
+        auto it = frozen_series_.find(key);
+        if (it == frozen_series_.end()) {
+            return LodView();
+        }
+        return select_lod_view(it->second.samples, it->second.lod, t_start, t_end, pixels);
+    }
+    return model_ ? model_->get_lod_view(key, t_start, t_end, pixels) : LodView();
+}
+
 void PlotView::fit_enabled_channels() {
+    SCC_TRACE_SCOPE("PlotView::fit_enabled_channels");
     if (!model_) {
         return;
     }
 
-    std::vector<int> vals;
-    auto enabled = model_->get_enabled_keys_with_data();
-    for (const auto& key : enabled) {
-        auto series = model_->get_series(key);
-        for (const auto& sample : series) {
-            vals.push_back(sample.v);
+    int y_min = 0;
+    int y_max = 0;
+    bool has_data = false;
+    for (const auto& key : model_->get_enabled_keys_with_data()) {
+        int vmin = 0;
+        int vmax = 0;
+        if (!model_->get_series_view(key).value_range(&vmin, &vmax)) {
+            continue;
         }
+        y_min = has_data ? std::min(y_min, vmin) : vmin;
+        y_max = has_data ? std::max(y_max, vmax) : vmax;
+        has_data = true;
     }
 
-    if (vals.empty()) {
+    if (!has_data) {
         return;
     }
 
-    int y_min = *std::min_element(vals.begin(), vals.end());
-    int y_max = *std::max_element(vals.begin(), vals.end());
-
     double span = static_cast<double>(y_max - y_min);
     if (span < 1.0) {
         span = 1.0;
@@ -352,13 +416,12 @@ double PlotView::compute_overlay_required_y_max(const RECT& plot_rect) const {
     double dy = kEndTagYOffsetPx * y_per_px + (kAutoExpandPadPx * y_per_px);
 
     double required = -1.0;
-    auto enabled = model_->get_enabled_keys_with_data();
-    for (const auto& key : enabled) {
-        auto series = model_->get_series(key);
-        if (series.empty()) {
+    ChannelSample last;
+    for (const auto& key : model_->get_enabled_keys_with_data()) {
+        if (!model_->get_last_sample(key, &last)) {
             continue;
         }
-        double v = static_cast<double>(series.back().v);
+        double v = static_cast<double>(last.v);
         double y = v + dy;
         if (y > required) {
             required = y;
@@ -418,8 +481,8 @@ void PlotView::ensure_color(const std::string& key) {
     if (color_map_.find(key) != color_map_.end()) {
         return;
     }
-    size_t idx = color_order_.size() % (sizeof(kColorTable) / sizeof(kColorTable[0]));
-    color_map_[key] = kColorTable[idx];
+    uint32_t rgb = channel_color(color_order_.size());
+    color_map_[key] = RGB((rgb >> 16) & 0xFF, (rgb >> 8) & 0xFF, rgb & 0xFF);
     color_order_.push_back(key);
 }
 
@@ -458,6 +521,7 @@ LRESULT PlotView::handle_message(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPar
         if (!model_ || !frozen_) {
             break;
         }
+        SCC_TRACE_SCOPE("PlotView::hover");
         RECT client = {};
         GetClientRect(hwnd, &client);
         RECT plot_rect = plot_rect_from_client(client);
@@ -485,53 +549,23 @@ LRESULT PlotView::handle_message(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPar
 
         hover_values_.clear();
         double snap_t = -1.0;
-        auto enabled = get_active_keys();
-        for (const auto& key : enabled) {
-            std::vector<ChannelSample> temp;
-            const std::vector<ChannelSample>* series_ptr = nullptr;
-            if (frozen_) {
-                auto it = frozen_series_.find(key);
-                if (it == frozen_series_.end()) {
-                    continue;
-                }
-                series_ptr = &it->second;
-            } else {
-                temp = model_->get_series(key);
-                if (temp.empty()) {
-                    continue;
-                }
-                series_ptr = &temp;
-            }
-
-            const auto& series = *series_ptr;
+        for (const auto& key : get_active_keys()) {
+            SeriesView series = series_for(key);
             if (series.empty()) {
                 continue;
             }
             double t_end = series.back().t;
             double t_start = t_end - time_window_;
 
-            std::vector<std::pair<double, int>> windowed;
-            for (const auto& sample : series) {
-                if (sample.t >= t_start) {
-                    windowed.emplace_back(sample.t - t_start, sample.v);
-                }
-            }
+            SeriesView windowed = series.since(t_start);
             if (windowed.empty()) {
                 continue;
             }
 
-            size_t best = 0;
-            double best_dist = std::abs(windowed[0].first - t_view);
-            for (size_t i = 1; i < windowed.size(); ++i) {
-                double dist = std::abs(windowed[i].first - t_view);
-                if (dist < best_dist) {
-                    best_dist = dist;
-                    best = i;
-                }
-            }
+            size_t best = windowed.nearest(t_start + t_view);
 
-            double real_t = windowed[best].first;
-            int value = windowed[best].second;
+            double real_t = windowed.time_at(best) - t_start;
+            int value = windowed.value_at(best);
             if (snap_t < 0.0) {
                 snap_t = real_t;
             }
@@ -567,6 +601,7 @@ LRESULT PlotView::handle_message(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPar
 }
 
 void PlotView::paint() {
+    double paint_start = clock_->now();
     PAINTSTRUCT ps = {};
     HDC hdc = BeginPaint(hwnd_, &ps);
     if (hdc) {
@@ -592,9 +627,13 @@ void PlotView::paint() {
         }
     }
     EndPaint(hwnd_, &ps);
+    if (stats_) {
+        stats_->mark_painted(paint_start, clock_->now());
+    }
 }
 
 void PlotView::draw_plot(HDC hdc, const RECT& client) {
+    SCC_TRACE_SCOPE("PlotView::draw_plot");
     Graphics g(hdc);
     g.SetSmoothingMode(SmoothingModeHighQuality);
     g.SetPixelOffsetMode(PixelOffsetModeHighQuality);
@@ -618,10 +657,7 @@ void PlotView::draw_plot(HDC hdc, const RECT& client) {
     SolidBrush label_brush(Color(220, 220, 220));
     RectF layout;
     std::wstring x_label = L"Time (s)";
-    std::vector<std::string> enabled;
-    if (model_) {
-        enabled = get_active_keys();
-    }
+    const std::vector<std::string>& enabled = get_active_keys();
 
     double y_span = y_max_ - y_min_;
     if (y_span <= 0.0) {
@@ -714,76 +750,90 @@ void PlotView::draw_plot(HDC hdc, const RECT& client) {
         return;
     }
 
-    for (const auto& key : enabled) {
-        ensure_color(key);
-        std::vector<ChannelSample> temp;
-        const std::vector<ChannelSample>* series_ptr = nullptr;
-        if (frozen_) {
-            auto it = frozen_series_.find(key);
-            if (it == frozen_series_.end()) {
-                continue;
-            }
-            series_ptr = &it->second;
-        } else {
-            temp = model_->get_series(key);
-            if (temp.empty()) {
+    auto draw_steps = [&](const Pen& pen, double t_start, const std::vector<ChannelSample>& points) {
+        for (size_t i = 0; i + 1 < points.size(); ++i) {
+            float px0 = static_cast<float>(data_to_x(plot_rect, points[i].t - t_start));
+            float px1 = static_cast<float>(data_to_x(plot_rect, points[i + 1].t - t_start));
+            float py0 = static_cast<float>(data_to_y(plot_rect, points[i].v));
+            float py1 = static_cast<float>(data_to_y(plot_rect, points[i + 1].v));
+
+            g.DrawLine(&pen, px0, py0, px1, py0);
+            g.DrawLine(&pen, px1, py0, px1, py1);
+        }
+    };
+
+    // References go first so the live traces stay on top. They are read
+    // from their mapped index like live data from the pyramid.
+    for (const auto& reference : references_) {
+        double offset = 0.0;
+        if (!reference->offset(*model_, &offset)) {
+            continue;
+        }
+        int plot_w = std::max<int>(1, static_cast<int>(plot_rect.right - plot_rect.left));
+        for (const auto& key : enabled) {
+            int ch = reference->channel_for(key);
+            SeriesView series = series_for(key);
+            if (ch < 0 || series.empty()) {
                 continue;
             }
-            series_ptr = &temp;
+            double t_end = series.back().t;
+            double t_start = t_end - time_window_;
+            reference->trace().draw_points(static_cast<size_t>(ch), offset, t_start - offset, t_end - offset, plot_w,
+                                           &draw_points_);
+            ensure_color(key);
+            COLORREF color = get_color(key);
+            Pen pen(Color(kReferenceAlpha, GetRValue(color), GetGValue(color), GetBValue(color)), kReferencePenWidth);
+            pen.SetLineJoin(LineJoinRound);
+            draw_steps(pen, t_start, draw_points_);
         }
+    }
 
-        const auto& series = *series_ptr;
+    for (const auto& key : enabled) {
+        ensure_color(key);
+        SeriesView series = series_for(key);
         if (series.size() < 2) {
             continue;
         }
 
         double t_end = series.back().t;
         double t_start = t_end - time_window_;
-        std::vector<ChannelSample> windowed;
-        for (const auto& sample : series) {
-            if (sample.t >= t_start) {
-                windowed.push_back(sample);
-            }
-        }
+        SeriesView windowed = series.since(t_start);
         if (windowed.size() < 2) {
             continue;
         }
 
-        std::vector<ChannelSample> simplified;
-        simplified.reserve(windowed.size());
-        int last_px = INT_MIN;
-        for (const auto& sample : windowed) {
-            double x_data = sample.t - t_start;
-            int px = static_cast<int>(std::lround(data_to_x(plot_rect, x_data)));
-            if (px == last_px) {
-                if (!simplified.empty()) {
-                    simplified.back() = sample;
+        // Long windows draw from the coarsest pyramid level that still has
+        // two buckets per pixel and run-length channels from their runs;
+        // short ones keep one raw sample per pixel.
+        int plot_w = std::max<int>(1, static_cast<int>(plot_rect.right - plot_rect.left));
+        LodView lod = lod_for(key, t_start, t_end, plot_w);
+        auto& simplified = draw_points_;
+        simplified.clear();
+        if (!lod.empty()) {
+            lod.to_step_points(t_start, t_end, plot_w, &simplified);
+        } else {
+            int last_px = INT_MIN;
+            for (ChannelSample sample : windowed) {
+                double x_data = sample.t - t_start;
+                int px = static_cast<int>(std::lround(data_to_x(plot_rect, x_data)));
+                if (px == last_px) {
+                    if (!simplified.empty()) {
+                        simplified.back() = sample;
+                    }
+                } else {
+                    simplified.push_back(sample);
+                    last_px = px;
                 }
-            } else {
-                simplified.push_back(sample);
-                last_px = px;
             }
         }
-        const auto& draw_series = simplified.size() >= 2 ? simplified : windowed;
+        if (simplified.size() < 2) {
+            simplified.assign(windowed.begin(), windowed.end());
+        }
 
         COLORREF color = get_color(key);
         Pen pen(Color(255, GetRValue(color), GetGValue(color), GetBValue(color)), 5.0f);
         pen.SetLineJoin(LineJoinRound);
-
-        for (size_t i = 0; i + 1 < draw_series.size(); ++i) {
-            double x0 = draw_series[i].t - t_start;
-            double x1 = draw_series[i + 1].t - t_start;
-            double y0 = draw_series[i].v;
-            double y1 = draw_series[i + 1].v;
-
-            float px0 = static_cast<float>(data_to_x(plot_rect, x0));
-            float px1 = static_cast<float>(data_to_x(plot_rect, x1));
-            float py0 = static_cast<float>(data_to_y(plot_rect, y0));
-            float py1 = static_cast<float>(data_to_y(plot_rect, y1));
-
-            g.DrawLine(&pen, px0, py0, px1, py0);
-            g.DrawLine(&pen, px1, py0, px1, py1);
-        }
+        draw_steps(pen, t_start, simplified);
     }
 
     if (overlay_enabled_) {
@@ -799,23 +849,7 @@ void PlotView::draw_plot(HDC hdc, const RECT& client) {
         SolidBrush bg_brush(Color(25, 0, 0, 0));
 
         for (const auto& key : enabled) {
-            std::vector<ChannelSample> temp;
-            const std::vector<ChannelSample>* series_ptr = nullptr;
-            if (frozen_) {
-                auto it = frozen_series_.find(key);
-                if (it == frozen_series_.end()) {
-                    continue;
-                }
-                series_ptr = &it->second;
-            } else {
-                temp = model_->get_series(key);
-                if (temp.empty()) {
-                    continue;
-                }
-                series_ptr = &temp;
-            }
-
-            const auto& series = *series_ptr;
+            SeriesView series = series_for(key);
             if (series.empty()) {
                 continue;
             }
@@ -871,6 +905,9 @@ void PlotView::draw_plot(HDC hdc, const RECT& client) {
         draw_hover(hdc, plot_rect);
     }
 
+    if (diagnostics_visible_ && !diagnostics_lines_.empty()) {
+        draw_diagnostics(hdc, plot_rect);
+    }
 }
 
 void PlotView::draw_hover(HDC hdc, const RECT& plot_rect) {
@@ -929,3 +966,35 @@ void PlotView::draw_hover(HDC hdc, const RECT& plot_rect) {
         }
     }
 }
+
+void PlotView::draw_diagnostics(HDC hdc, const RECT& plot_rect) {
+    Graphics g(hdc);
+    g.SetTextRenderingHint(TextRenderingHintClearTypeGridFit);
+
+    Font font(L"Consolas", 9, FontStyleRegular);
+    float max_w = 0.0f;
+    float line_h = 0.0f;
+    for (const auto& line : diagnostics_lines_) {
+        RectF bounds;
+        g.MeasureString(line.c_str(), -1, &font, PointF(0, 0), &bounds);
+        max_w = std::max<float>(max_w, bounds.Width);
+        line_h = std::max<float>(line_h, bounds.Height);
+    }
+
+    float padding = 6.0f;
+    float box_w = max_w + padding * 2.0f;
+    float box_h = line_h * static_cast<float>(diagnostics_lines_.size()) + padding * 2.0f;
+    float box_x = static_cast<float>(plot_rect.right) - box_w - 6.0f;
+    float box_y = static_cast<float>(plot_rect.top + 6);
+
+    SolidBrush bg(Color(190, 0, 0, 0));
+    g.FillRectangle(&bg, box_x, box_y, box_w, box_h);
+    Pen border(Color(255, 90, 90, 90), 1.0f);
+    g.DrawRectangle(&border, box_x, box_y, box_w, box_h);
+
+    SolidBrush text(Color(255, 200, 230, 200));
+    for (size_t i = 0; i < diagnostics_lines_.size(); ++i) {
+        float y = box_y + padding + line_h * static_cast<float>(i);
+        g.DrawString(diagnostics_lines_[i].c_str(), -1, &font, PointF(box_x + padding, y), &text);
+    }
+}
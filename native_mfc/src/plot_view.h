@@ -5,11 +5,15 @@
 #endif
 #include <windows.h>
 
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
 #include "channel_model.h"
+#include "clock.h"
+#include "pipeline_stats.h"
+#include "reference_trace.h"
 
 class PlotView {
 public:
@@ -17,6 +21,7 @@ public:
     HWND hwnd() const;
 
     void set_model(ChannelModel* model);
+    void set_clock(const Clock* clock);
     void set_time_window(double sec);
     void update_from_model(double now);
     void reset_visual();
@@ -26,6 +31,15 @@ public:
 
     void set_overlay_enabled(bool enabled);
     void set_frozen(bool frozen);
+    // Freezes the view on a trigger capture instead of the live data;
+    // set_frozen(false) returns to live.
+    void show_capture(const TriggerCapture& capture);
+    // Recordings drawn faintly under the live channels they map to.
+    void set_references(std::vector<std::shared_ptr<const ReferenceOverlay>> references);
+
+    void set_stats(PipelineStats* stats);
+    void set_diagnostics_visible(bool visible);
+    void set_diagnostics(const std::vector<std::wstring>& lines);
 
 private:
     static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
@@ -34,6 +48,7 @@ private:
     void paint();
     void draw_plot(HDC hdc, const RECT& client);
     void draw_hover(HDC hdc, const RECT& plot_rect);
+    void draw_diagnostics(HDC hdc, const RECT& plot_rect);
 
     RECT plot_rect_from_client(const RECT& client) const;
     void ensure_color(const std::string& key);
@@ -43,7 +58,10 @@ private:
     double compute_overlay_required_y_max(const RECT& plot_rect) const;
 
     void capture_snapshot();
-    std::vector<std::string> get_active_keys() const;
+    const std::vector<std::string>& get_active_keys() const;
+    // Frozen snapshot while frozen, otherwise the live model data.
+    SeriesView series_for(const std::string& key) const;
+    LodView lod_for(const std::string& key, double t_start, double t_end, int pixels) const;
 
     double data_to_x(const RECT& plot_rect, double x) const;
     double data_to_y(const RECT& plot_rect, double y) const;
@@ -51,6 +69,8 @@ private:
 
     HWND hwnd_ = nullptr;
     ChannelModel* model_ = nullptr;
+    PipelineStats* stats_ = nullptr;
+    const Clock* clock_ = &monotonic_clock();
 
     double time_window_ = 5.0;
     double y_min_ = 0.0;
@@ -68,6 +88,18 @@ private:
     std::unordered_map<std::string, COLORREF> color_map_;
     std::vector<std::string> color_order_;
 
-    std::unordered_map<std::string, std::vector<ChannelSample>> frozen_series_;
+    bool diagnostics_visible_ = false;
+    std::vector<std::wstring> diagnostics_lines_;
+
+    struct FrozenSeries {
+        SampleRing samples;
+        LodPyramid lod;
+    };
+    std::unordered_map<std::string, FrozenSeries> frozen_series_;
     std::vector<std::string> frozen_keys_;
+
+    std::vector<std::shared_ptr<const ReferenceOverlay>> references_;
+
+    // Reused across frames so drawing does not allocate.
+    std::vector<ChannelSample> draw_points_;
 };
@@ -0,0 +1,16 @@
+#include "range_aggregate.h"
+
+#include <cmath>
+
+AggregateBuckets::AggregateBuckets(double t_start, double t_end, double width)
+    : t_start_(t_start), t_end_(t_end) {
+    if (!(t_end >= t_start)) {
+        return;
+    }
+    double count = width > 0.0 ? std::ceil((t_end - t_start) / width) : 1.0;
+    if (!(count <= static_cast<double>(kMaxBuckets))) {
+        return;
+    }
+    width_ = count > 1.0 ? width : 0.0;
+    buckets_.resize(count > 1.0 ? static_cast<size_t>(count) : 1);
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "sample_ring.h"
+
+// Summary of the samples in a time range.
+struct RangeAggregate {
+    uint64_t count = 0;
+    int min = 0;
+    int max = 0;
+    int64_t sum = 0;
+    ChannelSample first;
+    ChannelSample last;
+
+    double mean() const { return count ? static_cast<double>(sum) / static_cast<double>(count) : 0.0; }
+
+    void add(double t, int v) {
+        if (count == 0) {
+            min = max = v;
+            first = ChannelSample{t, v};
+        } else {
+            min = v < min ? v : min;
+            max = v > max ? v : max;
+        }
+        count++;
+        sum += v;
+        last = ChannelSample{t, v};
+    }
+    // Folds in the summary of samples that all come after this one's.
+    void add(const RangeAggregate& later) {
+        if (later.count == 0) {
+            return;
+        }
+        if (count == 0) {
+            *this = later;
+            return;
+        }
+        min = later.min < min ? later.min : min;
+        max = later.max > max ? later.max : max;
+        count += later.count;
+        sum += later.sum;
+        last = later.last;
+    }
+};
+
+// Splits [t_start, t_end] into buckets of width seconds (the last one ends
+// at t_end and may be shorter; width <= 0 gives a single bucket) and folds
+// samples, fed oldest first, into the bucket holding their time. Storage
+// tiers feed whole blocks as summaries when fits() says a block lies inside
+// one bucket, and decode only the blocks that straddle a bucket edge.
+class AggregateBuckets {
+public:
+    static constexpr size_t kMaxBuckets = size_t(1) << 20;
+
+    // Buckets beyond kMaxBuckets are not created; check valid().
+    AggregateBuckets(double t_start, double t_end, double width);
+
+    bool valid() const { return !buckets_.empty(); }
+    double t_start() const { return t_start_; }
+    double t_end() const { return t_end_; }
+
+    // Whether samples from t_first to t_last all fall into one bucket.
+    bool fits(double t_first, double t_last) const {
+        return t_first >= t_start_ && t_last <= t_end_ && bucket(t_first) == bucket(t_last);
+    }
+    // block must satisfy fits(block.first.t, block.last.t).
+    void add(const RangeAggregate& block) { buckets_[bucket(block.first.t)].add(block); }
+    // Samples outside [t_start, t_end] are ignored.
+    void add(double t, int v) {
+        if (t >= t_start_ && t <= t_end_) {
+            buckets_[bucket(t)].add(t, v);
+        }
+    }
+
+    const std::vector<RangeAggregate>& buckets() const { return buckets_; }
+    std::vector<RangeAggregate>& buckets() { return buckets_; }
+
+private:
+    size_t bucket(double t) const {
+        if (width_ <= 0.0) {
+            return 0;
+        }
+        double k = (t - t_start_) / width_;
+        return k < static_cast<double>(buckets_.size() - 1) ? static_cast<size_t>(k) : buckets_.size() - 1;
+    }
+
+    double t_start_ = 0.0;
+    double t_end_ = 0.0;
+    double width_ = 0.0;
+    std::vector<RangeAggregate> buckets_;
+};
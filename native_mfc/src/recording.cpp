@@ -0,0 +1,117 @@
+#include "recording.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+constexpr char kMagic[8] = {'S', 'C', 'C', 'R', 'E', 'C', '0', '1'};
+constexpr size_t kMaxChannelIds = 0xFFFF;
+} // namespace
+
+RecordingWriter::~RecordingWriter() {
+    close();
+}
+
+bool RecordingWriter::open(const std::string& path, Format format, std::string* error) {
+    close();
+    out_.open(path, std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!out_) {
+        if (error) {
+            *error = "Cannot create recording: " + path;
+        }
+        return false;
+    }
+    format_ = format;
+    ids_.clear();
+    samples_written_ = 0;
+
+    if (format_ == Format::kBinary) {
+        put(kMagic, sizeof(kMagic));
+    } else {
+        out_ << "t,key,value\n";
+    }
+    return true;
+}
+
+bool RecordingWriter::is_open() const {
+    return out_.is_open();
+}
+
+void RecordingWriter::close() {
+    if (out_.is_open()) {
+        out_.flush();
+        out_.close();
+    }
+}
+
+void RecordingWriter::flush() {
+    if (out_.is_open()) {
+        out_.flush();
+    }
+}
+
+uint64_t RecordingWriter::samples_written() const {
+    return samples_written_;
+}
+
+void RecordingWriter::put(const void* data, size_t size) {
+    out_.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+}
+
+uint16_t RecordingWriter::channel_id(const std::string& key) {
+    auto it = ids_.find(key);
+    if (it != ids_.end()) {
+        return it->second;
+    }
+    uint16_t id = static_cast<uint16_t>(ids_.size());
+    ids_[key] = id;
+
+    uint8_t len = static_cast<uint8_t>(std::min<size_t>(key.size(), 255));
+    char tag = 'K';
+    put(&tag, 1);
+    put(&id, sizeof(id));
+    put(&len, 1);
+    put(key.data(), len);
+    return id;
+}
+
+void RecordingWriter::write_line(double ts, const std::unordered_map<std::string, int>& kv) {
+    if (!out_.is_open() || kv.empty()) {
+        return;
+    }
+
+    // Stable per-line key order keeps recordings of the same input identical.
+    sorted_.clear();
+    for (const auto& pair : kv) {
+        sorted_.push_back(&pair);
+    }
+    std::sort(sorted_.begin(), sorted_.end(), [](const auto* a, const auto* b) {
+        return a->first < b->first;
+    });
+
+    if (format_ == Format::kCsv) {
+        char stamp[32] = {};
+        std::snprintf(stamp, sizeof(stamp), "%.6f,", ts);
+        for (const auto* pair : sorted_) {
+            out_ << stamp << pair->first << ',' << pair->second << '\n';
+            samples_written_ += 1;
+        }
+        return;
+    }
+
+    for (const auto* pair : sorted_) {
+        if (ids_.find(pair->first) == ids_.end() && ids_.size() >= kMaxChannelIds) {
+            continue;
+        }
+        uint16_t id = channel_id(pair->first);
+        int32_t v = static_cast<int32_t>(pair->second);
+        char record[1 + sizeof(id) + sizeof(ts) + sizeof(v)];
+        record[0] = 'S';
+        std::memcpy(record + 1, &id, sizeof(id));
+        std::memcpy(record + 1 + sizeof(id), &ts, sizeof(ts));
+        std::memcpy(record + 1 + sizeof(id) + sizeof(ts), &v, sizeof(v));
+        put(record, sizeof(record));
+        samples_written_ += 1;
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Streams parsed samples to disk, either as long-format CSV
+// ("t,key,value") or as a compact binary recording:
+//
+//   "SCCREC01"                              file magic
+//   'K' u16 id  u8 len  char[len]           channel definition
+//   'S' u16 id  f64 t   i32 v               sample
+//
+// Integers are little-endian; channel ids are assigned in order of first
+// appearance.
+class RecordingWriter {
+public:
+    enum class Format {
+        kCsv,
+        kBinary,
+    };
+
+    ~RecordingWriter();
+
+    bool open(const std::string& path, Format format, std::string* error);
+    bool is_open() const;
+    void close();
+
+    void write_line(double ts, const std::unordered_map<std::string, int>& kv);
+    void flush();
+
+    uint64_t samples_written() const;
+
+private:
+    uint16_t channel_id(const std::string& key);
+    void put(const void* data, size_t size);
+
+    std::ofstream out_;
+    Format format_ = Format::kCsv;
+    std::unordered_map<std::string, uint16_t> ids_;
+    std::vector<const std::pair<const std::string, int>*> sorted_;
+    uint64_t samples_written_ = 0;
+};
@@ -0,0 +1,250 @@
+#include "reference_dialog.h"
+
+#include <commdlg.h>
+
+#include <sstream>
+
+#include "reference_trace.h"
+
+namespace {
+const wchar_t* kHintText =
+    L"One reference recording (.rec) per line: \"PATH\" [connect|trigger] [LIVE=REF ...]. connect lines the "
+    L"recording's start up with the first live sample, trigger with the newest trigger capture. Channels are drawn "
+    L"under live keys of the same name unless mapped, e.g. VBAT=BAT_MV. Lines starting with # are ignored.";
+
+std::wstring to_wstring(const std::string& s) {
+    if (s.empty()) {
+        return L"";
+    }
+    int len = MultiByteToWideChar(CP_UTF8, 0, s.c_str(), -1, nullptr, 0);
+    if (len <= 0) {
+        return L"";
+    }
+    std::wstring out(len - 1, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, s.c_str(), -1, &out[0], len);
+    return out;
+}
+
+std::string to_utf8(const std::wstring& s) {
+    if (s.empty()) {
+        return "";
+    }
+    int len = WideCharToMultiByte(CP_UTF8, 0, s.c_str(), -1, nullptr, 0, nullptr, nullptr);
+    if (len <= 0) {
+        return "";
+    }
+    std::string out(len - 1, '\0');
+    WideCharToMultiByte(CP_UTF8, 0, s.c_str(), -1, &out[0], len, nullptr, nullptr);
+    return out;
+}
+
+std::string trim(const std::string& s) {
+    size_t b = s.find_first_not_of(" \t\r");
+    if (b == std::string::npos) {
+        return "";
+    }
+    size_t e = s.find_last_not_of(" \t\r");
+    return s.substr(b, e - b + 1);
+}
+} // namespace
+
+void ReferenceDialog::show(HWND parent, const References& current, std::function<void(References)> on_apply) {
+    current_ = current;
+    on_apply_ = std::move(on_apply);
+
+    WNDCLASSW wc = {};
+    wc.lpfnWndProc = ReferenceDialog::WndProc;
+    wc.hInstance = GetModuleHandleW(nullptr);
+    wc.lpszClassName = L"ReferenceDialogWnd";
+    wc.hCursor = LoadCursor(nullptr, IDC_ARROW);
+    wc.hbrBackground = reinterpret_cast<HBRUSH>(GetStockObject(WHITE_BRUSH));
+    RegisterClassW(&wc);
+
+    hwnd_ = CreateWindowExW(
+        WS_EX_DLGMODALFRAME,
+        wc.lpszClassName,
+        L"Reference Traces",
+        WS_OVERLAPPED | WS_CAPTION | WS_SYSMENU | WS_THICKFRAME | WS_VISIBLE,
+        CW_USEDEFAULT, CW_USEDEFAULT, 720, 360,
+        parent,
+        nullptr,
+        wc.hInstance,
+        this
+    );
+    if (!hwnd_) {
+        return;
+    }
+
+    ShowWindow(hwnd_, SW_SHOW);
+
+    MSG msg;
+    while (IsWindow(hwnd_) && GetMessageW(&msg, nullptr, 0, 0)) {
+        if (IsDialogMessageW(hwnd_, &msg)) {
+            continue;
+        }
+        TranslateMessage(&msg);
+        DispatchMessageW(&msg);
+    }
+}
+
+bool ReferenceDialog::apply(std::wstring* error) {
+    int len = GetWindowTextLengthW(edit_);
+    std::wstring text(static_cast<size_t>(len) + 1, L'\0');
+    GetWindowTextW(edit_, &text[0], len + 1);
+    text.resize(static_cast<size_t>(len));
+
+    // The first open of a recording builds its index, which can take a
+    // few seconds for a long one.
+    HCURSOR previous = SetCursor(LoadCursor(nullptr, IDC_WAIT));
+    References next;
+    std::istringstream lines(to_utf8(text));
+    std::string line;
+    int line_no = 0;
+    bool ok = true;
+    while (ok && std::getline(lines, line)) {
+        line_no++;
+        line = trim(line);
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::shared_ptr<const ReferenceOverlay> reuse;
+        for (const auto& overlay : current_) {
+            if (overlay->definition() == line) {
+                reuse = overlay;
+            }
+        }
+        if (reuse) {
+            next.push_back(reuse);
+            continue;
+        }
+        auto overlay = std::make_shared<ReferenceOverlay>();
+        std::string err;
+        if (overlay->open(line, &err)) {
+            next.push_back(overlay);
+        } else {
+            *error = L"Line " + std::to_wstring(line_no) + L": " + to_wstring(err);
+            ok = false;
+        }
+    }
+    SetCursor(previous);
+    if (!ok) {
+        return false;
+    }
+    current_ = next;
+    if (on_apply_) {
+        on_apply_(std::move(next));
+    }
+    return true;
+}
+
+void ReferenceDialog::browse() {
+    wchar_t path[MAX_PATH] = {};
+    OPENFILENAMEW ofn = {};
+    ofn.lStructSize = sizeof(ofn);
+    ofn.hwndOwner = hwnd_;
+    ofn.lpstrFilter = L"Recordings (*.rec)\0*.rec\0All files (*.*)\0*.*\0";
+    ofn.lpstrFile = path;
+    ofn.nMaxFile = MAX_PATH;
+    ofn.Flags = OFN_FILEMUSTEXIST | OFN_PATHMUSTEXIST;
+    if (!GetOpenFileNameW(&ofn)) {
+        return;
+    }
+    int len = GetWindowTextLengthW(edit_);
+    std::wstring line = std::wstring(len > 0 ? L"\r\n" : L"") + L"\"" + path + L"\" connect";
+    SendMessageW(edit_, EM_SETSEL, static_cast<WPARAM>(len), static_cast<LPARAM>(len));
+    SendMessageW(edit_, EM_REPLACESEL, FALSE, reinterpret_cast<LPARAM>(line.c_str()));
+}
+
+LRESULT CALLBACK ReferenceDialog::WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+    ReferenceDialog* self = reinterpret_cast<ReferenceDialog*>(GetWindowLongPtrW(hwnd, GWLP_USERDATA));
+    if (msg == WM_NCCREATE) {
+        CREATESTRUCTW* cs = reinterpret_cast<CREATESTRUCTW*>(lParam);
+        self = reinterpret_cast<ReferenceDialog*>(cs->lpCreateParams);
+        SetWindowLongPtrW(hwnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(self));
+    }
+    if (self) {
+        return self->handle_message(hwnd, msg, wParam, lParam);
+    }
+    return DefWindowProcW(hwnd, msg, wParam, lParam);
+}
+
+LRESULT ReferenceDialog::handle_message(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+    switch (msg) {
+    case WM_CREATE: {
+        hint_ = CreateWindowW(L"STATIC", kHintText, WS_CHILD | WS_VISIBLE,
+                              10, 10, 680, 56, hwnd, nullptr, nullptr, nullptr);
+        edit_ = CreateWindowExW(WS_EX_CLIENTEDGE, L"EDIT", L"", WS_CHILD | WS_VISIBLE | WS_TABSTOP | ES_MULTILINE |
+                                ES_WANTRETURN | WS_VSCROLL | ES_AUTOVSCROLL | ES_AUTOHSCROLL, 10, 76, 680, 200, hwnd,
+                                nullptr, nullptr, nullptr);
+        font_ = CreateFontW(16, 0, 0, 0, FW_NORMAL, FALSE, FALSE, FALSE, DEFAULT_CHARSET,
+                            OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS, CLEARTYPE_QUALITY, FIXED_PITCH, L"Consolas");
+        if (font_) {
+            SendMessageW(edit_, WM_SETFONT, reinterpret_cast<WPARAM>(font_), TRUE);
+        }
+        std::wstring text;
+        for (const auto& overlay : current_) {
+            text += to_wstring(overlay->definition()) + L"\r\n";
+        }
+        SetWindowTextW(edit_, text.c_str());
+
+        btn_browse_ = CreateWindowW(L"BUTTON", L"Add...", WS_CHILD | WS_VISIBLE | WS_TABSTOP | BS_PUSHBUTTON,
+                                    430, 286, 80, 26, hwnd, reinterpret_cast<HMENU>(1), nullptr, nullptr);
+        btn_apply_ = CreateWindowW(L"BUTTON", L"Apply", WS_CHILD | WS_VISIBLE | WS_TABSTOP | BS_PUSHBUTTON,
+                                   520, 286, 80, 26, hwnd, reinterpret_cast<HMENU>(2), nullptr, nullptr);
+        btn_close_ = CreateWindowW(L"BUTTON", L"Close", WS_CHILD | WS_VISIBLE | WS_TABSTOP | BS_PUSHBUTTON,
+                                   610, 286, 80, 26, hwnd, reinterpret_cast<HMENU>(3), nullptr, nullptr);
+        return 0;
+    }
+    case WM_SIZE: {
+        int w = LOWORD(lParam);
+        int h = HIWORD(lParam);
+        if (edit_ && btn_browse_ && btn_apply_ && btn_close_) {
+            int margin = 10;
+            int hint_h = 56;
+            int btn_h = 26;
+            int btn_w = 80;
+            MoveWindow(hint_, margin, margin, w - 2 * margin, hint_h, TRUE);
+            MoveWindow(edit_, margin, 2 * margin + hint_h, w - 2 * margin, h - 4 * margin - hint_h - btn_h, TRUE);
+            MoveWindow(btn_browse_, w - 3 * btn_w - 3 * margin, h - btn_h - margin, btn_w, btn_h, TRUE);
+            MoveWindow(btn_apply_, w - 2 * btn_w - 2 * margin, h - btn_h - margin, btn_w, btn_h, TRUE);
+            MoveWindow(btn_close_, w - btn_w - margin, h - btn_h - margin, btn_w, btn_h, TRUE);
+        }
+        return 0;
+    }
+    case WM_COMMAND: {
+        HWND from = reinterpret_cast<HWND>(lParam);
+        if (from == btn_browse_) {
+            browse();
+            return 0;
+        }
+        if (from == btn_apply_) {
+            std::wstring error;
+            if (!apply(&error)) {
+                MessageBoxW(hwnd, error.c_str(), L"Reference Traces", MB_OK | MB_ICONWARNING);
+            }
+            return 0;
+        }
+        if (from == btn_close_) {
+            DestroyWindow(hwnd);
+            return 0;
+        }
+        break;
+    }
+    case WM_CLOSE:
+        DestroyWindow(hwnd);
+        return 0;
+    case WM_DESTROY:
+        if (font_) {
+            DeleteObject(font_);
+            font_ = nullptr;
+        }
+        hwnd_ = nullptr;
+        hint_ = nullptr;
+        edit_ = nullptr;
+        btn_browse_ = nullptr;
+        btn_apply_ = nullptr;
+        btn_close_ = nullptr;
+        break;
+    }
+    return DefWindowProcW(hwnd, msg, wParam, lParam);
+}
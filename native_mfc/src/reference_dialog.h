@@ -0,0 +1,41 @@
+#pragma once
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+class ReferenceOverlay;
+
+// Edits the reference recordings drawn under the live traces, one
+// definition per line (see parse_reference); Apply opens them all and
+// hands the new set to on_apply.
+class ReferenceDialog {
+public:
+    using References = std::vector<std::shared_ptr<const ReferenceOverlay>>;
+
+    void show(HWND parent, const References& current, std::function<void(References)> on_apply);
+
+private:
+    static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
+    LRESULT handle_message(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
+    // Opens every line; nothing changes unless all of them open.
+    bool apply(std::wstring* error);
+    // Appends a line for a recording picked in a file dialog.
+    void browse();
+
+    References current_;
+    std::function<void(References)> on_apply_;
+    HWND hwnd_ = nullptr;
+    HWND hint_ = nullptr;
+    HWND edit_ = nullptr;
+    HWND btn_browse_ = nullptr;
+    HWND btn_apply_ = nullptr;
+    HWND btn_close_ = nullptr;
+    HFONT font_ = nullptr;
+};
@@ -0,0 +1,576 @@
+#include "reference_trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <type_traits>
+
+#include "channel_model.h"
+#include "mapped_file.h"
+
+namespace {
+constexpr char kRecordingMagic[8] = {'S', 'C', 'C', 'R', 'E', 'C', '0', '1'};
+constexpr char kIndexMagic[8] = {'S', 'C', 'C', 'R', 'I', 'X', '0', '1'};
+constexpr const char* kIndexSuffix = ".scci";
+constexpr size_t kSampleRecord = 1 + 2 + 8 + 4;
+constexpr size_t kMaxChannelIds = 0x10000;
+constexpr int kLevels = ReferenceTrace::kLevels;
+
+// Index file: header, one entry per channel, then the names and the
+// 8-byte aligned columns the entries point at.
+struct IndexHeader {
+    char magic[8];
+    uint64_t source_size;
+    int64_t source_mtime;
+    uint32_t channels;
+    uint32_t reserved;
+};
+
+struct IndexChannel {
+    uint64_t count;
+    uint64_t t_offset;  // f64[count]
+    uint64_t v_offset;  // i32[count]
+    uint64_t level_offset[kLevels];  // LodBucket[level_count]
+    uint64_t level_count[kLevels];
+    uint64_t name_offset;
+    uint64_t name_len;
+};
+
+static_assert(std::is_trivially_copyable<LodBucket>::value && sizeof(LodBucket) % 8 == 0,
+              "LodBucket is stored as is in the index");
+
+uint64_t align8(uint64_t n) {
+    return (n + 7) & ~uint64_t(7);
+}
+
+size_t level_span(int level) {
+    size_t span = 1;
+    for (int k = 0; k < level; ++k) {
+        span *= LodPyramid::kFanout;
+    }
+    return span;
+}
+
+bool source_stamp(const std::string& path, uint64_t* size, int64_t* mtime) {
+    std::error_code ec;
+    *size = static_cast<uint64_t>(std::filesystem::file_size(path, ec));
+    if (ec) {
+        return false;
+    }
+    *mtime = static_cast<int64_t>(std::filesystem::last_write_time(path, ec).time_since_epoch().count());
+    return !ec;
+}
+
+// Calls on_define(id, name) and on_sample(id, t, v) for each record; a
+// truncated last record (a recording still being written) is ignored.
+bool scan_recording(const uint8_t* data, uint64_t size,
+                    const std::function<void(uint16_t, const std::string&)>& on_define,
+                    const std::function<void(uint16_t, double, int)>& on_sample, std::string* error) {
+    if (size < sizeof(kRecordingMagic) || std::memcmp(data, kRecordingMagic, sizeof(kRecordingMagic)) != 0) {
+        *error = "Not a binary recording";
+        return false;
+    }
+    uint64_t pos = sizeof(kRecordingMagic);
+    while (pos < size) {
+        uint8_t tag = data[pos];
+        uint16_t id = 0;
+        if (tag == 'S') {
+            if (size - pos < kSampleRecord) {
+                break;
+            }
+            double t = 0.0;
+            int32_t v = 0;
+            std::memcpy(&id, data + pos + 1, sizeof(id));
+            std::memcpy(&t, data + pos + 3, sizeof(t));
+            std::memcpy(&v, data + pos + 11, sizeof(v));
+            on_sample(id, t, v);
+            pos += kSampleRecord;
+        } else if (tag == 'K') {
+            if (size - pos < 4 || size - pos < 4u + data[pos + 3]) {
+                break;
+            }
+            std::memcpy(&id, data + pos + 1, sizeof(id));
+            on_define(id, std::string(reinterpret_cast<const char*>(data + pos + 4), data[pos + 3]));
+            pos += 4u + data[pos + 3];
+        } else {
+            *error = "Corrupt recording at byte " + std::to_string(pos);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Writes the index for the recording at source to the first of targets
+// that can be created (via a temporary file renamed into place): one pass
+// to size the channels, one to fill them.
+bool build_index(const std::string& source, const std::vector<std::string>& targets, std::string* built,
+                 std::string* error) {
+    uint64_t source_size = 0;
+    int64_t source_mtime = 0;
+    std::shared_ptr<const MappedFile> recording = MappedFile::open(source);
+    if (!recording || !source_stamp(source, &source_size, &source_mtime)) {
+        *error = "Cannot open recording: " + source;
+        return false;
+    }
+
+    std::vector<int> channel_of(kMaxChannelIds, -1);
+    std::vector<std::string> names;
+    std::vector<uint64_t> counts;
+    bool undefined = false;
+    bool ok = scan_recording(recording->data(), recording->size(),
+        [&](uint16_t id, const std::string& name) {
+            if (channel_of[id] < 0) {
+                channel_of[id] = static_cast<int>(names.size());
+                names.push_back(name);
+                counts.push_back(0);
+            }
+        },
+        [&](uint16_t id, double, int) {
+            if (channel_of[id] < 0) {
+                undefined = true;
+                return;
+            }
+            counts[static_cast<size_t>(channel_of[id])]++;
+        },
+        error);
+    if (!ok) {
+        return false;
+    }
+    if (undefined) {
+        *error = "Corrupt recording: sample of an undefined channel";
+        return false;
+    }
+
+    std::vector<IndexChannel> entries(names.size());
+    uint64_t offset = sizeof(IndexHeader) + entries.size() * sizeof(IndexChannel);
+    for (size_t c = 0; c < entries.size(); ++c) {
+        entries[c].name_offset = offset;
+        entries[c].name_len = names[c].size();
+        offset += names[c].size();
+    }
+    for (size_t c = 0; c < entries.size(); ++c) {
+        IndexChannel& e = entries[c];
+        e.count = counts[c];
+        e.t_offset = offset = align8(offset);
+        offset += e.count * sizeof(double);
+        e.v_offset = offset = align8(offset);
+        offset += e.count * sizeof(int32_t);
+        for (int k = 0; k < kLevels; ++k) {
+            size_t span = level_span(k + 1);
+            e.level_count[k] = (e.count + span - 1) / span;
+            e.level_offset[k] = offset = align8(offset);
+            offset += e.level_count[k] * sizeof(LodBucket);
+        }
+    }
+
+    std::string target;
+    std::string temp;
+    std::shared_ptr<MappedFile> out;
+    for (const auto& candidate : targets) {
+        target = candidate;
+        temp = target + ".tmp";
+        out = MappedFile::create(temp, offset);
+        if (out) {
+            break;
+        }
+    }
+    if (!out) {
+        *error = "Cannot create reference index: " + temp;
+        return false;
+    }
+    {
+        uint8_t* base = out->mutable_data();
+        IndexHeader header = {};
+        std::memcpy(header.magic, kIndexMagic, sizeof(kIndexMagic));
+        header.source_size = source_size;
+        header.source_mtime = source_mtime;
+        header.channels = static_cast<uint32_t>(entries.size());
+        std::memcpy(base, &header, sizeof(header));
+        for (size_t c = 0; c < entries.size(); ++c) {
+            std::memcpy(base + sizeof(IndexHeader) + c * sizeof(IndexChannel), &entries[c], sizeof(IndexChannel));
+            std::memcpy(base + entries[c].name_offset, names[c].data(), names[c].size());
+        }
+
+        struct Fill {
+            double* t;
+            int* v;
+            LodBucket* levels[kLevels];
+            uint64_t n = 0;
+        };
+        std::vector<Fill> fills(entries.size());
+        for (size_t c = 0; c < entries.size(); ++c) {
+            fills[c].t = reinterpret_cast<double*>(base + entries[c].t_offset);
+            fills[c].v = reinterpret_cast<int*>(base + entries[c].v_offset);
+            for (int k = 0; k < kLevels; ++k) {
+                fills[c].levels[k] = reinterpret_cast<LodBucket*>(base + entries[c].level_offset[k]);
+            }
+        }
+        const size_t spans[kLevels] = {level_span(1), level_span(2), level_span(3)};
+        static_assert(kLevels == 3, "spans lists one entry per level");
+        scan_recording(recording->data(), recording->size(), [](uint16_t, const std::string&) {},
+            [&](uint16_t id, double t, int v) {
+                Fill& f = fills[static_cast<size_t>(channel_of[id])];
+                // Columns are searched by time, so a step back is held.
+                if (f.n > 0 && t < f.t[f.n - 1]) {
+                    t = f.t[f.n - 1];
+                }
+                f.t[f.n] = t;
+                f.v[f.n] = v;
+                for (int k = 0; k < kLevels; ++k) {
+                    LodBucket& b = f.levels[k][f.n / spans[k]];
+                    if (f.n % spans[k] == 0) {
+                        b = LodBucket{t, v, v, v, v};
+                    } else {
+                        b.vmin = std::min(b.vmin, v);
+                        b.vmax = std::max(b.vmax, v);
+                        b.vlast = v;
+                    }
+                }
+                f.n++;
+            },
+            error);
+    }
+    out.reset();
+
+    std::error_code ec;
+    std::filesystem::rename(temp, target, ec);
+    if (ec) {
+        std::filesystem::remove(temp, ec);
+        *error = "Cannot create reference index: " + target;
+        return false;
+    }
+    *built = target;
+    return true;
+}
+
+// The index at path when it was built from the recording as it is now.
+std::shared_ptr<const MappedFile> open_current_index(const std::string& path, uint64_t source_size,
+                                                     int64_t source_mtime) {
+    std::error_code ec;
+    if (!std::filesystem::is_regular_file(path, ec)) {
+        return nullptr;
+    }
+    std::shared_ptr<const MappedFile> index = MappedFile::open(path);
+    if (!index || index->size() < sizeof(IndexHeader)) {
+        return nullptr;
+    }
+    IndexHeader header = {};
+    std::memcpy(&header, index->data(), sizeof(header));
+    if (std::memcmp(header.magic, kIndexMagic, sizeof(kIndexMagic)) != 0 || header.source_size != source_size ||
+        header.source_mtime != source_mtime) {
+        return nullptr;
+    }
+    return index;
+}
+
+// Index locations to try: next to the recording, then the temp directory
+// under a name derived from the recording's full path.
+std::vector<std::string> index_candidates(const std::string& path) {
+    std::vector<std::string> out = {path + kIndexSuffix};
+    std::error_code ec;
+    std::filesystem::path temp = std::filesystem::temp_directory_path(ec);
+    if (!ec) {
+        std::string full = std::filesystem::absolute(path, ec).string();
+        char hash[20] = {};
+        std::snprintf(hash, sizeof(hash), "%016llx",
+                      static_cast<unsigned long long>(std::hash<std::string>()(full)));
+        std::string name = std::filesystem::path(path).filename().string() + "." + hash + kIndexSuffix;
+        out.push_back((temp / name).string());
+    }
+    return out;
+}
+
+size_t bucket_upper_bound(const LodBucket* buckets, size_t count, double t) {
+    return static_cast<size_t>(std::upper_bound(buckets, buckets + count, t,
+        [](double value, const LodBucket& b) { return value < b.t; }) - buckets);
+}
+
+std::string next_token(const std::string& text, size_t* pos, bool* quoted) {
+    size_t i = text.find_first_not_of(" \t\r\n", *pos);
+    *quoted = false;
+    if (i == std::string::npos) {
+        *pos = text.size();
+        return "";
+    }
+    if (text[i] == '"') {
+        size_t end = text.find('"', i + 1);
+        *quoted = true;
+        *pos = end == std::string::npos ? text.size() : end + 1;
+        return text.substr(i + 1, (end == std::string::npos ? text.size() : end) - i - 1);
+    }
+    size_t end = text.find_first_of(" \t\r\n", i);
+    *pos = end == std::string::npos ? text.size() : end;
+    return text.substr(i, *pos - i);
+}
+} // namespace
+
+bool ReferenceTrace::open(const std::string& path, std::string* error) {
+    std::string err;
+    uint64_t source_size = 0;
+    int64_t source_mtime = 0;
+    if (!source_stamp(path, &source_size, &source_mtime)) {
+        err = "Cannot open recording: " + path;
+    } else {
+        std::vector<std::string> candidates = index_candidates(path);
+        std::shared_ptr<const MappedFile> index;
+        std::string index_path;
+        for (const auto& candidate : candidates) {
+            index = open_current_index(candidate, source_size, source_mtime);
+            if (index) {
+                index_path = candidate;
+                break;
+            }
+        }
+        if (!index && build_index(path, candidates, &index_path, &err)) {
+            index = open_current_index(index_path, source_size, source_mtime);
+            if (!index) {
+                err = "Cannot open reference index: " + index_path;
+            }
+        }
+        if (index && load_index(index, &err)) {
+            path_ = path;
+            index_path_ = index_path;
+            return true;
+        }
+    }
+    if (error) {
+        *error = err;
+    }
+    return false;
+}
+
+bool ReferenceTrace::load_index(const std::shared_ptr<const MappedFile>& index, std::string* error) {
+    const uint8_t* base = index->data();
+    const uint64_t size = index->size();
+    IndexHeader header = {};
+    std::memcpy(&header, base, sizeof(header));
+    if (header.channels > kMaxChannelIds ||
+        sizeof(IndexHeader) + uint64_t(header.channels) * sizeof(IndexChannel) > size) {
+        *error = "Invalid reference index";
+        return false;
+    }
+    auto fits = [size](uint64_t offset, uint64_t count, uint64_t elem) {
+        return offset % 8 == 0 && offset <= size && count <= (size - offset) / elem;
+    };
+
+    std::vector<Channel> channels(header.channels);
+    std::unordered_map<std::string, int> ids;
+    for (size_t c = 0; c < channels.size(); ++c) {
+        IndexChannel e = {};
+        std::memcpy(&e, base + sizeof(IndexHeader) + c * sizeof(IndexChannel), sizeof(e));
+        bool valid = e.name_offset <= size && e.name_len <= size - e.name_offset &&
+                     fits(e.t_offset, e.count, sizeof(double)) && fits(e.v_offset, e.count, sizeof(int32_t));
+        for (int k = 0; k < kLevels; ++k) {
+            size_t span = level_span(k + 1);
+            valid = valid && e.level_count[k] == (e.count + span - 1) / span &&
+                    fits(e.level_offset[k], e.level_count[k], sizeof(LodBucket));
+        }
+        if (!valid) {
+            *error = "Invalid reference index";
+            return false;
+        }
+        Channel& ch = channels[c];
+        ch.key.assign(reinterpret_cast<const char*>(base + e.name_offset), static_cast<size_t>(e.name_len));
+        ch.count = static_cast<size_t>(e.count);
+        ch.t = reinterpret_cast<const double*>(base + e.t_offset);
+        ch.v = reinterpret_cast<const int*>(base + e.v_offset);
+        for (int k = 0; k < kLevels; ++k) {
+            ch.levels[k] = reinterpret_cast<const LodBucket*>(base + e.level_offset[k]);
+            ch.level_count[k] = static_cast<size_t>(e.level_count[k]);
+        }
+        ids.emplace(ch.key, static_cast<int>(c));
+    }
+    index_ = index;
+    channels_ = std::move(channels);
+    ids_ = std::move(ids);
+    return true;
+}
+
+int ReferenceTrace::find(const std::string& key) const {
+    auto it = ids_.find(key);
+    return it == ids_.end() ? -1 : it->second;
+}
+
+uint64_t ReferenceTrace::total_samples() const {
+    uint64_t total = 0;
+    for (const auto& ch : channels_) {
+        total += ch.count;
+    }
+    return total;
+}
+
+bool ReferenceTrace::time_span(double* t_first, double* t_last) const {
+    bool any = false;
+    for (const auto& ch : channels_) {
+        if (ch.count == 0) {
+            continue;
+        }
+        *t_first = any ? std::min(*t_first, ch.t[0]) : ch.t[0];
+        *t_last = any ? std::max(*t_last, ch.t[ch.count - 1]) : ch.t[ch.count - 1];
+        any = true;
+    }
+    return any;
+}
+
+SampleRing::Segment ReferenceTrace::between(size_t ch, double t_start, double t_end) const {
+    const Channel& c = channels_[ch];
+    const double* first = std::lower_bound(c.t, c.t + c.count, t_start);
+    const double* last = std::upper_bound(first, c.t + c.count, t_end);
+    size_t i = static_cast<size_t>(first - c.t);
+    return SampleRing::Segment{first, c.v + i, static_cast<size_t>(last - first)};
+}
+
+LodView ReferenceTrace::select(size_t ch, double t_start, double t_end, int pixels) const {
+    int level = LodPyramid::select_level(between(ch, t_start, t_end).count, pixels);
+    if (level == 0) {
+        return LodView();
+    }
+    const Channel& c = channels_[ch];
+    const LodBucket* buckets = c.levels[level - 1];
+    size_t count = c.level_count[level - 1];
+    // Include the bucket that starts before t_start but may reach into it.
+    size_t first = bucket_upper_bound(buckets, count, t_start);
+    first = first > 0 ? first - 1 : 0;
+    size_t last = bucket_upper_bound(buckets, count, t_end);
+    return LodView(buckets, level, first, last);
+}
+
+void ReferenceTrace::draw_points(size_t ch, double offset, double t_start, double t_end, int pixels,
+                                 std::vector<ChannelSample>* out) const {
+    out->clear();
+    if (pixels <= 0 || t_end <= t_start) {
+        return;
+    }
+    LodView lod = select(ch, t_start, t_end, pixels);
+    if (!lod.empty()) {
+        lod.to_step_points(t_start, t_end, pixels, out);
+    } else {
+        SampleRing::Segment seg = between(ch, t_start, t_end);
+        double px_per_sec = static_cast<double>(pixels) / (t_end - t_start);
+        long last_px = std::numeric_limits<long>::min();
+        for (size_t i = 0; i < seg.count; ++i) {
+            ChannelSample sample{seg.t[i], seg.v[i]};
+            long px = std::lround((sample.t - t_start) * px_per_sec);
+            if (px == last_px) {
+                out->back() = sample;
+            } else {
+                out->push_back(sample);
+                last_px = px;
+            }
+        }
+    }
+    for (auto& p : *out) {
+        p.t += offset;
+    }
+}
+
+bool ReferenceTrace::first_trigger(size_t ch, const TriggerSpec& spec, double* t) const {
+    const Channel& c = channels_[ch];
+    Trigger trigger(spec, std::string());
+    for (size_t i = 0; i < c.count; ++i) {
+        if (trigger.on_sample(c.t[i], c.v[i], t)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parse_reference(const std::string& text, ReferenceSpec* out, std::string* error) {
+    ReferenceSpec spec;
+    size_t pos = 0;
+    bool quoted = false;
+    spec.path = next_token(text, &pos, &quoted);
+    if (spec.path.empty()) {
+        *error = "Missing recording path";
+        return false;
+    }
+    while (true) {
+        std::string token = next_token(text, &pos, &quoted);
+        if (token.empty() && !quoted) {
+            break;
+        }
+        size_t eq = token.find('=');
+        if (token == "connect") {
+            spec.align = ReferenceSpec::Align::kConnect;
+        } else if (token == "trigger") {
+            spec.align = ReferenceSpec::Align::kTrigger;
+        } else if (eq != std::string::npos && eq > 0 && eq + 1 < token.size()) {
+            spec.map.emplace_back(token.substr(0, eq), token.substr(eq + 1));
+        } else {
+            *error = "Unexpected '" + token + "' (expected connect, trigger or LIVE=REF)";
+            return false;
+        }
+    }
+    *out = std::move(spec);
+    return true;
+}
+
+bool ReferenceOverlay::open(const std::string& definition, std::string* error) {
+    ReferenceSpec spec;
+    ReferenceTrace trace;
+    if (!parse_reference(definition, &spec, error) || !trace.open(spec.path, error)) {
+        return false;
+    }
+    definition_ = definition;
+    spec_ = std::move(spec);
+    trace_ = std::move(trace);
+    map_.clear();
+    for (const auto& pair : spec_.map) {
+        map_[pair.first] = pair.second;
+    }
+    trigger_times_.clear();
+    return true;
+}
+
+int ReferenceOverlay::channel_for(const std::string& live_key) const {
+    auto it = map_.find(live_key);
+    return trace_.find(it == map_.end() ? live_key : it->second);
+}
+
+bool ReferenceOverlay::offset(const ChannelModel& model, double* out) const {
+    if (spec_.align == ReferenceSpec::Align::kConnect) {
+        double live_start = 0.0;
+        double ref_start = 0.0;
+        double ref_end = 0.0;
+        if (!model.get_session_start(&live_start) || !trace_.time_span(&ref_start, &ref_end)) {
+            return false;
+        }
+        *out = live_start - ref_start;
+        return true;
+    }
+
+    size_t captures = model.get_capture_count();
+    if (captures == 0) {
+        return false;
+    }
+    uint64_t seq = model.get_capture_seq();
+    if (seq != capture_seq_) {
+        if (!model.get_capture(captures - 1, &capture_)) {
+            return false;
+        }
+        capture_seq_ = seq;
+    }
+    const TriggerCapture* capture = &capture_;
+    auto it = trigger_times_.find(capture->trigger);
+    if (it == trigger_times_.end()) {
+        double t = std::numeric_limits<double>::quiet_NaN();
+        TriggerSpec spec;
+        std::string error;
+        if (parse_trigger(capture->trigger, &spec, &error)) {
+            int ch = channel_for(spec.key);
+            if (ch >= 0 && !trace_.first_trigger(static_cast<size_t>(ch), spec, &t)) {
+                t = std::numeric_limits<double>::quiet_NaN();
+            }
+        }
+        it = trigger_times_.emplace(capture->trigger, t).first;
+    }
+    if (std::isnan(it->second)) {
+        return false;
+    }
+    *out = capture->t - it->second;
+    return true;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "lod_pyramid.h"
+#include "sample_ring.h"
+#include "trigger.h"
+
+class ChannelModel;
+class MappedFile;
+
+// A binary recording (see RecordingWriter) opened for drawing under live
+// data. The recording interleaves channels, so on first use it is
+// transcoded into a per-channel index file next to it (or in the temp
+// directory when that is not writable): time and value columns plus the
+// same pyramid levels LodPyramid keeps. The index is memory-mapped and
+// reused while the recording's size and modification time match, so a
+// multi-hour reference costs address space rather than memory and a frame
+// reads only the buckets it draws.
+class ReferenceTrace {
+public:
+    static constexpr int kLevels = LodPyramid::kLevels;
+
+    bool open(const std::string& path, std::string* error);
+    bool is_open() const { return index_ != nullptr; }
+    const std::string& path() const { return path_; }
+    const std::string& index_path() const { return index_path_; }
+
+    size_t channel_count() const { return channels_.size(); }
+    const std::string& key(size_t ch) const { return channels_[ch].key; }
+    // Channel index for key, -1 when the recording has none.
+    int find(const std::string& key) const;
+    size_t sample_count(size_t ch) const { return channels_[ch].count; }
+    uint64_t total_samples() const;
+    // Earliest and latest sample time over all channels; false when empty.
+    bool time_span(double* t_first, double* t_last) const;
+
+    // Samples with t_start <= time <= t_end, straight from the mapping.
+    SampleRing::Segment between(size_t ch, double t_start, double t_end) const;
+    // Same level rule as LodPyramid::select; an empty level-0 view when
+    // the raw samples are sparse enough to draw directly.
+    LodView select(size_t ch, double t_start, double t_end, int pixels) const;
+    // Step-plot points for [t_start, t_end] (reference time) drawn pixels
+    // wide, shifted by offset: pyramid buckets for long spans, otherwise
+    // the last raw sample per pixel column.
+    void draw_points(size_t ch, double offset, double t_start, double t_end, int pixels,
+                     std::vector<ChannelSample>* out) const;
+    // Time the trigger first fires on channel ch; spec.key is ignored.
+    bool first_trigger(size_t ch, const TriggerSpec& spec, double* t) const;
+
+private:
+    struct Channel {
+        std::string key;
+        size_t count = 0;
+        const double* t = nullptr;
+        const int* v = nullptr;
+        const LodBucket* levels[kLevels] = {};
+        size_t level_count[kLevels] = {};
+    };
+
+    bool load_index(const std::shared_ptr<const MappedFile>& index, std::string* error);
+
+    std::string path_;
+    std::string index_path_;
+    std::shared_ptr<const MappedFile> index_;
+    std::vector<Channel> channels_;
+    std::unordered_map<std::string, int> ids_;
+};
+
+// How a reference is drawn: which recording, how its time axis lines up
+// with the live one and which of its channels goes under which live key.
+struct ReferenceSpec {
+    enum class Align : uint8_t {
+        // Reference start at the live session's first sample.
+        kConnect,
+        // Time the newest capture's trigger first fires in the reference at
+        // that capture's trigger time; nothing is drawn before a capture.
+        kTrigger,
+    };
+
+    std::string path;
+    Align align = Align::kConnect;
+    // (live key, reference key); unlisted live keys use the same name.
+    std::vector<std::pair<std::string, std::string>> map;
+};
+
+// Parses "PATH [connect|trigger] [LIVE=REF ...]"; PATH may be quoted.
+bool parse_reference(const std::string& text, ReferenceSpec* out, std::string* error);
+
+// An opened reference and its alignment against a live model.
+class ReferenceOverlay {
+public:
+    bool open(const std::string& definition, std::string* error);
+
+    const std::string& definition() const { return definition_; }
+    const ReferenceSpec& spec() const { return spec_; }
+    const ReferenceTrace& trace() const { return trace_; }
+
+    // Reference channel drawn under live_key, -1 when none.
+    int channel_for(const std::string& live_key) const;
+    // Live time minus reference time; false while there is nothing to
+    // align to. The reference search for a trigger runs once per
+    // definition.
+    bool offset(const ChannelModel& model, double* out) const;
+
+private:
+    std::string definition_;
+    ReferenceSpec spec_;
+    ReferenceTrace trace_;
+    std::unordered_map<std::string, std::string> map_;
+    // Trigger definition -> reference time of its first firing (NaN: never).
+    mutable std::unordered_map<std::string, double> trigger_times_;
+    // Newest capture seen, refetched when the model's sequence moves on.
+    mutable uint64_t capture_seq_ = 0;
+    mutable TriggerCapture capture_;
+};
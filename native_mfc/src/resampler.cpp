@@ -0,0 +1,612 @@
+#include "resampler.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <thread>
+
+#include "channel_model.h"
+
+namespace {
+constexpr double kInitialSpan = 1.0;
+// First look-back for the sample before the grid, and look-ahead past the
+// end; grows 8x while empty.
+constexpr double kProbeSpan = 0.001;
+// Samples per read_history call the chunk span is steered towards.
+constexpr size_t kChunkSamples = 16384;
+constexpr size_t kCsvBufferBytes = size_t(1) << 20;
+// Exports are split into parts of about this much text, one per task.
+constexpr double kPartBytes = 8.0 * 1024 * 1024;
+constexpr size_t kMaxThreads = 8;
+constexpr uint64_t kMinParallelRows = 65536;
+constexpr double kNaN = std::numeric_limits<double>::quiet_NaN();
+
+double before(double t) {
+    return std::nextafter(t, -std::numeric_limits<double>::infinity());
+}
+
+double after(double t) {
+    return std::nextafter(t, std::numeric_limits<double>::infinity());
+}
+
+// Kept free of early exits so the compiler vectorises it.
+void reduce_range(const int* v, size_t n, int* lo, int* hi) {
+    int a = *lo;
+    int b = *hi;
+    for (size_t i = 0; i < n; ++i) {
+        a = v[i] < a ? v[i] : a;
+        b = v[i] > b ? v[i] : b;
+    }
+    *lo = a;
+    *hi = b;
+}
+
+const char kDigitPairs[] =
+    "0001020304050607080910111213141516171819202122232425262728293031323334353637383940414243444546474849"
+    "5051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
+
+char* put_uint(char* p, uint64_t n) {
+    char digits[20];
+    char* end = digits + sizeof(digits);
+    char* q = end;
+    while (n >= 100) {
+        q -= 2;
+        std::memcpy(q, kDigitPairs + (n % 100) * 2, 2);
+        n /= 100;
+    }
+    if (n >= 10) {
+        q -= 2;
+        std::memcpy(q, kDigitPairs + n * 2, 2);
+    } else {
+        *--q = static_cast<char>('0' + n);
+    }
+    std::memcpy(p, q, static_cast<size_t>(end - q));
+    return p + (end - q);
+}
+
+// Fixed-point formatting without snprintf, which would dominate a large
+// export. Trailing fraction zeros are dropped unless keep_zeros is set.
+template <int kDecimals, uint64_t kScale>
+char* put_fixed(char* p, double v, bool keep_zeros) {
+    double scaled = std::round(std::fabs(v) * static_cast<double>(kScale));
+    if (!(scaled < 9e18)) {
+        return p + std::snprintf(p, 32, "%.17g", v);
+    }
+    uint64_t n = static_cast<uint64_t>(scaled);
+    if (v < 0.0 && n != 0) {
+        *p++ = '-';
+    }
+    p = put_uint(p, n / kScale);
+    uint64_t frac = n % kScale;
+    if (frac == 0 && !keep_zeros) {
+        return p;
+    }
+    *p++ = '.';
+    int len = kDecimals;
+    if (!keep_zeros) {
+        while (frac % 10 == 0) {
+            frac /= 10;
+            len--;
+        }
+    }
+    for (int i = len - 1; i >= 0; --i) {
+        p[i] = static_cast<char>('0' + frac % 10);
+        frac /= 10;
+    }
+    return p + len;
+}
+
+// Hold and min/max values are whole numbers; only interpolated ones get a
+// fraction (up to three digits).
+char* put_value(char* p, double v) {
+    if (v == std::floor(v) && std::fabs(v) < 9e15) {
+        if (v < 0.0) {
+            *p++ = '-';
+        }
+        return put_uint(p, static_cast<uint64_t>(std::fabs(v)));
+    }
+    return put_fixed<3, 1000>(p, v, false);
+}
+} // namespace
+
+bool parse_resample_policy(const std::string& text, ResamplePolicy* out) {
+    if (text == "hold") {
+        *out = ResamplePolicy::kHold;
+    } else if (text == "linear") {
+        *out = ResamplePolicy::kLinear;
+    } else if (text == "minmax") {
+        *out = ResamplePolicy::kMinMax;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// One channel's samples from the last row onwards, read a chunk at a time.
+// Consumed samples are discarded on each read except the newest, which the
+// hold and linear policies still need.
+struct Resampler::Cursor {
+    struct Range {
+        size_t count = 0;
+        int min = INT_MAX;
+        int max = INT_MIN;
+    };
+
+    std::string key;
+    bool has_data = false;
+    double t_last = 0.0;     // newest sample when the export started
+    double loaded_to = 0.0;  // every sample up to this time has been read
+    double stop_t = 0.0;     // reads stop here unless a later sample is needed
+    double span = kInitialSpan;
+    double probe = kProbeSpan;
+    std::vector<ChannelSample> scratch;
+    std::vector<double> t;
+    std::vector<int> v;
+    size_t pos = 0;          // first sample not yet consumed
+
+    bool exhausted() const { return !has_data || loaded_to >= t_last; }
+
+    void load_chunk(const ChannelModel& model, uint64_t* read) {
+        size_t keep = pos > 0 ? pos - 1 : 0;
+        t.erase(t.begin(), t.begin() + static_cast<std::ptrdiff_t>(keep));
+        v.erase(v.begin(), v.begin() + static_cast<std::ptrdiff_t>(keep));
+        pos -= keep;
+
+        // Past stop_t only the next sample is wanted, so look ahead in
+        // small steps that grow up to the chunk span across gaps.
+        bool beyond = loaded_to >= stop_t;
+        double to = loaded_to + (beyond ? probe : span);
+        bool clamped = !beyond && to > stop_t;
+        to = std::min(clamped ? stop_t : to, t_last);
+        scratch.clear();
+        model.read_history(key, after(loaded_to), to, &scratch);
+        loaded_to = to;
+        for (const auto& s : scratch) {
+            t.push_back(s.t);
+            v.push_back(s.v);
+        }
+        *read += scratch.size();
+        if (beyond) {
+            probe = std::min(probe * 8.0, span);
+        } else if (scratch.size() < kChunkSamples / 4 && !clamped) {
+            span *= 2.0;
+        } else if (scratch.size() > kChunkSamples * 2) {
+            span *= 0.5;
+        }
+    }
+
+    // Positions the cursor at the last sample before t_start.
+    void start(const ChannelModel& model, double t_start, double t_stop, uint64_t* read) {
+        double t_first = 0.0;
+        stop_t = t_stop;
+        has_data = model.get_stored_span(key, &t_first, &t_last);
+        loaded_to = before(t_start);
+        if (!has_data || t_first >= t_start) {
+            return;
+        }
+        for (double back = kProbeSpan;; back *= 8.0) {
+            double lo = std::max(t_start - back, t_first);
+            scratch.clear();
+            model.read_history(key, lo, before(t_start), &scratch);
+            *read += scratch.size();
+            if (!scratch.empty()) {
+                t.push_back(scratch.back().t);
+                v.push_back(scratch.back().v);
+                pos = 1;
+                return;
+            }
+            if (lo <= t_first) {
+                return;
+            }
+        }
+    }
+
+    // Loads until an unconsumed sample is available; false at the end.
+    bool head(const ChannelModel& model, uint64_t* read) {
+        while (pos == t.size() && !exhausted()) {
+            load_chunk(model, read);
+        }
+        return pos < t.size();
+    }
+
+    // First sample from pos on past limit. Rows usually advance by a few
+    // samples, so the search gallops from pos before bisecting.
+    size_t find_end(double limit, bool inclusive) const {
+        auto past = [&](size_t i) { return inclusive ? t[i] > limit : t[i] >= limit; };
+        size_t lo = pos;
+        size_t step = 1;
+        while (lo + step < t.size() && !past(lo + step)) {
+            lo += step;
+            step *= 2;
+        }
+        if (lo == t.size() || past(lo)) {
+            return lo;
+        }
+        size_t hi = std::min(lo + step, t.size());
+        auto first = t.begin() + static_cast<std::ptrdiff_t>(lo + 1);
+        auto last = t.begin() + static_cast<std::ptrdiff_t>(hi);
+        return static_cast<size_t>((inclusive ? std::upper_bound(first, last, limit)
+                                              : std::lower_bound(first, last, limit)) - t.begin());
+    }
+
+    // Consumes the samples up to limit (before it unless inclusive),
+    // reducing their values into *range when given.
+    void consume(const ChannelModel& model, double limit, bool inclusive, Range* range, uint64_t* read) {
+        for (;;) {
+            size_t end = find_end(limit, inclusive);
+            if (range && end > pos) {
+                range->count += end - pos;
+                reduce_range(v.data() + pos, end - pos, &range->min, &range->max);
+            }
+            pos = end;
+            if (pos < t.size() || exhausted()) {
+                return;
+            }
+            load_chunk(model, read);
+        }
+    }
+
+    double held() const { return pos > 0 ? static_cast<double>(v[pos - 1]) : kNaN; }
+
+    // Value at time x between the newest consumed sample and the next one.
+    double interpolated(double x) const {
+        if (pos == 0) {
+            return kNaN;
+        }
+        if (pos == t.size() || t[pos] <= t[pos - 1]) {
+            return held();
+        }
+        double a = static_cast<double>(v[pos - 1]);
+        double b = static_cast<double>(v[pos]);
+        return a + (b - a) * (x - t[pos - 1]) / (t[pos] - t[pos - 1]);
+    }
+};
+
+Resampler::Resampler(const ChannelModel& model, const std::vector<std::string>& keys,
+                     const ResampleGrid& grid, ResamplePolicy policy)
+    : model_(model), grid_(grid), policy_(policy) {
+    for (const auto& key : keys) {
+        cursors_.push_back(std::make_unique<Cursor>());
+        cursors_.back()->key = key;
+    }
+    if (grid_.step > 0.0 && grid_.t_end >= grid_.t_start) {
+        end_row_ = static_cast<uint64_t>(std::floor((grid_.t_end - grid_.t_start) / grid_.step + 1e-9)) + 1;
+    }
+    begin_t_ = grid_.t_start;
+    end_t_ = grid_.t_end;
+}
+
+Resampler::~Resampler() = default;
+
+size_t Resampler::columns() const {
+    return cursors_.size() * (policy_ == ResamplePolicy::kMinMax ? 2 : 1);
+}
+
+std::vector<std::string> Resampler::column_names() const {
+    std::vector<std::string> names;
+    for (const auto& c : cursors_) {
+        if (policy_ == ResamplePolicy::kMinMax) {
+            names.push_back(c->key + "_min");
+            names.push_back(c->key + "_max");
+        } else {
+            names.push_back(c->key);
+        }
+    }
+    return names;
+}
+
+bool Resampler::splittable() const {
+    return grid_.step > 0.0 || grid_.tolerance <= 0.0;
+}
+
+void Resampler::select_part(size_t index, size_t parts) {
+    if (grid_.step > 0.0) {
+        uint64_t rows = end_row_;
+        row_ = rows * index / parts;
+        end_row_ = rows * (index + 1) / parts;
+        begin_t_ = grid_.t_start + static_cast<double>(row_) * grid_.step;
+        return;
+    }
+    // Boundaries use the same expression on both sides so parts tile.
+    double span = grid_.t_end - grid_.t_start;
+    begin_t_ = grid_.t_start + span * static_cast<double>(index) / static_cast<double>(parts);
+    if (index + 1 < parts) {
+        end_t_ = before(grid_.t_start + span * static_cast<double>(index + 1) / static_cast<double>(parts));
+    }
+}
+
+void Resampler::start() {
+    started_ = true;
+    double stop = grid_.step > 0.0 ? grid_.t_start + static_cast<double>(end_row_) * grid_.step : end_t_;
+    for (auto& c : cursors_) {
+        c->start(model_, begin_t_, stop, &samples_read_);
+    }
+}
+
+bool Resampler::next(ResampledBlock* out) {
+    auto lock = model_.read_lock();
+    if (!started_) {
+        start();
+    }
+    out->columns = columns();
+    return grid_.step > 0.0 ? next_grid(out) : next_merged(out);
+}
+
+bool Resampler::next_grid(ResampledBlock* out) {
+    size_t n = static_cast<size_t>(std::min<uint64_t>(kBlockRows, end_row_ - row_));
+    if (n == 0) {
+        return false;
+    }
+    out->rows = n;
+    out->times.resize(n);
+    out->values.assign(n * out->columns, kNaN);
+    for (size_t i = 0; i < n; ++i) {
+        out->times[i] = grid_.t_start + static_cast<double>(row_ + i) * grid_.step;
+    }
+
+    size_t column = 0;
+    for (auto& cursor : cursors_) {
+        Cursor& c = *cursor;
+        double* dst = out->values.data() + column * n;
+        for (size_t i = 0; i < n; ++i) {
+            double row_t = out->times[i];
+            if (policy_ == ResamplePolicy::kHold) {
+                c.consume(model_, row_t, true, nullptr, &samples_read_);
+                dst[i] = c.held();
+            } else if (policy_ == ResamplePolicy::kLinear) {
+                c.consume(model_, row_t, true, nullptr, &samples_read_);
+                c.head(model_, &samples_read_);
+                dst[i] = c.interpolated(row_t);
+            } else {
+                // Bucket ends are computed like row times so buckets tile.
+                double bucket_end = grid_.t_start + static_cast<double>(row_ + i + 1) * grid_.step;
+                Cursor::Range range;
+                c.consume(model_, bucket_end, false, &range, &samples_read_);
+                if (range.count > 0) {
+                    dst[i] = range.min;
+                    dst[i + n] = range.max;
+                }
+            }
+        }
+        column += policy_ == ResamplePolicy::kMinMax ? 2 : 1;
+    }
+    row_ += n;
+    return true;
+}
+
+bool Resampler::next_merged(ResampledBlock* out) {
+    const size_t stride = kBlockRows;
+    out->times.clear();
+    out->values.assign(stride * out->columns, kNaN);
+    size_t n = 0;
+    while (n < kBlockRows) {
+        // The next row is the earliest unconsumed sample of any channel.
+        double row_t = std::numeric_limits<double>::infinity();
+        for (auto& c : cursors_) {
+            if (c->head(model_, &samples_read_)) {
+                row_t = std::min(row_t, c->t[c->pos]);
+            }
+        }
+        if (!(row_t <= end_t_)) {
+            break;
+        }
+        double limit = row_t + grid_.tolerance;
+        size_t column = 0;
+        for (auto& cursor : cursors_) {
+            Cursor& c = *cursor;
+            double* dst = out->values.data() + column * stride;
+            Cursor::Range range;
+            c.consume(model_, limit, true, &range, &samples_read_);
+            if (policy_ == ResamplePolicy::kHold) {
+                dst[n] = c.held();
+            } else if (policy_ == ResamplePolicy::kLinear) {
+                if (range.count == 0) {
+                    c.head(model_, &samples_read_);
+                }
+                dst[n] = range.count > 0 ? c.held() : c.interpolated(row_t);
+            } else if (range.count > 0) {
+                dst[n] = range.min;
+                dst[n + stride] = range.max;
+            }
+            column += policy_ == ResamplePolicy::kMinMax ? 2 : 1;
+        }
+        out->times.push_back(row_t);
+        n++;
+    }
+    if (n == 0) {
+        return false;
+    }
+    for (size_t col = 1; col < out->columns; ++col) {
+        std::memmove(out->values.data() + col * n, out->values.data() + col * stride, n * sizeof(double));
+    }
+    out->values.resize(n * out->columns);
+    out->rows = n;
+    row_ += n;
+    return true;
+}
+
+namespace {
+// Appends the block's rows to text[*used...], growing it as needed.
+void format_block(const ResampledBlock& block, std::vector<char>* text, size_t* used) {
+    const size_t row_bytes = 32 + 32 * block.columns;
+    for (size_t r = 0; r < block.rows; ++r) {
+        if (text->size() - *used < row_bytes) {
+            text->resize(std::max(text->size() * 2, *used + row_bytes));
+        }
+        char* p = text->data() + *used;
+        p = put_fixed<6, 1000000>(p, block.times[r], true);
+        for (size_t c = 0; c < block.columns; ++c) {
+            *p++ = ',';
+            double value = block.value(r, c);
+            if (!std::isnan(value)) {
+                p = put_value(p, value);
+            }
+        }
+        *p++ = '\n';
+        *used = static_cast<size_t>(p - text->data());
+    }
+}
+
+bool put_text(std::FILE* out, const char* data, size_t size, AlignedCsvStats* stats) {
+    stats->bytes += size;
+    return size == 0 || std::fwrite(data, 1, size, out) == size;
+}
+
+bool write_sequential(Resampler* resampler, std::FILE* out, AlignedCsvStats* stats) {
+    std::vector<char> text(kCsvBufferBytes);
+    size_t used = 0;
+    ResampledBlock block;
+    while (resampler->next(&block)) {
+        format_block(block, &text, &used);
+        stats->rows += block.rows;
+        if (used >= kCsvBufferBytes / 2) {
+            if (!put_text(out, text.data(), used, stats)) {
+                return false;
+            }
+            used = 0;
+        }
+    }
+    stats->samples = resampler->samples_read();
+    return put_text(out, text.data(), used, stats);
+}
+
+// Workers format parts in any order, at most a few ahead of the part being
+// written, so memory stays at a few parts' worth of text.
+bool write_parallel(const ChannelModel& model, const std::vector<std::string>& keys, const ResampleGrid& grid,
+                    ResamplePolicy policy, std::FILE* out, size_t parts, size_t threads, AlignedCsvStats* stats) {
+    struct Part {
+        std::vector<char> text;
+        size_t used = 0;
+        uint64_t rows = 0;
+        uint64_t samples = 0;
+        bool done = false;
+    };
+    std::vector<Part> results(parts);
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t next_part = 0;
+    size_t written = 0;
+    bool failed = false;
+    const size_t max_ahead = threads * 2;
+
+    auto worker = [&]() {
+        for (;;) {
+            size_t index = 0;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&]() { return failed || next_part >= parts || next_part < written + max_ahead; });
+                if (failed || next_part >= parts) {
+                    return;
+                }
+                index = next_part++;
+            }
+            Resampler resampler(model, keys, grid, policy);
+            resampler.select_part(index, parts);
+            Part part;
+            ResampledBlock block;
+            while (resampler.next(&block)) {
+                format_block(block, &part.text, &part.used);
+                part.rows += block.rows;
+            }
+            part.samples = resampler.samples_read();
+            part.done = true;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                results[index] = std::move(part);
+            }
+            cv.notify_all();
+        }
+    };
+    std::vector<std::thread> pool;
+    for (size_t i = 0; i < threads; ++i) {
+        pool.emplace_back(worker);
+    }
+
+    bool ok = true;
+    for (size_t i = 0; i < parts && ok; ++i) {
+        Part part;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&]() { return results[i].done; });
+            part = std::move(results[i]);
+        }
+        ok = put_text(out, part.text.data(), part.used, stats);
+        stats->rows += part.rows;
+        stats->samples += part.samples;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            written = i + 1;
+            failed = !ok;
+        }
+        cv.notify_all();
+    }
+    for (auto& thread : pool) {
+        thread.join();
+    }
+    return ok;
+}
+} // namespace
+
+bool write_aligned_csv(const ChannelModel& model, const std::vector<std::string>& keys, const ResampleGrid& grid,
+                       ResamplePolicy policy, std::FILE* out, AlignedCsvStats* stats, std::string* error) {
+    *stats = AlignedCsvStats();
+    Resampler resampler(model, keys, grid, policy);
+    stats->columns = resampler.columns();
+    std::string header = "t";
+    for (const auto& name : resampler.column_names()) {
+        header += "," + name;
+    }
+    header += "\n";
+    if (!put_text(out, header.data(), header.size(), stats)) {
+        *error = std::string("Write failed: ") + std::strerror(errno);
+        return false;
+    }
+
+    // Rows expected: exact for a step grid, from the channels' session
+    // rates for merged rows.
+    double span = std::max(0.0, grid.t_end - grid.t_start);
+    double rows = 0.0;
+    if (grid.step > 0.0) {
+        rows = span / grid.step;
+    } else {
+        auto lock = model.read_lock();
+        for (const auto& key : keys) {
+            ChannelStats session;
+            if (model.get_channel_stats(key, nullptr, &session)) {
+                rows += session.rate * span;
+            }
+        }
+    }
+    double bytes = rows * static_cast<double>(12 + 8 * stats->columns);
+    size_t threads = std::min<size_t>(kMaxThreads, std::max(1u, std::thread::hardware_concurrency()));
+    size_t parts = static_cast<size_t>(std::min(bytes / static_cast<double>(kPartBytes), 1e6));
+    parts = std::max(parts, threads * 4);
+
+    bool ok = resampler.splittable() && threads > 1 && rows >= static_cast<double>(kMinParallelRows)
+        ? write_parallel(model, keys, grid, policy, out, parts, threads, stats)
+        : write_sequential(&resampler, out, stats);
+    if (!ok) {
+        *error = std::string("Write failed: ") + std::strerror(errno);
+    }
+    return ok;
+}
+
+bool write_aligned_csv(const ChannelModel& model, const std::vector<std::string>& keys, const ResampleGrid& grid,
+                       ResamplePolicy policy, const std::string& path, AlignedCsvStats* stats, std::string* error) {
+    std::FILE* out = std::fopen(path.c_str(), "wb");
+    if (!out) {
+        *error = "Cannot open " + path + ": " + std::strerror(errno);
+        return false;
+    }
+    bool ok = write_aligned_csv(model, keys, grid, policy, out, stats, error);
+    if (std::fclose(out) != 0 && ok) {
+        *error = "Write failed: " + path;
+        ok = false;
+    }
+    return ok;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+class ChannelModel;
+
+// How a channel's samples become one value per grid row.
+enum class ResamplePolicy : uint8_t {
+    kHold,     // last sample at or before the row time (zero-order hold)
+    kLinear,   // interpolated between the samples around the row time
+    kMinMax,   // min and max of the samples in the row's bucket
+};
+
+// "hold", "linear" or "minmax".
+bool parse_resample_policy(const std::string& text, ResamplePolicy* out);
+
+struct ResampleGrid {
+    double t_start = 0.0;
+    double t_end = 0.0;
+    // Rows at t_start + i * step, each bucket running to the next row. With
+    // step 0 there is a row per distinct sample time across the channels
+    // instead; samples up to tolerance after a row's time join that row.
+    double step = 0.0;
+    double tolerance = 0.0;
+};
+
+// Up to Resampler::kBlockRows aligned rows. Values are stored a column at a
+// time; NaN where a channel has no value for a row.
+struct ResampledBlock {
+    size_t rows = 0;
+    size_t columns = 0;
+    std::vector<double> times;
+    std::vector<double> values;
+
+    double value(size_t row, size_t column) const { return values[column * rows + row]; }
+};
+
+// Puts the selected channels of a model on a common time grid. Each channel
+// is read through read_history in bounded chunks as the grid advances, so
+// memory stays at a few thousand samples per channel whatever the range,
+// and rows come out of a merge of the per-channel cursors. Within a chunk
+// a bucket's edges are found by binary search and its values reduced in
+// one pass over a contiguous column.
+//
+// next() takes the model's read lock for each block, so an export can run
+// while ingest continues; it must not be called with read_lock() held.
+class Resampler {
+public:
+    static constexpr size_t kBlockRows = 4096;
+
+    Resampler(const ChannelModel& model, const std::vector<std::string>& keys,
+              const ResampleGrid& grid, ResamplePolicy policy);
+    ~Resampler();
+    Resampler(const Resampler&) = delete;
+    Resampler& operator=(const Resampler&) = delete;
+
+    // One column per key, two (KEY_min, KEY_max) with kMinMax.
+    size_t columns() const;
+    std::vector<std::string> column_names() const;
+
+    // Parts of the output can be produced independently (e.g. on several
+    // threads) and concatenated: always with a step, and for merged rows
+    // only with zero tolerance, since a row may otherwise absorb samples
+    // across a part boundary.
+    bool splittable() const;
+    // Restricts the output to part index of parts (rows for a step grid,
+    // time otherwise). Call before next().
+    void select_part(size_t index, size_t parts);
+
+    // Fills the next rows; false once the grid is exhausted.
+    bool next(ResampledBlock* out);
+
+    // Samples read from the model so far.
+    uint64_t samples_read() const { return samples_read_; }
+
+private:
+    struct Cursor;
+
+    void start();
+    bool next_grid(ResampledBlock* out);
+    bool next_merged(ResampledBlock* out);
+
+    const ChannelModel& model_;
+    ResampleGrid grid_;
+    ResamplePolicy policy_;
+    std::vector<std::unique_ptr<Cursor>> cursors_;
+    bool started_ = false;
+    uint64_t row_ = 0;
+    uint64_t end_row_ = 0;
+    double begin_t_ = 0.0;
+    double end_t_ = 0.0;
+    uint64_t samples_read_ = 0;
+};
+
+struct AlignedCsvStats {
+    uint64_t rows = 0;
+    uint64_t samples = 0;
+    size_t columns = 0;
+    uint64_t bytes = 0;
+};
+
+// Writes "t,COLUMN..." rows (times with six decimals, empty cells for NaN).
+// Splittable grids are formatted in parts on worker threads and written in
+// order, so a large export is limited by the disk rather than by decoding
+// and formatting on one core.
+bool write_aligned_csv(const ChannelModel& model, const std::vector<std::string>& keys, const ResampleGrid& grid,
+                       ResamplePolicy policy, std::FILE* out, AlignedCsvStats* stats, std::string* error);
+bool write_aligned_csv(const ChannelModel& model, const std::vector<std::string>& keys, const ResampleGrid& grid,
+                       ResamplePolicy policy, const std::string& path, AlignedCsvStats* stats, std::string* error);
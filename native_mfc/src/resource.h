@@ -4,3 +4,9 @@
 #define IDR_MAINMENU 201
 #define IDI_APPICON 301
 #define ID_HELP_LOGFORMAT 9001
+#define ID_VIEW_DIAGNOSTICS 9002
+#define ID_VIEW_SAVE_TRACE 9003
+#define ID_VIEW_DERIVED 9004
+#define ID_VIEW_TRIGGERS 9005
+#define ID_VIEW_REFERENCES 9006
+#define ID_VIEW_TRANSITIONS 9007
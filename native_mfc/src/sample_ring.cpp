@@ -0,0 +1,788 @@
+#include "sample_ring.h"
+
+#include <algorithm>
+#include <climits>
+#include <numeric>
+
+#include "range_aggregate.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+constexpr size_t kMinCapacity = SampleRing::kBlockSize;
+constexpr size_t kMinRunCapacity = 64;
+constexpr size_t kMinRowCapacity = 1024;
+// Run and row tables shrink when less than a quarter full.
+constexpr size_t kShrinkFactor = 4;
+
+size_t round_up_pow2(size_t n, size_t cap = kMinCapacity) {
+    while (cap < n) {
+        cap <<= 1;
+    }
+    return cap;
+}
+
+int lowest_bit(uint64_t v) {
+#ifdef _MSC_VER
+    unsigned long index = 0;
+    _BitScanForward64(&index, v);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(v);
+#endif
+}
+
+// Position of set bit k (from 0) of v.
+size_t select_bit(uint64_t v, size_t k) {
+    if ((v & (v + 1)) == 0) {
+        // Only low bits set: a channel present on every row.
+        return k;
+    }
+    for (; k > 0; --k) {
+        v &= v - 1;
+    }
+    return static_cast<size_t>(lowest_bit(v));
+}
+} // namespace
+
+uint64_t RowTimeline::push_back(double t) {
+    if (!empty()) {
+        t = std::max(t, time(end_row() - 1));
+    }
+    if (times_.size() == capacity_) {
+        capacity_ = round_up_pow2(capacity_ * 2, kMinRowCapacity);
+        times_.reserve(capacity_);
+    }
+    size_t p = 0;
+    times_.push_back(&p).t[p & kChunkMask] = t;
+    return end_row() - 1;
+}
+
+void RowTimeline::drop_before(uint64_t row) {
+    if (row <= base_) {
+        return;
+    }
+    size_t n = static_cast<size_t>(std::min<uint64_t>(row - base_, times_.size()));
+    times_.pop_front(n);
+    base_ += n;
+    if (capacity_ > kMinRowCapacity && times_.size() * kShrinkFactor < capacity_) {
+        capacity_ = round_up_pow2(times_.size() * 2, kMinRowCapacity);
+        times_.reserve(capacity_);
+    }
+}
+
+void RowTimeline::clear() {
+    drop_before(end_row());
+}
+
+uint64_t RowTimeline::lower_bound(double t) const {
+    uint64_t lo = base_;
+    uint64_t hi = end_row();
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (time(mid) < t) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+size_t RowTimeline::allocated_bytes() const {
+    return times_.allocated_bytes();
+}
+
+void SampleRing::grow(size_t capacity_hint) {
+    reserve(std::max(capacity_hint, size() * 2));
+}
+
+ChannelSample SampleRing::special_at(size_t i) const {
+    if (layout_ == Layout::kRuns) {
+        size_t r = find_run(i);
+        return ChannelSample{run_time(r, base_ + i - run_first(r)), run_value(r)};
+    }
+    size_t p = rows_.pos(i);
+    return ChannelSample{row_times_->time(row_at(p)), rows_.chunk_at(p).v[p & kChunkMask]};
+}
+
+int SampleRing::special_value_at(size_t i) const {
+    if (layout_ == Layout::kRuns) {
+        return run_value(find_run(i));
+    }
+    size_t p = rows_.pos(i);
+    return rows_.chunk_at(p).v[p & kChunkMask];
+}
+
+void SampleRing::push_special(double t, int v, size_t capacity_hint) {
+    if (layout_ == Layout::kRuns) {
+        push_run(t, v);
+        return;
+    }
+    if (!fits_row(rows_.size(), t)) {
+        set_row_times(nullptr);
+        push_back(t, v, capacity_hint);
+        return;
+    }
+    if (rows_.size() == capacity_) {
+        grow(capacity_hint);
+    }
+    size_t p = 0;
+    RowChunk& c = rows_.push_back(&p);
+    place_row(&c, p & kChunkMask, row_times_->end_row() - 1);
+    put_value(&c, p, v);
+}
+
+void SampleRing::set_back(double t, int v) {
+    if (layout_ == Layout::kRuns) {
+        size_t r = runs_.size() - 1;
+        size_t off = 0;
+        const RunChunk& c = run_chunk(r, &off);
+        uint64_t count = run_end(r) - c.first[off];
+        size_t p = runs_.pos(r);
+        if (count == 1 || c.v[off] == v) {
+            RunChunk& w = runs_.writable(p);
+            if (count == 1) {
+                w.t_first[off] = t;
+                w.v[off] = v;
+            }
+            w.t_last[off] = t;
+            return;
+        }
+        // The run loses its last sample to a new one-sample run.
+        double prev = run_time(r, count - 2);
+        runs_.writable(p).t_last[off] = prev;
+        append_run(t, v, base_ + run_size_ - 1);
+        return;
+    }
+    if (layout_ == Layout::kRows && !fits_row(size() - 1, t)) {
+        set_row_times(nullptr);
+    }
+    size_t p = pos(size() - 1);
+    size_t off = p & kChunkMask;
+    Values* c = nullptr;
+    if (layout_ == Layout::kRows) {
+        // Moves the sample from its row to the newest one.
+        RowChunk& rc = rows_.writable(p);
+        if (off > 0) {
+            rc.present[rc.last >> 6] &= ~(uint64_t(1) << (rc.last & 63));
+        }
+        place_row(&rc, off, row_times_->end_row() - 1);
+        c = &rc;
+    } else {
+        Chunk& pc = ring_.writable(p);
+        pc.t[off] = t;
+        c = &pc;
+    }
+    c->v[off] = v;
+
+    // Re-summarise the block up to the replaced sample.
+    size_t begin = off & ~kBlockMask;
+    int lo = c->v[begin];
+    int hi = lo;
+    int64_t sum = lo;
+    for (size_t i = begin + 1; i <= off; ++i) {
+        lo = std::min(lo, c->v[i]);
+        hi = std::max(hi, c->v[i]);
+        sum += c->v[i];
+    }
+    c->block_min[off >> kBlockShift] = lo;
+    c->block_max[off >> kBlockShift] = hi;
+    c->block_sum[off >> kBlockShift] = sum;
+    if (off == kChunkMask) {
+        seal_chunk(p >> kChunkShift);
+    }
+}
+
+void SampleRing::pop_front(size_t n) {
+    if (layout_ != Layout::kRuns) {
+        ring_.pop_front(n);
+        rows_.pop_front(n);
+        return;
+    }
+    n = std::min(n, run_size_);
+    if (n == 0) {
+        return;
+    }
+    if (n == run_size_) {
+        clear();
+        return;
+    }
+    // Drop the runs before the new front sample, then start the run holding
+    // it at that sample.
+    size_t r = find_run(n);
+    uint64_t front = base_ + n;
+    uint64_t k = front - run_first(r);
+    double t = run_time(r, k);
+    runs_.pop_front(r);
+    if (k > 0) {
+        size_t p = runs_.pos(0);
+        RunChunk& c = runs_.writable(p);
+        c.t_first[p & kRunMask] = t;
+        c.first[p & kRunMask] = front;
+    }
+    base_ = front;
+    run_size_ -= n;
+    if (run_capacity_ > kMinRunCapacity && runs_.size() * kShrinkFactor < run_capacity_) {
+        reserve_runs(runs_.size() * 2);
+    }
+}
+
+void SampleRing::clear() {
+    ring_.clear();
+    rows_.clear();
+    runs_.clear();
+    base_ = 0;
+    run_size_ = 0;
+}
+
+void SampleRing::reserve(size_t capacity) {
+    if (layout_ == Layout::kRuns) {
+        return;
+    }
+    size_t cap = round_up_pow2(std::max(capacity, size()));
+    if (cap == capacity_) {
+        return;
+    }
+    capacity_ = cap;
+    if (layout_ == Layout::kRows ? rows_.reserve(cap) : ring_.reserve(cap)) {
+        rebuild_tree();
+    }
+}
+
+void SampleRing::set_run_length(bool enabled) {
+    if (enabled == run_length()) {
+        return;
+    }
+    SampleRing converted;
+    converted.layout_ = enabled ? Layout::kRuns : Layout::kPlain;
+    if (enabled) {
+        for (size_t i = 0; i < size(); ++i) {
+            converted.push_run(time_at(i), value_at(i));
+        }
+    } else {
+        converted.reserve(size());
+        for (size_t r = 0; r < runs_.size(); ++r) {
+            int v = run_value(r);
+            uint64_t count = run_end(r) - run_first(r);
+            for (uint64_t k = 0; k < count; ++k) {
+                converted.push_back(run_time(r, k), v);
+            }
+        }
+    }
+    *this = std::move(converted);
+}
+
+bool SampleRing::set_row_times(const RowTimeline* rows) {
+    if (rows == row_times_) {
+        return true;
+    }
+    if (layout_ == Layout::kRuns) {
+        return false;
+    }
+    SampleRing converted;
+    converted.layout_ = rows ? Layout::kRows : Layout::kPlain;
+    converted.row_times_ = rows;
+    converted.reserve(capacity_);
+    if (!rows) {
+        for (size_t i = 0; i < size(); ++i) {
+            converted.push_back(time_at(i), value_at(i));
+        }
+        *this = std::move(converted);
+        return true;
+    }
+    // Times and rows are both non-decreasing, so each sample's row is found
+    // walking forward from the previous one's.
+    uint64_t row = size() > 0 ? rows->lower_bound(time_at(0)) : 0;
+    for (size_t i = 0; i < size(); ++i) {
+        double t = time_at(i);
+        while (row < rows->end_row() && rows->time(row) < t) {
+            row++;
+        }
+        if (row == rows->end_row() || rows->time(row) != t || !converted.row_fits(i, row)) {
+            return false;
+        }
+        size_t p = 0;
+        RowChunk& c = converted.rows_.push_back(&p);
+        place_row(&c, p & kChunkMask, row);
+        converted.put_value(&c, p, value_at(i));
+        row++;
+    }
+    *this = std::move(converted);
+    return true;
+}
+
+void SampleRing::own_row_times() {
+    if (row_times_ && !row_owner_) {
+        row_owner_ = std::make_shared<RowTimeline>(*row_times_);
+        row_times_ = row_owner_.get();
+    }
+}
+
+uint64_t SampleRing::row_at(size_t p) const {
+    const RowChunk& c = rows_.chunk_at(p);
+    size_t off = p & kChunkMask;
+    // Rows only increase, so sample off is on relative row off or later:
+    // word off / 64 at the earliest, then the last word whose rank is not
+    // past it.
+    size_t w = off >> 6;
+    size_t last_word = static_cast<size_t>(c.last >> 6);
+    while (w < last_word && c.rank[w + 1] <= off) {
+        w++;
+    }
+    return c.first_row + (w << 6) + select_bit(c.present[w], off - c.rank[w]);
+}
+
+bool SampleRing::row_fits(size_t i, uint64_t row) const {
+    if (i == 0) {
+        return true;
+    }
+    // Appending, sample i - 1 is its chunk's newest.
+    size_t prev_p = rows_.pos(i - 1);
+    const RowChunk& prev = rows_.chunk_at(prev_p);
+    if (row <= (i == size() ? prev.first_row + prev.last : row_at(prev_p))) {
+        return false;
+    }
+    // Sample i starts a chunk, or shares one with sample i - 1.
+    size_t p = rows_.pos(i);
+    return (p & kChunkMask) == 0 || row - rows_.chunk_at(p).first_row < kChunkRows;
+}
+
+bool SampleRing::fits_row(size_t i, double t) const {
+    return !row_times_->empty() && row_times_->time(row_times_->end_row() - 1) == t &&
+        row_fits(i, row_times_->end_row() - 1);
+}
+
+void SampleRing::place_row(RowChunk* c, size_t off, uint64_t row) {
+    size_t from = 0;
+    if (off == 0) {
+        c->first_row = row;
+        std::fill(c->present, c->present + kRowWords, uint64_t(0));
+    } else {
+        from = static_cast<size_t>(c->last >> 6) + 1;
+    }
+    size_t k = static_cast<size_t>(row - c->first_row);
+    for (size_t w = from; w <= (k >> 6); ++w) {
+        c->rank[w] = static_cast<uint16_t>(off);
+    }
+    c->present[k >> 6] |= uint64_t(1) << (k & 63);
+    c->last = static_cast<uint16_t>(k);
+}
+
+size_t SampleRing::run_upper_bound(double t) const {
+    size_t lo = 0;
+    size_t hi = runs_.size();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        size_t off = 0;
+        if (run_chunk(mid, &off).t_first[off] <= t) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+bool SampleRing::extends_run(double t, int v) const {
+    if (layout_ != Layout::kRuns || run_size_ < 2) {
+        return false;
+    }
+    size_t off = 0;
+    const RunChunk& last = run_chunk(runs_.size() - 1, &off);
+    if (last.v[off] != v) {
+        return false;
+    }
+    size_t front_off = 0;
+    const RunChunk& front = run_chunk(0, &front_off);
+    double pace = (last.t_last[off] - front.t_first[front_off]) / static_cast<double>(run_size_ - 1);
+    return t - last.t_last[off] <= kRunGapFactor * pace;
+}
+
+double SampleRing::run_time(size_t r, uint64_t k) const {
+    size_t off = 0;
+    const RunChunk& c = run_chunk(r, &off);
+    uint64_t count = run_end(r) - c.first[off];
+    if (k == 0) {
+        return c.t_first[off];
+    }
+    if (k + 1 >= count) {
+        return c.t_last[off];
+    }
+    double span = c.t_last[off] - c.t_first[off];
+    return c.t_first[off] + span * (static_cast<double>(k) / static_cast<double>(count - 1));
+}
+
+size_t SampleRing::find_run(size_t i) const {
+    // Last run starting at or before sample i; appends look at the newest.
+    uint64_t index = base_ + i;
+    if (runs_.size() < 2 || run_first(runs_.size() - 1) <= index) {
+        return runs_.size() - (runs_.size() > 0 ? 1 : 0);
+    }
+    size_t lo = 1;
+    size_t hi = runs_.size() - 1;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (run_first(mid) <= index) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo - 1;
+}
+
+void SampleRing::push_run(double t, int v) {
+    if (extends_run(t, v)) {
+        size_t p = runs_.pos(runs_.size() - 1);
+        runs_.writable(p).t_last[p & kRunMask] = t;
+    } else {
+        append_run(t, v, base_ + run_size_);
+    }
+    run_size_++;
+}
+
+void SampleRing::append_run(double t, int v, uint64_t first) {
+    if (runs_.size() == run_capacity_) {
+        reserve_runs(runs_.size() * 2);
+    }
+    size_t p = 0;
+    RunChunk& c = runs_.push_back(&p);
+    size_t off = p & kRunMask;
+    c.t_first[off] = t;
+    c.t_last[off] = t;
+    c.first[off] = first;
+    c.v[off] = v;
+}
+
+void SampleRing::reserve_runs(size_t runs) {
+    size_t cap = round_up_pow2(std::max(runs, runs_.size()), kMinRunCapacity);
+    if (cap != run_capacity_) {
+        run_capacity_ = cap;
+        runs_.reserve(cap);
+    }
+}
+
+void SampleRing::seal_chunk(size_t slot) {
+    ChunkTree& tree = unshare(&tree_);
+    const Values& c = values(slot);
+    size_t node = slot_count() + slot;
+    tree.min[node] = *std::min_element(c.block_min, c.block_min + kChunkBlocks);
+    tree.max[node] = *std::max_element(c.block_max, c.block_max + kChunkBlocks);
+    tree.sum[node] = std::accumulate(c.block_sum, c.block_sum + kChunkBlocks, int64_t(0));
+    for (node >>= 1; node > 0; node >>= 1) {
+        tree.min[node] = std::min(tree.min[node * 2], tree.min[node * 2 + 1]);
+        tree.max[node] = std::max(tree.max[node * 2], tree.max[node * 2 + 1]);
+        tree.sum[node] = tree.sum[node * 2] + tree.sum[node * 2 + 1];
+    }
+}
+
+void SampleRing::rebuild_tree() {
+    // A fresh tree rather than unshare(): the old one may be a snapshot's.
+    size_t slots = slot_count();
+    auto tree = std::make_shared<ChunkTree>();
+    tree->min.assign(slots * 2, INT_MAX);
+    tree->max.assign(slots * 2, INT_MIN);
+    tree->sum.assign(slots * 2, 0);
+    // reserve() moved the chunks in use to the front of the table.
+    size_t sealed = ((pos(0) & kChunkMask) + size()) >> kChunkShift;
+    for (size_t slot = 0; slot < sealed; ++slot) {
+        const Values& c = values(slot);
+        tree->min[slots + slot] = *std::min_element(c.block_min, c.block_min + kChunkBlocks);
+        tree->max[slots + slot] = *std::max_element(c.block_max, c.block_max + kChunkBlocks);
+        tree->sum[slots + slot] = std::accumulate(c.block_sum, c.block_sum + kChunkBlocks, int64_t(0));
+    }
+    for (size_t node = slots - 1; node > 0; --node) {
+        tree->min[node] = std::min(tree->min[node * 2], tree->min[node * 2 + 1]);
+        tree->max[node] = std::max(tree->max[node * 2], tree->max[node * 2 + 1]);
+        tree->sum[node] = tree->sum[node * 2] + tree->sum[node * 2 + 1];
+    }
+    tree_ = std::move(tree);
+}
+
+size_t SampleRing::search(size_t first, size_t last, double t, bool upper) const {
+    last = std::min(last, size());
+    if (first >= last) {
+        return last;
+    }
+    auto before = [t, upper](double x) { return upper ? x <= t : x < t; };
+
+    if (layout_ == Layout::kRuns) {
+        // First run whose last sample is not before t, then the sample
+        // inside it; times are non-decreasing, so clamping to the range
+        // gives the answer within it.
+        size_t lo = 0;
+        size_t hi = runs_.size();
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            size_t off = 0;
+            if (before(run_chunk(mid, &off).t_last[off])) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        size_t found = size();
+        if (lo < runs_.size()) {
+            uint64_t k_lo = 0;
+            uint64_t k_hi = run_end(lo) - run_first(lo);
+            while (k_lo < k_hi) {
+                uint64_t mid = k_lo + (k_hi - k_lo) / 2;
+                if (before(run_time(lo, mid))) {
+                    k_lo = mid + 1;
+                } else {
+                    k_hi = mid;
+                }
+            }
+            found = static_cast<size_t>(run_first(lo) + k_lo - base_);
+        }
+        return std::min(std::max(found, first), last);
+    }
+
+    if (layout_ == Layout::kRows) {
+        size_t lo = first;
+        size_t hi = last;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (before(time_at(mid))) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+
+    // Chunk starts in [first, last) are first_start + k * kChunkSize; find
+    // the first one not before t, which leaves a single chunk to search.
+    size_t first_start = first + ((kChunkSize - (ring_.pos(first) & kChunkMask)) & kChunkMask);
+    size_t lo = first;
+    size_t hi = last;
+    if (first_start < last) {
+        size_t k_lo = 0;
+        size_t k_hi = (last - 1 - first_start) / kChunkSize + 1;
+        const size_t starts = k_hi;
+        while (k_lo < k_hi) {
+            size_t mid = k_lo + (k_hi - k_lo) / 2;
+            if (before(time_at(first_start + mid * kChunkSize))) {
+                k_lo = mid + 1;
+            } else {
+                k_hi = mid;
+            }
+        }
+        lo = k_lo == 0 ? first : first_start + (k_lo - 1) * kChunkSize;
+        hi = k_lo == starts ? last : first_start + k_lo * kChunkSize;
+    }
+    Segment seg = segment(lo, hi);
+    const double* end = seg.t + seg.count;
+    const double* it = upper ? std::upper_bound(seg.t, end, t) : std::lower_bound(seg.t, end, t);
+    return lo + static_cast<size_t>(it - seg.t);
+}
+
+SampleRing::Segment SampleRing::segment(size_t first, size_t last) const {
+    last = std::min(last, size());
+    if (first >= last || layout_ != Layout::kPlain) {
+        return Segment();
+    }
+    size_t p = ring_.pos(first);
+    size_t off = p & kChunkMask;
+    const Chunk& c = ring_.chunk_at(p);
+    return Segment{c.t + off, c.v + off, std::min(last - first, kChunkSize - off)};
+}
+
+void SampleRing::chunk_range(size_t p, size_t count, Summary* s) const {
+    const Values& c = values_at(p);
+    size_t i = p & kChunkMask;
+    size_t end = i + count;
+    int vmin = s->lo;
+    int vmax = s->hi;
+    int64_t sum = s->sum;
+    // Partial block, whole blocks from their summaries, partial block.
+    size_t lead = std::min(count, (kBlockSize - (i & kBlockMask)) & kBlockMask);
+    for (size_t j = i; j < i + lead; ++j) {
+        vmin = std::min(vmin, c.v[j]);
+        vmax = std::max(vmax, c.v[j]);
+        sum += c.v[j];
+    }
+    i += lead;
+    for (; i + kBlockSize <= end; i += kBlockSize) {
+        vmin = std::min(vmin, c.block_min[i >> kBlockShift]);
+        vmax = std::max(vmax, c.block_max[i >> kBlockShift]);
+        sum += c.block_sum[i >> kBlockShift];
+    }
+    for (; i < end; ++i) {
+        vmin = std::min(vmin, c.v[i]);
+        vmax = std::max(vmax, c.v[i]);
+        sum += c.v[i];
+    }
+    s->lo = vmin;
+    s->hi = vmax;
+    s->sum = sum;
+}
+
+void SampleRing::query_chunks(size_t first, size_t last, Summary* s) const {
+    const ChunkTree& tree = *tree_;
+    size_t slots = slot_count();
+    int vmin = s->lo;
+    int vmax = s->hi;
+    int64_t sum = s->sum;
+    for (first += slots, last += slots; first < last; first >>= 1, last >>= 1) {
+        if (first & 1) {
+            vmin = std::min(vmin, tree.min[first]);
+            vmax = std::max(vmax, tree.max[first]);
+            sum += tree.sum[first];
+            first++;
+        }
+        if (last & 1) {
+            last--;
+            vmin = std::min(vmin, tree.min[last]);
+            vmax = std::max(vmax, tree.max[last]);
+            sum += tree.sum[last];
+        }
+    }
+    s->lo = vmin;
+    s->hi = vmax;
+    s->sum = sum;
+}
+
+SampleRing::Summary SampleRing::summarize(size_t first, size_t last) const {
+    Summary s;
+    if (layout_ == Layout::kRuns) {
+        for (size_t r = find_run(first), end = find_run(last - 1); r <= end; ++r) {
+            uint64_t from = std::max<uint64_t>(run_first(r), base_ + first);
+            uint64_t to = std::min<uint64_t>(run_end(r), base_ + last);
+            s.lo = std::min(s.lo, run_value(r));
+            s.hi = std::max(s.hi, run_value(r));
+            s.sum += static_cast<int64_t>(run_value(r)) * static_cast<int64_t>(to - from);
+        }
+        return s;
+    }
+
+    // Partial chunk up to the first chunk boundary, then whole chunks from
+    // the tree (chunks wrap with the ring), then the partial tail chunk.
+    size_t i = first;
+    size_t lead = std::min(last - i, (kChunkSize - (pos(i) & kChunkMask)) & kChunkMask);
+    if (lead > 0) {
+        chunk_range(pos(i), lead, &s);
+        i += lead;
+    }
+
+    size_t chunks = (last - i) >> kChunkShift;
+    if (chunks > 0) {
+        size_t slot = pos(i) >> kChunkShift;
+        size_t run = std::min(chunks, slot_count() - slot);
+        query_chunks(slot, slot + run, &s);
+        if (run < chunks) {
+            query_chunks(0, chunks - run, &s);
+        }
+        i += chunks << kChunkShift;
+    }
+    if (i < last) {
+        chunk_range(pos(i), last - i, &s);
+    }
+    return s;
+}
+
+bool SampleRing::value_range(size_t first, size_t last, int* vmin, int* vmax) const {
+    last = std::min(last, size());
+    if (first >= last) {
+        return false;
+    }
+    Summary s = summarize(first, last);
+    *vmin = s.lo;
+    *vmax = s.hi;
+    return true;
+}
+
+void SampleRing::aggregate(size_t first, size_t last, AggregateBuckets* out) const {
+    last = std::min(last, size());
+    if (first >= last) {
+        return;
+    }
+    ChannelSample front = at(first);
+    ChannelSample back = at(last - 1);
+    if (out->fits(front.t, back.t)) {
+        Summary s = summarize(first, last);
+        out->add(RangeAggregate{last - first, s.lo, s.hi, s.sum, front, back});
+        return;
+    }
+    if (last - first <= kBlockSize) {
+        for (size_t i = first; i < last; ++i) {
+            ChannelSample sample = at(i);
+            out->add(sample.t, sample.v);
+        }
+        return;
+    }
+    size_t mid = first + (last - first) / 2;
+    aggregate(first, mid, out);
+    aggregate(mid, last, out);
+}
+
+SeriesView SampleRing::view(uint64_t version) const {
+    return SeriesView(this, 0, size(), version);
+}
+
+size_t SampleRing::allocated_bytes() const {
+    size_t tree = tree_ ? (tree_->min.size() + tree_->max.size()) * sizeof(int) + tree_->sum.size() * sizeof(int64_t)
+                        : 0;
+    return ring_.allocated_bytes() + rows_.allocated_bytes() + tree +
+        runs_.allocated_bytes();
+}
+
+size_t SeriesView::abs_lower_bound(double t) const {
+    return ring_->lower_bound(first_, last_, t);
+}
+
+size_t SeriesView::abs_upper_bound(double t) const {
+    return ring_->upper_bound(first_, last_, t);
+}
+
+size_t SeriesView::nearest(double t) const {
+    if (empty()) {
+        return 0;
+    }
+    size_t i = lower_bound(t);
+    if (i == size()) {
+        return i - 1;
+    }
+    if (i > 0 && t - time_at(i - 1) <= time_at(i) - t) {
+        return i - 1;
+    }
+    return i;
+}
+
+SeriesView SeriesView::slice(size_t from, size_t to) const {
+    to = std::min(to, size());
+    from = std::min(from, to);
+    return SeriesView(ring_, first_ + from, first_ + to, version_);
+}
+
+SeriesView SeriesView::since(double t_start) const {
+    if (empty()) {
+        return *this;
+    }
+    return SeriesView(ring_, abs_lower_bound(t_start), last_, version_);
+}
+
+SeriesView SeriesView::between(double t_start, double t_end) const {
+    if (empty()) {
+        return *this;
+    }
+    return SeriesView(ring_, abs_lower_bound(t_start), abs_upper_bound(t_end), version_);
+}
+
+bool SeriesView::value_range(int* vmin, int* vmax) const {
+    if (empty()) {
+        return false;
+    }
+    return ring_->value_range(first_, last_, vmin, vmax);
+}
+
+SampleRing::Segment SeriesView::segment(size_t from) const {
+    if (from >= size()) {
+        return SampleRing::Segment();
+    }
+    return ring_->segment(first_ + from, last_);
+}
@@ -0,0 +1,416 @@
+#pragma once
+
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+#include "chunk_ring.h"
+
+struct ChannelSample {
+    double t = 0.0;
+    int v = 0;
+};
+
+class AggregateBuckets;
+class SeriesView;
+
+// Arrival time of each parsed line (a row), shared by the rings that store
+// rows instead of times. Row numbers survive drop_before.
+class RowTimeline {
+public:
+    // Appends a row and returns its number.
+    uint64_t push_back(double t);
+    // Drops the rows before row.
+    void drop_before(uint64_t row);
+    void clear();
+
+    bool empty() const { return times_.size() == 0; }
+    // Rows held are [first_row(), end_row()).
+    uint64_t first_row() const { return base_; }
+    uint64_t end_row() const { return base_ + times_.size(); }
+    double time(uint64_t row) const {
+        size_t p = times_.pos(static_cast<size_t>(row - base_));
+        return times_.chunk_at(p).t[p & kChunkMask];
+    }
+    // First row with time >= t; end_row() when none.
+    uint64_t lower_bound(double t) const;
+
+    size_t allocated_bytes() const;
+
+private:
+    static constexpr size_t kChunkShift = 10;
+    static constexpr size_t kChunkMask = (size_t(1) << kChunkShift) - 1;
+
+    struct Chunk {
+        double t[size_t(1) << kChunkShift];
+    };
+
+    ChunkRing<Chunk, kChunkShift> times_;
+    size_t capacity_ = 0;
+    uint64_t base_ = 0;
+};
+
+// Per-channel sample FIFO of time and value columns in copy-on-write
+// chunks (see ChunkRing); index 0 is the oldest sample. Value min/max/sum
+// are kept per block and in a segment tree over chunks.
+//
+// In run-length mode (set_run_length) a run's interior times are
+// interpolated between its first and last; a sample more than
+// kRunGapFactor mean intervals after the previous one starts a new run.
+//
+// With shared rows (set_row_times) a chunk holds its first row and a
+// bitmap of the rows it has samples on instead of a time column.
+class SampleRing {
+public:
+    static constexpr size_t kBlockShift = 6;
+    static constexpr size_t kBlockSize = size_t(1) << kBlockShift;
+    static constexpr size_t kChunkShift = 10;
+    static constexpr size_t kChunkSize = size_t(1) << kChunkShift;
+    static constexpr double kRunGapFactor = 8.0;
+    // Rows one chunk's samples may span in shared-row mode.
+    static constexpr size_t kChunkRows = 2 * kChunkSize;
+
+    // Contiguous piece of a logical range; it ends at a chunk boundary.
+    // Always empty in run-length and shared-row mode.
+    struct Segment {
+        const double* t = nullptr;
+        const int* v = nullptr;
+        size_t count = 0;
+    };
+
+    size_t size() const {
+        if (layout_ == Layout::kPlain) {
+            return ring_.size();
+        }
+        return layout_ == Layout::kRuns ? run_size_ : rows_.size();
+    }
+    bool empty() const { return size() == 0; }
+    // 0 in run-length mode, where the run table sizes itself.
+    size_t capacity() const { return capacity_; }
+
+    double time_at(size_t i) const {
+        if (layout_ != Layout::kPlain) {
+            return special_at(i).t;
+        }
+        size_t p = ring_.pos(i);
+        return ring_.chunk_at(p).t[p & kChunkMask];
+    }
+    int value_at(size_t i) const {
+        if (layout_ != Layout::kPlain) {
+            return special_value_at(i);
+        }
+        size_t p = ring_.pos(i);
+        return ring_.chunk_at(p).v[p & kChunkMask];
+    }
+    ChannelSample at(size_t i) const {
+        if (layout_ != Layout::kPlain) {
+            return special_at(i);
+        }
+        size_t p = ring_.pos(i);
+        const Chunk& c = ring_.chunk_at(p);
+        return ChannelSample{c.t[p & kChunkMask], c.v[p & kChunkMask]};
+    }
+    ChannelSample front() const { return at(0); }
+    ChannelSample back() const { return at(size() - 1); }
+
+    // When the ring is full it grows to at least capacity_hint (and at least
+    // double its size), rounded up to a power of two.
+    void push_back(double t, int v, size_t capacity_hint = 0) {
+        if (layout_ != Layout::kPlain) {
+            push_special(t, v, capacity_hint);
+            return;
+        }
+        if (ring_.size() == capacity_) {
+            grow(capacity_hint);
+        }
+        size_t p = 0;
+        Chunk& c = ring_.push_back(&p);
+        c.t[p & kChunkMask] = t;
+        put_value(&c, p, v);
+    }
+    void set_back(double t, int v);
+    void pop_front(size_t n);
+    void clear();
+
+    // Sets the capacity to the smallest power of two >= max(capacity,
+    // size()). Only the chunk table is reallocated. No-op in run-length
+    // mode.
+    void reserve(size_t capacity);
+
+    // Converts the stored samples between plain and run-length storage.
+    void set_run_length(bool enabled);
+    bool run_length() const { return layout_ == Layout::kRuns; }
+    // Runs in run-length mode, each with its sample count and first sample.
+    size_t run_count() const { return runs_.size(); }
+    size_t run_samples(size_t r) const { return static_cast<size_t>(run_end(r) - run_first(r)); }
+    ChannelSample run_front(size_t r) const { return ChannelSample{run_time(r, 0), run_value(r)}; }
+    // First run that starts after t.
+    size_t run_upper_bound(double t) const;
+    // Whether push_back(t, v) would extend the newest run instead of
+    // starting one (always false outside run-length mode).
+    bool extends_run(double t, int v) const;
+
+    // False, changing nothing, unless every stored time is a row's. A later
+    // sample off the newest row converts back to a time column, as does
+    // nullptr. Not in run-length mode.
+    bool set_row_times(const RowTimeline* rows);
+    bool shared_times() const { return layout_ == Layout::kRows; }
+    // Gives a copy its own snapshot of the timeline.
+    void own_row_times();
+
+    // First index whose time is >= t. Times must be non-decreasing.
+    size_t lower_bound(double t) const { return lower_bound(0, size(), t); }
+    // Within [first, last): first index with time >= t, or > t for
+    // upper_bound (last when none).
+    size_t lower_bound(size_t first, size_t last, double t) const { return search(first, last, t, false); }
+    size_t upper_bound(size_t first, size_t last, double t) const { return search(first, last, t, true); }
+
+    // Contiguous piece of [first, last) starting at first; empty when the
+    // range is.
+    Segment segment(size_t first, size_t last) const;
+
+    // Value range over [first, last) in O(log n); returns false when the
+    // range is empty.
+    bool value_range(size_t first, size_t last, int* vmin, int* vmax) const;
+    // Folds [first, last) into out, whose range must cover those samples'
+    // times.
+    void aggregate(size_t first, size_t last, AggregateBuckets* out) const;
+
+    // View over every stored sample.
+    SeriesView view(uint64_t version = 0) const;
+
+    // Bytes of chunks, chunk table, summary tree and runs held by this ring
+    // (shared chunks included).
+    size_t allocated_bytes() const;
+
+private:
+    static constexpr size_t kBlockMask = kBlockSize - 1;
+    static constexpr size_t kChunkMask = kChunkSize - 1;
+    static constexpr size_t kChunkBlocks = kChunkSize / kBlockSize;
+
+    static constexpr size_t kRowWords = kChunkRows / 64;
+
+    enum class Layout : uint8_t { kPlain, kRuns, kRows };
+
+    // Values of either chunk layout.
+    struct Values {
+        int v[kChunkSize];
+        // Block summaries; a block's entry covers the slots written so far.
+        int block_min[kChunkBlocks];
+        int block_max[kChunkBlocks];
+        int64_t block_sum[kChunkBlocks];
+    };
+    struct Chunk : Values {
+        double t[kChunkSize];
+    };
+    // Shared-row layout: bit k of present is row first_row + k, where
+    // first_row is the row of the sample at offset 0.
+    struct RowChunk : Values {
+        uint64_t first_row;
+        uint64_t present[kRowWords];
+        // Samples in the words before each word, up to the newest.
+        uint16_t rank[kRowWords];
+        // Newest sample's row - first_row.
+        uint16_t last;
+    };
+
+    // Leaves at [slots, 2 * slots), trusted only once their chunk is full.
+    struct ChunkTree {
+        std::vector<int> min;
+        std::vector<int> max;
+        std::vector<int64_t> sum;
+    };
+
+    struct Summary {
+        int lo = INT_MAX;
+        int hi = INT_MIN;
+        int64_t sum = 0;
+    };
+
+    static constexpr size_t kRunShift = 6;
+    static constexpr size_t kRunMask = (size_t(1) << kRunShift) - 1;
+
+    struct RunChunk {
+        double t_first[size_t(1) << kRunShift];
+        double t_last[size_t(1) << kRunShift];
+        // Absolute index of the run's first sample (see base_).
+        uint64_t first[size_t(1) << kRunShift];
+        int v[size_t(1) << kRunShift];
+    };
+
+    // Stores v as the newest sample, at ring position p of chunk c.
+    void put_value(Values* c, size_t p, int v) {
+        size_t off = p & kChunkMask;
+        c->v[off] = v;
+
+        size_t block = off >> kBlockShift;
+        if ((off & kBlockMask) == 0) {
+            c->block_min[block] = v;
+            c->block_max[block] = v;
+            c->block_sum[block] = v;
+        } else {
+            c->block_min[block] = v < c->block_min[block] ? v : c->block_min[block];
+            c->block_max[block] = v > c->block_max[block] ? v : c->block_max[block];
+            c->block_sum[block] += v;
+        }
+        if (off == kChunkMask) {
+            seal_chunk(p >> kChunkShift);
+        }
+    }
+    // Run-length and shared-row counterparts of the accessors and append.
+    ChannelSample special_at(size_t i) const;
+    int special_value_at(size_t i) const;
+    void push_special(double t, int v, size_t capacity_hint);
+
+    // Of the plain or shared-row ring, whichever is in use.
+    size_t pos(size_t i) const { return layout_ == Layout::kRows ? rows_.pos(i) : ring_.pos(i); }
+    size_t slot_count() const { return layout_ == Layout::kRows ? rows_.slot_count() : ring_.slot_count(); }
+    const Values& values(size_t slot) const {
+        if (layout_ == Layout::kRows) {
+            return rows_.chunk(slot);
+        }
+        return ring_.chunk(slot);
+    }
+    const Values& values_at(size_t p) const { return values(p >> kChunkShift); }
+
+    void grow(size_t capacity_hint);
+    // Row of the sample at ring position p (shared-row mode).
+    uint64_t row_at(size_t p) const;
+    // Whether sample i (at most size()) can be on row, after sample i - 1.
+    bool row_fits(size_t i, uint64_t row) const;
+    // Whether sample i can be at time t on the newest row.
+    bool fits_row(size_t i, double t) const;
+    // Records that the sample at chunk offset off is on row; the ones before
+    // it in the chunk are on earlier rows.
+    static void place_row(RowChunk* c, size_t off, uint64_t row);
+    size_t search(size_t first, size_t last, double t, bool upper) const;
+    // Records a full chunk's range in the tree.
+    void seal_chunk(size_t slot);
+    void rebuild_tree();
+    // Range of count samples from position p within one chunk.
+    void chunk_range(size_t p, size_t count, Summary* s) const;
+    void query_chunks(size_t first, size_t last, Summary* s) const;
+    // Min, max and sum of [first, last) (non-empty, within size()).
+    Summary summarize(size_t first, size_t last) const;
+
+    const RunChunk& run_chunk(size_t r, size_t* off) const {
+        size_t p = runs_.pos(r);
+        *off = p & kRunMask;
+        return runs_.chunk_at(p);
+    }
+    uint64_t run_first(size_t r) const {
+        size_t off = 0;
+        return run_chunk(r, &off).first[off];
+    }
+    // Absolute index one past run r's last sample.
+    uint64_t run_end(size_t r) const { return r + 1 < runs_.size() ? run_first(r + 1) : base_ + run_size_; }
+    int run_value(size_t r) const {
+        size_t off = 0;
+        return run_chunk(r, &off).v[off];
+    }
+    // Time of sample k of run r.
+    double run_time(size_t r, uint64_t k) const;
+    // Run holding sample i.
+    size_t find_run(size_t i) const;
+    void push_run(double t, int v);
+    void append_run(double t, int v, uint64_t first);
+    void reserve_runs(size_t runs);
+
+    // Only the ring of the current layout holds samples.
+    ChunkRing<Chunk, kChunkShift> ring_;
+    ChunkRing<RowChunk, kChunkShift> rows_;
+    const RowTimeline* row_times_ = nullptr;
+    // Set by own_row_times.
+    std::shared_ptr<const RowTimeline> row_owner_;
+    std::shared_ptr<ChunkTree> tree_;
+    size_t capacity_ = 0;
+
+    // Run-length mode: runs, and the absolute index of sample 0.
+    ChunkRing<RunChunk, kRunShift> runs_;
+    size_t run_capacity_ = 0;
+    uint64_t base_ = 0;
+    size_t run_size_ = 0;
+    Layout layout_ = Layout::kPlain;
+};
+
+// Read-only range [first, last) of a SampleRing, valid until the ring is
+// next modified (see ChannelModel::get_version).
+class SeriesView {
+public:
+    class iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = ChannelSample;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = ChannelSample;
+
+        iterator() = default;
+        iterator(const SampleRing* ring, size_t index) : ring_(ring), index_(index) {}
+
+        ChannelSample operator*() const { return ring_->at(index_); }
+        iterator& operator++() {
+            ++index_;
+            return *this;
+        }
+        iterator operator++(int) {
+            iterator prev = *this;
+            ++index_;
+            return prev;
+        }
+        bool operator==(const iterator& other) const { return index_ == other.index_; }
+        bool operator!=(const iterator& other) const { return index_ != other.index_; }
+
+    private:
+        const SampleRing* ring_ = nullptr;
+        size_t index_ = 0;
+    };
+
+    SeriesView() = default;
+    SeriesView(const SampleRing* ring, size_t first, size_t last, uint64_t version)
+        : ring_(ring), first_(first), last_(last > first ? last : first), version_(version) {}
+
+    size_t size() const { return last_ - first_; }
+    bool empty() const { return last_ == first_; }
+    uint64_t version() const { return version_; }
+
+    double time_at(size_t i) const { return ring_->time_at(first_ + i); }
+    int value_at(size_t i) const { return ring_->value_at(first_ + i); }
+    ChannelSample operator[](size_t i) const { return ring_->at(first_ + i); }
+    ChannelSample front() const { return ring_->at(first_); }
+    ChannelSample back() const { return ring_->at(last_ - 1); }
+
+    iterator begin() const { return iterator(ring_, first_); }
+    iterator end() const { return iterator(ring_, last_); }
+
+    // Time lookups by binary search; positions are relative to this view.
+    // First sample with time >= t (size() when none).
+    size_t lower_bound(double t) const { return abs_lower_bound(t) - first_; }
+    // Sample closest in time to t, the earlier one on a tie; size() when empty.
+    size_t nearest(double t) const;
+
+    // Sub-range by position relative to this view.
+    SeriesView slice(size_t from, size_t to) const;
+    // Samples with time >= t_start (binary search).
+    SeriesView since(double t_start) const;
+    // Samples with t_start <= time <= t_end (binary search).
+    SeriesView between(double t_start, double t_end) const;
+
+    bool value_range(int* vmin, int* vmax) const;
+    void aggregate(AggregateBuckets* out) const { ring_->aggregate(first_, last_, out); }
+    // Contiguous piece starting at position from (relative to this view).
+    SampleRing::Segment segment(size_t from) const;
+
+private:
+    // Ring positions.
+    size_t abs_lower_bound(double t) const;
+    size_t abs_upper_bound(double t) const;
+
+    const SampleRing* ring_ = nullptr;
+    size_t first_ = 0;
+    size_t last_ = 0;
+    uint64_t version_ = 0;
+};
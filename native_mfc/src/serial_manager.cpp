@@ -8,10 +8,12 @@
 #include <algorithm>
 #include <string>
 
+#include "trace.h"
+
 #pragma comment(lib, "setupapi.lib")
 
 namespace {
-constexpr int kMaxRxBuffer = 4096;
+constexpr int kMaxRxBuffer = LineFramer::kMaxRxBuffer;
 
 std::wstring trim_ws(const std::wstring& input) {
     size_t start = input.find_first_not_of(L" \t\r\n");
@@ -162,19 +164,21 @@ bool SerialManager::connect(const std::wstring& port,
     PurgeComm(h, PURGE_RXCLEAR | PURGE_TXCLEAR);
 
     handle_ = h;
-    rx_buffer_.clear();
-    rx_overflow_ = 0;
+    framer_.reset();
     return true;
 }
 
 void SerialManager::disconnect() {
     close_handle();
-    rx_buffer_.clear();
-    rx_overflow_ = 0;
+    framer_.reset();
 }
 
-std::vector<std::string> SerialManager::read_lines(std::wstring* error) {
+std::vector<std::string> SerialManager::read_lines(std::wstring* error, size_t* bytes_read) {
+    SCC_TRACE_SCOPE("SerialManager::read_lines");
     std::vector<std::string> lines;
+    if (bytes_read) {
+        *bytes_read = 0;
+    }
     if (!is_connected()) {
         return lines;
     }
@@ -205,31 +209,13 @@ std::vector<std::string> SerialManager::read_lines(std::wstring* error) {
         return lines;
     }
 
-    buffer.resize(read);
-    rx_buffer_ += buffer;
-    if (static_cast<int>(rx_buffer_.size()) > kMaxRxBuffer) {
-        int overflow = static_cast<int>(rx_buffer_.size()) - kMaxRxBuffer;
-        rx_overflow_ += overflow;
-        rx_buffer_.erase(0, overflow);
+    if (bytes_read) {
+        *bytes_read = read;
     }
-
-    size_t pos = 0;
-    while ((pos = rx_buffer_.find('\n')) != std::string::npos) {
-        std::string line = rx_buffer_.substr(0, pos);
-        rx_buffer_.erase(0, pos + 1);
-        while (!line.empty() && (line.back() == '\r' || line.back() == '\n')) {
-            line.pop_back();
-        }
-        if (!line.empty()) {
-            lines.push_back(line);
-        }
-    }
-
+    framer_.push(buffer.data(), read, &lines);
     return lines;
 }
 
 int SerialManager::consume_rx_overflow() {
-    int count = rx_overflow_;
-    rx_overflow_ = 0;
-    return count;
+    return framer_.consume_overflow();
 }
@@ -5,6 +5,8 @@
 #include <string>
 #include <vector>
 
+#include "line_framer.h"
+
 struct SerialPortInfo {
     std::wstring device;
     std::wstring description;
@@ -27,7 +29,7 @@ public:
 
     void disconnect();
 
-    std::vector<std::string> read_lines(std::wstring* error);
+    std::vector<std::string> read_lines(std::wstring* error, size_t* bytes_read = nullptr);
 
     int consume_rx_overflow();
 
@@ -35,6 +37,5 @@ private:
     void close_handle();
 
     HANDLE handle_ = INVALID_HANDLE_VALUE;
-    std::string rx_buffer_;
-    int rx_overflow_ = 0;
+    LineFramer framer_;
 };
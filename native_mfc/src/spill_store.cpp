@@ -0,0 +1,338 @@
+#include "spill_store.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <random>
+
+#include "mapped_file.h"
+
+SpillStore::~SpillStore() {
+    close();
+}
+
+bool SpillStore::open(const std::string& dir, std::string* error) {
+    close();
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    if (ec || !std::filesystem::is_directory(dir, ec)) {
+        if (error) {
+            *error = "Failed to create spill directory: " + dir;
+        }
+        return false;
+    }
+    // Unique per session so concurrent instances can share a directory.
+    std::random_device rd;
+    unsigned long long stamp =
+        static_cast<unsigned long long>(std::chrono::system_clock::now().time_since_epoch().count());
+    char prefix[64] = {};
+    std::snprintf(prefix, sizeof(prefix), "scc_%llx_%08x_", stamp, static_cast<unsigned>(rd()));
+    dir_ = dir;
+    prefix_ = prefix;
+    last_error_.clear();
+    start_writer();
+    return true;
+}
+
+bool SpillStore::is_open() const {
+    return !dir_.empty();
+}
+
+void SpillStore::close() {
+    if (!is_open()) {
+        return;
+    }
+    stop_writer();
+    remove_segments();
+    dir_.clear();
+}
+
+void SpillStore::clear() {
+    if (!is_open()) {
+        return;
+    }
+    stop_writer();
+    remove_segments();
+    start_writer();
+}
+
+void SpillStore::start_writer() {
+    stop_ = false;
+    writer_ = std::thread([this] { writer_loop(); });
+}
+
+void SpillStore::stop_writer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    work_cv_.notify_all();
+    if (writer_.joinable()) {
+        writer_.join();
+    }
+    if (segment_file_) {
+        std::fclose(segment_file_);
+        segment_file_ = nullptr;
+    }
+    segment_size_ = 0;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.clear();
+    idle_cv_.notify_all();
+}
+
+void SpillStore::remove_segments() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    mappings_.clear();
+    for (uint32_t i = 0; i < segment_count_; ++i) {
+        std::remove(segment_path(i).c_str());
+    }
+    segment_count_ = 0;
+    channels_.clear();
+    samples_ = 0;
+    bytes_on_disk_ = 0;
+    pending_bytes_ = 0;
+}
+
+std::string SpillStore::segment_path(uint32_t segment) const {
+    char name[32] = {};
+    std::snprintf(name, sizeof(name), "%06u.seg", segment);
+    return (std::filesystem::path(dir_) / (prefix_ + name)).string();
+}
+
+void SpillStore::append(int channel, const HistoryBlockInfo& info, std::vector<uint8_t> data) {
+    if (!is_open() || channel < 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (static_cast<size_t>(channel) >= channels_.size()) {
+        channels_.resize(static_cast<size_t>(channel) + 1);
+    }
+    std::vector<Entry>& entries = channels_[static_cast<size_t>(channel)];
+    if (pending_bytes_ + data.size() > kMaxPendingBytes) {
+        lost_samples_ += static_cast<int>(info.count);
+        if (last_error_.empty()) {
+            last_error_ = "Spill writer fell behind; history dropped";
+        }
+        return;
+    }
+    Entry entry;
+    entry.info = info;
+    entry.size = static_cast<uint32_t>(data.size());
+    entry.pending = std::make_shared<const std::vector<uint8_t>>(std::move(data));
+    pending_bytes_ += entry.size;
+    samples_ += info.count;
+    queue_.push_back(Job{channel, entries.size(), entry.pending});
+    entries.push_back(std::move(entry));
+    work_cv_.notify_one();
+}
+
+void SpillStore::flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_cv_.wait(lock, [this] { return stop_ || (queue_.empty() && !writing_); });
+}
+
+void SpillStore::writer_loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        work_cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+        if (stop_) {
+            return;
+        }
+        Job job = std::move(queue_.front());
+        queue_.pop_front();
+        writing_ = true;
+        lock.unlock();
+
+        uint32_t segment = 0;
+        uint64_t offset = 0;
+        std::string error;
+        bool ok = write_block(*job.data, &segment, &offset, &error);
+
+        lock.lock();
+        writing_ = false;
+        Entry& entry = channels_[static_cast<size_t>(job.channel)][job.index];
+        pending_bytes_ -= entry.size;
+        if (ok) {
+            entry.segment = segment;
+            entry.offset = offset;
+            bytes_on_disk_ += entry.size;
+        } else {
+            entry.lost = true;
+            samples_ -= entry.info.count;
+            lost_samples_ += static_cast<int>(entry.info.count);
+            if (last_error_.empty()) {
+                last_error_ = error;
+            }
+        }
+        entry.pending.reset();
+        if (queue_.empty()) {
+            idle_cv_.notify_all();
+        }
+    }
+}
+
+bool SpillStore::write_block(const std::vector<uint8_t>& data, uint32_t* segment, uint64_t* offset,
+                             std::string* error) {
+    if (segment_file_ && segment_size_ + data.size() > kSegmentBytes) {
+        std::fclose(segment_file_);
+        segment_file_ = nullptr;
+    }
+    if (!segment_file_) {
+        uint32_t index = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            index = segment_count_++;
+        }
+        std::string path = segment_path(index);
+        segment_file_ = std::fopen(path.c_str(), "wb");
+        if (!segment_file_) {
+            *error = "Failed to create spill segment: " + path;
+            return false;
+        }
+        segment_size_ = 0;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        *segment = segment_count_ - 1;
+    }
+    *offset = segment_size_;
+    if (std::fwrite(data.data(), 1, data.size(), segment_file_) != data.size() || std::fflush(segment_file_) != 0) {
+        *error = "Failed to write spill segment";
+        // The failed write may have left partial bytes; start a new segment.
+        std::fclose(segment_file_);
+        segment_file_ = nullptr;
+        return false;
+    }
+    segment_size_ += data.size();
+    return true;
+}
+
+std::shared_ptr<const MappedFile> SpillStore::mapping_for(uint32_t segment, uint64_t end) const {
+    if (segment >= mappings_.size()) {
+        mappings_.resize(static_cast<size_t>(segment) + 1);
+    }
+    std::shared_ptr<const MappedFile>& mapping = mappings_[segment];
+    // The newest segment keeps growing; remap once a block lies past the end.
+    if (!mapping || mapping->size() < end) {
+        mapping = MappedFile::open(segment_path(segment));
+        if (mapping && mapping->size() < end) {
+            mapping.reset();
+        }
+    }
+    return mapping;
+}
+
+void SpillStore::collect(int channel, double t_start, double t_end, std::vector<BlockRef>* refs) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (channel < 0 || static_cast<size_t>(channel) >= channels_.size()) {
+        return;
+    }
+    const std::vector<Entry>& entries = channels_[static_cast<size_t>(channel)];
+    auto it = std::lower_bound(entries.begin(), entries.end(), t_start,
+                               [](const Entry& e, double t) { return e.info.t_last < t; });
+    for (; it != entries.end() && it->info.t_first <= t_end; ++it) {
+        if (it->lost) {
+            continue;
+        }
+        BlockRef ref;
+        ref.info = it->info;
+        ref.size = it->size;
+        if (it->pending) {
+            ref.pending = it->pending;
+            ref.data = it->pending->data();
+        } else {
+            ref.mapping = mapping_for(it->segment, it->offset + it->size);
+            if (!ref.mapping) {
+                continue;
+            }
+            ref.data = ref.mapping->data() + it->offset;
+        }
+        refs->push_back(std::move(ref));
+    }
+}
+
+void SpillStore::read(int channel, double t_start, double t_end, std::vector<ChannelSample>* out) const {
+    std::vector<BlockRef> refs;
+    collect(channel, t_start, t_end, &refs);
+    // Decoding touches the mapped pages, so it runs outside the lock.
+    for (const BlockRef& ref : refs) {
+        ChannelHistory::decode(ref.data, ref.size, ref.info.count, t_start, t_end, out);
+    }
+}
+
+bool SpillStore::value_range(int channel, double t_start, double t_end, int* vmin, int* vmax) const {
+    std::vector<BlockRef> refs;
+    collect(channel, t_start, t_end, &refs);
+    bool found = false;
+    int lo = 0;
+    int hi = 0;
+    for (const BlockRef& ref : refs) {
+        int a = ref.info.vmin;
+        int b = ref.info.vmax;
+        bool inside = ref.info.t_first >= t_start && ref.info.t_last <= t_end;
+        if (!inside && !ChannelHistory::decode_range(ref.data, ref.size, ref.info.count, t_start, t_end, &a, &b)) {
+            continue;
+        }
+        lo = found ? std::min(lo, a) : a;
+        hi = found ? std::max(hi, b) : b;
+        found = true;
+    }
+    if (found) {
+        *vmin = lo;
+        *vmax = hi;
+    }
+    return found;
+}
+
+void SpillStore::aggregate(int channel, AggregateBuckets* out) const {
+    std::vector<BlockRef> refs;
+    collect(channel, out->t_start(), out->t_end(), &refs);
+    for (const BlockRef& ref : refs) {
+        ChannelHistory::aggregate_block(ref.info, ref.data, ref.size, out);
+    }
+}
+
+bool SpillStore::time_span(int channel, double* t_first, double* t_last) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (channel < 0 || static_cast<size_t>(channel) >= channels_.size()) {
+        return false;
+    }
+    const std::vector<Entry>& entries = channels_[static_cast<size_t>(channel)];
+    auto readable = [](const Entry& e) { return !e.lost; };
+    auto first = std::find_if(entries.begin(), entries.end(), readable);
+    if (first == entries.end()) {
+        return false;
+    }
+    auto last = std::find_if(entries.rbegin(), entries.rend(), readable);
+    *t_first = first->info.t_first;
+    *t_last = last->info.t_last;
+    return true;
+}
+
+uint64_t SpillStore::samples() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return samples_;
+}
+
+uint64_t SpillStore::bytes_on_disk() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytes_on_disk_;
+}
+
+size_t SpillStore::pending_bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pending_bytes_;
+}
+
+int SpillStore::consume_lost_samples() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int out = lost_samples_;
+    lost_samples_ = 0;
+    return out;
+}
+
+std::string SpillStore::last_error() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return last_error_;
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "channel_history.h"
+
+class MappedFile;
+
+// On-disk tier for sealed ChannelHistory blocks. Blocks are handed over by
+// the ingest thread and appended to segment files by a background writer,
+// so ingest never waits for disk I/O; until written they stay readable from
+// memory. Reads map the segment files and decode straight from the mapping,
+// leaving residency to the OS page cache. Segment files belong to this
+// session and are deleted on close.
+class SpillStore {
+public:
+    static constexpr uint64_t kSegmentBytes = uint64_t(64) << 20;
+    // Blocks waiting for the writer beyond this are dropped rather than
+    // letting a stalled disk grow memory without bound.
+    static constexpr size_t kMaxPendingBytes = size_t(64) << 20;
+
+    SpillStore() = default;
+    ~SpillStore();
+
+    SpillStore(const SpillStore&) = delete;
+    SpillStore& operator=(const SpillStore&) = delete;
+
+    // Creates dir if needed and starts the writer thread.
+    bool open(const std::string& dir, std::string* error);
+    bool is_open() const;
+    // Stops the writer, discarding unwritten blocks, and deletes the segments.
+    void close();
+    // Drops every block and segment but stays open.
+    void clear();
+
+    // Blocks of one channel must be appended oldest first.
+    void append(int channel, const HistoryBlockInfo& info, std::vector<uint8_t> data);
+    // Waits until every appended block has been written (or failed).
+    void flush();
+
+    // Appends the samples with t_start <= time <= t_end to out.
+    void read(int channel, double t_start, double t_end, std::vector<ChannelSample>* out) const;
+    bool value_range(int channel, double t_start, double t_end, int* vmin, int* vmax) const;
+    // Folds the samples within out's range into it (see ChannelHistory::aggregate).
+    void aggregate(int channel, AggregateBuckets* out) const;
+    // Times of the channel's oldest and newest readable spilled samples.
+    bool time_span(int channel, double* t_first, double* t_last) const;
+
+    uint64_t samples() const;
+    uint64_t bytes_on_disk() const;
+    size_t pending_bytes() const;
+    // Samples whose blocks could not be written; the first error is kept.
+    int consume_lost_samples();
+    std::string last_error() const;
+
+private:
+    using Bytes = std::shared_ptr<const std::vector<uint8_t>>;
+
+    struct Entry {
+        HistoryBlockInfo info;
+        uint32_t segment = 0;
+        uint64_t offset = 0;
+        uint32_t size = 0;
+        Bytes pending;  // set until the writer has stored the block
+        bool lost = false;
+    };
+
+    struct Job {
+        int channel = 0;
+        size_t index = 0;
+        Bytes data;
+    };
+
+    // What a reader needs to decode one entry without holding the lock.
+    struct BlockRef {
+        HistoryBlockInfo info;
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+        Bytes pending;
+        std::shared_ptr<const MappedFile> mapping;
+    };
+
+    void writer_loop();
+    bool write_block(const std::vector<uint8_t>& data, uint32_t* segment, uint64_t* offset, std::string* error);
+    std::string segment_path(uint32_t segment) const;
+    void collect(int channel, double t_start, double t_end, std::vector<BlockRef>* refs) const;
+    void start_writer();
+    void stop_writer();
+    std::shared_ptr<const MappedFile> mapping_for(uint32_t segment, uint64_t end) const;
+    void remove_segments();
+
+    std::string dir_;
+    std::string prefix_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable work_cv_;
+    std::condition_variable idle_cv_;
+    std::deque<Job> queue_;
+    bool writing_ = false;
+    bool stop_ = false;
+    std::thread writer_;
+
+    std::vector<std::vector<Entry>> channels_;
+    uint64_t samples_ = 0;
+    uint64_t bytes_on_disk_ = 0;
+    size_t pending_bytes_ = 0;
+    int lost_samples_ = 0;
+    std::string last_error_;
+    uint32_t segment_count_ = 0;
+    mutable std::vector<std::shared_ptr<const MappedFile>> mappings_;
+
+    // Writer thread only.
+    std::FILE* segment_file_ = nullptr;
+    uint64_t segment_size_ = 0;
+};
@@ -0,0 +1,270 @@
+#include "trace.h"
+
+#include <fstream>
+
+#ifdef SCC_ENABLE_TRACE
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define SCC_TRACE_HAS_TSC 1
+#elif (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define SCC_TRACE_HAS_TSC 1
+#endif
+#endif
+
+namespace trace {
+
+#ifdef SCC_ENABLE_TRACE
+
+namespace {
+constexpr uint64_t kRingEvents = 1u << 15;
+constexpr uint64_t kRingMask = kRingEvents - 1;
+constexpr double kMinCalibrationSec = 0.01;
+
+// One event of a ring. seq is 2 * index + 2 once the event with that ring
+// index is stored and odd while the writer is storing it, so a dump can
+// tell a slot overwritten during its copy from the event it expected.
+struct Slot {
+    std::atomic<uint64_t> seq{0};
+    std::atomic<const char*> name{nullptr};
+    std::atomic<uint64_t> start{0};
+    std::atomic<uint64_t> end{0};
+    std::atomic<int64_t> arg{0};
+    std::atomic<EventType> type{EventType::kComplete};
+};
+
+struct ThreadRing {
+    std::atomic<uint64_t> head{0};
+    uint32_t tid = 0;
+    Slot slots[kRingEvents];
+};
+
+int64_t steady_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadRing>> rings;
+    std::vector<ThreadRing*> free_rings;
+    uint32_t next_tid = 1;
+
+    uint64_t base_ticks = now_ticks();
+    int64_t base_ns = steady_ns();
+};
+
+Registry& registry() {
+    static Registry* instance = new Registry();
+    return *instance;
+}
+
+ThreadRing* acquire_ring() {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    ThreadRing* ring = nullptr;
+    if (!reg.free_rings.empty()) {
+        ring = reg.free_rings.back();
+        reg.free_rings.pop_back();
+    } else {
+        reg.rings.push_back(std::make_unique<ThreadRing>());
+        ring = reg.rings.back().get();
+    }
+    ring->head.store(0, std::memory_order_relaxed);
+    ring->tid = reg.next_tid++;
+    return ring;
+}
+
+void release_ring(ThreadRing* ring) {
+    // The ring keeps its events for later dumps until another thread reuses it.
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.free_rings.push_back(ring);
+}
+
+struct ThreadHandle {
+    ThreadRing* ring = nullptr;
+    ~ThreadHandle() {
+        if (ring) {
+            release_ring(ring);
+        }
+    }
+};
+
+thread_local ThreadHandle t_handle;
+
+// False when the slot no longer (or not yet) holds event index.
+bool read_slot(const Slot& slot, uint64_t index, Event* out) {
+    uint64_t seq = slot.seq.load(std::memory_order_acquire);
+    if (seq != 2 * index + 2) {
+        return false;
+    }
+    out->name = slot.name.load(std::memory_order_relaxed);
+    out->start = slot.start.load(std::memory_order_relaxed);
+    out->end = slot.end.load(std::memory_order_relaxed);
+    out->arg = slot.arg.load(std::memory_order_relaxed);
+    out->type = slot.type.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.seq.load(std::memory_order_relaxed) == seq;
+}
+
+void append_event_json(std::string* out, const Event& e, uint32_t tid, double us_per_tick,
+                       uint64_t base_ticks, bool* first) {
+    char buf[256] = {};
+    double ts = static_cast<double>(static_cast<int64_t>(e.start - base_ticks)) * us_per_tick;
+    int n = 0;
+    switch (e.type) {
+    case EventType::kComplete: {
+        double dur = static_cast<double>(e.end - e.start) * us_per_tick;
+        n = std::snprintf(buf, sizeof(buf),
+                          "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+                          e.name, ts, dur, tid);
+        break;
+    }
+    case EventType::kInstant:
+        n = std::snprintf(buf, sizeof(buf),
+                          "{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":%u,"
+                          "\"args\":{\"value\":%lld}}",
+                          e.name, ts, tid, static_cast<long long>(e.arg));
+        break;
+    case EventType::kCounter:
+        n = std::snprintf(buf, sizeof(buf),
+                          "{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"tid\":%u,"
+                          "\"args\":{\"value\":%lld}}",
+                          e.name, ts, tid, static_cast<long long>(e.arg));
+        break;
+    }
+    if (n <= 0) {
+        return;
+    }
+    if (!*first) {
+        out->append(",\n");
+    }
+    *first = false;
+    out->append(buf, static_cast<size_t>(std::min<int>(n, static_cast<int>(sizeof(buf)) - 1)));
+}
+} // namespace
+
+bool enabled() {
+    return true;
+}
+
+uint64_t now_ticks() {
+#ifdef SCC_TRACE_HAS_TSC
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(steady_ns());
+#endif
+}
+
+void record(const Event& event) {
+    ThreadRing* ring = t_handle.ring;
+    if (!ring) {
+        ring = acquire_ring();
+        t_handle.ring = ring;
+    }
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    Slot& slot = ring->slots[head & kRingMask];
+    slot.seq.store(2 * head + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(event.name, std::memory_order_relaxed);
+    slot.start.store(event.start, std::memory_order_relaxed);
+    slot.end.store(event.end, std::memory_order_relaxed);
+    slot.arg.store(event.arg, std::memory_order_relaxed);
+    slot.type.store(event.type, std::memory_order_relaxed);
+    slot.seq.store(2 * head + 2, std::memory_order_release);
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+std::string dump_chrome_json() {
+    Registry& reg = registry();
+
+    // Calibrate ticks against the steady clock over the whole recording.
+    int64_t now_ns = steady_ns();
+    while (static_cast<double>(now_ns - reg.base_ns) * 1e-9 < kMinCalibrationSec) {
+        std::this_thread::yield();
+        now_ns = steady_ns();
+    }
+    uint64_t now_tk = now_ticks();
+    double elapsed_us = static_cast<double>(now_ns - reg.base_ns) * 1e-3;
+    double elapsed_ticks = static_cast<double>(now_tk - reg.base_ticks);
+    double us_per_tick = elapsed_ticks > 0.0 ? elapsed_us / elapsed_ticks : 1e-3;
+
+    std::vector<std::pair<uint32_t, std::vector<Event>>> copies;
+    {
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        for (const auto& ring : reg.rings) {
+            uint64_t head = ring->head.load(std::memory_order_acquire);
+            uint64_t count = std::min(head, kRingEvents);
+            std::vector<Event> events;
+            events.reserve(static_cast<size_t>(count));
+            Event e{};
+            for (uint64_t i = head - count; i < head; ++i) {
+                if (read_slot(ring->slots[i & kRingMask], i, &e)) {
+                    events.push_back(e);
+                }
+            }
+            copies.emplace_back(ring->tid, std::move(events));
+        }
+    }
+
+    std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    for (const auto& copy : copies) {
+        char meta[128] = {};
+        std::snprintf(meta, sizeof(meta),
+                      "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"thread %u\"}}",
+                      copy.first, copy.first);
+        if (!first) {
+            out.append(",\n");
+        }
+        out.append(meta);
+        first = false;
+        for (const auto& e : copy.second) {
+            append_event_json(&out, e, copy.first, us_per_tick, reg.base_ticks, &first);
+        }
+    }
+    out.append("\n]}\n");
+    return out;
+}
+
+#else
+
+bool enabled() {
+    return false;
+}
+
+std::string dump_chrome_json() {
+    return "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[]}\n";
+}
+
+#endif
+
+bool write_chrome_json(const std::string& path, std::string* error) {
+    if (!enabled()) {
+        if (error) {
+            *error = "Tracing is not compiled in (configure with -DSCC_ENABLE_TRACE=ON)";
+        }
+        return false;
+    }
+    std::ofstream f(path, std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!f) {
+        if (error) {
+            *error = "Cannot create trace file: " + path;
+        }
+        return false;
+    }
+    f << dump_chrome_json();
+    return static_cast<bool>(f);
+}
+
+} // namespace trace
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Opt-in event tracing of the capture and render pipeline.
+//
+// Build with -DSCC_ENABLE_TRACE=ON to compile the trace points in; otherwise
+// every SCC_TRACE_* macro expands to nothing. When enabled, each thread
+// records into its own fixed-size ring (single writer, no locks, oldest
+// events overwritten) and dump_chrome_json() renders all rings as
+// Chrome/Perfetto trace JSON ("Open trace file" in ui.perfetto.dev or
+// chrome://tracing). A dump skips events overwritten while it copies them.
+//
+// Names must be string literals: only the pointer is stored.
+
+namespace trace {
+
+bool enabled();
+
+// Renders every thread's ring as a Chrome trace event document.
+std::string dump_chrome_json();
+bool write_chrome_json(const std::string& path, std::string* error);
+
+#ifdef SCC_ENABLE_TRACE
+
+enum class EventType : uint32_t {
+    kComplete,
+    kInstant,
+    kCounter,
+};
+
+struct Event {
+    const char* name;
+    uint64_t start;
+    uint64_t end;
+    int64_t arg;
+    EventType type;
+};
+
+uint64_t now_ticks();
+void record(const Event& event);
+
+class Scope {
+public:
+    explicit Scope(const char* name) : name_(name), start_(now_ticks()) {}
+    ~Scope() {
+        record(Event{name_, start_, now_ticks(), 0, EventType::kComplete});
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    const char* name_;
+    uint64_t start_;
+};
+
+inline void instant(const char* name, int64_t arg) {
+    uint64_t ts = now_ticks();
+    record(Event{name, ts, ts, arg, EventType::kInstant});
+}
+
+inline void counter(const char* name, int64_t value) {
+    uint64_t ts = now_ticks();
+    record(Event{name, ts, ts, value, EventType::kCounter});
+}
+
+#define SCC_TRACE_CONCAT_INNER(a, b) a##b
+#define SCC_TRACE_CONCAT(a, b) SCC_TRACE_CONCAT_INNER(a, b)
+#define SCC_TRACE_SCOPE(name) ::trace::Scope SCC_TRACE_CONCAT(scc_trace_scope_, __LINE__)(name)
+#define SCC_TRACE_INSTANT(name, arg) ::trace::instant(name, static_cast<int64_t>(arg))
+#define SCC_TRACE_COUNTER(name, value) ::trace::counter(name, static_cast<int64_t>(value))
+
+#else
+
+#define SCC_TRACE_SCOPE(name) ((void)0)
+#define SCC_TRACE_INSTANT(name, arg) ((void)0)
+#define SCC_TRACE_COUNTER(name, value) ((void)0)
+
+#endif
+
+} // namespace trace
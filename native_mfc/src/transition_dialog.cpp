@@ -0,0 +1,306 @@
+#include "transition_dialog.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+#include "channel_model.h"
+
+namespace {
+constexpr UINT_PTR kRefreshTimer = 1;
+
+const wchar_t* kHintText =
+    L"One discrete channel per line (a state or fault code). Its value changes are indexed from now on, "
+    L"together with what is still stored. Pick a row and use Previous/Next to jump the plot to each "
+    L"change of that kind; the * row of a channel steps through every change.";
+
+std::wstring to_wstring(const std::string& s) {
+    if (s.empty()) {
+        return L"";
+    }
+    int len = MultiByteToWideChar(CP_UTF8, 0, s.c_str(), -1, nullptr, 0);
+    if (len <= 0) {
+        return L"";
+    }
+    std::wstring out(len - 1, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, s.c_str(), -1, &out[0], len);
+    return out;
+}
+
+std::string to_utf8(const std::wstring& s) {
+    if (s.empty()) {
+        return "";
+    }
+    int len = WideCharToMultiByte(CP_UTF8, 0, s.c_str(), -1, nullptr, 0, nullptr, nullptr);
+    if (len <= 0) {
+        return "";
+    }
+    std::string out(len - 1, '\0');
+    WideCharToMultiByte(CP_UTF8, 0, s.c_str(), -1, &out[0], len, nullptr, nullptr);
+    return out;
+}
+} // namespace
+
+void TransitionDialog::show(HWND parent, ChannelModel* model,
+                            std::function<void(const std::string&, const Transition&)> on_jump) {
+    model_ = model;
+    on_jump_ = std::move(on_jump);
+    listed_total_ = UINT64_MAX;
+    has_cursor_ = false;
+
+    WNDCLASSW wc = {};
+    wc.lpfnWndProc = TransitionDialog::WndProc;
+    wc.hInstance = GetModuleHandleW(nullptr);
+    wc.lpszClassName = L"TransitionDialogWnd";
+    wc.hCursor = LoadCursor(nullptr, IDC_ARROW);
+    wc.hbrBackground = reinterpret_cast<HBRUSH>(GetStockObject(WHITE_BRUSH));
+    RegisterClassW(&wc);
+
+    hwnd_ = CreateWindowExW(
+        WS_EX_DLGMODALFRAME,
+        wc.lpszClassName,
+        L"Transitions",
+        WS_OVERLAPPED | WS_CAPTION | WS_SYSMENU | WS_THICKFRAME | WS_VISIBLE,
+        CW_USEDEFAULT, CW_USEDEFAULT, 720, 520,
+        parent,
+        nullptr,
+        wc.hInstance,
+        this
+    );
+    if (!hwnd_) {
+        return;
+    }
+
+    ShowWindow(hwnd_, SW_SHOW);
+
+    MSG msg;
+    while (IsWindow(hwnd_) && GetMessageW(&msg, nullptr, 0, 0)) {
+        if (IsDialogMessageW(hwnd_, &msg)) {
+            continue;
+        }
+        TranslateMessage(&msg);
+        DispatchMessageW(&msg);
+    }
+}
+
+void TransitionDialog::apply() {
+    int len = GetWindowTextLengthW(edit_);
+    std::wstring text(static_cast<size_t>(len) + 1, L'\0');
+    GetWindowTextW(edit_, &text[0], len + 1);
+    text.resize(static_cast<size_t>(len));
+
+    std::vector<std::string> keys;
+    std::istringstream lines(to_utf8(text));
+    std::string line;
+    while (std::getline(lines, line)) {
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') {
+            continue;
+        }
+        size_t last = line.find_last_not_of(" \t\r");
+        keys.push_back(line.substr(first, last - first + 1));
+    }
+    for (const auto& key : model_->get_transition_keys()) {
+        if (std::find(keys.begin(), keys.end(), key) == keys.end()) {
+            model_->set_transition_index(key, false);
+        }
+    }
+    for (const auto& key : keys) {
+        model_->set_transition_index(key, true);
+    }
+    listed_total_ = UINT64_MAX;
+    refresh_counts();
+}
+
+void TransitionDialog::refresh_counts() {
+    const int any = TransitionIndex::kAnyValue;
+    std::vector<std::string> keys = model_->get_transition_keys();
+    uint64_t total = 0;
+    for (const auto& key : keys) {
+        total += model_->count_transitions(key, any, any);
+    }
+    if (total == listed_total_) {
+        return;
+    }
+    listed_total_ = total;
+
+    // Keep the selected kind selected across the rebuild.
+    LRESULT selected = SendMessageW(list_, LB_GETCURSEL, 0, 0);
+    Row keep;
+    bool has_keep = selected != LB_ERR && static_cast<size_t>(selected) < rows_.size();
+    if (has_keep) {
+        keep = rows_[static_cast<size_t>(selected)];
+    }
+    rows_.clear();
+    SendMessageW(list_, LB_RESETCONTENT, 0, 0);
+    auto add_row = [&](const Row& row, uint64_t count) {
+        wchar_t line[256] = {};
+        std::wstring from = row.from == any ? L"*" : std::to_wstring(row.from);
+        std::wstring to = row.to == any ? L"*" : std::to_wstring(row.to);
+        _snwprintf_s(line, 256, _TRUNCATE, L"%-16s %8s -> %-8s x%llu", to_wstring(row.key).c_str(), from.c_str(),
+                     to.c_str(), static_cast<unsigned long long>(count));
+        SendMessageW(list_, LB_ADDSTRING, 0, reinterpret_cast<LPARAM>(line));
+        if (has_keep && row.key == keep.key && row.from == keep.from && row.to == keep.to) {
+            SendMessageW(list_, LB_SETCURSEL, rows_.size(), 0);
+        }
+        rows_.push_back(row);
+    };
+    for (const auto& key : keys) {
+        add_row(Row{key, any, any}, model_->count_transitions(key, any, any));
+        for (const auto& kind : model_->get_transition_counts(key)) {
+            add_row(Row{key, kind.from, kind.to}, kind.count);
+        }
+    }
+}
+
+void TransitionDialog::step(bool forward) {
+    LRESULT selected = SendMessageW(list_, LB_GETCURSEL, 0, 0);
+    if (selected == LB_ERR || static_cast<size_t>(selected) >= rows_.size()) {
+        SetWindowTextW(status_, L"Select a row first.");
+        return;
+    }
+    const Row& row = rows_[static_cast<size_t>(selected)];
+    // Without a cursor Next starts at the oldest change and Previous at the newest.
+    double t = has_cursor_ ? cursor_t_ : (forward ? -HUGE_VAL : HUGE_VAL);
+    Transition found;
+    bool ok = forward ? model_->find_next_transition(row.key, t, row.from, row.to, &found)
+                      : model_->find_prev_transition(row.key, t, row.from, row.to, &found);
+    if (!ok) {
+        SetWindowTextW(status_, forward ? L"No later change." : L"No earlier change.");
+        return;
+    }
+    cursor_t_ = found.t;
+    has_cursor_ = true;
+    wchar_t line[256] = {};
+    _snwprintf_s(line, 256, _TRUNCATE, L"%s %d -> %d at %.6f s", to_wstring(row.key).c_str(), found.from, found.to,
+                 found.t);
+    SetWindowTextW(status_, line);
+    if (on_jump_) {
+        on_jump_(row.key, found);
+    }
+}
+
+LRESULT CALLBACK TransitionDialog::WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+    TransitionDialog* self = reinterpret_cast<TransitionDialog*>(GetWindowLongPtrW(hwnd, GWLP_USERDATA));
+    if (msg == WM_NCCREATE) {
+        CREATESTRUCTW* cs = reinterpret_cast<CREATESTRUCTW*>(lParam);
+        self = reinterpret_cast<TransitionDialog*>(cs->lpCreateParams);
+        SetWindowLongPtrW(hwnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(self));
+    }
+    if (self) {
+        return self->handle_message(hwnd, msg, wParam, lParam);
+    }
+    return DefWindowProcW(hwnd, msg, wParam, lParam);
+}
+
+LRESULT TransitionDialog::handle_message(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+    switch (msg) {
+    case WM_CREATE: {
+        hint_ = CreateWindowW(L"STATIC", kHintText, WS_CHILD | WS_VISIBLE,
+                              10, 10, 680, 56, hwnd, nullptr, nullptr, nullptr);
+        edit_ = CreateWindowExW(WS_EX_CLIENTEDGE, L"EDIT", L"", WS_CHILD | WS_VISIBLE | WS_TABSTOP | ES_MULTILINE |
+                                ES_WANTRETURN | WS_VSCROLL | ES_AUTOVSCROLL, 10, 76, 680, 100, hwnd, nullptr, nullptr, nullptr);
+        list_ = CreateWindowExW(WS_EX_CLIENTEDGE, L"LISTBOX", L"", WS_CHILD | WS_VISIBLE | WS_TABSTOP | WS_VSCROLL |
+                                LBS_NOTIFY | LBS_NOINTEGRALHEIGHT, 10, 222, 680, 200, hwnd, nullptr, nullptr, nullptr);
+        status_ = CreateWindowW(L"STATIC", L"", WS_CHILD | WS_VISIBLE,
+                                10, 448, 320, 20, hwnd, nullptr, nullptr, nullptr);
+        font_ = CreateFontW(16, 0, 0, 0, FW_NORMAL, FALSE, FALSE, FALSE, DEFAULT_CHARSET,
+                            OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS, CLEARTYPE_QUALITY, FIXED_PITCH, L"Consolas");
+        if (font_) {
+            SendMessageW(edit_, WM_SETFONT, reinterpret_cast<WPARAM>(font_), TRUE);
+            SendMessageW(list_, WM_SETFONT, reinterpret_cast<WPARAM>(font_), TRUE);
+        }
+        std::wstring text;
+        for (const auto& key : model_->get_transition_keys()) {
+            text += to_wstring(key) + L"\r\n";
+        }
+        SetWindowTextW(edit_, text.c_str());
+
+        btn_apply_ = CreateWindowW(L"BUTTON", L"Apply", WS_CHILD | WS_VISIBLE | WS_TABSTOP | BS_PUSHBUTTON,
+                                   610, 186, 80, 26, hwnd, reinterpret_cast<HMENU>(1), nullptr, nullptr);
+        btn_prev_ = CreateWindowW(L"BUTTON", L"Previous", WS_CHILD | WS_VISIBLE | WS_TABSTOP | BS_PUSHBUTTON,
+                                  430, 444, 80, 26, hwnd, reinterpret_cast<HMENU>(2), nullptr, nullptr);
+        btn_next_ = CreateWindowW(L"BUTTON", L"Next", WS_CHILD | WS_VISIBLE | WS_TABSTOP | BS_PUSHBUTTON,
+                                  520, 444, 80, 26, hwnd, reinterpret_cast<HMENU>(3), nullptr, nullptr);
+        btn_close_ = CreateWindowW(L"BUTTON", L"Close", WS_CHILD | WS_VISIBLE | WS_TABSTOP | BS_PUSHBUTTON,
+                                   610, 444, 80, 26, hwnd, reinterpret_cast<HMENU>(4), nullptr, nullptr);
+        refresh_counts();
+        SetTimer(hwnd, kRefreshTimer, 500, nullptr);
+        return 0;
+    }
+    case WM_SIZE: {
+        int w = LOWORD(lParam);
+        int h = HIWORD(lParam);
+        if (edit_ && list_ && btn_close_) {
+            int margin = 10;
+            int hint_h = 56;
+            int btn_h = 26;
+            int btn_w = 80;
+            int edit_h = std::max(60, (h - hint_h - 2 * btn_h - 6 * margin) / 3);
+            int edit_y = 2 * margin + hint_h;
+            int apply_y = edit_y + edit_h + margin;
+            int list_y = apply_y + btn_h + margin;
+            int bottom_y = h - btn_h - margin;
+            MoveWindow(hint_, margin, margin, w - 2 * margin, hint_h, TRUE);
+            MoveWindow(edit_, margin, edit_y, w - 2 * margin, edit_h, TRUE);
+            MoveWindow(btn_apply_, w - btn_w - margin, apply_y, btn_w, btn_h, TRUE);
+            MoveWindow(list_, margin, list_y, w - 2 * margin, bottom_y - margin - list_y, TRUE);
+            MoveWindow(status_, margin, bottom_y + 4, std::max(0, w - 4 * btn_w - 5 * margin), btn_h - 4, TRUE);
+            MoveWindow(btn_prev_, w - 3 * btn_w - 3 * margin, bottom_y, btn_w, btn_h, TRUE);
+            MoveWindow(btn_next_, w - 2 * btn_w - 2 * margin, bottom_y, btn_w, btn_h, TRUE);
+            MoveWindow(btn_close_, w - btn_w - margin, bottom_y, btn_w, btn_h, TRUE);
+        }
+        return 0;
+    }
+    case WM_TIMER:
+        if (wParam == kRefreshTimer) {
+            refresh_counts();
+            return 0;
+        }
+        break;
+    case WM_COMMAND: {
+        HWND from = reinterpret_cast<HWND>(lParam);
+        if (from == btn_apply_) {
+            apply();
+            return 0;
+        }
+        if (from == list_ && HIWORD(wParam) == LBN_SELCHANGE) {
+            has_cursor_ = false;
+            return 0;
+        }
+        if (from == btn_next_ || (from == list_ && HIWORD(wParam) == LBN_DBLCLK)) {
+            step(true);
+            return 0;
+        }
+        if (from == btn_prev_) {
+            step(false);
+            return 0;
+        }
+        if (from == btn_close_) {
+            DestroyWindow(hwnd);
+            return 0;
+        }
+        break;
+    }
+    case WM_CLOSE:
+        DestroyWindow(hwnd);
+        return 0;
+    case WM_DESTROY:
+        KillTimer(hwnd, kRefreshTimer);
+        if (font_) {
+            DeleteObject(font_);
+            font_ = nullptr;
+        }
+        hwnd_ = nullptr;
+        hint_ = nullptr;
+        edit_ = nullptr;
+        list_ = nullptr;
+        status_ = nullptr;
+        btn_apply_ = nullptr;
+        btn_prev_ = nullptr;
+        btn_next_ = nullptr;
+        btn_close_ = nullptr;
+        break;
+    }
+    return DefWindowProcW(hwnd, msg, wParam, lParam);
+}
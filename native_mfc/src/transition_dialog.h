@@ -0,0 +1,54 @@
+#pragma once
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+class ChannelModel;
+struct Transition;
+
+// Edits which channels have their value changes indexed (one key per line)
+// and lists each indexed kind with its count; Previous/Next hand the
+// selected kind's neighbouring change to on_jump.
+class TransitionDialog {
+public:
+    void show(HWND parent, ChannelModel* model,
+              std::function<void(const std::string& key, const Transition& transition)> on_jump);
+
+private:
+    struct Row {
+        std::string key;
+        int from = 0;
+        int to = 0;
+    };
+
+    static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
+    LRESULT handle_message(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
+    void apply();
+    void refresh_counts();
+    void step(bool forward);
+
+    ChannelModel* model_ = nullptr;
+    std::function<void(const std::string&, const Transition&)> on_jump_;
+    std::vector<Row> rows_;
+    uint64_t listed_total_ = UINT64_MAX;
+    // Time of the change last jumped to; reset when the selection changes.
+    double cursor_t_ = 0.0;
+    bool has_cursor_ = false;
+    HWND hwnd_ = nullptr;
+    HWND hint_ = nullptr;
+    HWND edit_ = nullptr;
+    HWND list_ = nullptr;
+    HWND status_ = nullptr;
+    HWND btn_apply_ = nullptr;
+    HWND btn_prev_ = nullptr;
+    HWND btn_next_ = nullptr;
+    HWND btn_close_ = nullptr;
+    HFONT font_ = nullptr;
+};
@@ -0,0 +1,146 @@
+#include "transition_index.h"
+
+#include <algorithm>
+
+void TransitionIndex::add(double t, int from, int to) {
+    if (events_.size() == kMaxEvents) {
+        const Transition& oldest = events_.front();
+        auto it = kinds_.find(kind_key(oldest.from, oldest.to));
+        it->second.pop_front();
+        if (it->second.empty()) {
+            kinds_.erase(it);
+        }
+        events_.pop_front();
+        base_++;
+    }
+    kinds_[kind_key(from, to)].push_back(base_ + events_.size());
+    events_.push_back(Transition{t, from, to});
+}
+
+void TransitionIndex::pop_back() {
+    if (events_.empty()) {
+        return;
+    }
+    const Transition& newest = events_.back();
+    auto it = kinds_.find(kind_key(newest.from, newest.to));
+    it->second.pop_back();
+    if (it->second.empty()) {
+        kinds_.erase(it);
+    }
+    events_.pop_back();
+}
+
+void TransitionIndex::clear() {
+    events_.clear();
+    kinds_.clear();
+    base_ = 0;
+}
+
+bool TransitionIndex::search(const std::deque<uint64_t>& seqs, double t, bool forward, uint64_t* seq) const {
+    if (forward) {
+        auto it = std::upper_bound(seqs.begin(), seqs.end(), t,
+                                   [this](double x, uint64_t s) { return x < event(s).t; });
+        if (it == seqs.end()) {
+            return false;
+        }
+        *seq = *it;
+        return true;
+    }
+    auto it = std::lower_bound(seqs.begin(), seqs.end(), t,
+                               [this](uint64_t s, double x) { return event(s).t < x; });
+    if (it == seqs.begin()) {
+        return false;
+    }
+    *seq = *(it - 1);
+    return true;
+}
+
+bool TransitionIndex::next(double t, int from, int to, Transition* out) const {
+    bool found = false;
+    uint64_t best = 0;
+    if (from == kAnyValue && to == kAnyValue) {
+        auto it = std::upper_bound(events_.begin(), events_.end(), t,
+                                   [](double x, const Transition& e) { return x < e.t; });
+        found = it != events_.end();
+        best = base_ + static_cast<uint64_t>(it - events_.begin());
+    } else {
+        for (const auto& kind : kinds_) {
+            const Transition& first = event(kind.second.front());
+            uint64_t seq = 0;
+            if ((from == kAnyValue || first.from == from) && (to == kAnyValue || first.to == to) &&
+                search(kind.second, t, true, &seq) && (!found || seq < best)) {
+                best = seq;
+                found = true;
+            }
+        }
+    }
+    if (found) {
+        *out = event(best);
+    }
+    return found;
+}
+
+bool TransitionIndex::prev(double t, int from, int to, Transition* out) const {
+    bool found = false;
+    uint64_t best = 0;
+    if (from == kAnyValue && to == kAnyValue) {
+        auto it = std::lower_bound(events_.begin(), events_.end(), t,
+                                   [](const Transition& e, double x) { return e.t < x; });
+        found = it != events_.begin();
+        best = base_ + static_cast<uint64_t>(it - events_.begin()) - (found ? 1 : 0);
+    } else {
+        for (const auto& kind : kinds_) {
+            const Transition& first = event(kind.second.front());
+            uint64_t seq = 0;
+            if ((from == kAnyValue || first.from == from) && (to == kAnyValue || first.to == to) &&
+                search(kind.second, t, false, &seq) && (!found || seq > best)) {
+                best = seq;
+                found = true;
+            }
+        }
+    }
+    if (found) {
+        *out = event(best);
+    }
+    return found;
+}
+
+uint64_t TransitionIndex::count(int from, int to) const {
+    if (from != kAnyValue && to != kAnyValue) {
+        auto it = kinds_.find(kind_key(from, to));
+        return it != kinds_.end() ? it->second.size() : 0;
+    }
+    uint64_t n = 0;
+    for (const auto& kind : kinds_) {
+        const Transition& first = event(kind.second.front());
+        if ((from == kAnyValue || first.from == from) && (to == kAnyValue || first.to == to)) {
+            n += kind.second.size();
+        }
+    }
+    return n;
+}
+
+std::vector<TransitionCount> TransitionIndex::counts() const {
+    std::vector<TransitionCount> out;
+    out.reserve(kinds_.size());
+    for (const auto& kind : kinds_) {
+        const Transition& first = event(kind.second.front());
+        out.push_back(TransitionCount{first.from, first.to, kind.second.size()});
+    }
+    std::sort(out.begin(), out.end(), [](const TransitionCount& a, const TransitionCount& b) {
+        if (a.count != b.count) {
+            return a.count > b.count;
+        }
+        return a.from != b.from ? a.from < b.from : a.to < b.to;
+    });
+    return out;
+}
+
+size_t TransitionIndex::bytes() const {
+    size_t seqs = 0;
+    for (const auto& kind : kinds_) {
+        seqs += kind.second.size();
+    }
+    return events_.size() * sizeof(Transition) + seqs * sizeof(uint64_t) +
+        kinds_.size() * (sizeof(uint64_t) + sizeof(std::deque<uint64_t>));
+}
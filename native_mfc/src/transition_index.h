@@ -0,0 +1,68 @@
+#pragma once
+
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+// One value change of a channel.
+struct Transition {
+    double t = 0.0;
+    int from = 0;
+    int to = 0;
+};
+
+// Changes of one (from, to) kind.
+struct TransitionCount {
+    int from = 0;
+    int to = 0;
+    uint64_t count = 0;
+};
+
+// Value changes of one discrete channel (a state or fault code), oldest
+// first, with a time-ordered list per (from, to) kind. Finding the next or
+// previous change of a kind is a binary search and its count is O(1); a
+// query with one side left open searches each matching kind. Beyond
+// kMaxEvents the oldest changes are dropped.
+class TransitionIndex {
+public:
+    static constexpr int kAnyValue = INT_MIN;
+    static constexpr size_t kMaxEvents = size_t(1) << 20;
+
+    // Times must be non-decreasing.
+    void add(double t, int from, int to);
+    // Removes the newest change (its sample was replaced).
+    void pop_back();
+    void clear();
+
+    size_t size() const { return events_.size(); }
+    bool empty() const { return events_.empty(); }
+    const Transition& back() const { return events_.back(); }
+    // Changes dropped to stay within kMaxEvents.
+    uint64_t dropped() const { return base_; }
+
+    // First change after t (before t for prev) matching from -> to, where
+    // kAnyValue matches any value; false when there is none.
+    bool next(double t, int from, int to, Transition* out) const;
+    bool prev(double t, int from, int to, Transition* out) const;
+    uint64_t count(int from, int to) const;
+    // Every kind seen, most frequent first.
+    std::vector<TransitionCount> counts() const;
+
+    size_t bytes() const;
+
+private:
+    static uint64_t kind_key(int from, int to) {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(from)) << 32) | static_cast<uint32_t>(to);
+    }
+    const Transition& event(uint64_t seq) const { return events_[static_cast<size_t>(seq - base_)]; }
+    // Nearest match in one time-ordered list of event numbers.
+    bool search(const std::deque<uint64_t>& seqs, double t, bool forward, uint64_t* seq) const;
+
+    std::deque<Transition> events_;
+    // Event numbers (base_ is the oldest kept) per kind.
+    std::unordered_map<uint64_t, std::deque<uint64_t>> kinds_;
+    uint64_t base_ = 0;
+};
@@ -0,0 +1,180 @@
+#include "trigger.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+
+namespace {
+bool parse_double(const std::string& text, double* out) {
+    char* end = nullptr;
+    double value = std::strtod(text.c_str(), &end);
+    if (text.empty() || *end != '\0' || !std::isfinite(value)) {
+        return false;
+    }
+    *out = value;
+    return true;
+}
+
+bool parse_state(const std::string& text, int* out) {
+    if (text == "*") {
+        *out = TriggerSpec::kAnyValue;
+        return true;
+    }
+    double value = 0.0;
+    if (!parse_double(text, &value) || value != std::floor(value) || std::fabs(value) > INT_MAX) {
+        return false;
+    }
+    *out = static_cast<int>(value);
+    return true;
+}
+} // namespace
+
+bool parse_trigger(const std::string& text, TriggerSpec* out, std::string* error) {
+    std::istringstream in(text);
+    std::vector<std::string> words;
+    std::string word;
+    while (in >> word) {
+        words.push_back(word);
+    }
+    if (words.size() < 2) {
+        *error = "Expected KEY rise|fall|cross|above|below|change ...";
+        return false;
+    }
+
+    TriggerSpec spec;
+    spec.key = words[0];
+    const std::string& kind = words[1];
+    size_t i = 2;
+    if (kind == "rise" || kind == "fall" || kind == "cross" || kind == "above" || kind == "below") {
+        spec.kind = kind == "rise" ? TriggerSpec::Kind::kRise
+                  : kind == "fall" ? TriggerSpec::Kind::kFall
+                  : kind == "cross" ? TriggerSpec::Kind::kCross
+                  : kind == "above" ? TriggerSpec::Kind::kAbove
+                  : TriggerSpec::Kind::kBelow;
+        if (i >= words.size() || !parse_double(words[i], &spec.level)) {
+            *error = kind + " needs a level";
+            return false;
+        }
+        i++;
+    } else if (kind == "change") {
+        spec.kind = TriggerSpec::Kind::kChange;
+        for (int* state : {&spec.from, &spec.to}) {
+            if (i < words.size() && parse_state(words[i], state)) {
+                i++;
+            }
+        }
+    } else {
+        *error = "Unknown trigger type: " + kind;
+        return false;
+    }
+
+    bool pulse = spec.kind == TriggerSpec::Kind::kAbove || spec.kind == TriggerSpec::Kind::kBelow;
+    for (; i < words.size(); i += 2) {
+        const std::string& name = words[i];
+        double value = 0.0;
+        if (i + 1 >= words.size() || !parse_double(words[i + 1], &value) || value < 0.0) {
+            *error = "Expected a non-negative number after " + name;
+            return false;
+        }
+        if (name == "hyst" && spec.kind != TriggerSpec::Kind::kChange) {
+            spec.hysteresis = value;
+        } else if (name == "min" && pulse) {
+            spec.min_width = value;
+        } else if (name == "max" && pulse) {
+            spec.max_width = value;
+        } else if (name == "pre") {
+            spec.pre = value;
+        } else if (name == "post") {
+            spec.post = value;
+        } else {
+            *error = "Unexpected '" + name + "' for " + kind;
+            return false;
+        }
+    }
+    if (spec.max_width > 0.0 && spec.max_width < spec.min_width) {
+        *error = "max must not be below min";
+        return false;
+    }
+    *out = spec;
+    return true;
+}
+
+Trigger::Trigger(const TriggerSpec& spec, const std::string& text) : spec_(spec), text_(text) {}
+
+void Trigger::reset() {
+    side_ = Side::kUnknown;
+    in_pulse_ = false;
+    pulse_fired_ = false;
+    pulse_start_ = 0.0;
+    has_last_ = false;
+    last_ = 0;
+}
+
+bool Trigger::on_sample(double t, int v, double* fire_t) {
+    if (spec_.kind == TriggerSpec::Kind::kChange) {
+        bool fired = has_last_ && v != last_ &&
+            (spec_.from == TriggerSpec::kAnyValue || spec_.from == last_) &&
+            (spec_.to == TriggerSpec::kAnyValue || spec_.to == v);
+        has_last_ = true;
+        last_ = v;
+        *fire_t = t;
+        return fired;
+    }
+
+    Side prev = side_;
+    double x = static_cast<double>(v);
+    if (x > spec_.level + spec_.hysteresis) {
+        side_ = Side::kHigh;
+    } else if (x < spec_.level - spec_.hysteresis) {
+        side_ = Side::kLow;
+    }
+    if (prev == Side::kUnknown || prev == side_) {
+        if (!in_pulse_ || pulse_fired_ || spec_.max_width > 0.0 || t - pulse_start_ < spec_.min_width) {
+            return false;
+        }
+        // A pulse with only a minimum width fires once it has lasted that long.
+        pulse_fired_ = true;
+        *fire_t = pulse_start_;
+        return true;
+    }
+
+    switch (spec_.kind) {
+    case TriggerSpec::Kind::kRise:
+        *fire_t = t;
+        return side_ == Side::kHigh;
+    case TriggerSpec::Kind::kFall:
+        *fire_t = t;
+        return side_ == Side::kLow;
+    case TriggerSpec::Kind::kCross:
+        *fire_t = t;
+        return true;
+    default:
+        break;
+    }
+
+    Side pulse_side = spec_.kind == TriggerSpec::Kind::kAbove ? Side::kHigh : Side::kLow;
+    if (side_ == pulse_side) {
+        in_pulse_ = true;
+        pulse_fired_ = false;
+        pulse_start_ = t;
+        if (spec_.max_width <= 0.0 && spec_.min_width <= 0.0) {
+            pulse_fired_ = true;
+            *fire_t = t;
+            return true;
+        }
+        return false;
+    }
+    bool was_pulse = in_pulse_;
+    in_pulse_ = false;
+    double width = t - pulse_start_;
+    *fire_t = pulse_start_;
+    return was_pulse && spec_.max_width > 0.0 && width >= spec_.min_width && width <= spec_.max_width;
+}
+
+size_t TriggerCapture::sample_count() const {
+    size_t n = 0;
+    for (const auto& s : series) {
+        n += s.size();
+    }
+    return n;
+}
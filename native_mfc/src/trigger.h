@@ -0,0 +1,82 @@
+#pragma once
+
+#include <climits>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "sample_ring.h"
+
+// Condition checked on every new sample of one channel.
+struct TriggerSpec {
+    enum class Kind : uint8_t { kRise, kFall, kCross, kAbove, kBelow, kChange };
+    static constexpr int kAnyValue = INT_MIN;
+
+    std::string key;
+    Kind kind = Kind::kRise;
+    double level = 0.0;
+    // Values within level +- hysteresis keep the side they were on, so
+    // noise around the level does not fire repeatedly.
+    double hysteresis = 0.0;
+    // kAbove/kBelow: pulse width bounds in seconds, 0 = unbounded.
+    double min_width = 0.0;
+    double max_width = 0.0;
+    // kChange: kAnyValue matches any value.
+    int from = kAnyValue;
+    int to = kAnyValue;
+    // Seconds captured before and after the trigger time.
+    double pre = 1.0;
+    double post = 1.0;
+};
+
+// Parses one of
+//   KEY rise|fall|cross LEVEL
+//   KEY above|below LEVEL [min SEC] [max SEC]
+//   KEY change [FROM|*] [TO|*]
+// followed by any of "hyst H", "pre SEC" and "post SEC".
+bool parse_trigger(const std::string& text, TriggerSpec* out, std::string* error);
+
+// Edge, pulse and state-change detector for one channel.
+//
+// rise/fall/cross fire when the value moves to the other side of the level.
+// above/below fire for an excursion to that side: with max set when it ends
+// no longer than max (a glitch), otherwise as soon as it has lasted min.
+// The trigger time of a pulse is its start. change fires on a value change
+// matching from/to.
+class Trigger {
+public:
+    Trigger() = default;
+    Trigger(const TriggerSpec& spec, const std::string& text);
+
+    const TriggerSpec& spec() const { return spec_; }
+    const std::string& text() const { return text_; }
+    void reset();
+
+    // Feeds the channel's next sample; true with *fire_t set when it fires.
+    bool on_sample(double t, int v, double* fire_t);
+
+private:
+    enum class Side : uint8_t { kUnknown, kLow, kHigh };
+
+    TriggerSpec spec_;
+    std::string text_;
+    Side side_ = Side::kUnknown;
+    bool in_pulse_ = false;
+    bool pulse_fired_ = false;
+    double pulse_start_ = 0.0;
+    bool has_last_ = false;
+    int last_ = 0;
+};
+
+// Every channel's samples around one trigger, kept after they leave the model.
+struct TriggerCapture {
+    uint64_t seq = 0;         // 1 for the session's first capture
+    std::string trigger;      // definition text
+    double t = 0.0;           // trigger time
+    double t_start = 0.0;
+    double t_end = 0.0;
+    std::vector<std::string> keys;
+    std::vector<std::vector<ChannelSample>> series;  // parallel to keys
+
+    size_t sample_count() const;
+};
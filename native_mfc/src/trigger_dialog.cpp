@@ -0,0 +1,263 @@
+#include "trigger_dialog.h"
+
+#include <algorithm>
+#include <sstream>
+
+#include "channel_model.h"
+
+namespace {
+constexpr UINT_PTR kRefreshTimer = 1;
+
+const wchar_t* kHintText =
+    L"One trigger per line: KEY rise|fall|cross LEVEL, KEY above|below LEVEL [min SEC] [max SEC] "
+    L"or KEY change [FROM|*] [TO|*], optionally followed by hyst H, pre SEC, post SEC (default 1 s). "
+    L"Example glitch trigger: CHG below 3000 max 0.01";
+
+std::wstring to_wstring(const std::string& s) {
+    if (s.empty()) {
+        return L"";
+    }
+    int len = MultiByteToWideChar(CP_UTF8, 0, s.c_str(), -1, nullptr, 0);
+    if (len <= 0) {
+        return L"";
+    }
+    std::wstring out(len - 1, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, s.c_str(), -1, &out[0], len);
+    return out;
+}
+
+std::string to_utf8(const std::wstring& s) {
+    if (s.empty()) {
+        return "";
+    }
+    int len = WideCharToMultiByte(CP_UTF8, 0, s.c_str(), -1, nullptr, 0, nullptr, nullptr);
+    if (len <= 0) {
+        return "";
+    }
+    std::string out(len - 1, '\0');
+    WideCharToMultiByte(CP_UTF8, 0, s.c_str(), -1, &out[0], len, nullptr, nullptr);
+    return out;
+}
+} // namespace
+
+void TriggerDialog::show(HWND parent, ChannelModel* model, std::function<void(const TriggerCapture&)> on_show) {
+    model_ = model;
+    on_show_ = std::move(on_show);
+    listed_seq_ = 0;
+
+    WNDCLASSW wc = {};
+    wc.lpfnWndProc = TriggerDialog::WndProc;
+    wc.hInstance = GetModuleHandleW(nullptr);
+    wc.lpszClassName = L"TriggerDialogWnd";
+    wc.hCursor = LoadCursor(nullptr, IDC_ARROW);
+    wc.hbrBackground = reinterpret_cast<HBRUSH>(GetStockObject(WHITE_BRUSH));
+    RegisterClassW(&wc);
+
+    hwnd_ = CreateWindowExW(
+        WS_EX_DLGMODALFRAME,
+        wc.lpszClassName,
+        L"Triggers",
+        WS_OVERLAPPED | WS_CAPTION | WS_SYSMENU | WS_THICKFRAME | WS_VISIBLE,
+        CW_USEDEFAULT, CW_USEDEFAULT, 720, 520,
+        parent,
+        nullptr,
+        wc.hInstance,
+        this
+    );
+    if (!hwnd_) {
+        return;
+    }
+
+    ShowWindow(hwnd_, SW_SHOW);
+
+    MSG msg;
+    while (IsWindow(hwnd_) && GetMessageW(&msg, nullptr, 0, 0)) {
+        if (IsDialogMessageW(hwnd_, &msg)) {
+            continue;
+        }
+        TranslateMessage(&msg);
+        DispatchMessageW(&msg);
+    }
+}
+
+bool TriggerDialog::apply(std::wstring* error) {
+    int len = GetWindowTextLengthW(edit_);
+    std::wstring text(static_cast<size_t>(len) + 1, L'\0');
+    GetWindowTextW(edit_, &text[0], len + 1);
+    text.resize(static_cast<size_t>(len));
+
+    model_->clear_triggers();
+    std::istringstream lines(to_utf8(text));
+    std::string line;
+    int line_no = 0;
+    while (std::getline(lines, line)) {
+        line_no++;
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') {
+            continue;
+        }
+        std::string err;
+        if (!model_->add_trigger(line.substr(first), &err)) {
+            *error = L"Line " + std::to_wstring(line_no) + L": " + to_wstring(err);
+            return false;
+        }
+    }
+    return true;
+}
+
+void TriggerDialog::refresh_captures() {
+    if (model_->get_capture_seq() == listed_seq_) {
+        return;
+    }
+    listed_seq_ = model_->get_capture_seq();
+    SendMessageW(list_, LB_RESETCONTENT, 0, 0);
+    TriggerCapture copy;
+    for (size_t i = 0; model_->get_capture(i, &copy); ++i) {
+        const TriggerCapture* capture = &copy;
+        wchar_t line[256] = {};
+        _snwprintf_s(line, 256, _TRUNCATE, L"#%llu  t=%.3f s  %s  (%zu channels, %zu samples)",
+                     static_cast<unsigned long long>(capture->seq), capture->t, to_wstring(capture->trigger).c_str(),
+                     capture->keys.size(), capture->sample_count());
+        LRESULT row = SendMessageW(list_, LB_ADDSTRING, 0, reinterpret_cast<LPARAM>(line));
+        SendMessageW(list_, LB_SETITEMDATA, static_cast<WPARAM>(row), static_cast<LPARAM>(capture->seq));
+    }
+}
+
+void TriggerDialog::show_selected() {
+    LRESULT row = SendMessageW(list_, LB_GETCURSEL, 0, 0);
+    if (row == LB_ERR || !on_show_) {
+        return;
+    }
+    // Rows keep the capture's sequence number; older captures may have
+    // been discarded since the list was filled.
+    uint64_t seq = static_cast<uint64_t>(SendMessageW(list_, LB_GETITEMDATA, static_cast<WPARAM>(row), 0));
+    TriggerCapture capture;
+    for (size_t i = 0; model_->get_capture(i, &capture); ++i) {
+        if (capture.seq == seq) {
+            on_show_(capture);
+            return;
+        }
+    }
+}
+
+LRESULT CALLBACK TriggerDialog::WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+    TriggerDialog* self = reinterpret_cast<TriggerDialog*>(GetWindowLongPtrW(hwnd, GWLP_USERDATA));
+    if (msg == WM_NCCREATE) {
+        CREATESTRUCTW* cs = reinterpret_cast<CREATESTRUCTW*>(lParam);
+        self = reinterpret_cast<TriggerDialog*>(cs->lpCreateParams);
+        SetWindowLongPtrW(hwnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(self));
+    }
+    if (self) {
+        return self->handle_message(hwnd, msg, wParam, lParam);
+    }
+    return DefWindowProcW(hwnd, msg, wParam, lParam);
+}
+
+LRESULT TriggerDialog::handle_message(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+    switch (msg) {
+    case WM_CREATE: {
+        hint_ = CreateWindowW(L"STATIC", kHintText, WS_CHILD | WS_VISIBLE,
+                              10, 10, 680, 56, hwnd, nullptr, nullptr, nullptr);
+        edit_ = CreateWindowExW(WS_EX_CLIENTEDGE, L"EDIT", L"", WS_CHILD | WS_VISIBLE | WS_TABSTOP | ES_MULTILINE |
+                                ES_WANTRETURN | WS_VSCROLL | ES_AUTOVSCROLL, 10, 76, 680, 140, hwnd, nullptr, nullptr, nullptr);
+        list_ = CreateWindowExW(WS_EX_CLIENTEDGE, L"LISTBOX", L"", WS_CHILD | WS_VISIBLE | WS_TABSTOP | WS_VSCROLL |
+                                LBS_NOTIFY | LBS_NOINTEGRALHEIGHT, 10, 262, 680, 170, hwnd, nullptr, nullptr, nullptr);
+        font_ = CreateFontW(16, 0, 0, 0, FW_NORMAL, FALSE, FALSE, FALSE, DEFAULT_CHARSET,
+                            OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS, CLEARTYPE_QUALITY, FIXED_PITCH, L"Consolas");
+        if (font_) {
+            SendMessageW(edit_, WM_SETFONT, reinterpret_cast<WPARAM>(font_), TRUE);
+            SendMessageW(list_, WM_SETFONT, reinterpret_cast<WPARAM>(font_), TRUE);
+        }
+        std::wstring text;
+        for (const auto& def : model_->get_triggers()) {
+            text += to_wstring(def) + L"\r\n";
+        }
+        SetWindowTextW(edit_, text.c_str());
+
+        btn_apply_ = CreateWindowW(L"BUTTON", L"Apply", WS_CHILD | WS_VISIBLE | WS_TABSTOP | BS_PUSHBUTTON,
+                                   610, 226, 80, 26, hwnd, reinterpret_cast<HMENU>(1), nullptr, nullptr);
+        btn_show_ = CreateWindowW(L"BUTTON", L"Show", WS_CHILD | WS_VISIBLE | WS_TABSTOP | BS_PUSHBUTTON,
+                                  430, 444, 80, 26, hwnd, reinterpret_cast<HMENU>(2), nullptr, nullptr);
+        btn_clear_ = CreateWindowW(L"BUTTON", L"Clear", WS_CHILD | WS_VISIBLE | WS_TABSTOP | BS_PUSHBUTTON,
+                                   520, 444, 80, 26, hwnd, reinterpret_cast<HMENU>(3), nullptr, nullptr);
+        btn_close_ = CreateWindowW(L"BUTTON", L"Close", WS_CHILD | WS_VISIBLE | WS_TABSTOP | BS_PUSHBUTTON,
+                                   610, 444, 80, 26, hwnd, reinterpret_cast<HMENU>(4), nullptr, nullptr);
+        refresh_captures();
+        SetTimer(hwnd, kRefreshTimer, 500, nullptr);
+        return 0;
+    }
+    case WM_SIZE: {
+        int w = LOWORD(lParam);
+        int h = HIWORD(lParam);
+        if (edit_ && list_ && btn_close_) {
+            int margin = 10;
+            int hint_h = 56;
+            int btn_h = 26;
+            int btn_w = 80;
+            int edit_h = std::max(60, (h - hint_h - 2 * btn_h - 6 * margin) / 2);
+            int edit_y = 2 * margin + hint_h;
+            int apply_y = edit_y + edit_h + margin;
+            int list_y = apply_y + btn_h + margin;
+            int bottom_y = h - btn_h - margin;
+            MoveWindow(hint_, margin, margin, w - 2 * margin, hint_h, TRUE);
+            MoveWindow(edit_, margin, edit_y, w - 2 * margin, edit_h, TRUE);
+            MoveWindow(btn_apply_, w - btn_w - margin, apply_y, btn_w, btn_h, TRUE);
+            MoveWindow(list_, margin, list_y, w - 2 * margin, bottom_y - margin - list_y, TRUE);
+            MoveWindow(btn_show_, w - 3 * btn_w - 3 * margin, bottom_y, btn_w, btn_h, TRUE);
+            MoveWindow(btn_clear_, w - 2 * btn_w - 2 * margin, bottom_y, btn_w, btn_h, TRUE);
+            MoveWindow(btn_close_, w - btn_w - margin, bottom_y, btn_w, btn_h, TRUE);
+        }
+        return 0;
+    }
+    case WM_TIMER:
+        if (wParam == kRefreshTimer) {
+            refresh_captures();
+            return 0;
+        }
+        break;
+    case WM_COMMAND: {
+        HWND from = reinterpret_cast<HWND>(lParam);
+        if (from == btn_apply_) {
+            std::wstring error;
+            if (!apply(&error)) {
+                MessageBoxW(hwnd, error.c_str(), L"Triggers", MB_OK | MB_ICONWARNING);
+            }
+            return 0;
+        }
+        if (from == btn_show_ || (from == list_ && HIWORD(wParam) == LBN_DBLCLK)) {
+            show_selected();
+            return 0;
+        }
+        if (from == btn_clear_) {
+            model_->clear_captures();
+            listed_seq_ = 0;
+            SendMessageW(list_, LB_RESETCONTENT, 0, 0);
+            return 0;
+        }
+        if (from == btn_close_) {
+            DestroyWindow(hwnd);
+            return 0;
+        }
+        break;
+    }
+    case WM_CLOSE:
+        DestroyWindow(hwnd);
+        return 0;
+    case WM_DESTROY:
+        KillTimer(hwnd, kRefreshTimer);
+        if (font_) {
+            DeleteObject(font_);
+            font_ = nullptr;
+        }
+        hwnd_ = nullptr;
+        hint_ = nullptr;
+        edit_ = nullptr;
+        list_ = nullptr;
+        btn_apply_ = nullptr;
+        btn_show_ = nullptr;
+        btn_clear_ = nullptr;
+        btn_close_ = nullptr;
+        break;
+    }
+    return DefWindowProcW(hwnd, msg, wParam, lParam);
+}
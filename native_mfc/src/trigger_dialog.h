@@ -0,0 +1,40 @@
+#pragma once
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+class ChannelModel;
+struct TriggerCapture;
+
+// Edits the model's triggers (one definition per line) and lists the
+// captures they produced; Show hands the selected capture to on_show.
+class TriggerDialog {
+public:
+    void show(HWND parent, ChannelModel* model, std::function<void(const TriggerCapture&)> on_show);
+
+private:
+    static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
+    LRESULT handle_message(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
+    bool apply(std::wstring* error);
+    void refresh_captures();
+    void show_selected();
+
+    ChannelModel* model_ = nullptr;
+    std::function<void(const TriggerCapture&)> on_show_;
+    uint64_t listed_seq_ = 0;
+    HWND hwnd_ = nullptr;
+    HWND hint_ = nullptr;
+    HWND edit_ = nullptr;
+    HWND list_ = nullptr;
+    HWND btn_apply_ = nullptr;
+    HWND btn_show_ = nullptr;
+    HWND btn_clear_ = nullptr;
+    HWND btn_close_ = nullptr;
+    HFONT font_ = nullptr;
+};
@@ -0,0 +1,231 @@
+#include "value_sketch.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+// floor(x / 2^s) for negative x too.
+int64_t floor_shift(int64_t x, int s) {
+    return x >= 0 ? (x >> s) : -((-x - 1) >> s) - 1;
+}
+
+int64_t bin_start(int64_t idx, int shift) {
+    return idx * (int64_t(1) << shift);
+}
+} // namespace
+
+void ValueHistogram::add(int v, uint64_t n) {
+    add_bin(v, 0, n);
+}
+
+void ValueHistogram::add_bin(int64_t idx, int shift, uint64_t n) {
+    while (shift_ < shift) {
+        coarsen();
+    }
+    idx = floor_shift(idx, shift_ - shift);
+    if (counts_.empty()) {
+        base_ = idx;
+        counts_.assign(1, 0);
+    }
+    for (;;) {
+        int64_t lo = std::min(base_, idx);
+        int64_t hi = std::max(base_ + static_cast<int64_t>(counts_.size()) - 1, idx);
+        if (hi - lo + 1 <= static_cast<int64_t>(kMaxBins)) {
+            break;
+        }
+        coarsen();
+        idx = floor_shift(idx, 1);
+    }
+    if (idx < base_) {
+        counts_.insert(counts_.begin(), static_cast<size_t>(base_ - idx), 0);
+        base_ = idx;
+    } else if (idx >= base_ + static_cast<int64_t>(counts_.size())) {
+        counts_.resize(static_cast<size_t>(idx - base_ + 1), 0);
+    }
+    counts_[static_cast<size_t>(idx - base_)] += n;
+    count_ += n;
+}
+
+void ValueHistogram::coarsen() {
+    if (!counts_.empty()) {
+        int64_t first = floor_shift(base_, 1);
+        int64_t last = floor_shift(base_ + static_cast<int64_t>(counts_.size()) - 1, 1);
+        std::vector<uint64_t> merged(static_cast<size_t>(last - first + 1), 0);
+        for (size_t i = 0; i < counts_.size(); ++i) {
+            merged[static_cast<size_t>(floor_shift(base_ + static_cast<int64_t>(i), 1) - first)] += counts_[i];
+        }
+        counts_.swap(merged);
+        base_ = first;
+    }
+    shift_++;
+}
+
+void ValueHistogram::remove(int v) {
+    int64_t idx = floor_shift(v, shift_);
+    if (idx < base_ || idx >= base_ + static_cast<int64_t>(counts_.size()) ||
+        counts_[static_cast<size_t>(idx - base_)] == 0) {
+        return;
+    }
+    counts_[static_cast<size_t>(idx - base_)]--;
+    count_--;
+    if (count_ == 0) {
+        clear();
+        return;
+    }
+    // Trim empty edge bins so they do not force coarsening later.
+    while (counts_.back() == 0) {
+        counts_.pop_back();
+    }
+    size_t lead = 0;
+    while (counts_[lead] == 0) {
+        lead++;
+    }
+    if (lead > 0) {
+        counts_.erase(counts_.begin(), counts_.begin() + static_cast<std::ptrdiff_t>(lead));
+        base_ += static_cast<int64_t>(lead);
+    }
+}
+
+void ValueHistogram::merge(const ValueHistogram& other) {
+    for (size_t i = 0; i < other.counts_.size(); ++i) {
+        if (other.counts_[i]) {
+            add_bin(other.base_ + static_cast<int64_t>(i), other.shift_, other.counts_[i]);
+        }
+    }
+}
+
+void ValueHistogram::clear() {
+    shift_ = 0;
+    base_ = 0;
+    counts_.clear();
+    count_ = 0;
+}
+
+int ValueHistogram::lowest() const {
+    for (size_t i = 0; i < counts_.size(); ++i) {
+        if (counts_[i]) {
+            return static_cast<int>(bin_start(base_ + static_cast<int64_t>(i), shift_));
+        }
+    }
+    return 0;
+}
+
+int ValueHistogram::highest() const {
+    for (size_t i = counts_.size(); i-- > 0;) {
+        if (counts_[i]) {
+            return static_cast<int>(bin_start(base_ + static_cast<int64_t>(i) + 1, shift_) - 1);
+        }
+    }
+    return 0;
+}
+
+double ValueHistogram::quantile(double q) const {
+    if (count_ == 0) {
+        return 0.0;
+    }
+    double target = std::min(std::max(q, 0.0), 1.0) * static_cast<double>(count_ - 1);
+    double width = static_cast<double>(int64_t(1) << shift_);
+    uint64_t below = 0;
+    for (size_t i = 0; i < counts_.size(); ++i) {
+        uint64_t c = counts_[i];
+        if (c == 0 || static_cast<double>(below + c) <= target) {
+            below += c;
+            continue;
+        }
+        double start = static_cast<double>(bin_start(base_ + static_cast<int64_t>(i), shift_));
+        if (shift_ == 0) {
+            return start;
+        }
+        // Spread the bin's samples evenly over the values it covers.
+        double frac = (target - static_cast<double>(below) + 0.5) / static_cast<double>(c);
+        return start + std::min(frac, 1.0) * (width - 1.0);
+    }
+    return highest();
+}
+
+void ValueHistogram::fill_linear(double lo, double hi, int bins, std::vector<uint64_t>* out) const {
+    out->assign(static_cast<size_t>(std::max(bins, 0)), 0);
+    if (bins <= 0) {
+        return;
+    }
+    double span = hi > lo ? hi - lo : 1.0;
+    double half = static_cast<double>((int64_t(1) << shift_) - 1) * 0.5;
+    for (size_t i = 0; i < counts_.size(); ++i) {
+        if (!counts_[i]) {
+            continue;
+        }
+        double centre = static_cast<double>(bin_start(base_ + static_cast<int64_t>(i), shift_)) + half;
+        int k = static_cast<int>(std::floor((centre - lo) / span * bins));
+        (*out)[static_cast<size_t>(std::min(std::max(k, 0), bins - 1))] += counts_[i];
+    }
+}
+
+void ValueHistogram::fill_log(double lo, double hi, int bins, std::vector<uint64_t>* out) const {
+    out->assign(static_cast<size_t>(std::max(bins, 0)), 0);
+    if (bins <= 0) {
+        return;
+    }
+    lo = std::max(lo, 1.0);
+    double decades = std::log(hi > lo ? hi / lo : 2.0);
+    double half = static_cast<double>((int64_t(1) << shift_) - 1) * 0.5;
+    for (size_t i = 0; i < counts_.size(); ++i) {
+        if (!counts_[i]) {
+            continue;
+        }
+        double centre = static_cast<double>(bin_start(base_ + static_cast<int64_t>(i), shift_)) + half;
+        int k = centre < lo ? 0 : static_cast<int>(std::floor(std::log(centre / lo) / decades * bins));
+        (*out)[static_cast<size_t>(std::min(std::max(k, 0), bins - 1))] += counts_[i];
+    }
+}
+
+void WindowSketch::add(int v) {
+    if (blocks_.empty() || blocks_.back().count == kBlockSamples) {
+        blocks_.emplace_back();
+    }
+    blocks_.back().hist.add(v);
+    blocks_.back().count++;
+}
+
+void WindowSketch::replace_last(int old_v, int v) {
+    if (blocks_.empty()) {
+        return;
+    }
+    blocks_.back().hist.remove(old_v);
+    blocks_.back().hist.add(v);
+}
+
+void WindowSketch::evict(size_t n) {
+    while (n > 0 && !blocks_.empty()) {
+        uint32_t left = blocks_.front().count - front_evicted_;
+        uint32_t take = static_cast<uint32_t>(std::min<size_t>(n, left));
+        front_evicted_ += take;
+        n -= take;
+        if (front_evicted_ == blocks_.front().count) {
+            blocks_.pop_front();
+            front_evicted_ = 0;
+        }
+    }
+}
+
+void WindowSketch::clear() {
+    blocks_.clear();
+    front_evicted_ = 0;
+}
+
+void WindowSketch::merged(const SeriesView& ring, ValueHistogram* out) const {
+    out->clear();
+    if (blocks_.empty()) {
+        return;
+    }
+    size_t first = 0;
+    if (front_evicted_ > 0) {
+        size_t left = std::min<size_t>(blocks_.front().count - front_evicted_, ring.size());
+        for (size_t i = 0; i < left; ++i) {
+            out->add(ring.value_at(i));
+        }
+        first = 1;
+    }
+    for (size_t i = first; i < blocks_.size(); ++i) {
+        out->merge(blocks_[i].hist);
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "sample_ring.h"
+
+// Mergeable histogram of integer values. Bins are 2^shift values wide and
+// at most kMaxBins span the values seen: while the values fit, every bin is
+// one value wide and quantiles are exact; a wider spread doubles the bin
+// width (merging neighbours) as often as needed. Memory stays bounded by
+// kMaxBins however many values are added.
+class ValueHistogram {
+public:
+    static constexpr size_t kMaxBins = 256;
+
+    void add(int v, uint64_t n = 1);
+    // Takes back one earlier add(v).
+    void remove(int v);
+    void merge(const ValueHistogram& other);
+    void clear();
+
+    bool empty() const { return count_ == 0; }
+    uint64_t count() const { return count_; }
+    int bin_width() const { return 1 << shift_; }
+    // Lowest and highest value covered by non-empty bins.
+    int lowest() const;
+    int highest() const;
+
+    // Value at fraction q (0..1) of the samples: exact with one-value bins,
+    // otherwise interpolated within the bin.
+    double quantile(double q) const;
+
+    // Counts over `bins` equal-width bins spanning [lo, hi]; each source bin
+    // lands in the output bin holding its centre.
+    void fill_linear(double lo, double hi, int bins, std::vector<uint64_t>* out) const;
+    // Same over geometrically spaced bins from max(lo, 1) to hi, for values
+    // spread over several decades.
+    void fill_log(double lo, double hi, int bins, std::vector<uint64_t>* out) const;
+
+private:
+    // Adds n to bin idx, given at the resolution of `shift`.
+    void add_bin(int64_t idx, int shift, uint64_t n);
+    void coarsen();
+
+    int shift_ = 0;
+    int64_t base_ = 0;  // bin index of counts_[0]
+    std::vector<uint64_t> counts_;
+    uint64_t count_ = 0;
+};
+
+// Value distribution of a channel's hot window, kept as one histogram per
+// block of kBlockSamples consecutive samples. Ingest updates the newest
+// block; eviction drops blocks once all their samples are gone. A query
+// merges the whole blocks and scans the ring for the remaining samples of
+// the partly evicted oldest block, so the result is exact for the window.
+class WindowSketch {
+public:
+    static constexpr uint32_t kBlockSamples = 1024;
+
+    void add(int v);
+    void replace_last(int old_v, int v);
+    // The n oldest samples left the window.
+    void evict(size_t n);
+    void clear();
+
+    // Distribution of ring, which must hold exactly the samples not evicted.
+    void merged(const SeriesView& ring, ValueHistogram* out) const;
+
+private:
+    struct Block {
+        ValueHistogram hist;
+        uint32_t count = 0;
+    };
+
+    std::deque<Block> blocks_;
+    uint32_t front_evicted_ = 0;
+};
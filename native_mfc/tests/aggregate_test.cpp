@@ -0,0 +1,129 @@
+// Range aggregates and buckets over the spill, history and hot tiers
+// against folding the samples read_history returns for the same range.
+
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "channel_model.h"
+#include "test_util.h"
+#include "tests.h"
+
+namespace {
+const char* const kKeys[] = {"ramp", "state"};
+
+// Lines 1 ms apart with pauses; the state channel goes run-length.
+double feed(ChannelModel* model, int lines) {
+    std::mt19937 rng(13);
+    int64_t us = 0;
+    int state = 0;
+    for (int line = 0; line < lines; ++line) {
+        uint32_t r = rng();
+        us += 1000 + ((r >> 12) % 5000 == 0 ? 2000000 : 0);
+        double t = static_cast<double>(us) * 1e-6;
+        if ((r >> 16) % 300 == 0) {
+            state = static_cast<int>((r >> 20) % 6);
+        }
+        std::unordered_map<std::string, int> kv;
+        kv["state"] = state;
+        if (r % 8 != 0) {
+            kv["ramp"] = static_cast<int>((line * 7 + (r >> 8) % 900) % 100000);
+        }
+        model->update_from_kv(kv, t);
+        if (line % 50 == 0) {
+            model->prune(t);
+        }
+    }
+    return static_cast<double>(us) * 1e-6;
+}
+
+// History keeps microsecond ticks, so first and last times may differ by
+// that much between a block's summary and its decoded samples.
+bool same_aggregate(const RangeAggregate& got, const RangeAggregate& want) {
+    if (got.count != want.count) {
+        return false;
+    }
+    return got.count == 0 ||
+        (got.min == want.min && got.max == want.max && got.sum == want.sum && got.first.v == want.first.v &&
+         got.last.v == want.last.v && std::abs(got.first.t - want.first.t) <= 1e-6 &&
+         std::abs(got.last.t - want.last.t) <= 1e-6 && got.mean() == want.mean());
+}
+
+std::vector<RangeAggregate> brute_force(const ChannelModel& model, const std::string& key, double t_start,
+                                        double t_end, double width) {
+    std::vector<ChannelSample> samples;
+    model.read_history(key, t_start, t_end, &samples);
+    size_t n = 1;
+    if (width > 0.0) {
+        n = static_cast<size_t>(std::ceil((t_end - t_start) / width));
+    }
+    std::vector<RangeAggregate> out(std::max<size_t>(n, 1));
+    for (const ChannelSample& s : samples) {
+        double k = width > 0.0 ? (s.t - t_start) / width : 0.0;
+        size_t b = k < static_cast<double>(out.size() - 1) ? static_cast<size_t>(k) : out.size() - 1;
+        out[b].add(s.t, s.v);
+    }
+    return out;
+}
+
+void test_aggregates() {
+    std::mt19937 rng(14);
+    std::error_code ec;
+    std::string dir = (std::filesystem::temp_directory_path(ec) / "scc_tests").string();
+    ChannelModel model;
+    std::string error;
+    CHECK(model.enable_spill(dir, &error));
+    model.set_time_window(1.0);
+    model.set_history_budget(64 << 10);
+    double t_max = feed(&model, 200000);
+    model.flush_spill();
+    CHECK(model.get_spilled_samples() > 0);
+
+    // Bounds 0.4 ms off the sample grid, so microsecond rounding never
+    // moves a sample across an edge.
+    std::uniform_int_distribution<int64_t> ms(0, static_cast<int64_t>(t_max * 1000.0));
+    const double widths[] = {0.0, 0.037, 0.25, 1.0, 7.0};
+    for (const char* key : kKeys) {
+        for (int q = 0; q < 200; ++q) {
+            double a = static_cast<double>(ms(rng)) * 1e-3 + 0.0004;
+            double b = static_cast<double>(ms(rng)) * 1e-3 + 0.0004;
+            if (a > b) {
+                std::swap(a, b);
+            }
+            std::vector<RangeAggregate> want = brute_force(model, key, a, b, 0.0);
+            RangeAggregate agg;
+            CHECK(model.get_aggregate(key, a, b, &agg) && same_aggregate(agg, want[0]));
+
+            double width = widths[q % 5];
+            if (width > 0.0 && (b - a) / width > 100000.0) {
+                continue;
+            }
+            want = brute_force(model, key, a, b, width);
+            std::vector<RangeAggregate> got;
+            if (!CHECK(model.get_aggregate_buckets(key, a, b, width, &got) && got.size() == want.size())) {
+                continue;
+            }
+            for (size_t i = 0; i < got.size(); ++i) {
+                if (!CHECK(same_aggregate(got[i], want[i]))) {
+                    break;
+                }
+            }
+        }
+    }
+
+    RangeAggregate agg;
+    std::vector<RangeAggregate> got;
+    CHECK(!model.get_aggregate("ramp", 2.0, 1.0, &agg));
+    CHECK(!model.get_aggregate("none", 0.0, 1.0, &agg));
+    CHECK(!model.get_aggregate_buckets("ramp", 0.0, 1.0, 1e-9, &got));
+    CHECK(model.get_aggregate("ramp", t_max + 1.0, t_max + 2.0, &agg) && agg.count == 0);
+}
+} // namespace
+
+void run_aggregate_tests() {
+    test_aggregates();
+}
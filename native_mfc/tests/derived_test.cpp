@@ -0,0 +1,42 @@
+// Derived channels and the received keys that share their names.
+
+#include <string>
+
+#include "channel_model.h"
+#include "test_util.h"
+#include "tests.h"
+
+namespace {
+int last_value(const ChannelModel& model, const std::string& key) {
+    ChannelSample s;
+    return model.get_last_sample(key, &s) ? s.v : -1;
+}
+
+void test_names() {
+    ChannelModel model;
+    std::string error;
+    CHECK(model.add_derived_channel("x", "a * 2", &error));
+    model.update_from_kv({{"a", 6}}, 1.0);
+    CHECK(last_value(model, "x") == 12);
+    // A received x is dropped while x is derived.
+    model.update_from_kv({{"a", 6}, {"x", 99}}, 2.0);
+    CHECK(last_value(model, "x") == 12);
+
+    // Redefined after a clear, x continues as derived.
+    model.clear_derived_channels();
+    CHECK(model.add_derived_channel("x", "a * 3", &error));
+    model.update_from_kv({{"a", 7}, {"x", 99}}, 3.0);
+    CHECK(last_value(model, "x") == 21);
+
+    // Left undefined, x takes the received key, which then keeps the name.
+    model.clear_derived_channels();
+    model.update_from_kv({{"a", 7}, {"x", 99}}, 4.0);
+    CHECK(last_value(model, "x") == 99);
+    CHECK(!model.add_derived_channel("x", "a", &error));
+    CHECK(!model.add_derived_channel("a", "x", &error));
+}
+} // namespace
+
+void run_derived_tests() {
+    test_names();
+}
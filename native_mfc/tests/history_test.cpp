@@ -0,0 +1,168 @@
+// read_history over spilled and compressed history and the hot ring against
+// every sample fed in, with a short window so most samples leave the ring.
+
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "channel_model.h"
+#include "test_util.h"
+#include "tests.h"
+
+namespace {
+using Samples = std::vector<ChannelSample>;
+
+// History keeps microsecond ticks.
+constexpr double kTimeTol = 1e-6;
+
+const char* const kKeys[] = {"ramp", "state", "wide"};
+constexpr size_t kKeyCount = 3;
+
+// Lines 1 ms apart (so nothing merges) with pauses. A step-like state on
+// every line, so its runs are evenly paced and their times exact; a noisy
+// ramp and values across the whole int range on most lines.
+void feed(ChannelModel* model, int lines, uint32_t seed, Samples* ref) {
+    std::mt19937 rng(seed);
+    int64_t us = 0;
+    int state = 0;
+    for (int line = 0; line < lines; ++line) {
+        uint32_t r = rng();
+        us += 1000 + ((r >> 12) % 5000 == 0 ? 2000000 : 0);
+        double t = static_cast<double>(us) * 1e-6;
+        if ((r >> 16) % 300 == 0) {
+            state = static_cast<int>((r >> 20) % 6);
+        }
+        uint32_t w = rng();
+        int values[kKeyCount] = {
+            static_cast<int>((line * 7 + (w % 9)) % 4096),
+            state,
+            (w >> 4) % 16 == 0 ? 0 : static_cast<int>(w >> 1),
+        };
+        std::unordered_map<std::string, int> kv;
+        for (size_t k = 0; k < kKeyCount; ++k) {
+            if (k == 1 || (w >> (24 + k)) % 8 != 0) {
+                kv[kKeys[k]] = values[k];
+                ref[k].push_back(ChannelSample{t, values[k]});
+            }
+        }
+        model->update_from_kv(kv, t);
+        if (line % 50 == 0) {
+            model->prune(t);
+        }
+    }
+}
+
+bool same_samples(const Samples& got, const Samples& want, size_t offset) {
+    if (got.size() + offset != want.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < got.size(); ++i) {
+        if (std::abs(got[i].t - want[offset + i].t) > kTimeTol || got[i].v != want[offset + i].v) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The stored samples are ref's newest; ranges between samples return
+// exactly the samples inside them.
+void check_history(const ChannelModel& model, const std::string& key, const Samples& ref, std::mt19937& rng) {
+    Samples all;
+    model.read_history(key, -1e9, 1e9, &all);
+    size_t offset = ref.size() - all.size();
+    if (!CHECK(!all.empty() && same_samples(all, ref, offset))) {
+        return;
+    }
+    double first = 0.0;
+    double last = 0.0;
+    CHECK(model.get_stored_span(key, &first, &last) && std::abs(first - all.front().t) <= kTimeTol &&
+          last == all.back().t);
+
+    std::uniform_int_distribution<size_t> index(offset, ref.size() - 1);
+    for (int q = 0; q < 100; ++q) {
+        size_t a = index(rng);
+        size_t b = q % 10 == 0 ? a : index(rng);
+        if (a > b) {
+            std::swap(a, b);
+        }
+        Samples part;
+        model.read_history(key, ref[a].t - 0.0004, ref[b].t + 0.0004, &part);
+        Samples want(ref.begin() + static_cast<std::ptrdiff_t>(a), ref.begin() + static_cast<std::ptrdiff_t>(b) + 1);
+        CHECK(same_samples(part, want, 0));
+    }
+}
+
+void test_round_trip() {
+    std::mt19937 rng(7);
+    ChannelModel model;
+    model.set_time_window(1.0);
+    Samples ref[kKeyCount];
+    feed(&model, 200000, 8, ref);
+    CHECK(model.get_history_samples() > 0);
+    for (size_t k = 0; k < kKeyCount; ++k) {
+        check_history(model, kKeys[k], ref[k], rng);
+        // Nothing was dropped.
+        Samples all;
+        model.read_history(kKeys[k], -1e9, 1e9, &all);
+        CHECK(all.size() == ref[k].size());
+    }
+    CHECK(model.consume_dropped_history() == 0);
+}
+
+// Past the budget the oldest blocks go, and are counted.
+void test_budget() {
+    std::mt19937 rng(9);
+    ChannelModel model;
+    model.set_time_window(1.0);
+    model.set_history_budget(64 << 10);
+    Samples ref[kKeyCount];
+    feed(&model, 200000, 10, ref);
+    uint64_t kept = 0;
+    uint64_t fed = 0;
+    for (size_t k = 0; k < kKeyCount; ++k) {
+        check_history(model, kKeys[k], ref[k], rng);
+        Samples all;
+        model.read_history(kKeys[k], -1e9, 1e9, &all);
+        kept += all.size();
+        fed += ref[k].size();
+    }
+    CHECK(model.get_history_bytes() <= (64 << 10));
+    CHECK(kept < fed && kept + static_cast<uint64_t>(model.consume_dropped_history()) == fed);
+}
+
+// With spilling, blocks over the budget move to disk and reads still
+// return every sample.
+void test_spill() {
+    std::mt19937 rng(11);
+    std::error_code ec;
+    std::string dir = (std::filesystem::temp_directory_path(ec) / "scc_tests").string();
+    ChannelModel model;
+    std::string error;
+    if (!CHECK(model.enable_spill(dir, &error))) {
+        return;
+    }
+    model.set_time_window(1.0);
+    model.set_history_budget(64 << 10);
+    Samples ref[kKeyCount];
+    feed(&model, 200000, 12, ref);
+    model.flush_spill();
+    CHECK(model.get_spilled_samples() > 0 && model.get_spilled_bytes() > 0);
+    for (size_t k = 0; k < kKeyCount; ++k) {
+        check_history(model, kKeys[k], ref[k], rng);
+        Samples all;
+        model.read_history(kKeys[k], -1e9, 1e9, &all);
+        CHECK(all.size() == ref[k].size());
+    }
+    CHECK(model.consume_dropped_history() == 0);
+}
+} // namespace
+
+void run_history_tests() {
+    test_round_trip();
+    test_budget();
+    test_spill();
+}
@@ -0,0 +1,280 @@
+// SampleRing in each layout (plain, run-length, shared rows) and across
+// conversions, against a vector of the samples it should hold.
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "sample_ring.h"
+#include "test_util.h"
+#include "tests.h"
+
+namespace {
+using Samples = std::vector<ChannelSample>;
+
+// Run-length times are interpolated; everything else must be exact.
+bool same_time(double a, double b, double tol) {
+    return tol == 0.0 ? a == b : std::abs(a - b) <= tol;
+}
+
+void check_ring(const SampleRing& ring, const Samples& ref, double tol, std::mt19937& rng) {
+    if (!CHECK(ring.size() == ref.size())) {
+        return;
+    }
+    std::vector<double> times(ref.size());
+    for (size_t i = 0; i < ref.size(); ++i) {
+        ChannelSample s = ring.at(i);
+        times[i] = s.t;
+        if (!CHECK(same_time(s.t, ref[i].t, tol) && s.v == ref[i].v && ring.value_at(i) == s.v &&
+                   ring.time_at(i) == s.t)) {
+            return;
+        }
+    }
+    if (ref.empty()) {
+        return;
+    }
+
+    // Segments cover the plain layout in order.
+    if (!ring.run_length() && !ring.shared_times()) {
+        for (size_t i = 0; i < ring.size();) {
+            SampleRing::Segment seg = ring.segment(i, ring.size());
+            if (!CHECK(seg.count > 0)) {
+                return;
+            }
+            for (size_t j = 0; j < seg.count; ++j) {
+                CHECK(seg.t[j] == times[i + j] && seg.v[j] == ref[i + j].v);
+            }
+            i += seg.count;
+        }
+    }
+
+    std::uniform_int_distribution<size_t> index(0, ref.size() - 1);
+    for (int q = 0; q < 50; ++q) {
+        size_t a = index(rng);
+        size_t b = index(rng);
+        if (a > b) {
+            std::swap(a, b);
+        }
+        b++;
+        double t = times[index(rng)] + (q % 3 == 0 ? 1e-4 : 0.0);
+        size_t lo = static_cast<size_t>(std::lower_bound(times.begin() + a, times.begin() + b, t) - times.begin());
+        size_t hi = static_cast<size_t>(std::upper_bound(times.begin() + a, times.begin() + b, t) - times.begin());
+        CHECK(ring.lower_bound(a, b, t) == lo);
+        CHECK(ring.upper_bound(a, b, t) == hi);
+
+        int vmin = 0;
+        int vmax = 0;
+        auto mm = std::minmax_element(ref.begin() + a, ref.begin() + b,
+                                      [](const ChannelSample& x, const ChannelSample& y) { return x.v < y.v; });
+        CHECK(ring.value_range(a, b, &vmin, &vmax) && vmin == mm.first->v && vmax == mm.second->v);
+    }
+}
+
+// Appends, replaces the newest sample and drops old ones at random.
+void test_plain() {
+    std::mt19937 rng(1);
+    SampleRing ring;
+    Samples ref;
+    double t = 0.0;
+    for (int op = 0; op < 200000; ++op) {
+        uint32_t r = rng();
+        if (r % 100 < 80 || ref.empty()) {
+            t += (r >> 8) % 4 * 0.001;
+            int v = static_cast<int>((r >> 12) % 5000);
+            ring.push_back(t, v, (r >> 20) % 2 ? 4096 : 0);
+            ref.push_back(ChannelSample{t, v});
+        } else if (r % 100 < 90) {
+            int v = static_cast<int>((r >> 12) % 5000);
+            ring.set_back(t, v);
+            ref.back() = ChannelSample{t, v};
+        } else if (ref.size() > 20000) {
+            size_t n = (r >> 8) % 3000;
+            ring.pop_front(n);
+            ref.erase(ref.begin(), ref.begin() + static_cast<std::ptrdiff_t>(n));
+        }
+        if (op % 5000 == 0) {
+            check_ring(ring, ref, 0.0, rng);
+        }
+    }
+    check_ring(ring, ref, 0.0, rng);
+
+    // A copy is a snapshot the original's ingest does not change.
+    SampleRing snap = ring;
+    Samples snap_ref = ref;
+    for (int i = 0; i < 50000; ++i) {
+        t += 0.001;
+        ring.push_back(t, i % 977);
+        if (i % 7 == 0) {
+            ring.set_back(t, i % 13);
+        }
+        if (i % 1000 == 0) {
+            ring.pop_front(700);
+        }
+    }
+    check_ring(snap, snap_ref, 0.0, rng);
+    ring.clear();
+    CHECK(ring.empty());
+}
+
+// Step-like values at an even pace, with pauses that must start a new run.
+void test_runs() {
+    std::mt19937 rng(2);
+    SampleRing ring;
+    ring.set_run_length(true);
+    Samples ref;
+    double t = 0.0;
+    int v = 0;
+    for (int op = 0; op < 100000; ++op) {
+        uint32_t r = rng();
+        if (r % 100 < 85 || ref.empty()) {
+            t += (r >> 8) % 500 == 0 ? 1000.0 : 0.25;
+            if ((r >> 16) % 20 == 0) {
+                v = static_cast<int>((r >> 20) % 8);
+            }
+            ring.push_back(t, v);
+            ref.push_back(ChannelSample{t, v});
+        } else if (r % 100 < 92) {
+            int w = (r >> 8) % 2 ? v : static_cast<int>((r >> 20) % 8);
+            ring.set_back(t, w);
+            ref.back().v = w;
+            v = w;
+        } else if (ref.size() > 20000) {
+            size_t n = (r >> 8) % 3000;
+            ring.pop_front(n);
+            ref.erase(ref.begin(), ref.begin() + static_cast<std::ptrdiff_t>(n));
+        }
+        if (op % 2000 == 0) {
+            check_ring(ring, ref, 1e-6, rng);
+        }
+    }
+    CHECK(ring.run_length() && ring.run_count() < ref.size() / 4);
+    check_ring(ring, ref, 1e-6, rng);
+}
+
+// A channel on most lines of a shared timeline; samples off the newest
+// row, or too far past their chunk's first row, fall back to own times.
+void test_rows() {
+    std::mt19937 rng(3);
+    RowTimeline rows;
+    SampleRing ring;
+    CHECK(ring.set_row_times(&rows));
+    Samples ref;
+    double t = 0.0;
+    for (int line = 0; line < 100000; ++line) {
+        uint32_t r = rng();
+        t += (r >> 8) % 3 * 0.001;
+        rows.push_back(t);
+        t = rows.time(rows.end_row() - 1);
+        if (r % 10 != 0) {
+            int v = static_cast<int>((r >> 12) % 4096);
+            ring.push_back(t, v);
+            ref.push_back(ChannelSample{t, v});
+            if ((r >> 24) % 8 == 0) {
+                ring.set_back(t, v + 1);
+                ref.back().v = v + 1;
+            }
+        }
+        if (line % 4000 == 3999) {
+            size_t n = ref.size() / 3;
+            ring.pop_front(n);
+            ref.erase(ref.begin(), ref.begin() + static_cast<std::ptrdiff_t>(n));
+            rows.drop_before(rows.lower_bound(ref.front().t));
+            check_ring(ring, ref, 0.0, rng);
+        }
+    }
+    CHECK(ring.shared_times());
+    check_ring(ring, ref, 0.0, rng);
+
+    // Not the newest row's time: back to a time column, nothing lost.
+    t += 0.5;
+    rows.push_back(t);
+    ring.push_back(t + 0.1, 7);
+    ref.push_back(ChannelSample{t + 0.1, 7});
+    CHECK(!ring.shared_times());
+    check_ring(ring, ref, 0.0, rng);
+    // Refused while that sample is stored, then taken once it is gone.
+    CHECK(!ring.set_row_times(&rows));
+    CHECK(!ring.shared_times());
+    ring.pop_front(ring.size());
+    ref.clear();
+    CHECK(ring.set_row_times(&rows) && ring.shared_times());
+
+    // A gap of more rows than a chunk may span.
+    for (int line = 0; line < 3 * static_cast<int>(SampleRing::kChunkRows); ++line) {
+        t += 0.001;
+        rows.push_back(t);
+        if (line < 10 || line > 2 * static_cast<int>(SampleRing::kChunkRows) + 10) {
+            ring.push_back(t, line);
+            ref.push_back(ChannelSample{t, line});
+        }
+    }
+    CHECK(!ring.shared_times());
+    check_ring(ring, ref, 0.0, rng);
+}
+
+// Every conversion keeps the samples.
+void test_conversions() {
+    std::mt19937 rng(4);
+    RowTimeline rows;
+    SampleRing ring;
+    Samples ref;
+    for (int i = 0; i < 20000; ++i) {
+        double t = i * 0.125;
+        rows.push_back(t);
+        if (i % 5 != 0) {
+            int v = i / 40 % 6;
+            ring.push_back(t, v);
+            ref.push_back(ChannelSample{t, v});
+        }
+    }
+    check_ring(ring, ref, 0.0, rng);
+    CHECK(ring.set_row_times(&rows) && ring.shared_times());
+    check_ring(ring, ref, 0.0, rng);
+
+    // A copy keeps its own timeline once the original's drops rows.
+    SampleRing snap = ring;
+    snap.own_row_times();
+    CHECK(ring.set_row_times(nullptr) && !ring.shared_times());
+    check_ring(ring, ref, 0.0, rng);
+    rows.drop_before(rows.end_row());
+    check_ring(snap, ref, 0.0, rng);
+    // Runs interpolate between the first and last time, so an uneven pace
+    // (every fifth line missing) is only approximate; the values are exact.
+    ring.set_run_length(true);
+    CHECK(ring.run_length() && ring.size() == ref.size());
+    for (size_t i = 0; i < ref.size(); ++i) {
+        if (!CHECK(ring.value_at(i) == ref[i].v && std::abs(ring.time_at(i) - ref[i].t) <= 0.125)) {
+            break;
+        }
+    }
+    CHECK(!ring.set_row_times(&rows));
+    ring.set_run_length(false);
+    CHECK(!ring.run_length() && ring.size() == ref.size());
+
+    // Rows to runs directly, at an even pace.
+    RowTimeline even;
+    SampleRing shared;
+    CHECK(shared.set_row_times(&even));
+    Samples even_ref;
+    for (int i = 0; i < 10000; ++i) {
+        double t = i * 0.25;
+        even.push_back(t);
+        shared.push_back(t, i / 100);
+        even_ref.push_back(ChannelSample{t, i / 100});
+    }
+    CHECK(shared.shared_times());
+    shared.set_run_length(true);
+    CHECK(shared.run_length() && !shared.shared_times());
+    check_ring(shared, even_ref, 1e-6, rng);
+    shared.set_run_length(false);
+    check_ring(shared, even_ref, 1e-6, rng);
+}
+} // namespace
+
+void run_ring_tests() {
+    test_plain();
+    test_runs();
+    test_rows();
+    test_conversions();
+}
@@ -0,0 +1,95 @@
+// Session and window statistics against the same figures computed over
+// the stored samples, with merged samples and a sliding window.
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "channel_model.h"
+#include "test_util.h"
+#include "tests.h"
+
+namespace {
+bool near(double a, double b) {
+    return std::abs(a - b) <= 1e-6 * std::max(1.0, std::abs(b));
+}
+
+// count, mean, stddev, rms, min and max of samples.
+ChannelStats brute_force(const std::vector<ChannelSample>& samples) {
+    ChannelStats out;
+    out.count = samples.size();
+    if (samples.empty()) {
+        return out;
+    }
+    double sum = 0.0;
+    double sum_sq = 0.0;
+    out.min = samples[0].v;
+    out.max = samples[0].v;
+    for (const ChannelSample& s : samples) {
+        sum += s.v;
+        sum_sq += static_cast<double>(s.v) * s.v;
+        out.min = std::min(out.min, s.v);
+        out.max = std::max(out.max, s.v);
+    }
+    double n = static_cast<double>(samples.size());
+    out.mean = sum / n;
+    double var = 0.0;
+    for (const ChannelSample& s : samples) {
+        var += (s.v - out.mean) * (s.v - out.mean);
+    }
+    out.stddev = std::sqrt(var / n);
+    out.rms = std::sqrt(sum_sq / n);
+    return out;
+}
+
+bool same_stats(const ChannelStats& got, const ChannelStats& want) {
+    return got.count == want.count && near(got.mean, want.mean) && near(got.stddev, want.stddev) &&
+        near(got.rms, want.rms) && got.min == want.min && got.max == want.max;
+}
+
+void test_stats() {
+    std::mt19937 rng(6);
+    ChannelModel model;
+    model.set_time_window(2.0);
+    double t = 0.0;
+    for (int line = 0; line < 30000; ++line) {
+        uint32_t r = rng();
+        // Lines 0.2 ms apart merge; a merged extreme must leave min/max.
+        t += r % 4 == 0 ? 0.0002 : 0.001;
+        int v = (r >> 8) % 50 == 0 ? static_cast<int>((r >> 16) % 100000) : 500 + static_cast<int>((r >> 16) % 64);
+        model.update_from_kv({{"v", v}}, t);
+        if (line % 100 == 0) {
+            model.prune(t);
+        }
+        if (line % 997 != 0) {
+            continue;
+        }
+
+        ChannelStats window;
+        ChannelStats session;
+        if (!CHECK(model.get_channel_stats("v", &window, &session))) {
+            return;
+        }
+        std::vector<ChannelSample> all;
+        model.read_history("v", -1e9, 1e9, &all);
+        CHECK(same_stats(session, brute_force(all)));
+        if (all.size() > 1) {
+            CHECK(near(session.rate, (all.size() - 1) / (all.back().t - all.front().t)));
+        }
+
+        SampleRing ring;
+        CHECK(model.copy_series("v", &ring, nullptr));
+        std::vector<ChannelSample> recent(ring.size());
+        for (size_t i = 0; i < ring.size(); ++i) {
+            recent[i] = ring.at(i);
+        }
+        CHECK(same_stats(window, brute_force(recent)));
+        CHECK(recent.empty() || recent.front().t >= t - 2.0 - 0.1);
+    }
+}
+} // namespace
+
+void run_stats_tests() {
+    test_stats();
+}
@@ -0,0 +1,51 @@
+// Behaviour tests for the core library, one suite per feature. Built on the
+// same core library as the GUI and the headless tool.
+
+#include <cstdio>
+#include <cstring>
+
+#include "test_util.h"
+#include "tests.h"
+
+namespace {
+struct Suite {
+    const char* name;
+    void (*run)();
+};
+
+const Suite kSuites[] = {
+    {"aggregate", run_aggregate_tests},
+    {"derived", run_derived_tests},
+    {"history", run_history_tests},
+    {"ring", run_ring_tests},
+    {"stats", run_stats_tests},
+    {"transitions", run_transition_tests},
+};
+
+void print_usage(const char* argv0) {
+    std::fprintf(stderr, "Usage: %s [suite]\n\nSuites (all when none is given):\n", argv0);
+    for (const auto& suite : kSuites) {
+        std::fprintf(stderr, "  %s\n", suite.name);
+    }
+}
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc > 1 && (std::strcmp(argv[1], "-h") == 0 || std::strcmp(argv[1], "--help") == 0)) {
+        print_usage(argv[0]);
+        return 0;
+    }
+    bool found = false;
+    for (const auto& suite : kSuites) {
+        if (argc < 2 || std::strcmp(argv[1], suite.name) == 0) {
+            suite.run();
+            found = true;
+        }
+    }
+    if (!found) {
+        std::fprintf(stderr, "Unknown suite: %s\n\n", argv[1]);
+        print_usage(argv[0]);
+        return 1;
+    }
+    return test::failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdio>
+
+namespace test {
+// Failed checks since the process started.
+inline int failures = 0;
+
+// Reports a failed check; returns cond so loops can stop at the first.
+inline bool check(bool cond, const char* expr, const char* file, int line) {
+    if (!cond) {
+        std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", file, line, expr);
+        failures++;
+    }
+    return cond;
+}
+} // namespace test
+
+#define CHECK(cond) ::test::check((cond), #cond, __FILE__, __LINE__)
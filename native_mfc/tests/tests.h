@@ -0,0 +1,10 @@
+#pragma once
+
+// Suites of simple_com_chart_tests. Each checks one feature against a
+// brute-force result and reports failures through CHECK.
+void run_aggregate_tests();
+void run_derived_tests();
+void run_history_tests();
+void run_ring_tests();
+void run_stats_tests();
+void run_transition_tests();
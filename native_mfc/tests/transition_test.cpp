@@ -0,0 +1,121 @@
+// The transition index against the value changes in the stored series,
+// including samples merged into the one before them.
+
+#include <map>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "channel_model.h"
+#include "test_util.h"
+#include "tests.h"
+
+namespace {
+constexpr int kAny = TransitionIndex::kAnyValue;
+
+std::vector<Transition> changes_in(const ChannelModel& model, const std::string& key) {
+    std::vector<ChannelSample> samples;
+    model.read_history(key, -1e9, 1e9, &samples);
+    std::vector<Transition> out;
+    for (size_t i = 1; i < samples.size(); ++i) {
+        if (samples[i].v != samples[i - 1].v) {
+            out.push_back(Transition{samples[i].t, samples[i - 1].v, samples[i].v});
+        }
+    }
+    return out;
+}
+
+// Walks the index with next and prev and compares every query kind.
+void check_index(const ChannelModel& model, const std::string& key) {
+    std::vector<Transition> ref = changes_in(model, key);
+    if (!CHECK(model.count_transitions(key, kAny, kAny) == ref.size())) {
+        return;
+    }
+    Transition tr;
+    double t = -1e9;
+    for (const Transition& want : ref) {
+        if (!CHECK(model.find_next_transition(key, t, kAny, kAny, &tr) && tr.t == want.t && tr.from == want.from &&
+                   tr.to == want.to)) {
+            return;
+        }
+        t = tr.t;
+    }
+    CHECK(!model.find_next_transition(key, t, kAny, kAny, &tr));
+    t = 1e9;
+    for (auto it = ref.rbegin(); it != ref.rend(); ++it) {
+        if (!CHECK(model.find_prev_transition(key, t, it->from, it->to, &tr) && tr.t == it->t)) {
+            return;
+        }
+        t = tr.t;
+    }
+
+    std::map<std::pair<int, int>, uint64_t> kinds;
+    for (const Transition& c : ref) {
+        kinds[{c.from, c.to}]++;
+    }
+    std::vector<TransitionCount> counts = model.get_transition_counts(key);
+    CHECK(counts.size() == kinds.size());
+    for (const TransitionCount& c : counts) {
+        CHECK(kinds[std::make_pair(c.from, c.to)] == c.count && model.count_transitions(key, c.from, c.to) == c.count);
+    }
+}
+
+// A, B, then B and C merged into the B sample: one change, A -> C.
+void test_merge() {
+    ChannelModel model;
+    model.set_transition_index("s", true);
+    model.update_from_kv({{"s", 1}}, 0.0);
+    model.update_from_kv({{"s", 2}}, 1.0);
+    model.update_from_kv({{"s", 2}}, 1.0002);
+    CHECK(model.count_transitions("s", 1, 2) == 1);
+    model.update_from_kv({{"s", 3}}, 1.0004);
+    CHECK(model.count_transitions("s", kAny, kAny) == 1);
+    CHECK(model.count_transitions("s", 1, 3) == 1);
+    check_index(model, "s");
+    // Merged back to the value before: no change at all.
+    model.update_from_kv({{"s", 1}}, 1.0006);
+    CHECK(model.count_transitions("s", kAny, kAny) == 0);
+    check_index(model, "s");
+}
+
+// State-like channels on shared lines, with lines close enough to merge.
+void test_random() {
+    std::mt19937 rng(5);
+    ChannelModel model;
+    const std::vector<std::string> keys = {"a", "b", "c", "d", "e", "f", "g", "h"};
+    for (const std::string& key : keys) {
+        model.set_transition_index(key, true);
+    }
+    std::vector<int> state(keys.size(), 0);
+    double t = 0.0;
+    for (int line = 0; line < 50000; ++line) {
+        t += rng() % 3 == 0 ? 0.0002 : 0.001;
+        std::unordered_map<std::string, int> kv;
+        for (size_t k = 0; k < keys.size(); ++k) {
+            uint32_t r = rng();
+            if (r % 8 == 0) {
+                state[k] = static_cast<int>((r >> 8) % 4);
+            }
+            if ((r >> 16) % 4 != 0) {
+                kv[keys[k]] = state[k];
+            }
+        }
+        model.update_from_kv(kv, t);
+    }
+    for (const std::string& key : keys) {
+        check_index(model, key);
+    }
+    // Rebuilt from the stored samples, the index is the same.
+    model.set_transition_index("a", false);
+    CHECK(model.count_transitions("a", kAny, kAny) == 0);
+    model.set_transition_index("a", true);
+    check_index(model, "a");
+}
+} // namespace
+
+void run_transition_tests() {
+    test_merge();
+    test_random();
+}